@@ -8,6 +8,7 @@
 
 #define BUILD_FOLDER "build/"
 #define SRC_FOLDER "src/"
+#define TESTS_FOLDER "tests/"
 
 #define BUILD_FAILED_MSG                                                                           \
     nob_log(NOB_ERROR, "--- Build Failed --------------------------------------");
@@ -21,6 +22,10 @@ int main(int argc, char **argv)
     Nob_Cmd cmd = {0};
     bool install_lazypm = false;
     bool run_lazypm = false;
+    bool test_lazypm = false;
+    bool bench_lazypm = false;
+    // count allocations per subsystem and log them on exit
+    bool alloc_stats = false;
 
     while (argc > 1)
     {
@@ -33,15 +38,32 @@ int main(int argc, char **argv)
         {
             run_lazypm = true;
         }
+        else if (strcmp(flag, "--test") == 0 || strcmp(flag, "-t") == 0 ||
+                 strcmp(flag, "test") == 0)
+        {
+            test_lazypm = true;
+        }
+        else if (strcmp(flag, "--bench") == 0 || strcmp(flag, "-b") == 0 ||
+                 strcmp(flag, "bench") == 0)
+        {
+            bench_lazypm = true;
+        }
+        else if (strcmp(flag, "--alloc-stats") == 0)
+        {
+            alloc_stats = true;
+        }
         else
         {
             nob_log(NOB_WARNING, "Unknown flag: \"%s\"", flag);
         }
         nob_shift_args(&argc, &argv);
     }
-    nob_cmd_append(&cmd, "cc", "-Wall", "-Wextra");
+    nob_cmd_append(&cmd, "cc", "-Wall", "-Wextra", "-pthread");
+    if (alloc_stats)
+        nob_cmd_append(&cmd, "-DLPM_ALLOC_STATS");
 
     Nob_File_Paths src_files = {0};
+    Nob_File_Paths c_files = {0};
     if (!nob_read_entire_dir(SRC_FOLDER, &src_files))
     {
         BUILD_FAILED_MSG
@@ -64,6 +86,7 @@ int main(int argc, char **argv)
         const char *file_ext = &temp_file_name[len - 2];
         if (strcmp(file_ext, ".h") == 0)
             continue;
+        nob_da_append(&c_files, temp_full_path);
         nob_cmd_append(&cmd, temp_full_path);
     }
 
@@ -79,6 +102,53 @@ int main(int argc, char **argv)
     // reaching here, the actual build of lazypm has succeeded, but user may have passed
     // in extra flags to automate running other processes.
 
+    // build and run the checks under tests/, each one is linked against the sources it covers
+    if (test_lazypm)
+    {
+        nob_log(NOB_INFO, "--- Test Lazypm ----------------------------------------");
+        nob_cmd_append(&cmd, "cc", "-Wall", "-Wextra", TESTS_FOLDER "version.c",
+                       SRC_FOLDER "version.c", "-o", BUILD_FOLDER "version_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+        {
+            nob_log(NOB_ERROR, "Failed to build the version checks");
+            return 1;
+        }
+        nob_cmd_append(&cmd, BUILD_FOLDER "version_test");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+        {
+            nob_log(NOB_ERROR, "Version checks failed");
+            return 1;
+        }
+        nob_log(NOB_INFO, "--- Tests Passed ---------------------------------------");
+    }
+
+    // build tests/bench.c optimized, against every source but the entry point, and run it
+    if (bench_lazypm)
+    {
+        nob_log(NOB_INFO, "--- Bench Lazypm ---------------------------------------");
+        // -O2 flags the labels the TUI cuts short on purpose
+        nob_cmd_append(&cmd, "cc", "-Wall", "-Wextra", "-Wno-format-truncation",
+                       "-Wno-stringop-truncation", "-O2", "-pthread", TESTS_FOLDER "bench.c");
+        for (size_t i = 0; i < c_files.count; ++i)
+        {
+            if (strcmp(c_files.items[i], SRC_FOLDER "lazypm.c") != 0)
+                nob_cmd_append(&cmd, c_files.items[i]);
+        }
+        nob_cmd_append(&cmd, "-o", BUILD_FOLDER "bench");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+        {
+            nob_log(NOB_ERROR, "Failed to build the benchmarks");
+            return 1;
+        }
+        nob_cmd_append(&cmd, BUILD_FOLDER "bench");
+        if (!nob_cmd_run_sync_and_reset(&cmd))
+        {
+            nob_log(NOB_ERROR, "Benchmarks failed");
+            return 1;
+        }
+        nob_log(NOB_INFO, "--- Bench Done -----------------------------------------");
+    }
+
     // copy lazypm executable to /usr/local/bin
     if (install_lazypm)
     {
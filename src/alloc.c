@@ -0,0 +1,274 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// alloc.c - Scoped bump arenas and optional per-subsystem allocation accounting
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_ARENA
+#include "alloc.h"
+#include "logs.h"
+#include <stdatomic.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+// "12.3 KiB" style, for the exit log
+static void _lpm_alloc_format_bytes(size_t bytes, char *buf, size_t size)
+{
+    if (bytes < 1024)
+        snprintf(buf, size, "%zu B", bytes);
+    else if (bytes < 1024 * 1024)
+        snprintf(buf, size, "%.1f KiB", bytes / 1024.0);
+    else
+        snprintf(buf, size, "%.1f MiB", bytes / (1024.0 * 1024.0));
+}
+
+//
+// Counting allocator
+//
+
+typedef struct
+{
+    atomic_size_t allocations; // malloc and realloc calls
+    atomic_size_t bytes;       // requested over the whole session
+    atomic_size_t live;
+    atomic_size_t peak; // of live
+} LPM_Alloc_Counters;
+
+static LPM_Alloc_Counters _lpm_alloc_counters[LPM_ALLOC_SUBSYSTEM_COUNT];
+
+#ifdef LPM_ALLOC_STATS
+static const char *_lpm_alloc_subsystem_names[LPM_ALLOC_SUBSYSTEM_COUNT] = {
+    "core", "packages", "filter", "facets", "process", "tui", "arena",
+};
+#endif // LPM_ALLOC_STATS
+
+// Prepended to every counted block, sized to keep the block aligned for any type
+typedef union
+{
+    struct
+    {
+        size_t size;
+        LPM_Alloc_Subsystem subsystem;
+    } info;
+    max_align_t align;
+} LPM_Alloc_Header;
+
+static void _lpm_alloc_grow(LPM_Alloc_Subsystem subsystem, size_t size)
+{
+    LPM_Alloc_Counters *counters = &_lpm_alloc_counters[subsystem];
+    atomic_fetch_add_explicit(&counters->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->bytes, size, memory_order_relaxed);
+    size_t live = atomic_fetch_add_explicit(&counters->live, size, memory_order_relaxed) + size;
+    size_t peak = atomic_load_explicit(&counters->peak, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(&counters->peak, &peak, live,
+                                                                 memory_order_relaxed,
+                                                                 memory_order_relaxed))
+        ;
+}
+
+static void _lpm_alloc_shrink(LPM_Alloc_Subsystem subsystem, size_t size)
+{
+    atomic_fetch_sub_explicit(&_lpm_alloc_counters[subsystem].live, size, memory_order_relaxed);
+}
+
+void *lpm_alloc_malloc(LPM_Alloc_Subsystem subsystem, size_t size)
+{
+    LPM_Alloc_Header *header = malloc(sizeof(*header) + size);
+    if (header == NULL)
+        return NULL;
+    header->info.size = size;
+    header->info.subsystem = subsystem;
+    _lpm_alloc_grow(subsystem, size);
+    return header + 1;
+}
+
+void *lpm_alloc_realloc(LPM_Alloc_Subsystem subsystem, void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return lpm_alloc_malloc(subsystem, size);
+    LPM_Alloc_Header *header = (LPM_Alloc_Header *)ptr - 1;
+    size_t old_size = header->info.size;
+    // charged to whoever allocated it first
+    subsystem = header->info.subsystem;
+    header = realloc(header, sizeof(*header) + size);
+    if (header == NULL)
+        return NULL;
+    header->info.size = size;
+    if (size > old_size)
+        _lpm_alloc_grow(subsystem, size - old_size);
+    else
+        _lpm_alloc_shrink(subsystem, old_size - size);
+    return header + 1;
+}
+
+void lpm_alloc_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    LPM_Alloc_Header *header = (LPM_Alloc_Header *)ptr - 1;
+    _lpm_alloc_shrink(header->info.subsystem, header->info.size);
+    free(header);
+}
+
+char *lpm_alloc_strdup(LPM_Alloc_Subsystem subsystem, const char *s)
+{
+    size_t len = strlen(s);
+    char *dup = lpm_alloc_malloc(subsystem, len + 1);
+    if (dup)
+        memcpy(dup, s, len + 1);
+    return dup;
+}
+
+int lpm_alloc_vasprintf(LPM_Alloc_Subsystem subsystem, char **strp, const char *fmt, va_list args)
+{
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    if (len < 0)
+        return -1;
+    *strp = lpm_alloc_malloc(subsystem, (size_t)len + 1);
+    if (*strp == NULL)
+        return -1;
+    vsnprintf(*strp, (size_t)len + 1, fmt, args);
+    return len;
+}
+
+//
+// Arenas
+//
+
+typedef struct LPM_Arena_Block
+{
+    struct LPM_Arena_Block *next;
+    size_t capacity;
+    size_t used;
+    _Alignas(max_align_t) unsigned char data[];
+} LPM_Arena_Block;
+
+typedef struct
+{
+    LPM_Arena_Block *head; // block being filled, older blocks follow
+    size_t used;
+    size_t high_water;
+    size_t resets;
+} LPM_Arena;
+
+static LPM_Arena _lpm_arenas[LPM_ARENA_SCOPE_COUNT];
+
+static const char *_lpm_arena_names[LPM_ARENA_SCOPE_COUNT] = {"load", "frame", "command"};
+
+static void _lpm_arena_push_block(LPM_Arena *arena, size_t capacity)
+{
+    LPM_Arena_Block *block = LPM_MALLOC(sizeof(*block) + capacity);
+    LPM_ASSERT(block != NULL && "Buy more RAM lol");
+    block->next = arena->head;
+    block->capacity = capacity;
+    block->used = 0;
+    arena->head = block;
+}
+
+static size_t _lpm_arena_free_blocks(LPM_Arena *arena)
+{
+    size_t capacity = 0;
+    while (arena->head)
+    {
+        LPM_Arena_Block *next = arena->head->next;
+        capacity += arena->head->capacity;
+        LPM_FREE(arena->head);
+        arena->head = next;
+    }
+    return capacity;
+}
+
+void *lpm_arena_alloc(LPM_Arena_Scope scope, size_t size)
+{
+    LPM_Arena *arena = &_lpm_arenas[scope];
+    size = size == 0 ? ARENA_ALIGN : (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (arena->head == NULL || arena->head->capacity - arena->head->used < size)
+        _lpm_arena_push_block(arena, size > LPM_ARENA_BLOCK_SIZE ? size : LPM_ARENA_BLOCK_SIZE);
+
+    void *ptr = arena->head->data + arena->head->used;
+    arena->head->used += size;
+    arena->used += size;
+    if (arena->used > arena->high_water)
+        arena->high_water = arena->used;
+    return ptr;
+}
+
+int lpm_arena_asprintf(LPM_Arena_Scope scope, char **strp, const char *fmt, ...)
+{
+    // format straight into the free space of the current block, only a string that doesn't fit
+    // is formatted twice
+    LPM_Arena_Block *head = _lpm_arenas[scope].head;
+    size_t available = head ? head->capacity - head->used : 0;
+    char *free_space = head ? (char *)head->data + head->used : NULL;
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(free_space, available, fmt, args);
+    va_end(args);
+    LPM_ASSERT(len >= 0 && "lpm_arena_asprintf: Bad format");
+    // returns free_space when the string fit
+    *strp = lpm_arena_alloc(scope, (size_t)len + 1);
+    if (*strp != free_space)
+    {
+        va_start(args, fmt);
+        vsnprintf(*strp, (size_t)len + 1, fmt, args);
+        va_end(args);
+    }
+    return len;
+}
+
+void lpm_arena_reset(LPM_Arena_Scope scope)
+{
+    LPM_Arena *arena = &_lpm_arenas[scope];
+    if (arena->head && arena->head->next)
+        _lpm_arena_push_block(arena, _lpm_arena_free_blocks(arena));
+    else if (arena->head)
+        arena->head->used = 0;
+    arena->used = 0;
+    arena->resets++;
+}
+
+void lpm_arena_release(LPM_Arena_Scope scope)
+{
+    LPM_Arena *arena = &_lpm_arenas[scope];
+    _lpm_arena_free_blocks(arena);
+    arena->used = 0;
+    arena->resets++;
+}
+
+void lpm_alloc_teardown(void)
+{
+    char message[1024];
+    size_t len = snprintf(message, sizeof(message), "Arena high-water marks");
+    for (size_t scope = 0; scope < LPM_ARENA_SCOPE_COUNT; ++scope)
+    {
+        char high_water[32];
+        _lpm_alloc_format_bytes(_lpm_arenas[scope].high_water, high_water, sizeof(high_water));
+        if (len < sizeof(message))
+            len += snprintf(message + len, sizeof(message) - len, "\n\t%-8s: %s over %zu resets",
+                            _lpm_arena_names[scope], high_water, _lpm_arenas[scope].resets);
+        _lpm_arena_free_blocks(&_lpm_arenas[scope]);
+    }
+    LPM_LOG_INFO("%s", message);
+
+#ifdef LPM_ALLOC_STATS
+    len = snprintf(message, sizeof(message), "Allocations by subsystem");
+    for (size_t subsystem = 0; subsystem < LPM_ALLOC_SUBSYSTEM_COUNT; ++subsystem)
+    {
+        LPM_Alloc_Counters *counters = &_lpm_alloc_counters[subsystem];
+        char bytes[32], peak[32], live[32];
+        _lpm_alloc_format_bytes(atomic_load(&counters->bytes), bytes, sizeof(bytes));
+        _lpm_alloc_format_bytes(atomic_load(&counters->peak), peak, sizeof(peak));
+        _lpm_alloc_format_bytes(atomic_load(&counters->live), live, sizeof(live));
+        if (len < sizeof(message))
+            len += snprintf(message + len, sizeof(message) - len,
+                            "\n\t%-8s: %zu allocations, %s requested, %s peak, %s live",
+                            _lpm_alloc_subsystem_names[subsystem],
+                            atomic_load(&counters->allocations), bytes, peak, live);
+    }
+    LPM_LOG_INFO("%s", message);
+#endif // LPM_ALLOC_STATS
+}
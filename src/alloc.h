@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// alloc.h - Scoped bump arenas and optional per-subsystem allocation accounting
+//
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bytes requested from LPM_MALLOC for each new arena block, bigger requests get their own block
+#ifndef LPM_ARENA_BLOCK_SIZE
+#define LPM_ARENA_BLOCK_SIZE (64 * 1024)
+#endif // LPM_ARENA_BLOCK_SIZE
+
+// Where an allocation is charged when lazypm is built with LPM_ALLOC_STATS. Every translation unit
+// defines LPM_ALLOC_SUBSYSTEM before its first include, anything else is charged to core.
+typedef enum
+{
+    LPM_ALLOC_CORE,
+    LPM_ALLOC_PACKAGES,
+    LPM_ALLOC_FILTER,
+    LPM_ALLOC_FACETS,
+    LPM_ALLOC_PROCESS,
+    LPM_ALLOC_TUI,
+    LPM_ALLOC_ARENA,
+    LPM_ALLOC_SUBSYSTEM_COUNT,
+} LPM_Alloc_Subsystem;
+
+#ifndef LPM_ALLOC_SUBSYSTEM
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_CORE
+#endif // LPM_ALLOC_SUBSYSTEM
+
+// Counting allocator behind LPM_MALLOC, LPM_REALLOC, LPM_FREE, LPM_STRDUP and LPM_VASPRINTF when
+// LPM_ALLOC_STATS is defined. Every block carries a small header with its size and subsystem.
+void *lpm_alloc_malloc(LPM_Alloc_Subsystem subsystem, size_t size);
+void *lpm_alloc_realloc(LPM_Alloc_Subsystem subsystem, void *ptr, size_t size);
+void lpm_alloc_free(void *ptr);
+char *lpm_alloc_strdup(LPM_Alloc_Subsystem subsystem, const char *s);
+int lpm_alloc_vasprintf(LPM_Alloc_Subsystem subsystem, char **strp, const char *fmt, va_list args);
+
+// Memory that lives as long as its phase and is given back all at once. Arenas belong to the main
+// thread, workers keep using LPM_MALLOC.
+typedef enum
+{
+    LPM_ARENA_LOAD,    // loading the package list and its indexes, released once the TUI is up
+    LPM_ARENA_FRAME,   // drawing one frame, reset before the next one
+    LPM_ARENA_COMMAND, // handling one key press, including any transaction it starts
+    LPM_ARENA_SCOPE_COUNT,
+} LPM_Arena_Scope;
+
+// size bytes aligned for any type, never NULL. Not to be freed, see lpm_arena_reset.
+void *lpm_arena_alloc(LPM_Arena_Scope scope, size_t size);
+// lpm_asprintf into the arena of scope
+int lpm_arena_asprintf(LPM_Arena_Scope scope, char **strp, const char *fmt, ...);
+// Forget every allocation of scope but keep its memory, merged into a single block when it took
+// several, so a steady workload stops allocating
+void lpm_arena_reset(LPM_Arena_Scope scope);
+// Forget every allocation of scope and give its memory back
+void lpm_arena_release(LPM_Arena_Scope scope);
+
+// Log arena high-water marks, and with LPM_ALLOC_STATS the allocations, bytes and peak of every
+// subsystem. Arenas are released.
+void lpm_alloc_teardown(void);
@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// backend.c - Where package knowledge comes from: xbps binaries or a fixture
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "backend.h"
+
+static const LPM_Backend *_lpm_backends[] = {
+    &lpm_backend_cli, // first is the default
+    &lpm_backend_fixture,
+};
+
+static const LPM_Backend *_lpm_backend_current = NULL;
+
+void lpm_backend_init(void)
+{
+    _lpm_backend_current = _lpm_backends[0];
+    const char *name = getenv("LPM_BACKEND");
+    if (name == NULL || *name == '\0')
+        return;
+    for (size_t i = 0; i < sizeof(_lpm_backends) / sizeof(*_lpm_backends); ++i)
+    {
+        if (strcmp(_lpm_backends[i]->name, name) == 0)
+        {
+            _lpm_backend_current = _lpm_backends[i];
+            LPM_LOG_INFO("Using the %s package backend", name);
+            return;
+        }
+    }
+    LPM_LOG_WARNING("Unknown package backend \"%s\", using %s", name,
+                    _lpm_backend_current->name);
+}
+
+void lpm_backend_teardown(void)
+{
+    if (_lpm_backend_current && _lpm_backend_current->teardown)
+        _lpm_backend_current->teardown();
+    _lpm_backend_current = NULL;
+}
+
+const LPM_Backend *lpm_backend(void)
+{
+    if (_lpm_backend_current == NULL)
+        lpm_backend_init();
+    return _lpm_backend_current;
+}
@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// backend.h - Where package knowledge comes from: xbps binaries or a fixture
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "process.h"
+#include "progress.h"
+
+// Listings use the `xbps-query -Rs` format, one "[*] pkgver short_desc" line per package ("[-]"
+// when not installed), NUL-terminated at out->items[out->count]. Package lists passed to
+// transactions are NULL-terminated pkgver arrays.
+typedef struct
+{
+    const char *name;
+
+    // Every package of every repository
+    LPM_Exit_Code (*list)(LPM_Process_Buffer *out);
+
+    // Install or update pkgvers, syncing the repositories first
+    LPM_Exit_Code (*install)(char *const pkgvers[], LPM_Progress *progress);
+    LPM_Exit_Code (*remove)(char *const pkgvers[], LPM_Progress *progress);
+    // Update pkgnames without syncing, or sync and update the whole system when pkgnames is NULL
+    LPM_Exit_Code (*upgrade)(char *const pkgnames[], LPM_Progress *progress);
+    // Resolve installing pkgvers, or removing them, without running the transaction. One
+    // "pkgver action arch repository installed_size download_size" line per package like
+    // `xbps-install -n`, stderr lines go to errors. Runs on a worker thread, no arena is touched.
+    LPM_Exit_Code (*dry_run)(char *const pkgvers[], bool remove, LPM_Process_Buffer *out,
+                             LPM_Process_Line_Callback errors, void *data);
+
+    // "<package count> <url> (<signature>)" per repository, like `xbps-query -L`
+    LPM_Exit_Code (*repositories)(LPM_Process_Buffer *out);
+    // list restricted to the repository at url
+    LPM_Exit_Code (*repository)(const char *url, LPM_Process_Buffer *out);
+    // Installed pkgvers nothing depends on anymore, one per line, like `xbps-query -O`
+    LPM_Exit_Code (*orphans)(LPM_Process_Buffer *out);
+
+    void (*teardown)(void); // optional
+} LPM_Backend;
+
+extern const LPM_Backend lpm_backend_cli;
+extern const LPM_Backend lpm_backend_fixture;
+
+// Pick the backend named by $LPM_BACKEND ("cli" or "fixture"), the cli by default. The fixture
+// backend serves the `xbps-query -Rs` style listing in the file named by $LPM_BACKEND_FIXTURE,
+// nothing is spawned.
+void lpm_backend_init(void);
+void lpm_backend_teardown(void);
+const LPM_Backend *lpm_backend(void);
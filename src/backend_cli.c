@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// backend_cli.c - Package backend running the xbps-query, xbps-install and xbps-remove binaries
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "backend.h"
+
+static void _lpm_backend_cli_progress_line(char *line, size_t len, LPM_Process_Stream stream,
+                                           void *data)
+{
+    // xbps reports errors on stderr, they belong in the output all the same
+    LPM_UNUSED(stream);
+    lpm_progress_feed(data, line, len);
+}
+
+// Run prefix followed by args (both NULL-terminated), following its output with progress when it
+// is set
+static LPM_Exit_Code _lpm_backend_cli_transaction(char *const prefix[], char *const args[],
+                                                  LPM_Progress *progress)
+{
+    size_t prefix_count = 0, args_count = 0;
+    while (prefix[prefix_count])
+        prefix_count++;
+    while (args && args[args_count])
+        args_count++;
+    char **argv =
+        lpm_arena_alloc(LPM_ARENA_COMMAND, (prefix_count + args_count + 1) * sizeof(*argv));
+    memcpy(argv, prefix, prefix_count * sizeof(*argv));
+    if (args_count > 0)
+        memcpy(argv + prefix_count, args, args_count * sizeof(*argv));
+    argv[prefix_count + args_count] = NULL;
+
+    LPM_Exit_Code result;
+    if (progress == NULL)
+        result = lpm_process_run(argv, NULL, NULL, NULL);
+    else
+    {
+        if (progress->output)
+        {
+            // separate the output of consecutive commands
+            char *cmd = lpm_process_describe(argv);
+            char *header;
+            size_t len = lpm_asprintf(&header, "$ %s", cmd);
+            lpm_output_append(progress->output, header, len, false);
+            LPM_FREE(header);
+            LPM_FREE(cmd);
+        }
+        result = lpm_process_run(argv, NULL, _lpm_backend_cli_progress_line, progress);
+    }
+    return result;
+}
+
+static LPM_Exit_Code _lpm_backend_cli_list(LPM_Process_Buffer *out)
+{
+    char *argv[] = {"xbps-query", "-Rs", "", NULL};
+    return lpm_process_run(argv, out, NULL, NULL);
+}
+
+static LPM_Exit_Code _lpm_backend_cli_install(char *const pkgvers[], LPM_Progress *progress)
+{
+    char *prefix[] = {"sudo", "xbps-install", "-Sy", NULL};
+    return _lpm_backend_cli_transaction(prefix, pkgvers, progress);
+}
+
+static LPM_Exit_Code _lpm_backend_cli_remove(char *const pkgvers[], LPM_Progress *progress)
+{
+    char *prefix[] = {"sudo", "xbps-remove", "-yo", NULL};
+    return _lpm_backend_cli_transaction(prefix, pkgvers, progress);
+}
+
+static LPM_Exit_Code _lpm_backend_cli_upgrade(char *const pkgnames[], LPM_Progress *progress)
+{
+    char *everything[] = {"sudo", "xbps-install", "-Syu", NULL};
+    char *some[] = {"sudo", "xbps-install", "-u", NULL};
+    return _lpm_backend_cli_transaction(pkgnames ? some : everything, pkgnames, progress);
+}
+
+static LPM_Exit_Code _lpm_backend_cli_dry_run(char *const pkgvers[], bool remove,
+                                              LPM_Process_Buffer *out,
+                                              LPM_Process_Line_Callback errors, void *data)
+{
+    // the same flags as the transactions, minus the sync: dry runs read the local repodata, and
+    // need no root
+    char *install[] = {"xbps-install", "-n", NULL};
+    char *removal[] = {"xbps-remove", "-n", "-o", NULL};
+    char **prefix = remove ? removal : install;
+    size_t prefix_count = 0, count = 0;
+    while (prefix[prefix_count])
+        prefix_count++;
+    while (pkgvers[count])
+        count++;
+    char **argv = LPM_MALLOC((prefix_count + count + 1) * sizeof(*argv));
+    LPM_ASSERT(argv != NULL && "Buy more RAM lol");
+    memcpy(argv, prefix, prefix_count * sizeof(*argv));
+    memcpy(argv + prefix_count, pkgvers, (count + 1) * sizeof(*argv));
+    LPM_Exit_Code result = lpm_process_run(argv, out, errors, data);
+    LPM_FREE(argv);
+    return result;
+}
+
+static LPM_Exit_Code _lpm_backend_cli_repositories(LPM_Process_Buffer *out)
+{
+    char *argv[] = {"xbps-query", "-L", NULL};
+    return lpm_process_run(argv, out, NULL, NULL);
+}
+
+static LPM_Exit_Code _lpm_backend_cli_repository(const char *url, LPM_Process_Buffer *out)
+{
+    char *repository;
+    lpm_asprintf(&repository, "--repository=%s", url);
+    char *argv[] = {"xbps-query", "-i", repository, "-Rs", "", NULL};
+    LPM_Exit_Code result = lpm_process_run(argv, out, NULL, NULL);
+    LPM_FREE(repository);
+    return result;
+}
+
+static LPM_Exit_Code _lpm_backend_cli_orphans(LPM_Process_Buffer *out)
+{
+    char *argv[] = {"xbps-query", "-O", NULL};
+    return lpm_process_run(argv, out, NULL, NULL);
+}
+
+const LPM_Backend lpm_backend_cli = {
+    .name = "cli",
+    .list = _lpm_backend_cli_list,
+    .install = _lpm_backend_cli_install,
+    .remove = _lpm_backend_cli_remove,
+    .upgrade = _lpm_backend_cli_upgrade,
+    .dry_run = _lpm_backend_cli_dry_run,
+    .repositories = _lpm_backend_cli_repositories,
+    .repository = _lpm_backend_cli_repository,
+    .orphans = _lpm_backend_cli_orphans,
+};
@@ -0,0 +1,262 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// backend_fixture.c - Package backend serving a canned `xbps-query -Rs` listing from a file
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "backend.h"
+
+// The listing, loaded on first use. Transactions flip the "[*]"/"[-]" markers in place, so later
+// listings see their effect, nothing is ever written back to the file.
+static LPM_Process_Buffer _lpm_backend_fixture_listing = {0};
+static bool _lpm_backend_fixture_loaded = false;
+
+static LPM_Exit_Code _lpm_backend_fixture_load(void)
+{
+    if (_lpm_backend_fixture_loaded)
+        return LPM_OK;
+    const char *path = getenv("LPM_BACKEND_FIXTURE");
+    if (path == NULL || *path == '\0')
+    {
+        LPM_LOG_ERROR("The fixture backend needs LPM_BACKEND_FIXTURE to name a listing file");
+        return LPM_ERROR_FILE_READ;
+    }
+    FILE *fp = fopen(path, "re");
+    if (fp == NULL)
+    {
+        LPM_LOG_ERROR("Failed to open fixture \"%s\"\n\tReason  : %s", path, strerror(errno));
+        return LPM_ERROR_FILE_READ;
+    }
+    LPM_Process_Buffer *listing = &_lpm_backend_fixture_listing;
+    size_t nread;
+    do
+    {
+        LPM_DA_RESERVE(listing, listing->count + LPM_PROCESS_READ_CHUNK_SIZE + 1);
+        nread = fread(listing->items + listing->count, 1, LPM_PROCESS_READ_CHUNK_SIZE, fp);
+        listing->count += nread;
+    } while (nread > 0);
+    fclose(fp);
+    listing->items[listing->count] = '\0';
+    _lpm_backend_fixture_loaded = true;
+    return LPM_OK;
+}
+
+static void _lpm_backend_fixture_append(LPM_Process_Buffer *out, const char *text, size_t len)
+{
+    LPM_DA_RESERVE(out, out->count + len + 1);
+    memcpy(out->items + out->count, text, len);
+    out->count += len;
+    out->items[out->count] = '\0';
+}
+
+// Next listing line from *cursor (without its '\n') into *line/*len, false at the end
+static bool _lpm_backend_fixture_next(char **cursor, char **line, size_t *len)
+{
+    char *end = _lpm_backend_fixture_listing.items + _lpm_backend_fixture_listing.count;
+    if (*cursor >= end)
+        return false;
+    char *newline = memchr(*cursor, '\n', end - *cursor);
+    *line = *cursor;
+    *len = (newline ? newline : end) - *cursor;
+    *cursor = newline ? newline + 1 : end;
+    return true;
+}
+
+// Length of the pkgver field of a listing line, which starts 4 bytes in
+static size_t _lpm_backend_fixture_pkgver_len(const char *line, size_t len)
+{
+    if (len < 4)
+        return 0;
+    const char *space = memchr(line + 4, ' ', len - 4);
+    return (space ? space : line + len) - (line + 4);
+}
+
+// Listing line of the package named pkgver
+static char *_lpm_backend_fixture_find(const char *pkgver, size_t *line_len)
+{
+    size_t want = strlen(pkgver);
+    char *cursor = _lpm_backend_fixture_listing.items;
+    char *line;
+    size_t len;
+    while (_lpm_backend_fixture_next(&cursor, &line, &len))
+    {
+        if (_lpm_backend_fixture_pkgver_len(line, len) == want &&
+            memcmp(line + 4, pkgver, want) == 0)
+        {
+            *line_len = len;
+            return line;
+        }
+    }
+    return NULL;
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_list(LPM_Process_Buffer *out)
+{
+    LPM_Exit_Code result = _lpm_backend_fixture_load();
+    if (result != LPM_OK)
+        return result;
+    _lpm_backend_fixture_append(out, _lpm_backend_fixture_listing.items,
+                                _lpm_backend_fixture_listing.count);
+    return LPM_OK;
+}
+
+static void _lpm_backend_fixture_feed(LPM_Progress *progress, const char *fmt, ...)
+{
+    if (progress == NULL)
+        return;
+    char line[LPM_PROGRESS_NAME_MAX + 64];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    lpm_progress_feed(progress, line, len < (int)sizeof(line) ? (size_t)len : sizeof(line) - 1);
+}
+
+// Mark every pkgver installed or not, reporting through progress like xbps would
+static LPM_Exit_Code _lpm_backend_fixture_transaction(char *const pkgvers[], bool install,
+                                                      LPM_Progress *progress)
+{
+    LPM_Exit_Code result = _lpm_backend_fixture_load();
+    if (result != LPM_OK)
+        return result;
+
+    size_t count = 0;
+    for (size_t i = 0; pkgvers[i]; ++i)
+    {
+        size_t len;
+        if (_lpm_backend_fixture_find(pkgvers[i], &len) == NULL)
+        {
+            _lpm_backend_fixture_feed(progress, "Package '%s' not found in repository pool.",
+                                      pkgvers[i]);
+            return LPM_ERROR_COMMAND_FAIL;
+        }
+        count++;
+    }
+
+    _lpm_backend_fixture_feed(progress, "%zu packages will be %s:", count,
+                              install ? "installed" : "removed");
+    for (size_t i = 0; pkgvers[i]; ++i)
+    {
+        size_t len;
+        char *line = _lpm_backend_fixture_find(pkgvers[i], &len);
+        memcpy(line, install ? "[*]" : "[-]", 3);
+        _lpm_backend_fixture_feed(progress, "%s: %s successfully.", pkgvers[i],
+                                  install ? "installed" : "removed");
+    }
+    _lpm_backend_fixture_feed(progress, "0 downloaded, %zu installed, 0 updated, %zu configured, "
+                              "%zu removed.",
+                              install ? count : 0, install ? count : 0, install ? 0 : count);
+    return LPM_OK;
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_install(char *const pkgvers[], LPM_Progress *progress)
+{
+    return _lpm_backend_fixture_transaction(pkgvers, true, progress);
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_remove(char *const pkgvers[], LPM_Progress *progress)
+{
+    return _lpm_backend_fixture_transaction(pkgvers, false, progress);
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_upgrade(char *const pkgnames[], LPM_Progress *progress)
+{
+    // a listing holds a single version of every package, it is always up to date
+    LPM_UNUSED(pkgnames);
+    LPM_Exit_Code result = _lpm_backend_fixture_load();
+    if (result == LPM_OK)
+        _lpm_backend_fixture_feed(
+            progress, "0 downloaded, 0 installed, 0 updated, 0 configured, 0 removed.");
+    return result;
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_dry_run(char *const pkgvers[], bool remove,
+                                                  LPM_Process_Buffer *out,
+                                                  LPM_Process_Line_Callback errors, void *data)
+{
+    // listings carry neither sizes nor dependencies, a transaction is the packages themselves
+    LPM_Exit_Code result = _lpm_backend_fixture_load();
+    if (result != LPM_OK)
+        return result;
+    for (size_t i = 0; pkgvers[i]; ++i)
+    {
+        size_t len;
+        const char *line = _lpm_backend_fixture_find(pkgvers[i], &len);
+        if (line == NULL)
+        {
+            char message[LPM_PROGRESS_NAME_MAX + 64];
+            int message_len = snprintf(message, sizeof(message),
+                                       "Package '%s' not found in repository pool.", pkgvers[i]);
+            if (errors)
+                errors(message, (size_t)message_len < sizeof(message) ? (size_t)message_len
+                                                                      : sizeof(message) - 1,
+                       LPM_PROCESS_STDERR, data);
+            return LPM_ERROR_COMMAND_FAIL;
+        }
+        // xbps has nothing to do for a package already in the wanted state
+        if ((line[1] == '*') != remove)
+            continue;
+        char *text;
+        size_t text_len = lpm_asprintf(&text, "%s %s noarch fixture 0 0\n", pkgvers[i],
+                                       remove ? "remove" : "install");
+        _lpm_backend_fixture_append(out, text, text_len);
+        LPM_FREE(text);
+    }
+    _lpm_backend_fixture_append(out, "", 0);
+    return LPM_OK;
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_repositories(LPM_Process_Buffer *out)
+{
+    LPM_Exit_Code result = _lpm_backend_fixture_load();
+    if (result != LPM_OK)
+        return result;
+    size_t count = 0;
+    char *cursor = _lpm_backend_fixture_listing.items;
+    char *line;
+    size_t len;
+    while (_lpm_backend_fixture_next(&cursor, &line, &len))
+        count++;
+    char *text;
+    size_t text_len = lpm_asprintf(&text, "%zu fixture:%s (unsigned)\n", count,
+                                   getenv("LPM_BACKEND_FIXTURE"));
+    _lpm_backend_fixture_append(out, text, text_len);
+    LPM_FREE(text);
+    return LPM_OK;
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_repository(const char *url, LPM_Process_Buffer *out)
+{
+    LPM_UNUSED(url);
+    return _lpm_backend_fixture_list(out);
+}
+
+static LPM_Exit_Code _lpm_backend_fixture_orphans(LPM_Process_Buffer *out)
+{
+    LPM_Exit_Code result = _lpm_backend_fixture_load();
+    if (result == LPM_OK)
+        _lpm_backend_fixture_append(out, "", 0); // nothing is ever orphaned
+    return result;
+}
+
+static void _lpm_backend_fixture_teardown(void)
+{
+    LPM_DA_FREE(_lpm_backend_fixture_listing);
+    _lpm_backend_fixture_listing = (LPM_Process_Buffer){0};
+    _lpm_backend_fixture_loaded = false;
+}
+
+const LPM_Backend lpm_backend_fixture = {
+    .name = "fixture",
+    .list = _lpm_backend_fixture_list,
+    .install = _lpm_backend_fixture_install,
+    .remove = _lpm_backend_fixture_remove,
+    .upgrade = _lpm_backend_fixture_upgrade,
+    .dry_run = _lpm_backend_fixture_dry_run,
+    .repositories = _lpm_backend_fixture_repositories,
+    .repository = _lpm_backend_fixture_repository,
+    .orphans = _lpm_backend_fixture_orphans,
+    .teardown = _lpm_backend_fixture_teardown,
+};
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "alloc.h"
 #include "external/termbox2.h"
 #include <ctype.h>
 #include <errno.h>
@@ -34,6 +35,18 @@
 #define LPM_ASSERT assert
 #endif // LPM_ASSERT
 
+//
+// Allocation seam, see alloc.h
+//
+
+#ifdef LPM_ALLOC_STATS
+#define LPM_MALLOC(size) lpm_alloc_malloc(LPM_ALLOC_SUBSYSTEM, size)
+#define LPM_REALLOC(ptr, size) lpm_alloc_realloc(LPM_ALLOC_SUBSYSTEM, ptr, size)
+#define _LPM_FREE lpm_alloc_free
+#define LPM_STRDUP(s) lpm_alloc_strdup(LPM_ALLOC_SUBSYSTEM, s)
+#define LPM_VASPRINTF(strp, fmt, args) lpm_alloc_vasprintf(LPM_ALLOC_SUBSYSTEM, strp, fmt, args)
+#endif // LPM_ALLOC_STATS
+
 #ifndef LPM_MALLOC
 #include <stdlib.h>
 #define LPM_MALLOC malloc
@@ -44,10 +57,10 @@
 #define LPM_REALLOC realloc
 #endif // LPM_REALLOC
 
-#ifndef LPM_FREE
+#ifndef _LPM_FREE
 #include <stdlib.h>
 #define _LPM_FREE free
-#endif // LPM_FREE
+#endif // _LPM_FREE
 
 #define LPM_FREE(ptr)                                                                              \
     do                                                                                             \
@@ -147,6 +160,7 @@ static inline int lpm_vasprintf(char **strp, const char *fmt, va_list args)
 #define LPM_FG_COLOR_GREEN TB_GREEN
 #define LPM_FG_COLOR_RED TB_RED
 #define LPM_FG_COLOR_BLUE TB_BLUE
+#define LPM_FG_COLOR_MARKED TB_YELLOW
 #define LPM_BG_COLOR 0
 #define LPM_BG_COLOR_HIGHLIGHT TB_MAGENTA
 #define LPM_BG_COLOR_HIGHLIGHT_FILTER TB_BLUE
@@ -0,0 +1,362 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// facets.c - Narrow the package list by install state and repository using bitsets
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_FACETS
+#include "facets.h"
+
+static const char *_lpm_facet_names[LPM_FACET_COUNT] = {
+    [LPM_FACET_INSTALLED] = "installed",
+    [LPM_FACET_AVAILABLE] = "available",
+    [LPM_FACET_UPGRADABLE] = "upgradable",
+    [LPM_FACET_ORPHAN] = "orphan",
+    [LPM_FACET_SOURCE] = "source",
+};
+
+void lpm_bitset_init(LPM_Bitset *set, size_t bits)
+{
+    size_t words = (bits + 63) / 64;
+    set->count = 0;
+    LPM_DA_RESERVE(set, words);
+    if (words > 0)
+        memset(set->items, 0, words * sizeof(*set->items));
+    set->count = words;
+}
+
+// Split the next line off *cursor, NUL-terminated in place, NULL once the buffer is exhausted
+static char *_lpm_facets_next_line(char **cursor, char *end)
+{
+    if (*cursor >= end)
+        return NULL;
+    char *line = *cursor;
+    char *newline = memchr(line, '\n', end - line);
+    if (newline == NULL)
+        newline = end;
+    *newline = '\0';
+    *cursor = newline + 1;
+    return line;
+}
+
+// Split line on whitespace in place, returns the number of fields stored in fields
+static size_t _lpm_facets_fields(char *line, char **fields, size_t max)
+{
+    size_t count = 0;
+    char *p = line;
+    while (count < max)
+    {
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            break;
+        fields[count++] = p;
+        while (*p != '\0' && !isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            break;
+        *p++ = '\0';
+    }
+    return count;
+}
+
+static void _lpm_facets_mark_pkgname(LPM_Bitset *set, const LPM_Package_Index *index,
+                                     const char *pkgver)
+{
+    size_t first, last;
+    lpm_packages_index_range(index, pkgver, lpm_packages_pkgname_len(pkgver), &first, &last);
+    for (size_t i = first; i < last; ++i)
+        lpm_bitset_set(set, index->items[i].row, true);
+}
+
+static void _lpm_facets_build_repositories(LPM_Facets *facets, const LPM_Package_Index *index)
+{
+    LPM_Packages_Buffer output = {0};
+    if (lpm_packages_list_repositories(&output) != LPM_OK || output.items == NULL)
+    {
+        LPM_DA_FREE(output);
+        return;
+    }
+
+    // `xbps-query -L` prints "<package count> <url> (<signature>)" per repository
+    char *cursor = output.items;
+    char *line;
+    while ((line = _lpm_facets_next_line(&cursor, output.items + output.count)) != NULL &&
+           facets->count < LPM_FACETS_MAX_REPOSITORIES)
+    {
+        char *fields[2];
+        if (_lpm_facets_fields(line, fields, 2) < 2)
+            continue;
+        char *url = fields[1];
+
+        LPM_Facets_Repository repo = {.url = lpm_strdup(url)};
+        lpm_bitset_init(&repo.rows, facets->row_count);
+
+        LPM_Packages repo_pkgs = {0};
+        lpm_packages_get_repository(&repo_pkgs, url);
+        for (size_t i = 0; i < repo_pkgs.count; ++i)
+        {
+            const char *pkgver = repo_pkgs.items[i].name;
+            size_t first, last;
+            lpm_packages_index_range(index, pkgver, lpm_packages_pkgname_len(pkgver), &first,
+                                     &last);
+            for (size_t j = first; j < last; ++j)
+            {
+                if (strcmp(index->items[j].pkgver, pkgver) == 0)
+                    lpm_bitset_set(&repo.rows, index->items[j].row, true);
+            }
+        }
+        lpm_packages_teardown(&repo_pkgs);
+        LPM_DA_APPEND(facets, repo);
+    }
+    LPM_DA_FREE(output);
+}
+
+static void _lpm_facets_combine(LPM_Facets *facets)
+{
+    size_t words = (facets->row_count + 63) / 64;
+    lpm_bitset_init(&facets->combined, facets->row_count);
+    for (size_t w = 0; w < words; ++w)
+    {
+        uint64_t word = ~UINT64_C(0);
+        for (size_t f = 0; f < LPM_FACET_COUNT; ++f)
+        {
+            if (facets->active & (1u << f))
+                word &= facets->sets[f].items[w];
+        }
+        if (facets->active_repos)
+        {
+            uint64_t repos = 0;
+            for (size_t r = 0; r < facets->count; ++r)
+            {
+                if (facets->active_repos & (UINT64_C(1) << r))
+                    repos |= facets->items[r].rows.items[w];
+            }
+            word &= repos;
+        }
+        facets->combined.items[w] = word;
+    }
+    facets->combined_generation = facets->generation;
+}
+
+void lpm_facets_build(LPM_Facets *facets, const LPM_Packages *pkgs)
+{
+    uint32_t active = facets->active;
+    uint64_t generation = facets->generation;
+    lpm_facets_teardown(facets);
+    facets->generation = generation + 1;
+    facets->row_count = pkgs->count;
+    for (size_t f = 0; f < LPM_FACET_COUNT; ++f)
+        lpm_bitset_init(&facets->sets[f], pkgs->count);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < pkgs->count; ++i)
+    {
+        const char *status = pkgs->items[i].status;
+        lpm_bitset_set(&facets->sets[LPM_FACET_INSTALLED], i,
+                       strcmp(status, LPM_PACKAGE_STATUS_INSTALLED) == 0);
+        lpm_bitset_set(&facets->sets[LPM_FACET_AVAILABLE], i,
+                       strcmp(status, LPM_PACKAGE_STATUS_AVAILABLE) == 0);
+        lpm_bitset_set(&facets->sets[LPM_FACET_SOURCE], i,
+                       strcmp(status, LPM_PACKAGE_STATUS_SOURCE) == 0);
+    }
+
+    LPM_Package_Index index = {0};
+    lpm_packages_index_build(&index, pkgs);
+
+    LPM_Packages_Buffer output = {0};
+    if (lpm_packages_list_orphans(&output) == LPM_OK && output.items)
+    {
+        // one installed pkgver per line
+        char *cursor = output.items;
+        char *line;
+        while ((line = _lpm_facets_next_line(&cursor, output.items + output.count)) != NULL)
+        {
+            char *fields[1];
+            if (_lpm_facets_fields(line, fields, 1) == 1)
+                _lpm_facets_mark_pkgname(&facets->sets[LPM_FACET_ORPHAN], &index, fields[0]);
+        }
+    }
+    LPM_DA_FREE(output);
+
+    _lpm_facets_build_repositories(facets, &index);
+    LPM_DA_FREE(index);
+
+    // source rows share pkgnames with binary ones but are neither installed nor in a repository
+    const uint64_t *source = facets->sets[LPM_FACET_SOURCE].items;
+    for (size_t w = 0; w < facets->sets[LPM_FACET_SOURCE].count; ++w)
+    {
+        facets->sets[LPM_FACET_ORPHAN].items[w] &= ~source[w];
+        for (size_t r = 0; r < facets->count; ++r)
+            facets->items[r].rows.items[w] &= ~source[w];
+    }
+
+    facets->active = active;
+    _lpm_facets_combine(facets);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Built facets over %zu packages and %zu repositories in %.1f ms", pkgs->count,
+                 facets->count, elapsed_ms);
+}
+
+void lpm_facets_teardown(LPM_Facets *facets)
+{
+    for (size_t f = 0; f < LPM_FACET_COUNT; ++f)
+    {
+        LPM_DA_FREE(facets->sets[f]);
+        facets->sets[f] = (LPM_Bitset){0};
+    }
+    for (size_t i = 0; i < facets->count; ++i)
+    {
+        LPM_FREE(facets->items[i].url);
+        LPM_DA_FREE(facets->items[i].rows);
+    }
+    LPM_DA_FREE(*facets);
+    LPM_DA_FREE(facets->combined);
+    facets->combined = (LPM_Bitset){0};
+    facets->count = 0;
+    facets->capacity = 0;
+    facets->row_count = 0;
+    facets->active = 0;
+    facets->active_repos = 0;
+}
+
+bool lpm_facets_any_active(const LPM_Facets *facets)
+{
+    return facets->active != 0 || facets->active_repos != 0;
+}
+
+void lpm_facets_toggle(LPM_Facets *facets, LPM_Facet facet)
+{
+    facets->active ^= 1u << facet;
+    // a row is either installed, available or a source package, AND-ing two would always be empty
+    const uint32_t states = (1u << LPM_FACET_INSTALLED) | (1u << LPM_FACET_AVAILABLE) |
+                            (1u << LPM_FACET_SOURCE);
+    if ((states & (1u << facet)) && (facets->active & (1u << facet)))
+        facets->active &= ~(states & ~(1u << facet));
+    _lpm_facets_combine(facets);
+}
+
+void lpm_facets_cycle_repository(LPM_Facets *facets)
+{
+    if (facets->count == 0)
+        return;
+    size_t next = 0;
+    for (size_t r = 0; r < facets->count; ++r)
+    {
+        if (facets->active_repos & (UINT64_C(1) << r))
+            next = r + 1;
+    }
+    facets->active_repos = next < facets->count ? UINT64_C(1) << next : 0;
+    _lpm_facets_combine(facets);
+}
+
+const char *lpm_facets_repository(const LPM_Facets *facets)
+{
+    for (size_t r = 0; r < facets->count; ++r)
+    {
+        if (facets->active_repos & (UINT64_C(1) << r))
+            return facets->items[r].url;
+    }
+    return NULL;
+}
+
+void lpm_facets_restore(LPM_Facets *facets, uint32_t active, const char *repository)
+{
+    facets->active = active & ((1u << LPM_FACET_COUNT) - 1);
+    facets->active_repos = 0;
+    for (size_t r = 0; repository && r < facets->count; ++r)
+    {
+        if (strcmp(facets->items[r].url, repository) == 0)
+            facets->active_repos = UINT64_C(1) << r;
+    }
+    _lpm_facets_combine(facets);
+}
+
+void lpm_facets_set_installed(LPM_Facets *facets, size_t row, bool installed)
+{
+    if (row >= facets->row_count || lpm_bitset_test(&facets->sets[LPM_FACET_SOURCE], row))
+        return;
+    facets->generation++;
+    lpm_bitset_set(&facets->sets[LPM_FACET_INSTALLED], row, installed);
+    lpm_bitset_set(&facets->sets[LPM_FACET_AVAILABLE], row, !installed);
+    // freshly installed or updated rows are current, removed rows are neither
+    lpm_bitset_set(&facets->sets[LPM_FACET_UPGRADABLE], row, false);
+    if (!installed)
+        lpm_bitset_set(&facets->sets[LPM_FACET_ORPHAN], row, false);
+    _lpm_facets_combine(facets);
+}
+
+void lpm_facets_set_upgradable(LPM_Facets *facets, const LPM_Package_Rows *rows)
+{
+    LPM_Bitset *set = &facets->sets[LPM_FACET_UPGRADABLE];
+    facets->generation++;
+    lpm_bitset_init(set, facets->row_count);
+    for (size_t i = 0; i < rows->count; ++i)
+    {
+        if (rows->items[i] < facets->row_count)
+            lpm_bitset_set(set, rows->items[i], true);
+    }
+    _lpm_facets_combine(facets);
+}
+
+bool lpm_facets_swap_selection(LPM_Facets *facets, LPM_Facets_Selection *selection)
+{
+    LPM_Facets_Selection shown = {
+        .active = facets->active,
+        .active_repos = facets->active_repos,
+        .combined = facets->combined,
+        .combined_generation = facets->combined_generation,
+    };
+    facets->active = selection->active;
+    facets->active_repos = selection->active_repos;
+    facets->combined = selection->combined;
+    facets->combined_generation = selection->combined_generation;
+    *selection = shown;
+    // without facets selected the combined rows are not looked at, they get recombined on toggle
+    if (!lpm_facets_any_active(facets) || facets->combined_generation == facets->generation)
+        return false;
+    _lpm_facets_combine(facets);
+    return true;
+}
+
+void lpm_facets_apply(const LPM_Facets *facets, const LPM_Package_Rows *rows,
+                      LPM_Package_Rows *out)
+{
+    out->count = 0;
+    LPM_DA_RESERVE(out, rows->count);
+    if (!lpm_facets_any_active(facets) || facets->combined.items == NULL)
+    {
+        if (rows->count > 0)
+            memcpy(out->items, rows->items, rows->count * sizeof(*rows->items));
+        out->count = rows->count;
+        return;
+    }
+    for (size_t i = 0; i < rows->count; ++i)
+    {
+        uint32_t row = rows->items[i];
+        if (row < facets->row_count && lpm_bitset_test(&facets->combined, row))
+            out->items[out->count++] = row;
+    }
+}
+
+void lpm_facets_describe(const LPM_Facets *facets, char *buf, size_t size)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    for (size_t f = 0; f < LPM_FACET_COUNT && len < size; ++f)
+    {
+        if (facets->active & (1u << f))
+            len += snprintf(buf + len, size - len, "%s%s", len ? ", " : "", _lpm_facet_names[f]);
+    }
+    for (size_t r = 0; r < facets->count && len < size; ++r)
+    {
+        if (facets->active_repos & (UINT64_C(1) << r))
+            len += snprintf(buf + len, size - len, "%s%s", len ? ", " : "", facets->items[r].url);
+    }
+}
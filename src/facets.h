@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// facets.h - Narrow the package list by install state and repository using bitsets
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "packages.h"
+
+#define LPM_FACETS_MAX_REPOSITORIES 64
+
+typedef enum
+{
+    LPM_FACET_INSTALLED,
+    LPM_FACET_AVAILABLE,
+    LPM_FACET_UPGRADABLE,
+    LPM_FACET_ORPHAN,
+    LPM_FACET_SOURCE, // templates of a void-packages checkout, see srcpkgs.h
+    LPM_FACET_COUNT,
+} LPM_Facet;
+
+// One bit per row of the package table
+typedef struct
+{
+    uint64_t *items;
+    size_t count; // words
+    size_t capacity;
+} LPM_Bitset;
+
+// Size set for bits bits, all cleared
+void lpm_bitset_init(LPM_Bitset *set, size_t bits);
+
+static inline void lpm_bitset_set(LPM_Bitset *set, size_t bit, bool value)
+{
+    if (value)
+        set->items[bit / 64] |= UINT64_C(1) << (bit % 64);
+    else
+        set->items[bit / 64] &= ~(UINT64_C(1) << (bit % 64));
+}
+
+static inline bool lpm_bitset_test(const LPM_Bitset *set, size_t bit)
+{
+    return (set->items[bit / 64] >> (bit % 64)) & 1;
+}
+
+typedef struct
+{
+    char *url;
+    LPM_Bitset rows;
+} LPM_Facets_Repository;
+
+typedef struct
+{
+    LPM_Bitset sets[LPM_FACET_COUNT];
+    LPM_Facets_Repository *items; // configured repositories
+    size_t count;
+    size_t capacity;
+    size_t row_count;
+
+    uint32_t active;              // bit per LPM_Facet, active facets are AND-ed together
+    uint64_t active_repos;        // bit per repository, selected repositories are OR-ed together
+    LPM_Bitset combined;          // cached result of the active facets
+    uint64_t generation;          // bumped whenever a set changes
+    uint64_t combined_generation; // generation combined was computed at
+} LPM_Facets;
+
+// What a view has selected of the facets, kept aside while another view is shown. See
+// lpm_facets_swap_selection.
+typedef struct
+{
+    uint32_t active;
+    uint64_t active_repos;
+    LPM_Bitset combined;
+    uint64_t combined_generation;
+} LPM_Facets_Selection;
+
+// Compute every facet for pkgs except upgradable, which comes from lpm_facets_set_upgradable.
+// This is the only place xbps is queried, toggling a facet afterwards only combines bitsets.
+void lpm_facets_build(LPM_Facets *facets, const LPM_Packages *pkgs);
+void lpm_facets_teardown(LPM_Facets *facets);
+
+bool lpm_facets_any_active(const LPM_Facets *facets);
+void lpm_facets_toggle(LPM_Facets *facets, LPM_Facet facet);
+// Cycle the repository filter: all repositories -> first -> second -> ... -> all repositories
+void lpm_facets_cycle_repository(LPM_Facets *facets);
+// url of the selected repository, NULL when every repository is
+const char *lpm_facets_repository(const LPM_Facets *facets);
+// Activate exactly the facets of the active bits and the repository with url repository, e.g.
+// from a saved session. A repository that is no longer configured selects every repository.
+void lpm_facets_restore(LPM_Facets *facets, uint32_t active, const char *repository);
+// Keep the install state facets in sync after installing or uninstalling a row
+void lpm_facets_set_installed(LPM_Facets *facets, size_t row, bool installed);
+// Replace the upgradable facet, e.g. with the rows found by lpm_upgrades_compute
+void lpm_facets_set_upgradable(LPM_Facets *facets, const LPM_Package_Rows *rows);
+
+// Exchange the active selection with the one kept aside by another view, without copying the
+// combined rows. They are only recombined when facets are selected and a set changed since.
+//
+// Returns true when they were, rows the view narrowed with the old ones are stale.
+bool lpm_facets_swap_selection(LPM_Facets *facets, LPM_Facets_Selection *selection);
+
+// out = rows that pass every active facet, in the order of rows
+void lpm_facets_apply(const LPM_Facets *facets, const LPM_Package_Rows *rows,
+                      LPM_Package_Rows *out);
+// Short human readable summary of the active facets, e.g. "installed, orphan"
+void lpm_facets_describe(const LPM_Facets *facets, char *buf, size_t size);
@@ -0,0 +1,232 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// files.c - Files of an installed package, streamed in by a background thread
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "files.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Text of the paths is copied into blocks of this size, they never move either
+#define FILES_TEXT_BLOCK_SIZE (64 * 1024)
+
+typedef struct
+{
+    char *text; // free space of the current block
+    size_t text_left;
+} LPM_Files_Writer;
+
+// Copy path into the text blocks and publish it, false once the list is full
+static bool _lpm_files_append(LPM_Files *files, LPM_Files_Writer *writer, const char *path)
+{
+    size_t count = atomic_load_explicit(&files->count, memory_order_relaxed);
+    size_t chunk = count / LPM_FILES_CHUNK_ENTRIES;
+    if (chunk >= LPM_FILES_MAX_CHUNKS)
+        return false;
+    if (files->chunks[chunk] == NULL)
+    {
+        files->chunks[chunk] = LPM_MALLOC(LPM_FILES_CHUNK_ENTRIES * sizeof(*files->chunks[chunk]));
+        LPM_ASSERT(files->chunks[chunk] != NULL && "Buy more RAM lol");
+    }
+
+    size_t len = strlen(path);
+    if (writer->text_left < len + 1)
+    {
+        size_t size = len + 1 > FILES_TEXT_BLOCK_SIZE ? len + 1 : FILES_TEXT_BLOCK_SIZE;
+        writer->text = LPM_MALLOC(size);
+        LPM_ASSERT(writer->text != NULL && "Buy more RAM lol");
+        writer->text_left = size;
+        LPM_DA_APPEND(&files->blocks, writer->text);
+    }
+    memcpy(writer->text, path, len + 1);
+    files->chunks[chunk][count % LPM_FILES_CHUNK_ENTRIES] = writer->text;
+    writer->text += len + 1;
+    writer->text_left -= len + 1;
+    // the path and its chunk are written before the count that makes them visible
+    atomic_store_explicit(&files->count, count + 1, memory_order_release);
+    return true;
+}
+
+static LPM_Exit_Code _lpm_files_stream(LPM_Files *files)
+{
+    int fd = open(files->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (errno == ENOENT)
+            return LPM_OK; // a metapackage, it has no files
+        LPM_LOG_ERROR("Failed to open \"%s\"\n\tReason  : %s", files->path, strerror(errno));
+        return LPM_ERROR_FILE_READ;
+    }
+
+    LPM_Exit_Code result = LPM_OK;
+    LPM_Packages_Buffer buf = {0};
+    LPM_Pkgdb_Paths paths = {0};
+    LPM_Pkgdb_Files_Parser parser = {0};
+    LPM_Files_Writer writer = {0};
+    while (!atomic_load(&files->cancel))
+    {
+        LPM_DA_RESERVE(&buf, buf.count + LPM_FILES_READ_SIZE + 1);
+        ssize_t n = read(fd, buf.items + buf.count, LPM_FILES_READ_SIZE);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            LPM_LOG_ERROR("Failed to read \"%s\"\n\tReason  : %s", files->path, strerror(errno));
+            LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+        }
+        if (n == 0)
+            break;
+        buf.count += (size_t)n;
+        buf.items[buf.count] = '\0';
+
+        paths.count = 0;
+        size_t consumed = lpm_pkgdb_parse_files(&parser, buf.items, buf.count, &paths);
+        for (size_t i = 0; i < paths.count; ++i)
+        {
+            if (!_lpm_files_append(files, &writer, paths.items[i]))
+            {
+                LPM_LOG_WARNING("Listing the first %zu files of %s only",
+                                atomic_load(&files->count), files->pkgver);
+                LPM_CLEANUP_RETURN(LPM_OK);
+            }
+        }
+        memmove(buf.items, buf.items + consumed, buf.count - consumed);
+        buf.count -= consumed;
+    }
+
+cleanup:
+    close(fd);
+    LPM_DA_FREE(buf);
+    LPM_DA_FREE(paths);
+    return result;
+}
+
+static void *_lpm_files_worker(void *arg)
+{
+    LPM_Files *files = arg;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    files->result = _lpm_files_stream(files);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    files->elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Listed %zu files of %s in %.1f ms", atomic_load(&files->count), files->pkgver,
+                 files->elapsed_ms);
+    atomic_store(&files->done, true);
+    return NULL;
+}
+
+void lpm_files_start(LPM_Files *files, const char *pkgdb_path, const char *pkgver)
+{
+    lpm_files_teardown(files);
+    strncpy(files->pkgver, pkgver, sizeof(files->pkgver) - 1);
+    files->path = lpm_pkgdb_files_path(pkgdb_path, pkgver);
+    atomic_store(&files->done, false);
+    atomic_store(&files->cancel, false);
+    files->active = true;
+    int err = pthread_create(&files->thread, NULL, _lpm_files_worker, files);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start the files thread, listing inline\n\tReason  : %s",
+                        strerror(err));
+        _lpm_files_worker(files);
+        return;
+    }
+    files->started = true;
+}
+
+bool lpm_files_active(const LPM_Files *files)
+{
+    return files->active;
+}
+
+bool lpm_files_poll(LPM_Files *files)
+{
+    if (!files->active || !atomic_load(&files->done))
+        return false;
+    if (files->started)
+        pthread_join(files->thread, NULL);
+    files->started = false;
+    files->active = false;
+    return true;
+}
+
+size_t lpm_files_count(const LPM_Files *files)
+{
+    return atomic_load_explicit(&files->count, memory_order_acquire);
+}
+
+const char *lpm_files_get(const LPM_Files *files, size_t index)
+{
+    return files->chunks[index / LPM_FILES_CHUNK_ENTRIES][index % LPM_FILES_CHUNK_ENTRIES];
+}
+
+void lpm_files_set_query(LPM_Files *files, const char *query)
+{
+    if (strcmp(files->query, query) == 0)
+        return;
+    // a longer query only narrows the rows already matched
+    bool narrowing = files->query[0] != '\0' && strstr(query, files->query) != NULL;
+    strncpy(files->query, query, sizeof(files->query) - 1);
+    files->query[sizeof(files->query) - 1] = '\0';
+    if (!narrowing)
+    {
+        files->rows.count = 0;
+        files->filtered = 0;
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < files->rows.count; ++i)
+    {
+        if (strstr(lpm_files_get(files, files->rows.items[i]), files->query))
+            files->rows.items[kept++] = files->rows.items[i];
+    }
+    files->rows.count = kept;
+}
+
+size_t lpm_files_view_count(LPM_Files *files)
+{
+    size_t count = lpm_files_count(files);
+    if (files->query[0] == '\0')
+        return count;
+    for (; files->filtered < count; ++files->filtered)
+    {
+        if (strstr(lpm_files_get(files, files->filtered), files->query))
+            LPM_DA_APPEND(&files->rows, (uint32_t)files->filtered);
+    }
+    return files->rows.count;
+}
+
+const char *lpm_files_view_get(const LPM_Files *files, size_t row)
+{
+    if (files->query[0] == '\0')
+        return lpm_files_get(files, row);
+    return lpm_files_get(files, files->rows.items[row]);
+}
+
+void lpm_files_teardown(LPM_Files *files)
+{
+    atomic_store(&files->cancel, true);
+    if (files->started)
+        pthread_join(files->thread, NULL);
+    files->started = false;
+    files->active = false;
+    for (size_t i = 0; i < LPM_FILES_MAX_CHUNKS && files->chunks[i]; ++i)
+        LPM_FREE(files->chunks[i]);
+    for (size_t i = 0; i < files->blocks.count; ++i)
+        LPM_FREE(files->blocks.items[i]);
+    LPM_DA_FREE(files->blocks);
+    files->blocks = (LPM_Files_Blocks){0};
+    LPM_DA_FREE(files->rows);
+    files->rows = (LPM_Files_Rows){0};
+    LPM_FREE(files->path);
+    atomic_store(&files->count, 0);
+    files->filtered = 0;
+    files->query[0] = '\0';
+    files->pkgver[0] = '\0';
+}
@@ -0,0 +1,88 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// files.h - Files of an installed package, streamed in by a background thread
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "pkgdb.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Paths per chunk of the list. Chunks never move once published, so the main thread reads them
+// while the worker appends.
+#ifndef LPM_FILES_CHUNK_ENTRIES
+#define LPM_FILES_CHUNK_ENTRIES 4096
+#endif // LPM_FILES_CHUNK_ENTRIES
+
+// Bigger lists are cut off, 4M paths is well past texlive-full
+#define LPM_FILES_MAX_CHUNKS 1024
+
+// Bytes read from the files plist at a time, the first screen shows after the first read
+#ifndef LPM_FILES_READ_SIZE
+#define LPM_FILES_READ_SIZE (64 * 1024)
+#endif // LPM_FILES_READ_SIZE
+
+#define LPM_FILES_QUERY_MAX_LEN 256
+
+typedef struct
+{
+    char **items;
+    size_t count;
+    size_t capacity;
+} LPM_Files_Blocks;
+
+typedef struct
+{
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} LPM_Files_Rows;
+
+typedef struct
+{
+    char pkgver[LPM_PACKAGE_NAME_MAX];
+
+    // written by the worker, read by the main thread up to count
+    const char **chunks[LPM_FILES_MAX_CHUNKS];
+    atomic_size_t count;
+    LPM_Files_Blocks blocks; // text of the paths, only touched by the worker
+
+    pthread_t thread;
+    bool started;
+    bool active;
+    atomic_bool done;
+    atomic_bool cancel;
+    char *path;
+    LPM_Exit_Code result;
+    double elapsed_ms;
+
+    // only touched by the main thread, see lpm_files_view_count
+    char query[LPM_FILES_QUERY_MAX_LEN];
+    LPM_Files_Rows rows; // entries matching query, unused without a query
+    size_t filtered;     // entries already matched against query
+} LPM_Files;
+
+// Stream the files of the installed package pkgver from its files plist next to the pkgdb at
+// pkgdb_path, replacing the previous list
+void lpm_files_start(LPM_Files *files, const char *pkgdb_path, const char *pkgver);
+bool lpm_files_active(const LPM_Files *files);
+// Returns true once, when the whole list is in
+bool lpm_files_poll(LPM_Files *files);
+// Paths streamed in so far
+size_t lpm_files_count(const LPM_Files *files);
+const char *lpm_files_get(const LPM_Files *files, size_t index);
+
+// Only show the paths containing query, "" shows all of them
+void lpm_files_set_query(LPM_Files *files, const char *query);
+// Rows of the view, the paths matching the query. Matches the paths streamed in since the last
+// call first, so the cost per frame follows what arrived rather than the length of the list.
+size_t lpm_files_view_count(LPM_Files *files);
+const char *lpm_files_view_get(const LPM_Files *files, size_t row);
+
+// Stop the worker and free the list
+void lpm_files_teardown(LPM_Files *files);
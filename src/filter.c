@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// filter.c - Filter the package list, with memoized results and query history
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_FILTER
+#include "filter.h"
+
+static size_t _lpm_filter_entry_bytes(const LPM_Filter_Cache_Entry *entry)
+{
+    return sizeof(*entry) + strlen(entry->query) + 1 +
+           entry->rows.capacity * sizeof(*entry->rows.items);
+}
+
+static void _lpm_filter_entry_free(LPM_Filter_Cache_Entry *entry)
+{
+    LPM_FREE(entry->query);
+    LPM_DA_FREE(entry->rows);
+}
+
+void lpm_filter_invalidate(LPM_Filter *filter)
+{
+    for (size_t i = 0; i < filter->count; ++i)
+        _lpm_filter_entry_free(&filter->items[i]);
+    filter->count = 0;
+    filter->bytes = 0;
+}
+
+void lpm_filter_index(LPM_Filter *filter, const LPM_Packages *pkgs)
+{
+    lpm_filter_invalidate(filter);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lpm_trigram_index_build(&filter->index, pkgs);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Built trigram index over %zu packages in %.1f ms\n\tMemory  : %zu KiB, %zu "
+                 "trigrams, %zu bytes of postings",
+                 pkgs->count, elapsed_ms, lpm_trigram_index_bytes(&filter->index) / 1024,
+                 filter->index.key_count, filter->index.postings_size);
+}
+
+void lpm_filter_teardown(LPM_Filter *filter)
+{
+    lpm_filter_invalidate(filter);
+    lpm_trigram_index_teardown(&filter->index);
+    LPM_DA_FREE(*filter);
+    filter->capacity = 0;
+    for (size_t i = 0; i < filter->history_count; ++i)
+        LPM_FREE(filter->history[i]);
+    filter->history_count = 0;
+    filter->history_cursor = 0;
+}
+
+// Trim surrounding whitespace and lowercase, so "Python " and "python" share a cache entry
+static void _lpm_filter_normalize(const char *query, char *out, size_t out_size)
+{
+    while (isspace((unsigned char)*query))
+        query++;
+    size_t len = strlen(query);
+    while (len > 0 && isspace((unsigned char)query[len - 1]))
+        len--;
+    if (len >= out_size)
+        len = out_size - 1;
+    for (size_t i = 0; i < len; ++i)
+        out[i] = (char)tolower((unsigned char)query[i]);
+    out[len] = '\0';
+}
+
+static void _lpm_filter_evict(LPM_Filter *filter)
+{
+    while (filter->bytes > LPM_FILTER_CACHE_BUDGET && filter->count > 0)
+    {
+        size_t lru = 0;
+        for (size_t i = 1; i < filter->count; ++i)
+        {
+            if (filter->items[i].last_used < filter->items[lru].last_used)
+                lru = i;
+        }
+        filter->bytes -= _lpm_filter_entry_bytes(&filter->items[lru]);
+        _lpm_filter_entry_free(&filter->items[lru]);
+        filter->items[lru] = filter->items[--filter->count];
+    }
+}
+
+void lpm_filter_query(LPM_Filter *filter, const LPM_Packages *pkgs, const char *query,
+                      LPM_Package_Rows *rows)
+{
+    char needle[LPM_FILTER_QUERY_MAX_LEN];
+    _lpm_filter_normalize(query, needle, sizeof(needle));
+    if (needle[0] == '\0')
+    {
+        lpm_packages_rows_all(rows, pkgs);
+        return;
+    }
+
+    // Exact hit, or the narrowest cached query this one refines: every row matching "python3"
+    // also matches "python", so only the rows cached for "python" need to be rescanned.
+    LPM_Filter_Cache_Entry *base = NULL;
+    for (size_t i = 0; i < filter->count; ++i)
+    {
+        LPM_Filter_Cache_Entry *entry = &filter->items[i];
+        if (strstr(needle, entry->query) == NULL)
+            continue;
+        if (base == NULL || entry->rows.count < base->rows.count)
+            base = entry;
+    }
+
+    filter->clock++;
+    if (base && strcmp(base->query, needle) == 0)
+    {
+        base->last_used = filter->clock;
+        rows->count = 0;
+        LPM_DA_RESERVE(rows, base->rows.count);
+        if (base->rows.count > 0)
+            memcpy(rows->items, base->rows.items, base->rows.count * sizeof(*rows->items));
+        rows->count = base->rows.count;
+        return;
+    }
+
+    LPM_Filter_Cache_Entry entry = {.query = lpm_strdup(needle), .last_used = filter->clock};
+    if (base)
+    {
+        base->last_used = filter->clock;
+        for (size_t i = 0; i < base->rows.count; ++i)
+        {
+            if (lpm_packages_contains(&pkgs->items[base->rows.items[i]], needle))
+                LPM_DA_APPEND(&entry.rows, base->rows.items[i]);
+        }
+    }
+    else if (filter->index.row_count == pkgs->count &&
+             lpm_trigram_index_candidates(&filter->index, needle, &entry.rows))
+    {
+        // the index only proves every trigram occurs somewhere in the row, verify the substring
+        size_t count = 0;
+        for (size_t i = 0; i < entry.rows.count; ++i)
+        {
+            if (lpm_packages_contains(&pkgs->items[entry.rows.items[i]], needle))
+                entry.rows.items[count++] = entry.rows.items[i];
+        }
+        entry.rows.count = count;
+    }
+    else
+    {
+        for (size_t i = 0; i < pkgs->count; ++i)
+        {
+            if (lpm_packages_contains(&pkgs->items[i], needle))
+                LPM_DA_APPEND(&entry.rows, (uint32_t)i);
+        }
+    }
+
+    rows->count = 0;
+    LPM_DA_RESERVE(rows, entry.rows.count);
+    if (entry.rows.count > 0)
+        memcpy(rows->items, entry.rows.items, entry.rows.count * sizeof(*rows->items));
+    rows->count = entry.rows.count;
+
+    // a single result larger than the whole budget is not worth keeping
+    size_t entry_bytes = _lpm_filter_entry_bytes(&entry);
+    if (entry_bytes > LPM_FILTER_CACHE_BUDGET)
+    {
+        _lpm_filter_entry_free(&entry);
+        return;
+    }
+    filter->bytes += entry_bytes;
+    LPM_DA_APPEND(filter, entry);
+    _lpm_filter_evict(filter);
+}
+
+void lpm_filter_history_push(LPM_Filter *filter, const char *query)
+{
+    char normalized[LPM_FILTER_QUERY_MAX_LEN];
+    _lpm_filter_normalize(query, normalized, sizeof(normalized));
+    if (normalized[0] == '\0')
+    {
+        lpm_filter_history_rewind(filter);
+        return;
+    }
+
+    // move a repeated query to the front instead of storing it twice
+    for (size_t i = 0; i < filter->history_count; ++i)
+    {
+        if (strcmp(filter->history[i], normalized) != 0)
+            continue;
+        char *existing = filter->history[i];
+        memmove(&filter->history[i], &filter->history[i + 1],
+                (filter->history_count - i - 1) * sizeof(*filter->history));
+        filter->history[filter->history_count - 1] = existing;
+        lpm_filter_history_rewind(filter);
+        return;
+    }
+
+    if (filter->history_count == LPM_FILTER_HISTORY_MAX)
+    {
+        LPM_FREE(filter->history[0]);
+        memmove(&filter->history[0], &filter->history[1],
+                (LPM_FILTER_HISTORY_MAX - 1) * sizeof(*filter->history));
+        filter->history_count--;
+    }
+    filter->history[filter->history_count++] = lpm_strdup(normalized);
+    lpm_filter_history_rewind(filter);
+}
+
+const char *lpm_filter_history_prev(LPM_Filter *filter)
+{
+    if (filter->history_cursor == 0)
+        return NULL;
+    return filter->history[--filter->history_cursor];
+}
+
+const char *lpm_filter_history_next(LPM_Filter *filter)
+{
+    if (filter->history_cursor >= filter->history_count)
+        return NULL;
+    if (++filter->history_cursor == filter->history_count)
+        return "";
+    return filter->history[filter->history_cursor];
+}
+
+void lpm_filter_history_rewind(LPM_Filter *filter)
+{
+    filter->history_cursor = filter->history_count;
+}
@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// filter.h - Filter the package list, with memoized results and query history
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "packages.h"
+#include "trigram.h"
+
+// Bytes of row sets the filter cache may hold before evicting the least recently used query
+#ifndef LPM_FILTER_CACHE_BUDGET
+#define LPM_FILTER_CACHE_BUDGET (8 * 1024 * 1024)
+#endif // LPM_FILTER_CACHE_BUDGET
+
+#define LPM_FILTER_QUERY_MAX_LEN 64
+#define LPM_FILTER_HISTORY_MAX 32
+
+typedef struct
+{
+    char *query; // normalized: trimmed and lowercase
+    LPM_Package_Rows rows;
+    uint64_t last_used;
+} LPM_Filter_Cache_Entry;
+
+typedef struct
+{
+    LPM_Filter_Cache_Entry *items;
+    size_t count;
+    size_t capacity;
+    size_t bytes; // memory held by the cached queries and row sets
+    uint64_t clock;
+    LPM_Trigram_Index index;
+
+    char *history[LPM_FILTER_HISTORY_MAX]; // oldest first
+    size_t history_count;
+    size_t history_cursor; // == history_count when not browsing history
+} LPM_Filter;
+
+void lpm_filter_teardown(LPM_Filter *filter);
+// Drop every cached result and (re)build the trigram index, call whenever pkgs is (re)loaded
+void lpm_filter_index(LPM_Filter *filter, const LPM_Packages *pkgs);
+void lpm_filter_invalidate(LPM_Filter *filter);
+
+// Fill rows with the packages matching query. Results are memoized per normalized query, and a
+// query containing a cached one (e.g. "python3" after "python") only rescans the cached rows.
+void lpm_filter_query(LPM_Filter *filter, const LPM_Packages *pkgs, const char *query,
+                      LPM_Package_Rows *rows);
+
+void lpm_filter_history_push(LPM_Filter *filter, const char *query);
+// Step through previous queries, returns NULL when there is nothing further in that direction.
+// lpm_filter_history_next returns "" when stepping past the most recent query.
+const char *lpm_filter_history_prev(LPM_Filter *filter);
+const char *lpm_filter_history_next(LPM_Filter *filter);
+void lpm_filter_history_rewind(LPM_Filter *filter);
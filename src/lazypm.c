@@ -7,16 +7,38 @@
 
 #define TB_IMPL
 
+#include "mirrors.h"
+#include "query.h"
 #include "tui.h"
 
-int main(void)
+int main(int argc, char **argv)
 {
+    lpm_backend_init();
+
+    // `lazypm query` is read-only and non-interactive, it needs neither root nor termbox
+    if (argc > 1 && strcmp(argv[1], "query") == 0)
+    {
+        int result = lpm_query_main(argc - 1, argv + 1);
+        lpm_backend_teardown();
+        lpm_alloc_teardown();
+        return result;
+    }
+    // `lazypm mirrors` only reads the configuration, --write needs root to change it
+    if (argc > 1 && strcmp(argv[1], "mirrors") == 0)
+    {
+        int result = lpm_mirrors_main(argc - 1, argv + 1);
+        lpm_backend_teardown();
+        lpm_alloc_teardown();
+        return result;
+    }
+
     // until we implement feature to capture user's password, we will require users to
     // run `sudo lazypm`...
     if (getuid() != 0)
     {
         LPM_LOG_ERROR("lazypm requires root privileges to manage system packages.\n"
                       "\t\t  Please run with sudo: sudo lazypm");
+        lpm_backend_teardown();
         lpm_log_dump_session();
         return LPM_ERROR;
     }
@@ -25,7 +47,7 @@ int main(void)
     LPM_Packages pkgs = {0};
     LPM_Exit_Code result = lpm_tui_setup(&layout, &pkgs);
     if (result == LPM_OK)
-        lpm_tui_run(&layout, &pkgs);
+        result = lpm_tui_run(&layout, &pkgs);
     lpm_tui_teardown(&layout, &pkgs);
     return result;
 }
@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// loader.c - Load the package list and everything derived from it on a background thread
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "loader.h"
+
+static void *_lpm_loader_worker(void *arg)
+{
+    LPM_Loader *loader = arg;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    loader->result = lpm_packages_fetch(&loader->pkgs);
+    char *distdir = lpm_srcpkgs_distdir();
+    if (loader->result == LPM_OK && distdir)
+    {
+        char *cache_path = lpm_srcpkgs_cache_path();
+        if (lpm_srcpkgs_scan(&loader->srcpkgs, distdir, cache_path) == LPM_OK)
+            lpm_srcpkgs_append(&loader->srcpkgs, &loader->pkgs);
+        LPM_FREE(cache_path);
+    }
+    LPM_FREE(distdir);
+    lpm_packages_measure(&loader->pkgs);
+    lpm_filter_index(&loader->filter, &loader->pkgs);
+    lpm_facets_build(&loader->facets, &loader->pkgs);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    loader->elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Loaded %zu packages in the background in %.1f ms", loader->pkgs.count,
+                 loader->elapsed_ms);
+    atomic_store(&loader->done, true);
+    return NULL;
+}
+
+void lpm_loader_start(LPM_Loader *loader)
+{
+    lpm_loader_teardown(loader);
+    atomic_store(&loader->done, false);
+    loader->active = true;
+    int err = pthread_create(&loader->thread, NULL, _lpm_loader_worker, loader);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start the loader thread, loading inline\n\tReason  : %s",
+                        strerror(err));
+        _lpm_loader_worker(loader);
+        loader->started = false;
+        return;
+    }
+    loader->started = true;
+}
+
+bool lpm_loader_active(const LPM_Loader *loader)
+{
+    return loader->active;
+}
+
+bool lpm_loader_poll(LPM_Loader *loader)
+{
+    if (!loader->active || !atomic_load(&loader->done))
+        return false;
+    if (loader->started)
+        pthread_join(loader->thread, NULL);
+    loader->started = false;
+    loader->active = false; // report the results once
+    return true;
+}
+
+void lpm_loader_teardown(LPM_Loader *loader)
+{
+    if (loader->started)
+        pthread_join(loader->thread, NULL);
+    loader->started = false;
+    loader->active = false;
+    lpm_packages_teardown(&loader->pkgs);
+    lpm_srcpkgs_teardown(&loader->srcpkgs);
+    lpm_filter_teardown(&loader->filter);
+    lpm_facets_teardown(&loader->facets);
+}
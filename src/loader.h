@@ -0,0 +1,44 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// loader.h - Load the package list and everything derived from it on a background thread
+//
+
+#pragma once
+
+#include "common.h"
+#include "facets.h"
+#include "filter.h"
+#include "logs.h"
+#include "packages.h"
+#include "srcpkgs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+    pthread_t thread;
+    bool started;
+    bool active; // started and not reported by lpm_loader_poll yet
+    atomic_bool done;
+
+    // only valid once lpm_loader_poll has returned true, the caller takes them over
+    LPM_Exit_Code result; // of lpm_packages_fetch, see lpm_packages_fetch_report
+    LPM_Packages pkgs;
+    LPM_Srcpkgs srcpkgs; // the source rows at the end of pkgs point into it
+    LPM_Filter filter; // trigram index over pkgs, nothing cached yet
+    LPM_Facets facets; // built for pkgs, no facet active
+    double elapsed_ms;
+} LPM_Loader;
+
+// Fetch the package list, append the templates of a void-packages checkout if there is one, index
+// it and build its facets without blocking the caller. Status
+// messages are left to the caller, the worker only logs. The load arena belongs to the worker
+// until lpm_loader_poll has returned true.
+void lpm_loader_start(LPM_Loader *loader);
+bool lpm_loader_active(const LPM_Loader *loader);
+// Returns true once, when the load has finished and its results can be taken over
+bool lpm_loader_poll(LPM_Loader *loader);
+// Wait for a running load and free whatever the caller did not take over
+void lpm_loader_teardown(LPM_Loader *loader);
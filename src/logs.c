@@ -6,6 +6,7 @@
 //
 
 #include "logs.h"
+#include <pthread.h>
 
 char *lpm_log_level_str(LPM_Log_Level log_level)
 {
@@ -23,6 +24,8 @@ char *lpm_log_level_str(LPM_Log_Level log_level)
 }
 
 static char *_log_buffer = {0};
+// Background work (e.g. upgrades) logs too, entries must not interleave
+static pthread_mutex_t _log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 void lpm_log_dump_session(void)
 {
@@ -39,7 +42,7 @@ void lpm_log_dump_session(void)
     }
 }
 
-char *lpm_log_file_path(void)
+const char *lpm_log_home_dir(void)
 {
     const char *home = getenv("HOME");
     LPM_ASSERT(home != NULL && "$HOME not found...");
@@ -56,13 +59,23 @@ char *lpm_log_file_path(void)
                 home = pw->pw_dir;
         }
     }
+    return home;
+}
 
+char *lpm_log_state_dir(void)
+{
+    const char *home = lpm_log_home_dir();
     char *base_path;
     lpm_asprintf(&base_path, "%s/.local/state/lazypm", home);
 
     if (mkdir(base_path, 0755) == -1 && errno != EEXIST)
         LPM_ASSERT(0 && "Failed to create lazypm directory");
+    return base_path;
+}
 
+char *lpm_log_file_path(void)
+{
+    char *base_path = lpm_log_state_dir();
     char *log_dir;
     lpm_asprintf(&log_dir, "%s/logs", base_path);
     if (mkdir(log_dir, 0755) == -1 && errno != EEXIST)
@@ -83,8 +96,9 @@ char *lpm_log_file_path(void)
 
 void _lpm_log(LPM_Log_Level level, const char *file, int line, const char *fmt, ...)
 {
+    pthread_mutex_lock(&_log_mutex);
     char *path = lpm_log_file_path();
-    FILE *fd = fopen(path, "a");
+    FILE *fd = fopen(path, "ae");
     LPM_ASSERT(fd != NULL && "failed to open log file...");
     LPM_FREE(path);
 
@@ -126,4 +140,5 @@ void _lpm_log(LPM_Log_Level level, const char *file, int line, const char *fmt,
     // Cleanup
     LPM_FREE(user_message);
     LPM_FREE(log_entry);
+    pthread_mutex_unlock(&_log_mutex);
 }
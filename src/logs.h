@@ -5,6 +5,8 @@
 // logs.h
 //
 
+#pragma once
+
 #include "common.h"
 #include <pwd.h>
 
@@ -19,6 +21,10 @@ char *lpm_log_level_str(LPM_Log_Level log_level);
 
 void lpm_log_dump_session(void);
 char *lpm_log_file_path(void);
+// Home of the user running lazypm, the user who ran sudo under sudo
+const char *lpm_log_home_dir(void);
+// ~/.local/state/lazypm of the user who ran sudo, created if missing. Owned by the caller.
+char *lpm_log_state_dir(void);
 
 void _lpm_log(LPM_Log_Level level, const char *file, int line, const char *fmt, ...);
 #define LPM_LOG_INFO(fmt, ...) _lpm_log(LPM_LOG_LEVEL_INFO, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
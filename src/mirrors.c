@@ -0,0 +1,910 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// mirrors.c - Rank repository mirrors by latency and throughput (`lazypm mirrors ...`)
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PROCESS
+#include "mirrors.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// How often running downloads are checked for their first byte and their exit
+#define MIRRORS_TICK_MS 5
+
+// Void's own mirrors, probed along with the configured ones unless --no-defaults is given
+static const char *_lpm_mirrors_defaults[] = {
+    "https://repo-default.voidlinux.org",
+    "https://repo-fastly.voidlinux.org",
+    "https://repo-de.voidlinux.org",
+    "https://repo-fi.voidlinux.org",
+    "https://repo-us.voidlinux.org",
+    "https://mirrors.servercentral.com/voidlinux",
+};
+
+static void _lpm_mirrors_usage(FILE *stream)
+{
+    fprintf(stream,
+            "Usage: lazypm mirrors [options]\n"
+            "\n"
+            "Rank mirrors by downloading the repodata of each, several at a time, and measuring\n"
+            "the TCP connect latency and the sustained throughput. Candidates are the mirrors of\n"
+            "the repositories in " LPM_MIRRORS_CONF_DIR " and " LPM_MIRRORS_SHARE_DIR
+            ", Void's own\n"
+            "mirrors and any given with --mirror.\n"
+            "\n"
+            "Options:\n"
+            "  -m, --mirror URL     Also probe URL, e.g. https://repo-fi.voidlinux.org\n"
+            "  -n, --no-defaults    Do not probe Void's own mirrors\n"
+            "  -j, --jobs N         Downloads running at the same time (default %d)\n"
+            "  -t, --timeout SECS   Give up on a download after SECS seconds (default %d)\n"
+            "  -a, --arch ARCH      Repodata architecture (default: xbps-uhelper arch)\n"
+            "  -r, --rootdir DIR    Read and write the xbps.d directories below DIR\n"
+            "  -w, --write          Point the configured repositories at the fastest mirror\n"
+            "  -h, --help           Show this message\n"
+            "\n"
+            "--write copies each file declaring a mirror repository to " LPM_MIRRORS_CONF_DIR
+            ",\n"
+            "where it masks the file of the same name in " LPM_MIRRORS_SHARE_DIR ".\n"
+            "Exit status is non-zero if no mirror could be downloaded from.\n",
+            LPM_MIRRORS_MAX_JOBS, LPM_MIRRORS_FETCH_TIMEOUT_MS / 1000);
+}
+
+static double _lpm_mirrors_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void _lpm_mirrors_format_bytes(double bytes, char *buf, size_t size)
+{
+    const char *units[] = {"B", "KiB", "MiB", "GiB"};
+    size_t unit = 0;
+    while (bytes >= 1024 && unit + 1 < sizeof(units) / sizeof(*units))
+    {
+        bytes /= 1024;
+        unit++;
+    }
+    if (unit == 0)
+        snprintf(buf, size, "%.0f %s", bytes, units[unit]);
+    else
+        snprintf(buf, size, "%.1f %s", bytes, units[unit]);
+}
+
+//
+// configuration
+//
+
+static bool _lpm_mirrors_is_http(const char *url, size_t len)
+{
+    return (len >= 7 && strncmp(url, "http://", 7) == 0) ||
+           (len >= 8 && strncmp(url, "https://", 8) == 0);
+}
+
+// Length of the mirror part of a repository url, the part before "/current". 0 when url is not
+// served by a mirror, e.g. a local directory or a third party repository.
+static size_t _lpm_mirrors_base_len(const char *url, size_t len)
+{
+    if (!_lpm_mirrors_is_http(url, len))
+        return 0;
+    for (size_t i = 0; i + 8 <= len; ++i)
+    {
+        if (memcmp(url + i, "/current", 8) == 0 && (i + 8 == len || url[i + 8] == '/'))
+            return i;
+    }
+    return 0;
+}
+
+// The value of a "repository=" line, xbps.d(5) allows blanks around the key and a comment
+// after the value
+static bool _lpm_mirrors_repository(const char *line, size_t len, size_t *value,
+                                    size_t *value_len)
+{
+    size_t i = 0;
+    while (i < len && isspace((unsigned char)line[i]))
+        i++;
+    if (len - i < 10 || memcmp(line + i, "repository", 10) != 0)
+        return false;
+    i += 10;
+    while (i < len && isblank((unsigned char)line[i]))
+        i++;
+    if (i == len || line[i] != '=')
+        return false;
+    i++;
+    while (i < len && isblank((unsigned char)line[i]))
+        i++;
+    size_t end = i;
+    while (end < len && !isspace((unsigned char)line[end]) && line[end] != '#')
+        end++;
+    *value = i;
+    *value_len = end - i;
+    return end > i;
+}
+
+static LPM_Exit_Code _lpm_mirrors_read_file(const char *path, LPM_Process_Buffer *out)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return LPM_ERROR_FILE_READ;
+    LPM_Exit_Code result = LPM_OK;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+    out->count = 0;
+    LPM_DA_RESERVE(out, (size_t)st.st_size + 1);
+    while (out->count < (size_t)st.st_size)
+    {
+        ssize_t n = read(fd, out->items + out->count, (size_t)st.st_size - out->count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        out->count += (size_t)n;
+    }
+    out->items[out->count] = '\0';
+
+cleanup:
+    close(fd);
+    return result;
+}
+
+// Append the *.conf files of dir that no earlier directory already had
+static void _lpm_mirrors_read_dir(LPM_Mirrors_Confs *confs, const char *dir)
+{
+    DIR *d = lpm_process_opendir(dir);
+    if (d == NULL)
+        return;
+    size_t masked = confs->count;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len <= 5 || strcmp(entry->d_name + len - 5, ".conf") != 0)
+            continue;
+        bool seen = false;
+        for (size_t i = 0; i < masked && !seen; ++i)
+            seen = strcmp(confs->items[i].name, entry->d_name) == 0;
+        if (seen)
+            continue;
+
+        LPM_Mirrors_Conf conf = {.name = lpm_strdup(entry->d_name)};
+        lpm_asprintf(&conf.path, "%s/%s", dir, entry->d_name);
+        if (_lpm_mirrors_read_file(conf.path, &conf.text) != LPM_OK)
+        {
+            LPM_LOG_WARNING("Failed to read an xbps.d file\n\tReason  : %s: %s", conf.path,
+                            strerror(errno));
+            LPM_FREE(conf.name);
+            LPM_FREE(conf.path);
+            LPM_DA_FREE(conf.text);
+            continue;
+        }
+        LPM_DA_APPEND(confs, conf);
+    }
+    closedir(d);
+}
+
+static int _lpm_mirrors_cmp_confs(const void *a, const void *b)
+{
+    return strcmp(((const LPM_Mirrors_Conf *)a)->name, ((const LPM_Mirrors_Conf *)b)->name);
+}
+
+static void _lpm_mirrors_read_confs(LPM_Mirrors_Confs *confs, const char *rootdir)
+{
+    char *dir;
+    lpm_asprintf(&dir, "%s%s", rootdir, LPM_MIRRORS_CONF_DIR);
+    _lpm_mirrors_read_dir(confs, dir);
+    LPM_FREE(dir);
+    lpm_asprintf(&dir, "%s%s", rootdir, LPM_MIRRORS_SHARE_DIR);
+    _lpm_mirrors_read_dir(confs, dir);
+    LPM_FREE(dir);
+    if (confs->count > 0)
+        qsort(confs->items, confs->count, sizeof(*confs->items), _lpm_mirrors_cmp_confs);
+}
+
+static void _lpm_mirrors_confs_teardown(LPM_Mirrors_Confs *confs)
+{
+    for (size_t i = 0; i < confs->count; ++i)
+    {
+        LPM_FREE(confs->items[i].name);
+        LPM_FREE(confs->items[i].path);
+        LPM_DA_FREE(confs->items[i].text);
+    }
+    LPM_DA_FREE(*confs);
+    confs->count = 0;
+    confs->capacity = 0;
+}
+
+// url points into the text of the file, base_len is its mirror part
+typedef void (*LPM_Mirrors_Repository_Fn)(const char *url, size_t url_len, size_t base_len,
+                                          void *data);
+
+// Calls fn for every mirror repository of conf, in file order. Returns false when there is none.
+
+static bool _lpm_mirrors_each_repository(const LPM_Mirrors_Conf *conf,
+                                         LPM_Mirrors_Repository_Fn fn, void *data)
+{
+    bool found = false;
+    const char *p = conf->text.items;
+    const char *end = conf->text.items + conf->text.count;
+    while (p < end)
+    {
+        const char *newline = memchr(p, '\n', end - p);
+        size_t line_len = newline ? (size_t)(newline - p) : (size_t)(end - p);
+        size_t value;
+        size_t value_len;
+        size_t base_len;
+        if (_lpm_mirrors_repository(p, line_len, &value, &value_len) &&
+            (base_len = _lpm_mirrors_base_len(p + value, value_len)) > 0)
+        {
+            found = true;
+            fn(p + value, value_len, base_len, data);
+        }
+        p += line_len + 1;
+    }
+    return found;
+}
+
+// Add base unless it is already a candidate, a trailing '/' does not make a different mirror
+static void _lpm_mirrors_add(LPM_Mirrors *mirrors, const char *base, size_t len)
+{
+    while (len > 0 && base[len - 1] == '/')
+        len--;
+    for (size_t i = 0; i < mirrors->count; ++i)
+    {
+        if (strlen(mirrors->items[i].base) == len && memcmp(mirrors->items[i].base, base, len) == 0)
+            return;
+    }
+    LPM_Mirror mirror = {.pid = -1};
+    lpm_asprintf(&mirror.base, "%.*s", (int)len, base);
+    LPM_DA_APPEND(mirrors, mirror);
+}
+
+typedef struct
+{
+    LPM_Mirrors *mirrors;
+    char *suffix; // of the first mirror repository, e.g. "/current/musl"
+} LPM_Mirrors_Collect;
+
+static void _lpm_mirrors_collect(const char *url, size_t url_len, size_t base_len, void *data)
+{
+    LPM_Mirrors_Collect *collect = data;
+    _lpm_mirrors_add(collect->mirrors, url, base_len);
+    if (collect->suffix == NULL)
+    {
+        size_t suffix_len = url_len - base_len;
+        while (suffix_len > 0 && url[base_len + suffix_len - 1] == '/')
+            suffix_len--;
+        lpm_asprintf(&collect->suffix, "%.*s", (int)suffix_len, url + base_len);
+    }
+}
+
+// ARCH as xbps sees it, XBPS_ARCH overrides the native one like it does for xbps itself
+static char *_lpm_mirrors_arch(void)
+{
+    const char *env = getenv("XBPS_ARCH");
+    if (env != NULL && *env != '\0')
+        return lpm_strdup(env);
+
+    LPM_Process_Buffer out = {0};
+    char *argv[] = {"xbps-uhelper", "arch", NULL};
+    if (lpm_process_run(argv, &out, NULL, NULL) == LPM_OK && out.count > 0)
+    {
+        while (out.count > 0 && isspace((unsigned char)out.items[out.count - 1]))
+            out.items[--out.count] = '\0';
+        if (out.count > 0)
+            return out.items;
+    }
+    LPM_DA_FREE(out);
+
+    struct utsname name;
+    if (uname(&name) != 0)
+        return NULL;
+    return lpm_strdup(name.machine);
+}
+
+//
+// probes
+//
+
+// host and port of the mirror, false when base is not a url we understand
+static bool _lpm_mirrors_host(const char *base, char *host, size_t host_size, const char **port)
+{
+    const char *p = strstr(base, "://");
+    if (p == NULL)
+        return false;
+    *port = strncmp(base, "https", 5) == 0 ? "443" : "80";
+    p += 3;
+    const char *at = strpbrk(p, "@/");
+    if (at != NULL && *at == '@')
+        p = at + 1;
+
+    const char *end;
+    if (*p == '[')
+    {
+        p++;
+        end = strchr(p, ']');
+        if (end == NULL)
+            return false;
+    }
+    else
+        end = p + strcspn(p, ":/");
+    size_t len = end - p;
+    if (len == 0 || len >= host_size)
+        return false;
+    memcpy(host, p, len);
+    host[len] = '\0';
+
+    if (*end == ']')
+        end++;
+    if (*end == ':')
+    {
+        // only valid until the next call, the caller resolves the name right away
+        static char port_buf[8];
+        size_t port_len = strcspn(end + 1, "/");
+        if (port_len == 0 || port_len >= sizeof(port_buf))
+            return false;
+        memcpy(port_buf, end + 1, port_len);
+        port_buf[port_len] = '\0';
+        *port = port_buf;
+    }
+    return true;
+}
+
+// Time a TCP connect to every mirror at once. The name lookups happen first so their time is not
+// counted, the connects then race each other instead of queueing behind a slow mirror.
+static void _lpm_mirrors_connect(LPM_Mirrors *mirrors)
+{
+    struct pollfd *fds = LPM_MALLOC(mirrors->count * sizeof(*fds));
+    LPM_ASSERT(fds != NULL && "Buy more RAM lol");
+    struct addrinfo **addrs = LPM_MALLOC(mirrors->count * sizeof(*addrs));
+    LPM_ASSERT(addrs != NULL && "Buy more RAM lol");
+    struct timespec *starts = LPM_MALLOC(mirrors->count * sizeof(*starts));
+    LPM_ASSERT(starts != NULL && "Buy more RAM lol");
+
+    for (size_t i = 0; i < mirrors->count; ++i)
+    {
+        LPM_Mirror *mirror = &mirrors->items[i];
+        fds[i] = (struct pollfd){.fd = -1, .events = POLLOUT};
+        addrs[i] = NULL;
+        char host[256];
+        const char *port;
+        if (!_lpm_mirrors_host(mirror->base, host, sizeof(host), &port))
+        {
+            mirror->error = "not a mirror url";
+            continue;
+        }
+        struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+        int err = getaddrinfo(host, port, &hints, &addrs[i]);
+        if (err != 0)
+        {
+            LPM_LOG_WARNING("Failed to resolve a mirror\n\tReason  : %s: %s", host,
+                            gai_strerror(err));
+            mirror->error = "host not found";
+            addrs[i] = NULL;
+        }
+    }
+
+    size_t pending = 0;
+    for (size_t i = 0; i < mirrors->count; ++i)
+    {
+        if (addrs[i] == NULL)
+            continue;
+        int fd = socket(addrs[i]->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            mirrors->items[i].error = "connect failed";
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &starts[i]);
+        if (connect(fd, addrs[i]->ai_addr, addrs[i]->ai_addrlen) == 0)
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            mirrors->items[i].connect_ms = _lpm_mirrors_ms(&starts[i], &now);
+            close(fd);
+        }
+        else if (errno == EINPROGRESS)
+        {
+            fds[i].fd = fd;
+            pending++;
+        }
+        else
+        {
+            LPM_LOG_WARNING("Failed to connect to a mirror\n\tReason  : %s: %s",
+                            mirrors->items[i].base, strerror(errno));
+            mirrors->items[i].error = "connect failed";
+            close(fd);
+        }
+    }
+
+    struct timespec connects_start;
+    clock_gettime(CLOCK_MONOTONIC, &connects_start);
+    while (pending > 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int elapsed_ms = (int)_lpm_mirrors_ms(&connects_start, &now);
+        int remaining = LPM_MIRRORS_CONNECT_TIMEOUT_MS - elapsed_ms;
+        if (remaining <= 0)
+            break;
+        // poll ignores negative descriptors, finished connects drop out that way
+        int ready = poll(fds, mirrors->count, remaining);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (size_t i = 0; i < mirrors->count; ++i)
+        {
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+            int err = 0;
+            socklen_t err_len = sizeof(err);
+            getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+            if (err == 0)
+                mirrors->items[i].connect_ms = _lpm_mirrors_ms(&starts[i], &now);
+            else
+            {
+                LPM_LOG_WARNING("Failed to connect to a mirror\n\tReason  : %s: %s",
+                                mirrors->items[i].base, strerror(err));
+                mirrors->items[i].error = "connect failed";
+            }
+            close(fds[i].fd);
+            fds[i].fd = -1;
+            pending--;
+        }
+    }
+
+    for (size_t i = 0; i < mirrors->count; ++i)
+    {
+        if (fds[i].fd >= 0)
+        {
+            mirrors->items[i].error = "connect timed out";
+            close(fds[i].fd);
+        }
+        if (addrs[i] != NULL)
+            freeaddrinfo(addrs[i]);
+    }
+    LPM_FREE(fds);
+    LPM_FREE(addrs);
+    LPM_FREE(starts);
+}
+
+static void _lpm_mirrors_fetch_start(LPM_Mirror *mirror, const char *tmpdir, size_t index)
+{
+    lpm_asprintf(&mirror->output, "%s/%zu-repodata", tmpdir, index);
+    char *argv[] = {"xbps-fetch", "-o", mirror->output, mirror->url, NULL};
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // a group of its own, a timeout then takes down whatever xbps-fetch started as well
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &mirror->start);
+    int err = posix_spawnp(&mirror->pid, argv[0], &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start xbps-fetch\n\tReason  : %s", strerror(err));
+        mirror->error = "xbps-fetch failed to start";
+        mirror->pid = -1;
+    }
+}
+
+// Bytes of the download so far, xbps-fetch writes to "<output>.part" and renames it when done
+static int64_t _lpm_mirrors_fetch_bytes(const LPM_Mirror *mirror)
+{
+    struct stat st;
+    if (stat(mirror->output, &st) == 0)
+        return st.st_size;
+    char part[PATH_MAX];
+    snprintf(part, sizeof(part), "%s.part", mirror->output);
+    if (stat(part, &st) == 0)
+        return st.st_size;
+    return 0;
+}
+
+// Returns true once the download has exited or was killed
+static bool _lpm_mirrors_fetch_reap(LPM_Mirror *mirror, int timeout_ms)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!mirror->receiving && _lpm_mirrors_fetch_bytes(mirror) > 0)
+    {
+        mirror->receiving = true;
+        mirror->first_byte = now;
+    }
+
+    int status;
+    pid_t pid = waitpid(mirror->pid, &status, WNOHANG);
+    if (pid == 0)
+    {
+        if (_lpm_mirrors_ms(&mirror->start, &now) < timeout_ms)
+            return false;
+        kill(-mirror->pid, SIGKILL);
+        waitpid(mirror->pid, NULL, 0);
+        mirror->pid = -1;
+        mirror->error = "download timed out";
+        return true;
+    }
+    mirror->pid = -1;
+
+    if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        LPM_LOG_WARNING("Failed to download the repodata of a mirror\n\tReason  : %s",
+                        mirror->url);
+        mirror->error = "download failed";
+        return true;
+    }
+    mirror->fetch_ms = _lpm_mirrors_ms(&mirror->start, &now);
+    mirror->bytes = _lpm_mirrors_fetch_bytes(mirror);
+    // from the first byte on, handshakes and request latency are already behind the transfer.
+    // A download too quick to be seen in flight falls back to its whole duration.
+    double transfer_ms = mirror->receiving ? _lpm_mirrors_ms(&mirror->first_byte, &now) : 0;
+    if (transfer_ms < MIRRORS_TICK_MS)
+        transfer_ms = mirror->fetch_ms;
+    if (mirror->bytes <= 0 || transfer_ms <= 0)
+    {
+        mirror->error = "empty repodata";
+        return true;
+    }
+    mirror->throughput = mirror->bytes / (transfer_ms / 1000.0);
+    return true;
+}
+
+// Download the repodata of every reachable mirror, at most jobs at a time
+static void _lpm_mirrors_fetch(LPM_Mirrors *mirrors, const char *tmpdir, size_t jobs,
+                               int timeout_ms)
+{
+    size_t next = 0;
+    size_t running = 0;
+    for (;;)
+    {
+        while (running < jobs && next < mirrors->count)
+        {
+            LPM_Mirror *mirror = &mirrors->items[next];
+            if (mirror->error == NULL)
+            {
+                _lpm_mirrors_fetch_start(mirror, tmpdir, next);
+                if (mirror->pid > 0)
+                    running++;
+            }
+            next++;
+        }
+        if (running == 0)
+            break;
+
+        poll(NULL, 0, MIRRORS_TICK_MS);
+        for (size_t i = 0; i < next; ++i)
+        {
+            LPM_Mirror *mirror = &mirrors->items[i];
+            if (mirror->pid > 0 && _lpm_mirrors_fetch_reap(mirror, timeout_ms))
+                running--;
+        }
+    }
+}
+
+// Fastest sustained download first, the connect latency breaks ties, failures go last
+static int _lpm_mirrors_cmp_rank(const void *a, const void *b)
+{
+    const LPM_Mirror *ma = a;
+    const LPM_Mirror *mb = b;
+    if ((ma->error == NULL) != (mb->error == NULL))
+        return ma->error == NULL ? -1 : 1;
+    if (ma->throughput != mb->throughput)
+        return ma->throughput > mb->throughput ? -1 : 1;
+    if (ma->connect_ms != mb->connect_ms)
+        return ma->connect_ms < mb->connect_ms ? -1 : 1;
+    return strcmp(ma->base, mb->base);
+}
+
+static void _lpm_mirrors_print(const LPM_Mirrors *mirrors)
+{
+    printf("%4s  %-44s %10s %10s %12s\n", "#", "mirror", "connect", "repodata", "throughput");
+    for (size_t i = 0; i < mirrors->count; ++i)
+    {
+        const LPM_Mirror *mirror = &mirrors->items[i];
+        if (mirror->error != NULL)
+        {
+            printf("%4s  %-44s %s\n", "-", mirror->base, mirror->error);
+            continue;
+        }
+        char bytes[32];
+        char rate[32];
+        _lpm_mirrors_format_bytes((double)mirror->bytes, bytes, sizeof(bytes));
+        _lpm_mirrors_format_bytes(mirror->throughput, rate, sizeof(rate));
+        printf("%4zu  %-44s %7.1f ms %10s %10s/s\n", i + 1, mirror->base, mirror->connect_ms,
+               bytes, rate);
+    }
+}
+
+//
+// override
+//
+
+typedef struct
+{
+    const char *best;
+    LPM_Process_Buffer *out;
+    const char *copied; // of the original text, up to here is in out already
+    size_t replaced;
+} LPM_Mirrors_Rewrite;
+
+static void _lpm_mirrors_buffer_append(LPM_Process_Buffer *buf, const char *s, size_t len)
+{
+    LPM_DA_RESERVE(buf, buf->count + len + 1);
+    memcpy(buf->items + buf->count, s, len);
+    buf->count += len;
+    buf->items[buf->count] = '\0';
+}
+
+static void _lpm_mirrors_rewrite(const char *base, size_t url_len, size_t base_len, void *data)
+{
+    LPM_UNUSED(url_len);
+    LPM_Mirrors_Rewrite *rewrite = data;
+    size_t best_len = strlen(rewrite->best);
+    if (base_len == best_len && memcmp(base, rewrite->best, best_len) == 0)
+        return;
+    _lpm_mirrors_buffer_append(rewrite->out, rewrite->copied, base - rewrite->copied);
+    _lpm_mirrors_buffer_append(rewrite->out, rewrite->best, best_len);
+    rewrite->copied = base + base_len;
+    rewrite->replaced++;
+}
+
+// Point every mirror repository of confs at best. Files are written to the configuration
+// directory under rootdir, a file of the share directory is copied there and masked that way.
+static LPM_Exit_Code _lpm_mirrors_write(const LPM_Mirrors_Confs *confs, const char *rootdir,
+                                        const char *best)
+{
+    LPM_Exit_Code result = LPM_OK;
+    char *dir;
+    lpm_asprintf(&dir, "%s%s", rootdir, LPM_MIRRORS_CONF_DIR);
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+    {
+        fprintf(stderr, "lazypm mirrors: cannot create %s: %s\n", dir, strerror(errno));
+        LPM_FREE(dir);
+        return LPM_ERROR;
+    }
+
+    size_t written = 0;
+    LPM_Process_Buffer out = {0};
+    for (size_t i = 0; i < confs->count; ++i)
+    {
+        const LPM_Mirrors_Conf *conf = &confs->items[i];
+        out.count = 0;
+        LPM_Mirrors_Rewrite rewrite = {.best = best, .out = &out, .copied = conf->text.items};
+        if (!_lpm_mirrors_each_repository(conf, _lpm_mirrors_rewrite, &rewrite) ||
+            rewrite.replaced == 0)
+            continue;
+        _lpm_mirrors_buffer_append(&out, rewrite.copied,
+                                   conf->text.items + conf->text.count - rewrite.copied);
+
+        // write a sibling and rename it over the file, a crash never leaves half a file behind
+        char *path;
+        char *tmp_path;
+        lpm_asprintf(&path, "%s/%s", dir, conf->name);
+        lpm_asprintf(&tmp_path, "%s.tmp", path);
+        FILE *fd = fopen(tmp_path, "wbe");
+        bool ok = fd && fwrite(out.items, 1, out.count, fd) == out.count;
+        if (fd && fclose(fd) == EOF)
+            ok = false;
+        if (!ok || rename(tmp_path, path) == -1)
+        {
+            fprintf(stderr, "lazypm mirrors: cannot write %s: %s\n", path, strerror(errno));
+            unlink(tmp_path);
+            result = LPM_ERROR;
+        }
+        else
+        {
+            LPM_LOG_INFO("Pointed %zu repositories of %s at %s", rewrite.replaced, path, best);
+            printf("Wrote %s\n", path);
+            written++;
+        }
+        LPM_FREE(tmp_path);
+        LPM_FREE(path);
+    }
+    if (written == 0 && result == LPM_OK)
+        printf("The repositories already use %s\n", best);
+
+    LPM_DA_FREE(out);
+    LPM_FREE(dir);
+    return result;
+}
+
+LPM_Exit_Code lpm_mirrors_main(int argc, char **argv)
+{
+    LPM_Mirrors mirrors = {0};
+    bool defaults = true;
+    bool write_override = false;
+    long jobs = LPM_MIRRORS_MAX_JOBS;
+    long timeout_s = LPM_MIRRORS_FETCH_TIMEOUT_MS / 1000;
+    const char *rootdir = "";
+    char *arch = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        char *flag = argv[i];
+        bool takes_value = strcmp(flag, "--mirror") == 0 || strcmp(flag, "-m") == 0 ||
+                           strcmp(flag, "--jobs") == 0 || strcmp(flag, "-j") == 0 ||
+                           strcmp(flag, "--timeout") == 0 || strcmp(flag, "-t") == 0 ||
+                           strcmp(flag, "--arch") == 0 || strcmp(flag, "-a") == 0 ||
+                           strcmp(flag, "--rootdir") == 0 || strcmp(flag, "-r") == 0;
+        if (takes_value && i + 1 >= argc)
+        {
+            fprintf(stderr, "lazypm mirrors: option \"%s\" needs a value\n\n", flag);
+            _lpm_mirrors_usage(stderr);
+            LPM_DA_FREE(mirrors);
+            return LPM_ERROR;
+        }
+
+        char *end = NULL;
+        if (strcmp(flag, "--mirror") == 0 || strcmp(flag, "-m") == 0)
+        {
+            char *url = argv[++i];
+            size_t len = strlen(url);
+            size_t base_len = _lpm_mirrors_base_len(url, len);
+            if (!_lpm_mirrors_is_http(url, len))
+            {
+                fprintf(stderr, "lazypm mirrors: \"%s\" is not an http(s) url\n", url);
+                LPM_DA_FREE(mirrors);
+                return LPM_ERROR;
+            }
+            _lpm_mirrors_add(&mirrors, url, base_len > 0 ? base_len : len);
+        }
+        else if (strcmp(flag, "--no-defaults") == 0 || strcmp(flag, "-n") == 0)
+            defaults = false;
+        else if (strcmp(flag, "--jobs") == 0 || strcmp(flag, "-j") == 0)
+            jobs = strtol(argv[++i], &end, 10);
+        else if (strcmp(flag, "--timeout") == 0 || strcmp(flag, "-t") == 0)
+            timeout_s = strtol(argv[++i], &end, 10);
+        else if (strcmp(flag, "--arch") == 0 || strcmp(flag, "-a") == 0)
+        {
+            LPM_FREE(arch);
+            arch = lpm_strdup(argv[++i]);
+        }
+        else if (strcmp(flag, "--rootdir") == 0 || strcmp(flag, "-r") == 0)
+            rootdir = argv[++i];
+        else if (strcmp(flag, "--write") == 0 || strcmp(flag, "-w") == 0)
+            write_override = true;
+        else if (strcmp(flag, "--help") == 0 || strcmp(flag, "-h") == 0)
+        {
+            _lpm_mirrors_usage(stdout);
+            LPM_FREE(arch);
+            LPM_DA_FREE(mirrors);
+            return LPM_OK;
+        }
+        else
+        {
+            fprintf(stderr, "lazypm mirrors: unknown option \"%s\"\n\n", flag);
+            _lpm_mirrors_usage(stderr);
+            LPM_FREE(arch);
+            LPM_DA_FREE(mirrors);
+            return LPM_ERROR;
+        }
+
+        if (end != NULL && (*end != '\0' || jobs <= 0 || timeout_s <= 0))
+        {
+            fprintf(stderr, "lazypm mirrors: \"%s\" needs a positive number\n", flag);
+            LPM_FREE(arch);
+            LPM_DA_FREE(mirrors);
+            return LPM_ERROR;
+        }
+    }
+    // xbps takes "/" and "" alike, the configuration paths are appended to it
+    size_t rootdir_len = strlen(rootdir);
+    while (rootdir_len > 0 && rootdir[rootdir_len - 1] == '/')
+        rootdir_len--;
+    char *root;
+    lpm_asprintf(&root, "%.*s", (int)rootdir_len, rootdir);
+
+    LPM_Exit_Code result = LPM_OK;
+    char tmpdir[] = "/tmp/lazypm-mirrors-XXXXXX";
+    bool have_tmpdir = false;
+    LPM_Mirrors_Confs confs = {0};
+    _lpm_mirrors_read_confs(&confs, root);
+    LPM_Mirrors_Collect collect = {.mirrors = &mirrors};
+    bool configured = false;
+    for (size_t i = 0; i < confs.count; ++i)
+        configured |= _lpm_mirrors_each_repository(&confs.items[i], _lpm_mirrors_collect, &collect);
+    if (defaults)
+    {
+        for (size_t i = 0; i < sizeof(_lpm_mirrors_defaults) / sizeof(*_lpm_mirrors_defaults); ++i)
+            _lpm_mirrors_add(&mirrors, _lpm_mirrors_defaults[i], strlen(_lpm_mirrors_defaults[i]));
+    }
+    if (write_override && !configured)
+    {
+        fprintf(stderr, "lazypm mirrors: no repository in %s%s or %s%s is served by a mirror\n",
+                root, LPM_MIRRORS_CONF_DIR, root, LPM_MIRRORS_SHARE_DIR);
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    if (mirrors.count == 0)
+    {
+        fprintf(stderr, "lazypm mirrors: no mirror to probe\n");
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+
+    if (arch == NULL)
+        arch = _lpm_mirrors_arch();
+    if (arch == NULL)
+    {
+        fprintf(stderr, "lazypm mirrors: cannot tell the architecture, pass --arch\n");
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    // every mirror carries the same tree, the first configured repository says which part of it
+    const char *suffix = collect.suffix ? collect.suffix : "/current";
+    for (size_t i = 0; i < mirrors.count; ++i)
+        lpm_asprintf(&mirrors.items[i].url, "%s%s/%s-repodata", mirrors.items[i].base, suffix,
+                     arch);
+
+    if (mkdtemp(tmpdir) == NULL)
+    {
+        fprintf(stderr, "lazypm mirrors: cannot create %s: %s\n", tmpdir, strerror(errno));
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    have_tmpdir = true;
+
+    printf("Probing %zu mirrors, %ld at a time, with <mirror>%s/%s-repodata\n", mirrors.count,
+           jobs, suffix, arch);
+    fflush(stdout);
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    _lpm_mirrors_connect(&mirrors);
+    _lpm_mirrors_fetch(&mirrors, tmpdir, (size_t)jobs, (int)(timeout_s * 1000));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    LPM_LOG_INFO("Probed %zu mirrors in %.0f ms, %ld downloads at a time", mirrors.count,
+                 _lpm_mirrors_ms(&start, &end), jobs);
+
+    qsort(mirrors.items, mirrors.count, sizeof(*mirrors.items), _lpm_mirrors_cmp_rank);
+    _lpm_mirrors_print(&mirrors);
+    if (mirrors.items[0].error != NULL)
+    {
+        fprintf(stderr, "lazypm mirrors: no mirror could be downloaded from\n");
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    if (write_override)
+        result = _lpm_mirrors_write(&confs, root, mirrors.items[0].base);
+
+cleanup:
+    for (size_t i = 0; i < mirrors.count; ++i)
+    {
+        LPM_Mirror *mirror = &mirrors.items[i];
+        if (mirror->output != NULL)
+        {
+            char part[PATH_MAX];
+            snprintf(part, sizeof(part), "%s.part", mirror->output);
+            unlink(part);
+            unlink(mirror->output);
+        }
+        LPM_FREE(mirror->base);
+        LPM_FREE(mirror->url);
+        LPM_FREE(mirror->output);
+    }
+    if (have_tmpdir)
+        rmdir(tmpdir);
+    LPM_DA_FREE(mirrors);
+    _lpm_mirrors_confs_teardown(&confs);
+    LPM_FREE(collect.suffix);
+    LPM_FREE(arch);
+    LPM_FREE(root);
+    return result;
+}
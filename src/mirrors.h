@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// mirrors.h - Rank repository mirrors by latency and throughput (`lazypm mirrors ...`)
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "process.h"
+#include <sys/types.h>
+
+// Configuration directories of xbps.d(5), a file in the first masks the one of the same name in
+// the second
+#ifndef LPM_MIRRORS_CONF_DIR
+#define LPM_MIRRORS_CONF_DIR "/etc/xbps.d"
+#endif // LPM_MIRRORS_CONF_DIR
+#ifndef LPM_MIRRORS_SHARE_DIR
+#define LPM_MIRRORS_SHARE_DIR "/usr/share/xbps.d"
+#endif // LPM_MIRRORS_SHARE_DIR
+
+// Repodata downloads running at the same time, they share the link so fewer is fairer
+#ifndef LPM_MIRRORS_MAX_JOBS
+#define LPM_MIRRORS_MAX_JOBS 4
+#endif // LPM_MIRRORS_MAX_JOBS
+
+#ifndef LPM_MIRRORS_CONNECT_TIMEOUT_MS
+#define LPM_MIRRORS_CONNECT_TIMEOUT_MS 3000
+#endif // LPM_MIRRORS_CONNECT_TIMEOUT_MS
+
+#ifndef LPM_MIRRORS_FETCH_TIMEOUT_MS
+#define LPM_MIRRORS_FETCH_TIMEOUT_MS 30000
+#endif // LPM_MIRRORS_FETCH_TIMEOUT_MS
+
+typedef struct
+{
+    char *base; // e.g. "https://repo-fi.voidlinux.org", what comes before "/current"
+    char *url;  // repodata fetched from it
+
+    // probe results
+    const char *error; // NULL when both probes succeeded
+    double connect_ms;
+    double fetch_ms;      // from spawning xbps-fetch to its exit
+    double throughput;    // bytes per second from the first byte on disk to the exit
+    int64_t bytes;
+
+    // fetch in flight
+    pid_t pid;
+    char *output;
+    struct timespec start;
+    struct timespec first_byte;
+    bool receiving;
+} LPM_Mirror;
+
+typedef struct
+{
+    LPM_Mirror *items;
+    size_t count;
+    size_t capacity;
+} LPM_Mirrors;
+
+// A *.conf file of the xbps.d directories
+typedef struct
+{
+    char *name; // basename, it is what masks a file of the other directory
+    char *path;
+    LPM_Process_Buffer text;
+} LPM_Mirrors_Conf;
+
+typedef struct
+{
+    LPM_Mirrors_Conf *items; // in the lexical order xbps reads them in
+    size_t count;
+    size_t capacity;
+} LPM_Mirrors_Confs;
+
+// Entry point for `lazypm mirrors`. argv[0] is "mirrors". Probing needs no root, writing the
+// override with --write does.
+//
+// Returns LPM_OK when at least one mirror answered, LPM_ERROR otherwise.
+LPM_Exit_Code lpm_mirrors_main(int argc, char **argv);
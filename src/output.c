@@ -0,0 +1,205 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// output.c - Bounded scrollback of command output, older lines spill to a temp file
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PROCESS
+#include "output.h"
+
+static LPM_Output_Line *_lpm_output_at(LPM_Output *output, size_t i)
+{
+    return &output->lines[(output->head + i) % LPM_OUTPUT_RING_LINES];
+}
+
+// Move the oldest line from memory to the spill file
+static void _lpm_output_spill(LPM_Output *output)
+{
+    LPM_Output_Line *line = _lpm_output_at(output, 0);
+    if (output->spill == NULL)
+    {
+        output->spill = lpm_process_tmpfile();
+        if (output->spill == NULL)
+            LPM_LOG_WARNING("Failed to create the output spill file\n\tReason  : %s",
+                            strerror(errno));
+    }
+    if (output->spill)
+    {
+        if (output->spilled % LPM_OUTPUT_BLOCK_LINES == 0)
+            LPM_DA_APPEND(&output->checkpoints, output->spill_size);
+        fseek(output->spill, 0, SEEK_END);
+        fwrite(output->ring + line->pos % LPM_OUTPUT_RING_SIZE, 1, line->len, output->spill);
+        fputc('\n', output->spill);
+        output->spill_size += line->len + 1;
+        // a cached partial block just got a line longer
+        if (output->block_index == output->spilled / LPM_OUTPUT_BLOCK_LINES)
+            output->block_lines = 0;
+        output->spilled++;
+    }
+    output->head = (output->head + 1) % LPM_OUTPUT_RING_LINES;
+    output->count--;
+}
+
+void lpm_output_teardown(LPM_Output *output)
+{
+    lpm_output_clear(output);
+    LPM_DA_FREE(output->checkpoints);
+    output->checkpoints.capacity = 0;
+    LPM_FREE(output->block);
+}
+
+void lpm_output_clear(LPM_Output *output)
+{
+    if (output->spill)
+        fclose(output->spill);
+    output->spill = NULL;
+    output->spilled = 0;
+    output->spill_size = 0;
+    output->checkpoints.count = 0;
+    output->block_lines = 0;
+    output->write = 0;
+    output->head = 0;
+    output->count = 0;
+    output->transient = false;
+}
+
+void lpm_output_append(LPM_Output *output, const char *line, size_t len, bool transient)
+{
+    if (output->transient && output->count > 0)
+    {
+        output->count--;
+        output->write = _lpm_output_at(output, output->count)->pos;
+    }
+    output->transient = transient;
+
+    if (len > LPM_OUTPUT_LINE_MAX)
+        len = LPM_OUTPUT_LINE_MAX;
+    // lines are stored contiguously, skip to the start of the ring when the tail is too short
+    if (output->write % LPM_OUTPUT_RING_SIZE + len > LPM_OUTPUT_RING_SIZE)
+        output->write += LPM_OUTPUT_RING_SIZE - output->write % LPM_OUTPUT_RING_SIZE;
+
+    // everything from the oldest line up to the end of the new one has to fit in the ring
+    while (output->count > 0 &&
+           (output->write + len - _lpm_output_at(output, 0)->pos > LPM_OUTPUT_RING_SIZE ||
+            output->count == LPM_OUTPUT_RING_LINES))
+        _lpm_output_spill(output);
+
+    memcpy(output->ring + output->write % LPM_OUTPUT_RING_SIZE, line, len);
+    *_lpm_output_at(output, output->count) =
+        (LPM_Output_Line){.pos = output->write, .len = (uint32_t)len};
+    output->count++;
+    output->write += len;
+}
+
+size_t lpm_output_count(const LPM_Output *output)
+{
+    return output->spilled + output->count;
+}
+
+// Read the block of spilled lines holding index back from the spill file, unless it is cached
+static bool _lpm_output_load_block(LPM_Output *output, size_t index)
+{
+    size_t block = index / LPM_OUTPUT_BLOCK_LINES;
+    if (output->block_lines > 0 && output->block_index == block)
+        return true;
+    if (output->spill == NULL)
+        return false;
+
+    uint64_t start = output->checkpoints.items[block];
+    uint64_t end = block + 1 < output->checkpoints.count ? output->checkpoints.items[block + 1]
+                                                         : output->spill_size;
+    if (output->block == NULL)
+    {
+        output->block = LPM_MALLOC(LPM_OUTPUT_BLOCK_LINES * (LPM_OUTPUT_LINE_MAX + 1));
+        LPM_ASSERT(output->block != NULL && "Buy more RAM lol");
+    }
+    fflush(output->spill);
+    fseek(output->spill, (long)start, SEEK_SET);
+    size_t size = fread(output->block, 1, end - start, output->spill);
+
+    output->block_index = block;
+    output->block_lines = 0;
+    output->block_starts[0] = 0;
+    for (size_t i = 0; i < size && output->block_lines < LPM_OUTPUT_BLOCK_LINES; ++i)
+    {
+        if (output->block[i] == '\n')
+            output->block_starts[++output->block_lines] = (uint32_t)i + 1;
+    }
+    return output->block_lines > 0;
+}
+
+static size_t _lpm_output_spilled_line(LPM_Output *output, size_t index, char *buf, size_t size)
+{
+    size_t len = 0;
+    size_t i = index % LPM_OUTPUT_BLOCK_LINES;
+    if (_lpm_output_load_block(output, index) && i < output->block_lines)
+    {
+        // the next line starts right after this one's '\n'
+        len = output->block_starts[i + 1] - output->block_starts[i] - 1;
+        if (len > size - 1)
+            len = size - 1;
+        memcpy(buf, output->block + output->block_starts[i], len);
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+size_t lpm_output_line(LPM_Output *output, size_t index, char *buf, size_t size)
+{
+    if (index < output->spilled)
+        return _lpm_output_spilled_line(output, index, buf, size);
+    index -= output->spilled;
+    if (index >= output->count)
+    {
+        buf[0] = '\0';
+        return 0;
+    }
+    LPM_Output_Line *line = _lpm_output_at(output, index);
+    size_t len = line->len < size - 1 ? line->len : size - 1;
+    memcpy(buf, output->ring + line->pos % LPM_OUTPUT_RING_SIZE, len);
+    buf[len] = '\0';
+    return len;
+}
+
+static bool _lpm_output_contains(const char *haystack, size_t len, const char *needle,
+                                 size_t needle_len)
+{
+    for (size_t i = 0; i + needle_len <= len; ++i)
+    {
+        size_t j = 0;
+        while (j < needle_len && tolower((unsigned char)haystack[i + j]) ==
+                                     tolower((unsigned char)needle[j]))
+            j++;
+        if (j == needle_len)
+            return true;
+    }
+    return false;
+}
+
+size_t lpm_output_search(LPM_Output *output, const char *needle, size_t from, bool forward)
+{
+    size_t total = lpm_output_count(output);
+    size_t needle_len = strlen(needle);
+    if (needle_len == 0 || total == 0)
+        return total;
+    if (from >= total)
+    {
+        if (forward)
+            return total;
+        from = total - 1;
+    }
+
+    char line[LPM_OUTPUT_LINE_MAX + 1];
+    for (size_t i = from;; forward ? ++i : --i)
+    {
+        if (i >= total)
+            break;
+        size_t len = lpm_output_line(output, i, line, sizeof(line));
+        if (_lpm_output_contains(line, len, needle, needle_len))
+            return i;
+        if (!forward && i == 0)
+            break;
+    }
+    return total;
+}
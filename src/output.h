@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// output.h - Bounded scrollback of command output, older lines spill to a temp file
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "process.h"
+
+// Bytes of line text kept in memory
+#ifndef LPM_OUTPUT_RING_SIZE
+#define LPM_OUTPUT_RING_SIZE (256 * 1024)
+#endif // LPM_OUTPUT_RING_SIZE
+
+// Lines kept in memory, whichever of the two limits is hit first evicts the oldest line
+#ifndef LPM_OUTPUT_RING_LINES
+#define LPM_OUTPUT_RING_LINES 4096
+#endif // LPM_OUTPUT_RING_LINES
+
+// Longer lines are truncated
+#define LPM_OUTPUT_LINE_MAX 1024
+#define LPM_OUTPUT_BLOCK_LINES 64
+
+typedef struct
+{
+    uint64_t pos; // bytes written to the ring before this line, the line is at ring[pos % size]
+    uint32_t len;
+} LPM_Output_Line;
+
+typedef struct
+{
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} LPM_Output_Checkpoints;
+
+typedef struct
+{
+    char ring[LPM_OUTPUT_RING_SIZE];
+    uint64_t write; // pos of the next line, it only ever grows
+    LPM_Output_Line lines[LPM_OUTPUT_RING_LINES];
+    size_t head; // oldest line in lines
+    size_t count;
+    bool transient; // the newest line is replaced by the next one, e.g. a download progress line
+
+    // Lines evicted from memory, in order, one per '\n'. Only the offset of every
+    // LPM_OUTPUT_BLOCK_LINES-th line is kept, spilled lines are read back a block at a time.
+    FILE *spill;
+    size_t spilled;
+    uint64_t spill_size;
+    LPM_Output_Checkpoints checkpoints;
+    char *block; // the last block read back, its lines start at block_starts
+    size_t block_index;
+    size_t block_lines; // 0 when nothing is cached
+    uint32_t block_starts[LPM_OUTPUT_BLOCK_LINES + 1];
+} LPM_Output;
+
+void lpm_output_teardown(LPM_Output *output);
+// Forget every line, e.g. before running the next command
+void lpm_output_clear(LPM_Output *output);
+// Append one line (without its terminator). A transient line is replaced by the next append.
+void lpm_output_append(LPM_Output *output, const char *line, size_t len, bool transient);
+
+// Lines appended since the last clear, in memory or spilled
+size_t lpm_output_count(const LPM_Output *output);
+// Copy line index into buf, NUL-terminated and truncated to size. Returns its length.
+size_t lpm_output_line(LPM_Output *output, size_t index, char *buf, size_t size);
+// Next line at or after from (or at or before it, going backwards) containing needle, ignoring
+// ASCII case. Returns lpm_output_count() when there is none.
+size_t lpm_output_search(LPM_Output *output, const char *needle, size_t from, bool forward);
@@ -0,0 +1,562 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// owners.c - On-disk index of the package owning each installed file, like `xbps-query -o`
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "owners.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OWNERS_MAGIC "LPMO"
+// Bump whenever the layout below changes, an older index is then rebuilt from scratch
+#define OWNERS_VERSION 1
+
+// The file is the header, the pkgver offsets, the block offsets, the NUL-terminated pkgvers and
+// the entries, each a varint run: length shared with the previous path, suffix length, suffix,
+// package. Host byte order, the index never leaves the machine.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t block_entries;
+    uint32_t package_count;
+    uint32_t entry_count;
+    uint32_t block_count;
+    uint32_t strings_size;
+    uint32_t entries_size;
+} LPM_Owners_Header;
+
+typedef struct
+{
+    const char *path;
+    size_t offset; // into the text buffer, path is only set once the buffer stopped growing
+    uint32_t package;
+} LPM_Owners_Entry;
+
+typedef struct
+{
+    LPM_Owners_Entry *items;
+    size_t count;
+    size_t capacity;
+} LPM_Owners_Entries;
+
+typedef struct
+{
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} LPM_Owners_U32s;
+
+// Walks the entries of a map in path order, decoding the front coding as it goes
+typedef struct
+{
+    const LPM_Owners_Map *map;
+    uint32_t index; // of the next entry
+    const unsigned char *p;
+    char path[LPM_OWNERS_PATH_MAX];
+    size_t len;
+    uint32_t package;
+} LPM_Owners_Cursor;
+
+static const unsigned char *_lpm_owners_varint_read(const unsigned char *p,
+                                                    const unsigned char *end, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7)
+    {
+        result |= (uint32_t)(*p & 0x7f) << shift;
+        if ((*p++ & 0x80) == 0)
+        {
+            *value = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void _lpm_owners_varint_append(LPM_Packages_Buffer *bytes, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        LPM_DA_APPEND(bytes, (char)(value | 0x80));
+        value >>= 7;
+    }
+    LPM_DA_APPEND(bytes, (char)value);
+}
+
+static void _lpm_owners_cursor_seek(LPM_Owners_Cursor *cursor, const LPM_Owners_Map *map,
+                                    uint32_t block)
+{
+    cursor->map = map;
+    cursor->index = block * LPM_OWNERS_BLOCK_ENTRIES;
+    cursor->p = block < map->block_count ? map->entries + map->blocks[block] : NULL;
+    cursor->len = 0;
+}
+
+// Decode the next entry into cursor->path and cursor->package, false at the end or on garbage
+static bool _lpm_owners_cursor_next(LPM_Owners_Cursor *cursor)
+{
+    const LPM_Owners_Map *map = cursor->map;
+    if (cursor->index >= map->entry_count || cursor->p == NULL)
+        return false;
+    const unsigned char *end = map->entries + map->entries_size;
+    uint32_t shared, suffix;
+    const unsigned char *p = _lpm_owners_varint_read(cursor->p, end, &shared);
+    if (p)
+        p = _lpm_owners_varint_read(p, end, &suffix);
+    if (p == NULL || shared > cursor->len || (size_t)shared + suffix >= sizeof(cursor->path) ||
+        suffix > (size_t)(end - p))
+        return false;
+    memcpy(cursor->path + shared, p, suffix);
+    cursor->len = shared + suffix;
+    cursor->path[cursor->len] = '\0';
+    p = _lpm_owners_varint_read(p + suffix, end, &cursor->package);
+    if (p == NULL || cursor->package >= map->package_count)
+        return false;
+    cursor->p = p;
+    cursor->index++;
+    return true;
+}
+
+static void _lpm_owners_unmap(LPM_Owners_Map *map)
+{
+    if (map->data)
+        munmap(map->data, map->size);
+    *map = (LPM_Owners_Map){0};
+}
+
+static LPM_Exit_Code _lpm_owners_map(const char *path, LPM_Owners_Map *map)
+{
+    _lpm_owners_unmap(map);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return LPM_ERROR_FILE_READ; // not built yet
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(LPM_Owners_Header))
+    {
+        close(fd);
+        return LPM_ERROR_FILE_READ;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        LPM_LOG_WARNING("Failed to map \"%s\"\n\tReason  : %s", path, strerror(errno));
+        return LPM_ERROR_FILE_READ;
+    }
+    map->data = data;
+    map->size = (size_t)st.st_size;
+
+    LPM_Owners_Header header;
+    memcpy(&header, map->data, sizeof(header));
+    uint64_t expected = sizeof(header) + 4ull * header.package_count + 4ull * header.block_count +
+                        header.strings_size + header.entries_size;
+    if (memcmp(header.magic, OWNERS_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != OWNERS_VERSION || header.block_entries != LPM_OWNERS_BLOCK_ENTRIES ||
+        expected != map->size ||
+        header.block_count !=
+            (header.entry_count + LPM_OWNERS_BLOCK_ENTRIES - 1) / LPM_OWNERS_BLOCK_ENTRIES)
+    {
+        _lpm_owners_unmap(map);
+        return LPM_ERROR_FILE_READ;
+    }
+    map->package_count = header.package_count;
+    map->entry_count = header.entry_count;
+    map->block_count = header.block_count;
+    map->packages = (const uint32_t *)(map->data + sizeof(header));
+    map->blocks = map->packages + header.package_count;
+    map->strings = (const char *)(map->blocks + header.block_count);
+    map->entries = (const unsigned char *)map->strings + header.strings_size;
+    map->entries_size = header.entries_size;
+
+    // decoding checks the entries as it goes, the offsets are checked once here
+    bool valid = header.strings_size == 0 || map->strings[header.strings_size - 1] == '\0';
+    for (uint32_t i = 0; valid && i < header.package_count; ++i)
+        valid = map->packages[i] < header.strings_size;
+    for (uint32_t i = 0; valid && i < header.block_count; ++i)
+        valid = map->blocks[i] < header.entries_size;
+    if (!valid)
+    {
+        _lpm_owners_unmap(map);
+        return LPM_ERROR_FILE_READ;
+    }
+    return LPM_OK;
+}
+
+static const char *_lpm_owners_pkgver(const LPM_Owners_Map *map, uint32_t package)
+{
+    return map->strings + map->packages[package];
+}
+
+// Package of map whose pkgver is pkgver, UINT32_MAX if there is none
+static uint32_t _lpm_owners_find_package(const LPM_Owners_Map *map, const char *pkgver)
+{
+    size_t lo = 0;
+    size_t hi = map->package_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(_lpm_owners_pkgver(map, (uint32_t)mid), pkgver);
+        if (cmp == 0)
+            return (uint32_t)mid;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return UINT32_MAX;
+}
+
+static int _lpm_owners_installed_cmp(const void *a, const void *b)
+{
+    return strcmp(((const LPM_Package_Index_Entry *)a)->pkgver,
+                  ((const LPM_Package_Index_Entry *)b)->pkgver);
+}
+
+static int _lpm_owners_entry_cmp(const void *a, const void *b)
+{
+    const LPM_Owners_Entry *ea = a;
+    const LPM_Owners_Entry *eb = b;
+    int cmp = strcmp(ea->path, eb->path);
+    if (cmp != 0)
+        return cmp;
+    return (ea->package > eb->package) - (ea->package < eb->package);
+}
+
+static void _lpm_owners_entry_append(LPM_Owners_Entries *entries, LPM_Packages_Buffer *text,
+                                     const char *path, size_t len, uint32_t package)
+{
+    if (len == 0 || len >= LPM_OWNERS_PATH_MAX)
+        return;
+    LPM_Owners_Entry entry = {.offset = text->count, .package = package};
+    LPM_DA_RESERVE(text, text->count + len + 1);
+    memcpy(text->items + text->count, path, len + 1);
+    text->count += len + 1;
+    LPM_DA_APPEND(entries, entry);
+}
+
+static LPM_Exit_Code _lpm_owners_write(const char *path, const LPM_Package_Index *installed,
+                                       const LPM_Owners_Entries *entries)
+{
+    LPM_Packages_Buffer strings = {0};
+    LPM_Owners_U32s packages = {0};
+    for (size_t i = 0; i < installed->count; ++i)
+    {
+        const char *pkgver = installed->items[i].pkgver;
+        LPM_DA_APPEND(&packages, (uint32_t)strings.count);
+        size_t len = strlen(pkgver) + 1;
+        LPM_DA_RESERVE(&strings, strings.count + len);
+        memcpy(strings.items + strings.count, pkgver, len);
+        strings.count += len;
+    }
+
+    LPM_Owners_U32s blocks = {0};
+    LPM_Packages_Buffer bytes = {0};
+    const char *previous = "";
+    for (size_t i = 0; i < entries->count; ++i)
+    {
+        const char *entry_path = entries->items[i].path;
+        size_t shared = 0;
+        if (i % LPM_OWNERS_BLOCK_ENTRIES == 0)
+            LPM_DA_APPEND(&blocks, (uint32_t)bytes.count);
+        else
+        {
+            while (previous[shared] && previous[shared] == entry_path[shared])
+                shared++;
+        }
+        size_t suffix = strlen(entry_path + shared);
+        _lpm_owners_varint_append(&bytes, (uint32_t)shared);
+        _lpm_owners_varint_append(&bytes, (uint32_t)suffix);
+        LPM_DA_RESERVE(&bytes, bytes.count + suffix);
+        memcpy(bytes.items + bytes.count, entry_path + shared, suffix);
+        bytes.count += suffix;
+        _lpm_owners_varint_append(&bytes, entries->items[i].package);
+        previous = entry_path;
+    }
+
+    LPM_Owners_Header header = {
+        .magic = OWNERS_MAGIC,
+        .version = OWNERS_VERSION,
+        .block_entries = LPM_OWNERS_BLOCK_ENTRIES,
+        .package_count = (uint32_t)packages.count,
+        .entry_count = (uint32_t)entries->count,
+        .block_count = (uint32_t)blocks.count,
+        .strings_size = (uint32_t)strings.count,
+        .entries_size = (uint32_t)bytes.count,
+    };
+
+    // write a sibling and rename it over the index, a crash never leaves half a file behind
+    LPM_Exit_Code result = LPM_OK;
+    char *tmp_path;
+    lpm_asprintf(&tmp_path, "%s.tmp", path);
+    FILE *fd = fopen(tmp_path, "wbe");
+    if (fd == NULL)
+    {
+        LPM_LOG_WARNING("Failed to write the file owners index\n\tReason  : %s: %s", tmp_path,
+                        strerror(errno));
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    bool written = fwrite(&header, sizeof(header), 1, fd) == 1;
+    if (packages.count > 0)
+        written &= fwrite(packages.items, sizeof(*packages.items), packages.count, fd) ==
+                   packages.count;
+    if (blocks.count > 0)
+        written &= fwrite(blocks.items, sizeof(*blocks.items), blocks.count, fd) == blocks.count;
+    written &= fwrite(strings.items, 1, strings.count, fd) == strings.count;
+    written &= fwrite(bytes.items, 1, bytes.count, fd) == bytes.count;
+    if (fclose(fd) == EOF || !written || rename(tmp_path, path) == -1)
+    {
+        LPM_LOG_WARNING("Failed to write the file owners index\n\tReason  : %s: %s", tmp_path,
+                        strerror(errno));
+        unlink(tmp_path);
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+
+cleanup:
+    LPM_FREE(tmp_path);
+    LPM_DA_FREE(strings);
+    LPM_DA_FREE(packages);
+    LPM_DA_FREE(blocks);
+    LPM_DA_FREE(bytes);
+    return result;
+}
+
+static LPM_Exit_Code _lpm_owners_update(LPM_Owners *owners)
+{
+    LPM_Packages_Buffer pkgdb = {0};
+    LPM_Package_Index installed = {0};
+    LPM_Exit_Code result = lpm_pkgdb_read(owners->pkgdb_path, &pkgdb, &installed);
+    if (result != LPM_OK)
+    {
+        LPM_DA_FREE(pkgdb);
+        return result;
+    }
+    if (installed.count > 0)
+        qsort(installed.items, installed.count, sizeof(*installed.items),
+              _lpm_owners_installed_cmp);
+
+    // an installed pkgver already in the old index owns the same files as back then
+    LPM_Owners_Map old = {0};
+    _lpm_owners_map(owners->index_path, &old);
+    uint32_t *remap = LPM_MALLOC((old.package_count + 1) * sizeof(*remap));
+    LPM_ASSERT(remap != NULL && "Buy more RAM lol");
+    for (uint32_t i = 0; i < old.package_count; ++i)
+        remap[i] = UINT32_MAX;
+    LPM_Owners_U32s reparse = {0};
+    for (size_t i = 0; i < installed.count; ++i)
+    {
+        uint32_t package = _lpm_owners_find_package(&old, installed.items[i].pkgver);
+        if (package == UINT32_MAX)
+            LPM_DA_APPEND(&reparse, (uint32_t)i);
+        else
+            remap[package] = (uint32_t)i;
+    }
+    owners->reparsed = reparse.count;
+    if (old.data && reparse.count == 0 && old.package_count == installed.count)
+        LPM_CLEANUP_RETURN(LPM_OK); // nothing changed since the last update
+
+    LPM_Owners_Entries entries = {0};
+    LPM_Packages_Buffer text = {0};
+    LPM_Owners_Cursor cursor;
+    _lpm_owners_cursor_seek(&cursor, &old, 0);
+    while (_lpm_owners_cursor_next(&cursor))
+    {
+        if (remap[cursor.package] != UINT32_MAX)
+            _lpm_owners_entry_append(&entries, &text, cursor.path, cursor.len,
+                                     remap[cursor.package]);
+    }
+    LPM_Packages_Buffer files = {0};
+    LPM_Pkgdb_Paths paths = {0};
+    for (size_t i = 0; i < reparse.count; ++i)
+    {
+        paths.count = 0;
+        const char *pkgver = installed.items[reparse.items[i]].pkgver;
+        if (lpm_pkgdb_read_files(owners->pkgdb_path, pkgver, &files, &paths) != LPM_OK)
+            continue;
+        for (size_t j = 0; j < paths.count; ++j)
+            _lpm_owners_entry_append(&entries, &text, paths.items[j], strlen(paths.items[j]),
+                                     reparse.items[i]);
+    }
+    LPM_DA_FREE(files);
+    LPM_DA_FREE(paths);
+
+    for (size_t i = 0; i < entries.count; ++i)
+        entries.items[i].path = text.items + entries.items[i].offset;
+    if (entries.count > 0)
+        qsort(entries.items, entries.count, sizeof(*entries.items), _lpm_owners_entry_cmp);
+    size_t unique = 0;
+    for (size_t i = 0; i < entries.count; ++i)
+    {
+        if (unique == 0 || _lpm_owners_entry_cmp(&entries.items[unique - 1], &entries.items[i]))
+            entries.items[unique++] = entries.items[i];
+    }
+    entries.count = unique;
+    result = _lpm_owners_write(owners->index_path, &installed, &entries);
+    LPM_DA_FREE(entries);
+    LPM_DA_FREE(text);
+
+cleanup:
+    _lpm_owners_unmap(&old);
+    LPM_FREE(remap);
+    LPM_DA_FREE(reparse);
+    LPM_DA_FREE(installed);
+    LPM_DA_FREE(pkgdb);
+    return result;
+}
+
+static void *_lpm_owners_worker(void *arg)
+{
+    LPM_Owners *owners = arg;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    owners->result = _lpm_owners_update(owners);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    owners->elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Updated the file owners index in %.1f ms, read the files of %zu packages",
+                 owners->elapsed_ms, owners->reparsed);
+    atomic_store(&owners->done, true);
+    return NULL;
+}
+
+void lpm_owners_start(LPM_Owners *owners, const char *pkgdb_path, const char *index_path)
+{
+    if (owners->started)
+        pthread_join(owners->thread, NULL);
+    owners->started = false;
+    LPM_FREE(owners->pkgdb_path);
+    LPM_FREE(owners->index_path);
+    owners->pkgdb_path = lpm_strdup(pkgdb_path);
+    owners->index_path = lpm_strdup(index_path);
+    atomic_store(&owners->done, false);
+    owners->active = true;
+    int err = pthread_create(&owners->thread, NULL, _lpm_owners_worker, owners);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start the file owners thread, indexing inline\n\tReason  : %s",
+                        strerror(err));
+        _lpm_owners_worker(owners);
+        return;
+    }
+    owners->started = true;
+}
+
+bool lpm_owners_active(const LPM_Owners *owners)
+{
+    return owners->active;
+}
+
+bool lpm_owners_poll(LPM_Owners *owners)
+{
+    if (!owners->active || !atomic_load(&owners->done))
+        return false;
+    if (owners->started)
+        pthread_join(owners->thread, NULL);
+    owners->started = false;
+    owners->active = false;
+    // the update renamed a new file over the index, the old mapping still shows the old one
+    if (_lpm_owners_map(owners->index_path, &owners->map) != LPM_OK && owners->result == LPM_OK)
+        owners->result = LPM_ERROR_FILE_READ;
+    return true;
+}
+
+bool lpm_owners_ready(const LPM_Owners *owners)
+{
+    return owners->map.data != NULL;
+}
+
+char *lpm_owners_path(void)
+{
+    char *dir = lpm_log_state_dir();
+    char *path;
+    lpm_asprintf(&path, "%s/%s", dir, LPM_OWNERS_FILE_NAME);
+    LPM_FREE(dir);
+    return path;
+}
+
+static void _lpm_owners_match(LPM_Owners_Matches *matches, const LPM_Owners_Cursor *cursor,
+                              size_t limit)
+{
+    if (matches->total++ >= limit)
+        return;
+    LPM_Owners_Match match = {
+        .path = matches->text.count,
+        .pkgver = _lpm_owners_pkgver(cursor->map, cursor->package),
+    };
+    LPM_DA_RESERVE(&matches->text, matches->text.count + cursor->len + 1);
+    memcpy(matches->text.items + matches->text.count, cursor->path, cursor->len + 1);
+    matches->text.count += cursor->len + 1;
+    LPM_DA_APPEND(matches, match);
+}
+
+void lpm_owners_search(const LPM_Owners *owners, const char *query, size_t limit,
+                       LPM_Owners_Matches *matches)
+{
+    matches->count = 0;
+    matches->text.count = 0;
+    matches->total = 0;
+    const LPM_Owners_Map *map = &owners->map;
+    if (map->data == NULL || query[0] == '\0')
+        return;
+
+    LPM_Owners_Cursor cursor;
+    if (query[0] != '/')
+    {
+        _lpm_owners_cursor_seek(&cursor, map, 0);
+        while (_lpm_owners_cursor_next(&cursor))
+        {
+            if (strstr(cursor.path, query))
+                _lpm_owners_match(matches, &cursor, limit);
+        }
+        return;
+    }
+
+    // first block whose first path is not below the query, matches may start in the one before
+    uint32_t lo = 0;
+    uint32_t hi = map->block_count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        _lpm_owners_cursor_seek(&cursor, map, mid);
+        if (_lpm_owners_cursor_next(&cursor) && strcmp(cursor.path, query) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t query_len = strlen(query);
+    _lpm_owners_cursor_seek(&cursor, map, lo > 0 ? lo - 1 : 0);
+    while (_lpm_owners_cursor_next(&cursor))
+    {
+        int cmp = strncmp(cursor.path, query, query_len);
+        if (cmp < 0)
+            continue;
+        if (cmp > 0)
+            break;
+        _lpm_owners_match(matches, &cursor, limit);
+    }
+}
+
+void lpm_owners_matches_teardown(LPM_Owners_Matches *matches)
+{
+    LPM_DA_FREE(*matches);
+    LPM_DA_FREE(matches->text);
+    *matches = (LPM_Owners_Matches){0};
+}
+
+void lpm_owners_teardown(LPM_Owners *owners)
+{
+    if (owners->started)
+        pthread_join(owners->thread, NULL);
+    owners->started = false;
+    owners->active = false;
+    _lpm_owners_unmap(&owners->map);
+    LPM_FREE(owners->pkgdb_path);
+    LPM_FREE(owners->index_path);
+}
@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// owners.h - On-disk index of the package owning each installed file, like `xbps-query -o`
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "pkgdb.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LPM_OWNERS_FILE_NAME "owners.idx"
+
+// Paths per block of the index. Only the first path of a block is stored whole, the others keep
+// the suffix they don't share with the previous path. Bigger blocks are smaller on disk but scan
+// more paths per lookup.
+#ifndef LPM_OWNERS_BLOCK_ENTRIES
+#define LPM_OWNERS_BLOCK_ENTRIES 16
+#endif // LPM_OWNERS_BLOCK_ENTRIES
+
+#define LPM_OWNERS_PATH_MAX 4096
+
+typedef struct
+{
+    size_t path;        // offset into LPM_Owners_Matches.text
+    const char *pkgver; // points into the mapped index
+} LPM_Owners_Match;
+
+typedef struct
+{
+    LPM_Owners_Match *items;
+    size_t count;
+    size_t capacity;
+    LPM_Packages_Buffer text; // NUL-terminated paths of the matches
+    size_t total;             // matches found, including the ones past the limit
+} LPM_Owners_Matches;
+
+// Read-only mapping of an index file
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    uint32_t package_count;
+    uint32_t entry_count;
+    uint32_t block_count;
+    const uint32_t *packages; // offset of each pkgver into strings, sorted by pkgver
+    const char *strings;
+    const uint32_t *blocks; // offset of each block into entries
+    const unsigned char *entries;
+    size_t entries_size;
+} LPM_Owners_Map;
+
+typedef struct
+{
+    LPM_Owners_Map map; // only touched by the main thread
+
+    // background update, see lpm_owners_start
+    pthread_t thread;
+    bool started;
+    bool active;
+    atomic_bool done;
+    char *pkgdb_path;
+    char *index_path;
+    LPM_Exit_Code result;
+    size_t reparsed; // packages whose files plist was read by the last update
+    double elapsed_ms;
+} LPM_Owners;
+
+// Bring the index at index_path up to date with the pkgdb at pkgdb_path on a background thread.
+// Only packages installed, updated or removed since the last update have their files plist read,
+// the paths of every other package are carried over from the old index.
+void lpm_owners_start(LPM_Owners *owners, const char *pkgdb_path, const char *index_path);
+bool lpm_owners_active(const LPM_Owners *owners);
+// Returns true once, when an update has finished and the new index is mapped
+bool lpm_owners_poll(LPM_Owners *owners);
+bool lpm_owners_ready(const LPM_Owners *owners);
+// Index file in the lazypm state directory, owned by the caller
+char *lpm_owners_path(void);
+
+// Paths matching query and the package owning each, in path order, at most limit of them. A query
+// starting with '/' is a path prefix found by binary search, anything else is matched anywhere
+// in the path, e.g. "libssl.so".
+void lpm_owners_search(const LPM_Owners *owners, const char *query, size_t limit,
+                       LPM_Owners_Matches *matches);
+void lpm_owners_matches_teardown(LPM_Owners_Matches *matches);
+
+// Wait for a running update and unmap the index
+void lpm_owners_teardown(LPM_Owners *owners);
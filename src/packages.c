@@ -5,117 +5,193 @@
 // packages.c - Track and display xbps packages
 //
 
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
 #include "packages.h"
+#include <fnmatch.h>
+#include <pthread.h>
+
+// Outputs smaller than this are parsed on the calling thread, spawning workers costs more
+#define PACKAGES_PARSE_THREADED_MIN_SIZE (4 * 1024 * 1024)
+// Rough bytes per `xbps-query -Rs` line, used to presize each worker's package array
+#define PACKAGES_PARSE_BYTES_PER_LINE 80
 
 void lpm_packages_teardown(LPM_Packages *pkgs)
 {
-    for (size_t i = 0; i < pkgs->count; ++i)
-    {
-        LPM_FREE(pkgs->items[i].status);
-        LPM_FREE(pkgs->items[i].name);
-        LPM_FREE(pkgs->items[i].description);
-    }
     LPM_FREE(pkgs->items);
+    LPM_FREE(pkgs->buffer);
     pkgs->capacity = 0;
     pkgs->count = 0;
 }
 
-typedef void (*LPM_Packages_Parse_Line_Callback)(char *line, void *data);
-
-static LPM_Exit_Code _lpm_packages_run_cmd(const char *cmd,
-                                           LPM_Packages_Parse_Line_Callback callback, void *data)
+// Parse one `[*] pkgver   short_desc` line in place: the name and description become
+// NUL-terminated spans into the line, nothing is copied.
+static bool _lpm_packages_parse_line(LPM_Package *pkg, char *line, char *end)
 {
-    uint8_t result = LPM_OK;
-    FILE *fp = NULL;
-    char *line = NULL;
-    size_t len = 0;
-
-    fp = popen(cmd, "r");
-    if (fp == NULL)
+    if (end - line < 5)
+        return false;
+    if (end[-1] == '\r')
+        end--;
+    *end = '\0';
+
+    pkg->status = memcmp(line, LPM_PACKAGE_STATUS_INSTALLED, 3) == 0
+                      ? LPM_PACKAGE_STATUS_INSTALLED
+                      : LPM_PACKAGE_STATUS_AVAILABLE;
+    pkg->name = line + 4;
+
+    char *separator = memchr(pkg->name, ' ', end - pkg->name);
+    if (separator == NULL)
     {
-        LPM_LOG_ERROR("popen() failed for command: \"%s\"\n\tReason  : %s\n", cmd, strerror(errno));
-        LPM_CLEANUP_RETURN(LPM_ERROR_PIPE_OPEN);
+        pkg->description = end;
+        return true;
     }
+    *separator = '\0';
+
+    char *description = separator + 1;
+    while (*description == ' ')
+        description++;
+    pkg->description = description;
+    return true;
+}
 
-    while (getline(&line, &len, fp) != -1)
+// Parse every line in [begin, end). end must be writable, the last line is NUL-terminated there.
+static void _lpm_packages_parse_range(LPM_Packages *pkgs, char *begin, char *end)
+{
+    char *line = begin;
+    while (line < end)
     {
-        if (callback)
-            callback(line, data);
+        char *newline = memchr(line, '\n', end - line);
+        if (newline == NULL)
+            newline = end;
+
+        LPM_Package pkg;
+        if (_lpm_packages_parse_line(&pkg, line, newline))
+            LPM_DA_APPEND(pkgs, pkg);
+        line = newline + 1;
     }
+}
 
-    if (ferror(fp))
-    {
-        LPM_LOG_ERROR("An error occurred while reading the output of: \"%s\"\n\tReason:%s\n", cmd,
-                      strerror(errno));
+typedef struct
+{
+    char *begin;
+    char *end;
+    LPM_Packages pkgs; // worker-local rows, merged in chunk order once every worker is done
+} LPM_Packages_Parse_Chunk;
 
-        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
-    }
+static void *_lpm_packages_parse_worker(void *arg)
+{
+    LPM_Packages_Parse_Chunk *chunk = arg;
+    size_t expected_lines = (chunk->end - chunk->begin) / PACKAGES_PARSE_BYTES_PER_LINE;
+    LPM_DA_RESERVE(&chunk->pkgs, expected_lines);
+    _lpm_packages_parse_range(&chunk->pkgs, chunk->begin, chunk->end);
+    return NULL;
+}
 
-cleanup:
-    LPM_FREE(line);
-    if (fp)
-    {
-        int exit_status = pclose(fp);
-        if (exit_status == -1)
-        {
-            LPM_LOG_WARNING("Failed to close command stream: \"%s\"\nReason: %s\n", cmd,
-                            strerror(errno));
-            if (result != LPM_ERROR_FILE_READ)
-                result = LPM_ERROR_PIPE_CLOSE;
-        }
-        else if (WIFEXITED(exit_status))
-        {
-            int code = WEXITSTATUS(exit_status);
-            if (code != 0)
-            {
-                LPM_LOG_ERROR("Command exited with non-zero status: %d\n", code);
-                result = LPM_ERROR_COMMAND_FAIL; // define this constant
-            }
-        }
-        else
-        {
-            LPM_LOG_ERROR("Command did not exit normally: \"%s\"\n", cmd);
-            result = LPM_ERROR_COMMAND_FAIL;
-        }
-    }
-    return result;
+static size_t _lpm_packages_parse_thread_count(size_t size)
+{
+    if (size < PACKAGES_PARSE_THREADED_MIN_SIZE)
+        return 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    size_t threads = (size_t)cpus < LPM_PACKAGES_PARSE_MAX_THREADS ? (size_t)cpus
+                                                                   : LPM_PACKAGES_PARSE_MAX_THREADS;
+    // keep every chunk big enough to be worth a thread
+    size_t by_size = size / (PACKAGES_PARSE_THREADED_MIN_SIZE / 4);
+    return threads < by_size ? threads : by_size;
 }
 
-static void _lpm_packages_get_callback(char *line, void *data)
+void lpm_packages_parse(LPM_Packages *pkgs, LPM_Packages_Buffer *buf)
 {
-    LPM_Packages *pkgs = (LPM_Packages *)data;
+    lpm_packages_parse_threads(pkgs, buf, _lpm_packages_parse_thread_count(buf->count));
+}
 
-    LPM_Package pkg = {0};
-    pkg.status = strndup(line, 3);
+void lpm_packages_parse_threads(LPM_Packages *pkgs, LPM_Packages_Buffer *buf, size_t thread_count)
+{
+    LPM_FREE(pkgs->buffer);
+    pkgs->buffer = buf->items;
+    if (buf->items == NULL)
+        return;
+
+    char *begin = buf->items;
+    char *end = buf->items + buf->count;
+    *buf = (LPM_Packages_Buffer){0};
+
+    if (thread_count > LPM_PACKAGES_PARSE_MAX_THREADS)
+        thread_count = LPM_PACKAGES_PARSE_MAX_THREADS;
+    if (thread_count <= 1)
+    {
+        _lpm_packages_parse_range(pkgs, begin, end);
+        return;
+    }
 
-    size_t i = 4;
-    while (!isspace(line[i]))
+    // Split on line boundaries: every chunk but the last ends just past a newline, so workers
+    // never share a line and can NUL-terminate fields in place without stepping on each other.
+    LPM_Packages_Parse_Chunk chunks[LPM_PACKAGES_PARSE_MAX_THREADS] = {0};
+    pthread_t threads[LPM_PACKAGES_PARSE_MAX_THREADS];
+    bool spawned[LPM_PACKAGES_PARSE_MAX_THREADS] = {0};
+    size_t chunk_size = (end - begin) / thread_count;
+    char *chunk_begin = begin;
+    for (size_t i = 0; i < thread_count; ++i)
     {
-        i++;
+        char *chunk_end = end;
+        char *split = chunk_begin + chunk_size;
+        if (i + 1 < thread_count && split < end)
+        {
+            char *newline = memchr(split, '\n', end - split);
+            chunk_end = newline ? newline + 1 : end;
+        }
+        chunks[i].begin = chunk_begin;
+        chunks[i].end = chunk_end;
+        chunk_begin = chunk_end;
     }
-    char temp = line[i];
-    line[i] = '\0';
-    pkg.name = lpm_strdup(line + 4);
-    line[i] = temp;
 
-    while (isspace(line[i]))
+    for (size_t i = 1; i < thread_count; ++i)
     {
-        i++;
+        int err = pthread_create(&threads[i], NULL, _lpm_packages_parse_worker, &chunks[i]);
+        spawned[i] = err == 0;
+        if (err != 0)
+            LPM_LOG_WARNING("Failed to spawn parse worker, parsing inline\n\tReason  : %s",
+                            strerror(err));
+    }
+    // the calling thread takes the first chunk, and any chunk whose worker failed to start
+    _lpm_packages_parse_worker(&chunks[0]);
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        if (spawned[i])
+            pthread_join(threads[i], NULL);
+        else
+            _lpm_packages_parse_worker(&chunks[i]);
     }
-    pkg.description = lpm_strdup(line + i);
 
-    LPM_DA_APPEND(pkgs, pkg);
+    size_t total = pkgs->count;
+    for (size_t i = 0; i < thread_count; ++i)
+        total += chunks[i].pkgs.count;
+    LPM_DA_RESERVE(pkgs, total);
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        if (chunks[i].pkgs.count > 0)
+            memcpy(pkgs->items + pkgs->count, chunks[i].pkgs.items,
+                   chunks[i].pkgs.count * sizeof(*pkgs->items));
+        pkgs->count += chunks[i].pkgs.count;
+        LPM_DA_FREE(chunks[i].pkgs);
+    }
 }
 
-LPM_Exit_Code lpm_packages_get(LPM_Packages *pkgs, const char *pkg_name)
+LPM_Exit_Code lpm_packages_get(LPM_Packages *pkgs)
 {
-    // pkg_name NULL -> pass empty string to get all packages
-    char *cmd;
-    lpm_asprintf(&cmd, "xbps-query -Rs '%s'", pkg_name ? pkg_name : "");
+    return lpm_packages_fetch_report(lpm_packages_fetch(pkgs));
+}
 
-    uint8_t result = _lpm_packages_run_cmd(cmd, _lpm_packages_get_callback, pkgs);
-    LPM_FREE(cmd);
+LPM_Exit_Code lpm_packages_fetch(LPM_Packages *pkgs)
+{
+    LPM_Packages_Buffer output = {0};
+    LPM_Exit_Code result = lpm_backend()->list(&output);
+    lpm_packages_parse(pkgs, &output);
+    return result;
+}
 
+LPM_Exit_Code lpm_packages_fetch_report(LPM_Exit_Code result)
+{
     if (result == LPM_OK || result == LPM_ERROR_PIPE_CLOSE)
     {
         if (result == LPM_ERROR_PIPE_CLOSE)
@@ -130,33 +206,29 @@ LPM_Exit_Code lpm_packages_get(LPM_Packages *pkgs, const char *pkg_name)
     else if (result == LPM_ERROR_COMMAND_FAIL)
         LPM_STATUS_MSG_SET_ERROR("Command failed to query package(s).");
     else
-        LPM_UNREACHABLE("lpm_packages_get error checking");
+        LPM_UNREACHABLE("lpm_packages_fetch_report error checking");
 
     return LPM_ERROR;
 }
 
-LPM_Exit_Code lpm_packages_install(LPM_Package *pkg)
+LPM_Exit_Code lpm_packages_install(LPM_Package *pkg, LPM_Progress *progress)
 {
     if (pkg == NULL || pkg->name == NULL)
         return LPM_ERROR;
 
-    char *cmd;
-    lpm_asprintf(&cmd, "sudo xbps-install -Sy '%s' 2>&1", pkg->name);
-
-    uint8_t result = _lpm_packages_run_cmd(cmd, NULL, NULL);
-    LPM_FREE(cmd);
+    char *pkgvers[] = {pkg->name, NULL};
+    uint8_t result = lpm_backend()->install(pkgvers, progress);
 
     if (result == LPM_ERROR_PIPE_OPEN)
         LPM_STATUS_MSG_SET_ERROR("Failed to open pipe stream to install package.");
     else if (result == LPM_ERROR_FILE_READ)
         LPM_STATUS_MSG_SET_ERROR("Failed to parse install results.");
     else if (result == LPM_ERROR_COMMAND_FAIL)
-        LPM_STATUS_MSG_SET_ERROR("Command failed to install package.");
+        LPM_STATUS_MSG_SET_ERROR("Command failed to install package. Press o to see its output.");
     else if (result == LPM_OK || result == LPM_ERROR_PIPE_CLOSE)
     {
         bool is_update = strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0;
-        LPM_FREE(pkg->status);
-        pkg->status = lpm_strdup(LPM_PACKAGE_STATUS_INSTALLED);
+        pkg->status = LPM_PACKAGE_STATUS_INSTALLED;
 
         if (result == LPM_OK)
         {
@@ -177,17 +249,61 @@ LPM_Exit_Code lpm_packages_install(LPM_Package *pkg)
     return result;
 }
 
-LPM_Exit_Code lpm_packages_update_all(void)
+LPM_Exit_Code lpm_packages_install_rows(LPM_Packages *pkgs, const LPM_Package_Rows *rows,
+                                        LPM_Progress *progress)
+{
+    if (rows->count == 0)
+        return LPM_ERROR;
+
+    char **pkgvers = lpm_arena_alloc(LPM_ARENA_COMMAND, (rows->count + 1) * sizeof(*pkgvers));
+    for (size_t i = 0; i < rows->count; ++i)
+        pkgvers[i] = pkgs->items[rows->items[i]].name;
+    pkgvers[rows->count] = NULL;
+
+    uint8_t result = lpm_backend()->install(pkgvers, progress);
+
+    if (result == LPM_ERROR_PIPE_OPEN)
+        LPM_STATUS_MSG_SET_ERROR("Failed to open pipe stream to install packages.");
+    else if (result == LPM_ERROR_FILE_READ)
+        LPM_STATUS_MSG_SET_ERROR("Failed to parse install results.");
+    else if (result == LPM_ERROR_COMMAND_FAIL)
+        LPM_STATUS_MSG_SET_ERROR(
+            "Command failed to install marked packages. Press o to see its output.");
+    else if (result == LPM_OK || result == LPM_ERROR_PIPE_CLOSE)
+    {
+        for (size_t i = 0; i < rows->count; ++i)
+            pkgs->items[rows->items[i]].status = LPM_PACKAGE_STATUS_INSTALLED;
+
+        if (result == LPM_OK)
+        {
+            char *status_msg;
+            lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                               "%zu marked packages were installed successfully.", rows->count);
+            LPM_STATUS_MSG_SET_SUCCESS(status_msg);
+        }
+        else
+        {
+            LPM_STATUS_MSG_SET_INFO("Install command succeeded but failed to close pipe stream.");
+            result = LPM_OK;
+        }
+    }
+    else
+        LPM_UNREACHABLE("lpm_packages_install_rows error checking");
+
+    return result;
+}
+
+LPM_Exit_Code lpm_packages_update_all(LPM_Progress *progress)
 {
-    char *cmd = "sudo xbps-install -Syu 2>&1";
-    uint8_t result = _lpm_packages_run_cmd(cmd, NULL, NULL);
+    uint8_t result = lpm_backend()->upgrade(NULL, progress);
 
     if (result == LPM_ERROR_PIPE_OPEN)
         LPM_STATUS_MSG_SET_ERROR("Failed to open pipe stream to update all packages.");
     else if (result == LPM_ERROR_FILE_READ)
         LPM_STATUS_MSG_SET_ERROR("Failed to parse update results.");
     else if (result == LPM_ERROR_COMMAND_FAIL)
-        LPM_STATUS_MSG_SET_ERROR("Command failed to update all packages.");
+        LPM_STATUS_MSG_SET_ERROR(
+            "Command failed to update all packages. Press o to see its output.");
     else if (result == LPM_OK)
         LPM_STATUS_MSG_SET_SUCCESS("Updated all packages successfully.");
     else if (result == LPM_ERROR_PIPE_CLOSE)
@@ -201,23 +317,20 @@ LPM_Exit_Code lpm_packages_update_all(void)
     return result;
 }
 
-LPM_Exit_Code lpm_packages_uninstall(LPM_Package *pkg)
+LPM_Exit_Code lpm_packages_uninstall(LPM_Package *pkg, LPM_Progress *progress)
 {
-    char *cmd;
-    lpm_asprintf(&cmd, "sudo xbps-remove -yo '%s' 2>&1", pkg->name);
-    uint8_t result = _lpm_packages_run_cmd(cmd, NULL, NULL);
-    LPM_FREE(cmd);
+    char *pkgvers[] = {pkg->name, NULL};
+    uint8_t result = lpm_backend()->remove(pkgvers, progress);
 
     if (result == LPM_ERROR_PIPE_OPEN)
         LPM_STATUS_MSG_SET_ERROR("Failed to open pipe stream to uninstall package.");
     else if (result == LPM_ERROR_FILE_READ)
         LPM_STATUS_MSG_SET_ERROR("Failed to parse uninstall results.");
     else if (result == LPM_ERROR_COMMAND_FAIL)
-        LPM_STATUS_MSG_SET_ERROR("Command failed to uninstall package.");
+        LPM_STATUS_MSG_SET_ERROR("Command failed to uninstall package. Press o to see its output.");
     else if (result == LPM_OK || result == LPM_ERROR_PIPE_CLOSE)
     {
-        LPM_FREE(pkg->status);
-        pkg->status = LPM_STRDUP(LPM_PACKAGE_STATUS_AVAILABLE);
+        pkg->status = LPM_PACKAGE_STATUS_AVAILABLE;
         if (result == LPM_OK)
             LPM_STATUS_MSG_SET_SUCCESS("Uninstalled package successfully.");
         else
@@ -232,7 +345,8 @@ LPM_Exit_Code lpm_packages_uninstall(LPM_Package *pkg)
 
 LPM_Exit_Code lpm_packages_update_xbps(void)
 {
-    uint8_t result = _lpm_packages_run_cmd("sudo xbps-install -u xbps 2>&1", NULL, NULL);
+    char *pkgnames[] = {"xbps", NULL};
+    uint8_t result = lpm_backend()->upgrade(pkgnames, NULL);
     if (result == LPM_OK)
         LPM_LOG_INFO("Xbps was updated successfully.");
     else if (result == LPM_ERROR_PIPE_OPEN)
@@ -247,3 +361,250 @@ LPM_Exit_Code lpm_packages_update_xbps(void)
         LPM_UNREACHABLE("lpm_packages_update_xbps error checking");
     return result;
 }
+
+// Failures of optional listings are only logged, callers degrade gracefully
+static LPM_Exit_Code _lpm_packages_optional(LPM_Exit_Code result, const char *what)
+{
+    if (result == LPM_OK || result == LPM_ERROR_PIPE_CLOSE)
+        return LPM_OK;
+    LPM_LOG_WARNING("Failed to list %s with the %s backend", what, lpm_backend()->name);
+    return result;
+}
+
+LPM_Exit_Code lpm_packages_get_repository(LPM_Packages *pkgs, const char *url)
+{
+    LPM_Packages_Buffer output = {0};
+    LPM_Exit_Code result =
+        _lpm_packages_optional(lpm_backend()->repository(url, &output), "repository packages");
+    lpm_packages_parse(pkgs, &output);
+    return result;
+}
+
+LPM_Exit_Code lpm_packages_list_repositories(LPM_Packages_Buffer *out)
+{
+    return _lpm_packages_optional(lpm_backend()->repositories(out), "repositories");
+}
+
+LPM_Exit_Code lpm_packages_dry_run(char *const pkgvers[], bool remove, LPM_Packages_Buffer *out,
+                                   LPM_Process_Line_Callback errors, void *data)
+{
+    return lpm_backend()->dry_run(pkgvers, remove, out, errors, data);
+}
+
+LPM_Exit_Code lpm_packages_list_orphans(LPM_Packages_Buffer *out)
+{
+    return _lpm_packages_optional(lpm_backend()->orphans(out), "orphans");
+}
+
+size_t lpm_packages_pkgname_len(const char *pkgver)
+{
+    const char *dash = strrchr(pkgver, '-');
+    if (dash == NULL)
+        return strlen(pkgver);
+    return dash - pkgver;
+}
+
+bool lpm_packages_match(const LPM_Package *pkg, const char *pattern)
+{
+    size_t name_len = lpm_packages_pkgname_len(pkg->name);
+    if (strpbrk(pattern, "*?[") == NULL)
+        return strlen(pattern) == name_len && strncmp(pkg->name, pattern, name_len) == 0;
+
+    // fnmatch() needs a NUL-terminated subject, and the pkgname is only a prefix of the pkgver
+    char name[LPM_PACKAGE_NAME_MAX];
+    if (name_len >= sizeof(name))
+        name_len = sizeof(name) - 1;
+    memcpy(name, pkg->name, name_len);
+    name[name_len] = '\0';
+    return fnmatch(pattern, name, 0) == 0;
+}
+
+// ASCII case-insensitive strstr(), needle must already be lowercase
+static bool _lpm_packages_strcasestr(const char *haystack, const char *needle, size_t needle_len)
+{
+    char first = needle[0];
+    char first_upper = (char)toupper((unsigned char)first);
+    for (const char *p = haystack; *p; ++p)
+    {
+        if (*p != first && *p != first_upper)
+            continue;
+        size_t i = 1;
+        while (i < needle_len && tolower((unsigned char)p[i]) == (unsigned char)needle[i])
+            i++;
+        if (i == needle_len)
+            return true;
+    }
+    return false;
+}
+
+bool lpm_packages_contains(const LPM_Package *pkg, const char *needle)
+{
+    size_t needle_len = strlen(needle);
+    if (needle_len == 0)
+        return true;
+    return _lpm_packages_strcasestr(pkg->name, needle, needle_len) ||
+           _lpm_packages_strcasestr(pkg->description, needle, needle_len);
+}
+
+// Eight bytes at a time: a word is printable ASCII when no byte is below ' ', is DEL or has the
+// high bit of a UTF-8 sequence set
+#define PACKAGES_SWAR_ONES UINT64_C(0x0101010101010101)
+#define PACKAGES_SWAR_HIGHS UINT64_C(0x8080808080808080)
+
+static bool _lpm_packages_word_printable(uint64_t word)
+{
+    uint64_t below_space = (word - PACKAGES_SWAR_ONES * ' ') & ~word & PACKAGES_SWAR_HIGHS;
+    uint64_t del = word ^ (PACKAGES_SWAR_ONES * 0x7f);
+    uint64_t is_del = (del - PACKAGES_SWAR_ONES) & ~del & PACKAGES_SWAR_HIGHS;
+    return ((word & PACKAGES_SWAR_HIGHS) | below_space | is_del) == 0;
+}
+
+static size_t _lpm_packages_ascii_prefix(const char *s, size_t len)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, s + i, sizeof(word));
+        if (!_lpm_packages_word_printable(word))
+            break;
+    }
+    while (i < len && s[i] >= ' ' && s[i] < 0x7f)
+        i++;
+    return i;
+}
+
+// Columns of one codepoint as tb_print draws it: what termbox cannot print becomes U+FFFD
+static int _lpm_packages_codepoint_width(const char *s, size_t *len)
+{
+    uint32_t codepoint = 0xfffd;
+    int n = tb_utf8_char_to_unicode(&codepoint, s);
+    *len = n < 0 ? (size_t)-n : (size_t)n;
+    if (n <= 0)
+        return 1;
+    int width = tb_wcwidth(codepoint);
+    return width < 0 ? 1 : width;
+}
+
+size_t lpm_packages_text_cut(const char *s, size_t ascii, size_t columns, size_t *width)
+{
+    if (columns <= ascii)
+    {
+        *width = columns;
+        return columns;
+    }
+    size_t i = ascii;
+    size_t taken = ascii;
+    while (s[i] != '\0')
+    {
+        size_t len;
+        int w = _lpm_packages_codepoint_width(s + i, &len);
+        if (len == 0 || taken + w > columns)
+            break;
+        taken += w;
+        i += len;
+    }
+    *width = taken;
+    return i;
+}
+
+static uint16_t _lpm_packages_clamp_width(size_t width)
+{
+    return width < UINT16_MAX ? (uint16_t)width : UINT16_MAX;
+}
+
+void lpm_packages_measure(LPM_Packages *pkgs)
+{
+    for (size_t i = 0; i < pkgs->count; ++i)
+    {
+        LPM_Package *pkg = &pkgs->items[i];
+        size_t width;
+        size_t len = strlen(pkg->name);
+        size_t ascii = _lpm_packages_ascii_prefix(pkg->name, len);
+        lpm_packages_text_cut(pkg->name, ascii, SIZE_MAX, &width);
+        pkg->name_width = _lpm_packages_clamp_width(width);
+
+        len = strlen(pkg->description);
+        ascii = _lpm_packages_ascii_prefix(pkg->description, len);
+        // the prefix of a longer description is still exact, only its width saturates
+        pkg->description_ascii = _lpm_packages_clamp_width(ascii);
+        width = ascii;
+        if (ascii < len)
+            lpm_packages_text_cut(pkg->description, ascii, SIZE_MAX, &width);
+        pkg->description_width = _lpm_packages_clamp_width(width);
+    }
+}
+
+void lpm_packages_rows_all(LPM_Package_Rows *rows, const LPM_Packages *pkgs)
+{
+    rows->count = 0;
+    LPM_DA_RESERVE(rows, pkgs->count);
+    for (size_t i = 0; i < pkgs->count; ++i)
+        rows->items[i] = (uint32_t)i;
+    rows->count = pkgs->count;
+}
+
+static int _lpm_packages_index_cmp_name(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0)
+        return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+static int _lpm_packages_index_cmp(const void *a, const void *b)
+{
+    const LPM_Package_Index_Entry *ea = a;
+    const LPM_Package_Index_Entry *eb = b;
+    int cmp = _lpm_packages_index_cmp_name(ea->pkgver, ea->name_len, eb->pkgver, eb->name_len);
+    if (cmp != 0)
+        return cmp;
+    cmp = strcmp(ea->pkgver, eb->pkgver);
+    if (cmp != 0)
+        return cmp;
+    return (ea->row > eb->row) - (ea->row < eb->row);
+}
+
+void lpm_packages_index_build(LPM_Package_Index *index, const LPM_Packages *pkgs)
+{
+    index->count = 0;
+    LPM_DA_RESERVE(index, pkgs->count);
+    for (size_t i = 0; i < pkgs->count; ++i)
+    {
+        index->items[i] = (LPM_Package_Index_Entry){
+            .pkgver = pkgs->items[i].name,
+            .name_len = (uint32_t)lpm_packages_pkgname_len(pkgs->items[i].name),
+            .row = (uint32_t)i,
+        };
+    }
+    index->count = pkgs->count;
+    lpm_packages_index_sort(index);
+}
+
+void lpm_packages_index_sort(LPM_Package_Index *index)
+{
+    if (index->count > 0)
+        qsort(index->items, index->count, sizeof(*index->items), _lpm_packages_index_cmp);
+}
+
+void lpm_packages_index_range(const LPM_Package_Index *index, const char *name, size_t len,
+                              size_t *first, size_t *last)
+{
+    size_t lo = 0;
+    size_t hi = index->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const LPM_Package_Index_Entry *entry = &index->items[mid];
+        if (_lpm_packages_index_cmp_name(entry->pkgver, entry->name_len, name, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *first = lo;
+    while (lo < index->count &&
+           _lpm_packages_index_cmp_name(index->items[lo].pkgver, index->items[lo].name_len, name,
+                                        len) == 0)
+        lo++;
+    *last = lo;
+}
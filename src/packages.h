@@ -7,18 +7,33 @@
 
 #pragma once
 
+#include "backend.h"
 #include "common.h"
 #include "logs.h"
+#include "process.h"
+#include "progress.h"
 #include "status.h"
 
 #define LPM_PACKAGE_STATUS_INSTALLED "[*]"
 #define LPM_PACKAGE_STATUS_AVAILABLE "[-]"
+#define LPM_PACKAGE_STATUS_SOURCE "[s]" // template in a void-packages checkout, see srcpkgs.h
+#define LPM_PACKAGE_NAME_MAX 256
+
+// Upper bound on worker threads used to parse very large package listings
+#ifndef LPM_PACKAGES_PARSE_MAX_THREADS
+#define LPM_PACKAGES_PARSE_MAX_THREADS 8
+#endif // LPM_PACKAGES_PARSE_MAX_THREADS
 
 typedef struct
 {
-    char *status;
-    char *name;
-    char *description;
+    const char *status; // LPM_PACKAGE_STATUS_INSTALLED, _AVAILABLE or _SOURCE
+    char *name;         // pkgver, points into LPM_Packages.buffer
+    char *description;  // points into LPM_Packages.buffer
+
+    // Display columns, filled in by lpm_packages_measure so frames never scan the text
+    uint16_t name_width;
+    uint16_t description_width;
+    uint16_t description_ascii; // bytes of the printable ASCII prefix, a column in it is a byte
 } LPM_Package;
 
 typedef struct
@@ -26,11 +41,84 @@ typedef struct
     LPM_Package *items;
     size_t count;
     size_t capacity;
+    char *buffer; // raw xbps-query output, package fields are NUL-terminated spans into it
 } LPM_Packages;
 
+typedef LPM_Process_Buffer LPM_Packages_Buffer;
+
+// A set of rows of an LPM_Packages table, used for views over the full package list
+typedef struct
+{
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} LPM_Package_Rows;
+
+// Rows sorted by (pkgname, pkgver) for looking packages up by name
+typedef struct
+{
+    const char *pkgver;
+    uint32_t name_len;
+    uint32_t row;
+} LPM_Package_Index_Entry;
+
+typedef struct
+{
+    LPM_Package_Index_Entry *items;
+    size_t count;
+    size_t capacity;
+} LPM_Package_Index;
+
 void lpm_packages_teardown(LPM_Packages *pkgs);
-LPM_Exit_Code lpm_packages_get(LPM_Packages *pkgs, const char *pkg_name);
-LPM_Exit_Code lpm_packages_install(LPM_Package *pkg);
-LPM_Exit_Code lpm_packages_update_all(void);
-LPM_Exit_Code lpm_packages_uninstall(LPM_Package *pkg);
+// Parse `xbps-query -Rs` output in place. pkgs takes ownership of buf, which must be
+// NUL-terminated at buf->items[buf->count]. Large outputs are split on line boundaries and parsed
+// on up to LPM_PACKAGES_PARSE_MAX_THREADS threads, rows keep their original order.
+void lpm_packages_parse(LPM_Packages *pkgs, LPM_Packages_Buffer *buf);
+// lpm_packages_parse on thread_count threads (at most LPM_PACKAGES_PARSE_MAX_THREADS) whatever the
+// size of buf and the CPUs online, for tests/bench.c
+void lpm_packages_parse_threads(LPM_Packages *pkgs, LPM_Packages_Buffer *buf, size_t thread_count);
+// Every package of every repository, see LPM_Backend.list
+LPM_Exit_Code lpm_packages_get(LPM_Packages *pkgs);
+// lpm_packages_get in two halves for loading off the main thread: lpm_packages_fetch only runs the
+// query and parses it, lpm_packages_fetch_report turns its result into a status message
+LPM_Exit_Code lpm_packages_fetch(LPM_Packages *pkgs);
+LPM_Exit_Code lpm_packages_fetch_report(LPM_Exit_Code result);
+// Transactions take an optional progress, fed with their output as it streams in
+LPM_Exit_Code lpm_packages_install(LPM_Package *pkg, LPM_Progress *progress);
+// Install or update every row in a single transaction
+LPM_Exit_Code lpm_packages_install_rows(LPM_Packages *pkgs, const LPM_Package_Rows *rows,
+                                        LPM_Progress *progress);
+LPM_Exit_Code lpm_packages_update_all(LPM_Progress *progress);
+LPM_Exit_Code lpm_packages_uninstall(LPM_Package *pkg, LPM_Progress *progress);
 LPM_Exit_Code lpm_packages_update_xbps(void);
+// Resolve a transaction without running it, see LPM_Backend.dry_run. Safe on a worker thread.
+LPM_Exit_Code lpm_packages_dry_run(char *const pkgvers[], bool remove, LPM_Packages_Buffer *out,
+                                   LPM_Process_Line_Callback errors, void *data);
+// Packages of a single repository, `xbps-query -Rs` restricted to url
+LPM_Exit_Code lpm_packages_get_repository(LPM_Packages *pkgs, const char *url);
+// Raw output of `xbps-query -L` and `xbps-query -O`
+LPM_Exit_Code lpm_packages_list_repositories(LPM_Packages_Buffer *out);
+LPM_Exit_Code lpm_packages_list_orphans(LPM_Packages_Buffer *out);
+
+// Length of the pkgname portion of a pkgver, e.g. "foo-bar-1.0_1" -> strlen("foo-bar")
+size_t lpm_packages_pkgname_len(const char *pkgver);
+// Match a package against an exact pkgname or a shell glob over the pkgname ("python3-*")
+bool lpm_packages_match(const LPM_Package *pkg, const char *pattern);
+// Case-insensitive substring search over the pkgver and description, like `xbps-query -Rs`.
+// needle must already be lowercase.
+bool lpm_packages_contains(const LPM_Package *pkg, const char *needle);
+// Fill in the display widths of every row, once per load. Printable ASCII is checked eight bytes
+// at a time, anything else is measured with termbox's own width table.
+void lpm_packages_measure(LPM_Packages *pkgs);
+// Bytes of s that fit in columns, *width gets the columns they take. ascii is the length of the
+// printable ASCII prefix of s, a cut within it costs nothing.
+size_t lpm_packages_text_cut(const char *s, size_t ascii, size_t columns, size_t *width);
+// Set rows to every row of pkgs, in table order
+void lpm_packages_rows_all(LPM_Package_Rows *rows, const LPM_Packages *pkgs);
+
+void lpm_packages_index_build(LPM_Package_Index *index, const LPM_Packages *pkgs);
+// Sort entries added by hand into the order lpm_packages_index_build leaves them in
+void lpm_packages_index_sort(LPM_Package_Index *index);
+// Entries [*first, *last) of index whose pkgname is name[0..len)
+void lpm_packages_index_range(const LPM_Package_Index *index, const char *name, size_t len,
+                              size_t *first, size_t *last);
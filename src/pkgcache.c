@@ -0,0 +1,535 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// pkgcache.c - What the xbps package cache holds and which of it can go
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "pkgcache.h"
+#include "version.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Caches smaller than this per thread are not worth another thread
+#define PKGCACHE_FILES_PER_THREAD 1024
+// Files claimed by a thread at a time, keeps the shared counter out of the hot path
+#define PKGCACHE_STAT_BATCH 64
+
+static const struct
+{
+    const char *suffix;
+    uint32_t part;
+} _lpm_pkgcache_suffixes[] = {
+    {".xbps", LPM_PKGCACHE_PART_XBPS},
+    {".xbps.sig", LPM_PKGCACHE_PART_SIG},
+    {".xbps.sig2", LPM_PKGCACHE_PART_SIG2},
+};
+
+// A directory entry that is part of a cached package
+typedef struct
+{
+    char *name;
+    size_t base_len; // name[0..base_len) is the "pkgver.arch.xbps" the entry belongs to
+    uint32_t part;
+    int64_t bytes;
+} LPM_Pkgcache_Entry;
+
+typedef struct
+{
+    LPM_Pkgcache_Entry *items;
+    size_t count;
+    size_t capacity;
+} LPM_Pkgcache_Entries;
+
+// Work shared by the stat threads
+typedef struct
+{
+    int dir_fd;
+    LPM_Pkgcache_Entries *entries;
+    atomic_size_t next;
+} LPM_Pkgcache_Stat;
+
+static bool _lpm_pkgcache_mtime_equal(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+static bool _lpm_pkgcache_mtime(const char *path, struct timespec *mtime)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    *mtime = st.st_mtim;
+    return true;
+}
+
+//
+// listing
+//
+
+static void *_lpm_pkgcache_stat_worker(void *arg)
+{
+    LPM_Pkgcache_Stat *scan = arg;
+    size_t first;
+    while ((first = atomic_fetch_add(&scan->next, PKGCACHE_STAT_BATCH)) < scan->entries->count)
+    {
+        size_t last = first + PKGCACHE_STAT_BATCH;
+        if (last > scan->entries->count)
+            last = scan->entries->count;
+        for (size_t i = first; i < last; ++i)
+        {
+            LPM_Pkgcache_Entry *entry = &scan->entries->items[i];
+            struct stat st;
+            if (fstatat(scan->dir_fd, entry->name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+                S_ISREG(st.st_mode))
+                entry->bytes = (int64_t)st.st_blocks * 512; // what deleting it gives back
+            else
+                entry->bytes = -1; // gone since it was listed, or not a file
+        }
+    }
+    return NULL;
+}
+
+static size_t _lpm_pkgcache_thread_count(size_t files)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    size_t threads = (size_t)cpus < LPM_PKGCACHE_MAX_THREADS ? (size_t)cpus
+                                                             : LPM_PKGCACHE_MAX_THREADS;
+    size_t by_size = files / PKGCACHE_FILES_PER_THREAD + 1;
+    return threads < by_size ? threads : by_size;
+}
+
+// Size every entry on up to LPM_PKGCACHE_MAX_THREADS threads, the calling one included. Returns
+// the number of threads used.
+static size_t _lpm_pkgcache_stat_entries(int dir_fd, LPM_Pkgcache_Entries *entries)
+{
+    LPM_Pkgcache_Stat scan = {.dir_fd = dir_fd, .entries = entries};
+    atomic_store(&scan.next, 0);
+    size_t thread_count = _lpm_pkgcache_thread_count(entries->count);
+    pthread_t threads[LPM_PKGCACHE_MAX_THREADS];
+    bool spawned[LPM_PKGCACHE_MAX_THREADS] = {0};
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        int err = pthread_create(&threads[i], NULL, _lpm_pkgcache_stat_worker, &scan);
+        spawned[i] = err == 0;
+        if (err != 0)
+            LPM_LOG_WARNING("Failed to spawn cache worker, scanning inline\n\tReason  : %s",
+                            strerror(err));
+    }
+    // the calling thread works too, and picks up whatever a missing worker would have done
+    _lpm_pkgcache_stat_worker(&scan);
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        if (spawned[i])
+            pthread_join(threads[i], NULL);
+    }
+    return thread_count;
+}
+
+static int _lpm_pkgcache_entry_cmp(const void *a, const void *b)
+{
+    const LPM_Pkgcache_Entry *ea = a;
+    const LPM_Pkgcache_Entry *eb = b;
+    size_t len = ea->base_len < eb->base_len ? ea->base_len : eb->base_len;
+    int cmp = memcmp(ea->name, eb->name, len);
+    if (cmp != 0)
+        return cmp;
+    return (ea->base_len > eb->base_len) - (ea->base_len < eb->base_len);
+}
+
+// Turn the entries of one "pkgver.arch.xbps" into a file, false when the name is no pkgver
+static bool _lpm_pkgcache_file(const LPM_Pkgcache_Entry *entries, size_t count,
+                               LPM_Pkgcache_File *file)
+{
+    const char *base = entries[0].name;
+    size_t base_len = entries[0].base_len;
+    // the arch is everything after the last dot before ".xbps", versions have dots of their own
+    size_t stem_len = base_len - strlen(".xbps");
+    size_t pkgver_len = stem_len - 1;
+    while (pkgver_len > 0 && base[pkgver_len] != '.')
+        pkgver_len--;
+    if (pkgver_len == 0)
+        return false;
+
+    // "pkgver.arch.xbps\0pkgver\0" in one allocation
+    char *name = LPM_MALLOC(base_len + 1 + pkgver_len + 1);
+    LPM_ASSERT(name != NULL && "Buy more RAM lol");
+    memcpy(name, base, base_len);
+    name[base_len] = '\0';
+    char *pkgver = name + base_len + 1;
+    memcpy(pkgver, base, pkgver_len);
+    pkgver[pkgver_len] = '\0';
+    size_t name_len = lpm_packages_pkgname_len(pkgver);
+    if (name_len == 0 || name_len >= pkgver_len)
+    {
+        LPM_FREE(name);
+        return false;
+    }
+
+    *file = (LPM_Pkgcache_File){.name = name, .pkgver = pkgver, .name_len = (uint32_t)name_len};
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (entries[i].bytes < 0)
+            continue;
+        file->parts |= entries[i].part;
+        file->bytes += entries[i].bytes;
+    }
+    return file->parts != 0;
+}
+
+static LPM_Exit_Code _lpm_pkgcache_list(LPM_Pkgcache *cache)
+{
+    DIR *dir = lpm_process_opendir(cache->dir);
+    if (dir == NULL)
+    {
+        LPM_LOG_ERROR("Failed to open \"%s\"\n\tReason  : %s", cache->dir, strerror(errno));
+        return LPM_ERROR_FILE_READ;
+    }
+    LPM_Pkgcache_Entries entries = {0};
+    struct dirent *dirent;
+    while ((dirent = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(dirent->d_name);
+        for (size_t s = 0; s < sizeof(_lpm_pkgcache_suffixes) / sizeof(*_lpm_pkgcache_suffixes);
+             ++s)
+        {
+            size_t suffix_len = strlen(_lpm_pkgcache_suffixes[s].suffix);
+            if (len <= suffix_len ||
+                strcmp(dirent->d_name + len - suffix_len, _lpm_pkgcache_suffixes[s].suffix) != 0)
+                continue;
+            LPM_Pkgcache_Entry entry = {
+                .name = lpm_strdup(dirent->d_name),
+                .base_len = len - suffix_len + strlen(".xbps"),
+                .part = _lpm_pkgcache_suffixes[s].part,
+            };
+            LPM_DA_APPEND(&entries, entry);
+            break;
+        }
+    }
+    cache->threads = _lpm_pkgcache_stat_entries(dirfd(dir), &entries);
+    closedir(dir);
+
+    // the signatures of a package sort right next to it
+    if (entries.count > 0)
+        qsort(entries.items, entries.count, sizeof(*entries.items), _lpm_pkgcache_entry_cmp);
+    for (size_t first = 0; first < entries.count;)
+    {
+        size_t last = first + 1;
+        while (last < entries.count &&
+               _lpm_pkgcache_entry_cmp(&entries.items[first], &entries.items[last]) == 0)
+            last++;
+        LPM_Pkgcache_File file;
+        if (_lpm_pkgcache_file(&entries.items[first], last - first, &file))
+            LPM_DA_APPEND(&cache->files, file);
+        first = last;
+    }
+
+    for (size_t i = 0; i < entries.count; ++i)
+        LPM_FREE(entries.items[i].name);
+    LPM_DA_FREE(entries);
+    return LPM_OK;
+}
+
+//
+// classification
+//
+
+static int _lpm_pkgcache_name_cmp(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0)
+        return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+static int _lpm_pkgcache_file_cmp(const void *a, const void *b)
+{
+    const LPM_Pkgcache_File *fa = a;
+    const LPM_Pkgcache_File *fb = b;
+    int cmp = _lpm_pkgcache_name_cmp(fa->pkgver, fa->name_len, fb->pkgver, fb->name_len);
+    if (cmp != 0)
+        return cmp;
+    cmp = lpm_version_compare(lpm_version_of(fa->pkgver), lpm_version_of(fb->pkgver));
+    if (cmp != 0)
+        return cmp;
+    return strcmp(fa->name, fb->name); // same pkgver for another arch
+}
+
+static int _lpm_pkgcache_installed_cmp(const void *a, const void *b)
+{
+    const LPM_Package_Index_Entry *ea = a;
+    const LPM_Package_Index_Entry *eb = b;
+    return _lpm_pkgcache_name_cmp(ea->pkgver, ea->name_len, eb->pkgver, eb->name_len);
+}
+
+static const char *_lpm_pkgcache_installed(const LPM_Package_Index *installed, const char *name,
+                                           size_t len)
+{
+    size_t lo = 0;
+    size_t hi = installed->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const LPM_Package_Index_Entry *entry = &installed->items[mid];
+        int cmp = _lpm_pkgcache_name_cmp(entry->pkgver, entry->name_len, name, len);
+        if (cmp == 0)
+            return entry->pkgver;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+static int _lpm_pkgcache_group_cmp(const void *a, const void *b)
+{
+    const LPM_Pkgcache_Group *ga = a;
+    const LPM_Pkgcache_Group *gb = b;
+    if (ga->reclaimable != gb->reclaimable)
+        return ga->reclaimable < gb->reclaimable ? 1 : -1;
+    if (ga->bytes != gb->bytes)
+        return ga->bytes < gb->bytes ? 1 : -1;
+    return _lpm_pkgcache_name_cmp(ga->pkgname, ga->name_len, gb->pkgname, gb->name_len);
+}
+
+static LPM_Exit_Code _lpm_pkgcache_classify(LPM_Pkgcache *cache)
+{
+    LPM_Packages_Buffer pkgdb = {0};
+    LPM_Package_Index installed = {0};
+    LPM_Exit_Code result = lpm_pkgdb_read(cache->pkgdb_path, &pkgdb, &installed);
+    if (result != LPM_OK)
+    {
+        LPM_DA_FREE(pkgdb);
+        LPM_DA_FREE(installed);
+        return result;
+    }
+    if (installed.count > 0)
+        qsort(installed.items, installed.count, sizeof(*installed.items),
+              _lpm_pkgcache_installed_cmp);
+
+    cache->groups.count = 0;
+    cache->bytes = 0;
+    cache->reclaimable = 0;
+    for (size_t i = 0; i < cache->files.count; ++i)
+    {
+        LPM_Pkgcache_File *file = &cache->files.items[i];
+        const char *current = _lpm_pkgcache_installed(&installed, file->pkgver, file->name_len);
+        int cmp = current ? lpm_version_compare(lpm_version_of(file->pkgver),
+                                                lpm_version_of(current))
+                          : 0;
+        file->state = current == NULL ? LPM_PKGCACHE_NOT_INSTALLED
+                      : cmp < 0       ? LPM_PKGCACHE_SUPERSEDED
+                      : cmp > 0       ? LPM_PKGCACHE_PENDING
+                                      : LPM_PKGCACHE_CURRENT;
+        bool reclaimable =
+            file->state == LPM_PKGCACHE_SUPERSEDED || file->state == LPM_PKGCACHE_NOT_INSTALLED;
+
+        LPM_Pkgcache_Group *group = cache->groups.count > 0
+                                        ? &cache->groups.items[cache->groups.count - 1]
+                                        : NULL;
+        if (group == NULL || _lpm_pkgcache_name_cmp(group->pkgname, group->name_len,
+                                                    file->pkgver, file->name_len) != 0)
+        {
+            LPM_Pkgcache_Group next = {
+                .pkgname = file->pkgver,
+                .name_len = file->name_len,
+                .first = i,
+            };
+            LPM_DA_APPEND(&cache->groups, next);
+            group = &cache->groups.items[cache->groups.count - 1];
+        }
+        group->count++;
+        group->bytes += file->bytes;
+        group->reclaimable += reclaimable ? file->bytes : 0;
+        cache->bytes += file->bytes;
+        cache->reclaimable += reclaimable ? file->bytes : 0;
+    }
+    if (cache->groups.count > 0)
+        qsort(cache->groups.items, cache->groups.count, sizeof(*cache->groups.items),
+              _lpm_pkgcache_group_cmp);
+
+    LPM_DA_FREE(installed);
+    LPM_DA_FREE(pkgdb);
+    return LPM_OK;
+}
+
+//
+// scan
+//
+
+static void _lpm_pkgcache_free_files(LPM_Pkgcache *cache)
+{
+    for (size_t i = 0; i < cache->files.count; ++i)
+        LPM_FREE(cache->files.items[i].name);
+    cache->files.count = 0;
+    cache->groups.count = 0;
+}
+
+static void *_lpm_pkgcache_worker(void *arg)
+{
+    LPM_Pkgcache *cache = arg;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cache->result = LPM_OK;
+    if (cache->listed)
+    {
+        _lpm_pkgcache_free_files(cache);
+        cache->result = _lpm_pkgcache_list(cache);
+        if (cache->result == LPM_OK && cache->files.count > 0)
+            qsort(cache->files.items, cache->files.count, sizeof(*cache->files.items),
+                  _lpm_pkgcache_file_cmp);
+    }
+    if (cache->result == LPM_OK)
+        cache->result = _lpm_pkgcache_classify(cache);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    cache->elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    if (cache->result == LPM_OK)
+        LPM_LOG_INFO("%s %zu cached packages of %s in %.1f ms on %zu threads\n"
+                     "\tSize    : %.1f MiB in %zu packages, %.1f MiB reclaimable",
+                     cache->listed ? "Scanned" : "Reclassified", cache->files.count, cache->dir,
+                     cache->elapsed_ms, cache->listed ? cache->threads : 1,
+                     cache->bytes / (1024.0 * 1024.0), cache->groups.count,
+                     cache->reclaimable / (1024.0 * 1024.0));
+    atomic_store(&cache->done, true);
+    return NULL;
+}
+
+bool lpm_pkgcache_start(LPM_Pkgcache *cache, const char *dir, const char *pkgdb_path)
+{
+    if (cache->active)
+        return false;
+
+    struct timespec dir_mtime = {0};
+    struct timespec pkgdb_mtime = {0};
+    _lpm_pkgcache_mtime(dir, &dir_mtime);
+    _lpm_pkgcache_mtime(pkgdb_path, &pkgdb_mtime);
+    bool same_dir = cache->dir && strcmp(cache->dir, dir) == 0;
+    bool same_pkgdb = cache->pkgdb_path && strcmp(cache->pkgdb_path, pkgdb_path) == 0;
+    // a package added or removed renames an entry, which bumps the directory mtime
+    bool listed = !cache->scanned || !same_dir ||
+                  !_lpm_pkgcache_mtime_equal(&cache->dir_mtime, &dir_mtime);
+    if (!listed && same_pkgdb && _lpm_pkgcache_mtime_equal(&cache->pkgdb_mtime, &pkgdb_mtime))
+        return false;
+
+    if (!same_dir)
+    {
+        LPM_FREE(cache->dir);
+        cache->dir = lpm_strdup(dir);
+    }
+    if (!same_pkgdb)
+    {
+        LPM_FREE(cache->pkgdb_path);
+        cache->pkgdb_path = lpm_strdup(pkgdb_path);
+    }
+    // taken before the scan, a change during it is picked up by the next one
+    cache->dir_mtime = dir_mtime;
+    cache->pkgdb_mtime = pkgdb_mtime;
+    cache->scanned = true;
+    cache->listed = listed;
+    atomic_store(&cache->done, false);
+    cache->active = true;
+    int err = pthread_create(&cache->thread, NULL, _lpm_pkgcache_worker, cache);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start the cache scan thread, scanning inline\n\tReason  : %s",
+                        strerror(err));
+        _lpm_pkgcache_worker(cache);
+        return true;
+    }
+    cache->started = true;
+    return true;
+}
+
+bool lpm_pkgcache_active(const LPM_Pkgcache *cache)
+{
+    return cache->active;
+}
+
+bool lpm_pkgcache_poll(LPM_Pkgcache *cache)
+{
+    if (!cache->active || !atomic_load(&cache->done))
+        return false;
+    if (cache->started)
+        pthread_join(cache->thread, NULL);
+    cache->started = false;
+    cache->active = false;
+    if (cache->result != LPM_OK)
+        cache->scanned = false; // try again next time
+    return true;
+}
+
+LPM_Exit_Code lpm_pkgcache_purge(LPM_Pkgcache *cache, const LPM_Bitset *selected, size_t *removed,
+                                 int64_t *freed)
+{
+    *removed = 0;
+    *freed = 0;
+    if (cache->active)
+        return LPM_ERROR;
+
+    LPM_Exit_Code result = LPM_OK;
+    char *path = NULL;
+    for (size_t g = 0; g < cache->groups.count; ++g)
+    {
+        if (!lpm_bitset_test(selected, g))
+            continue;
+        const LPM_Pkgcache_Group *group = &cache->groups.items[g];
+        for (size_t i = group->first; i < group->first + group->count; ++i)
+        {
+            const LPM_Pkgcache_File *file = &cache->files.items[i];
+            if (file->state != LPM_PKGCACHE_SUPERSEDED &&
+                file->state != LPM_PKGCACHE_NOT_INSTALLED)
+                continue;
+            bool purged = true;
+            for (size_t s = 0;
+                 s < sizeof(_lpm_pkgcache_suffixes) / sizeof(*_lpm_pkgcache_suffixes); ++s)
+            {
+                if (!(file->parts & _lpm_pkgcache_suffixes[s].part))
+                    continue;
+                LPM_FREE(path);
+                // name ends in ".xbps", the suffixes start with it
+                lpm_asprintf(&path, "%s/%.*s%s", cache->dir,
+                             (int)(strlen(file->name) - strlen(".xbps")), file->name,
+                             _lpm_pkgcache_suffixes[s].suffix);
+                if (unlink(path) != 0 && errno != ENOENT)
+                {
+                    LPM_LOG_ERROR("Failed to delete \"%s\"\n\tReason  : %s", path,
+                                  strerror(errno));
+                    purged = false;
+                    result = LPM_ERROR;
+                }
+            }
+            if (purged)
+            {
+                (*removed)++;
+                *freed += file->bytes;
+            }
+        }
+    }
+    LPM_FREE(path);
+    LPM_LOG_INFO("Purged %zu cached packages, %.1f MiB, from %s", *removed,
+                 *freed / (1024.0 * 1024.0), cache->dir);
+    return result;
+}
+
+void lpm_pkgcache_teardown(LPM_Pkgcache *cache)
+{
+    if (cache->started)
+        pthread_join(cache->thread, NULL);
+    cache->started = false;
+    cache->active = false;
+    _lpm_pkgcache_free_files(cache);
+    LPM_DA_FREE(cache->files);
+    LPM_DA_FREE(cache->groups);
+    LPM_FREE(cache->dir);
+    LPM_FREE(cache->pkgdb_path);
+    *cache = (LPM_Pkgcache){0};
+}
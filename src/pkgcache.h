@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// pkgcache.h - What the xbps package cache holds and which of it can go
+//
+
+#pragma once
+
+#include "common.h"
+#include "facets.h"
+#include "logs.h"
+#include "pkgdb.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// cachedir of xbps.d(5) when it is not configured otherwise
+#ifndef LPM_PKGCACHE_DIR
+#define LPM_PKGCACHE_DIR "/var/cache/xbps"
+#endif // LPM_PKGCACHE_DIR
+
+// Upper bound on threads stat-ing the files of the cache
+#ifndef LPM_PKGCACHE_MAX_THREADS
+#define LPM_PKGCACHE_MAX_THREADS 8
+#endif // LPM_PKGCACHE_MAX_THREADS
+
+typedef enum
+{
+    LPM_PKGCACHE_CURRENT,       // the installed version
+    LPM_PKGCACHE_PENDING,       // newer than the installed version, e.g. a prefetched upgrade
+    LPM_PKGCACHE_SUPERSEDED,    // older than the installed version
+    LPM_PKGCACHE_NOT_INSTALLED, // no version of the package is installed
+} LPM_Pkgcache_State;
+
+// Parts of a cached package present on disk
+#define LPM_PKGCACHE_PART_XBPS (1u << 0) // pkgver.arch.xbps
+#define LPM_PKGCACHE_PART_SIG (1u << 1)  // pkgver.arch.xbps.sig
+#define LPM_PKGCACHE_PART_SIG2 (1u << 2) // pkgver.arch.xbps.sig2
+
+typedef struct
+{
+    char *name;         // "pkgver.arch.xbps", the signatures append to it
+    const char *pkgver; // points into the allocation of name
+    uint32_t name_len;  // of the pkgname
+    uint32_t parts;     // LPM_PKGCACHE_PART_*
+    int64_t bytes;      // on disk, of every part
+    LPM_Pkgcache_State state;
+} LPM_Pkgcache_File;
+
+typedef struct
+{
+    LPM_Pkgcache_File *items; // sorted by pkgname, then oldest version first
+    size_t count;
+    size_t capacity;
+} LPM_Pkgcache_Files;
+
+typedef struct
+{
+    const char *pkgname; // not NUL-terminated, points into the first file
+    size_t name_len;
+    size_t first; // into LPM_Pkgcache_Files, the files of one pkgname
+    size_t count;
+    int64_t bytes;
+    int64_t reclaimable; // superseded or not installed
+} LPM_Pkgcache_Group;
+
+typedef struct
+{
+    LPM_Pkgcache_Group *items; // most reclaimable first
+    size_t count;
+    size_t capacity;
+} LPM_Pkgcache_Groups;
+
+typedef struct
+{
+    // only valid while no scan is active
+    LPM_Pkgcache_Files files;
+    LPM_Pkgcache_Groups groups;
+    int64_t bytes;
+    int64_t reclaimable;
+
+    // what the results were computed from, see lpm_pkgcache_start
+    char *dir;
+    char *pkgdb_path;
+    struct timespec dir_mtime;
+    struct timespec pkgdb_mtime;
+    bool scanned;
+
+    pthread_t thread;
+    bool started;
+    bool active;
+    atomic_bool done;
+    LPM_Exit_Code result;
+    bool listed;         // the last scan listed the directory instead of reusing the files
+    size_t threads;      // that stat-ed the files
+    double elapsed_ms;
+} LPM_Pkgcache;
+
+// Scan the cache at dir against the pkgdb at pkgdb_path on a background thread. The directory is
+// only listed again when its mtime changed since the last scan, and nothing is done at all when
+// the pkgdb did not change either. Returns false in that case, the results are still current.
+bool lpm_pkgcache_start(LPM_Pkgcache *cache, const char *dir, const char *pkgdb_path);
+bool lpm_pkgcache_active(const LPM_Pkgcache *cache);
+// Returns true once, when a scan has finished
+bool lpm_pkgcache_poll(LPM_Pkgcache *cache);
+
+// Delete the reclaimable files of the groups set in selected, one bit per group. Failures are
+// logged and skipped. The directory changed, so the next lpm_pkgcache_start lists it again.
+LPM_Exit_Code lpm_pkgcache_purge(LPM_Pkgcache *cache, const LPM_Bitset *selected, size_t *removed,
+                                 int64_t *freed);
+
+// Wait for a running scan and free the results
+void lpm_pkgcache_teardown(LPM_Pkgcache *cache);
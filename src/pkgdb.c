@@ -0,0 +1,326 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// pkgdb.c - Read the xbps package database and notice when something else changes it
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "pkgdb.h"
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PKGDB_PKGVER_KEY "<key>pkgver</key>"
+
+static LPM_Exit_Code _lpm_pkgdb_read_file(const char *path, LPM_Packages_Buffer *out)
+{
+    // runs next to the main thread spawning xbps, don't leak into its children
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LPM_LOG_ERROR("Failed to open \"%s\"\n\tReason  : %s", path, strerror(errno));
+        return LPM_ERROR_FILE_READ;
+    }
+
+    LPM_Exit_Code result = LPM_OK;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+
+    out->count = 0;
+    LPM_DA_RESERVE(out, (size_t)st.st_size + 1);
+    while (out->count < (size_t)st.st_size)
+    {
+        ssize_t n = read(fd, out->items + out->count, (size_t)st.st_size - out->count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break; // truncated while reading, parse what we have
+        out->count += (size_t)n;
+    }
+    out->items[out->count] = '\0';
+
+cleanup:
+    if (result != LPM_OK)
+        LPM_LOG_ERROR("Failed to read \"%s\"\n\tReason  : %s", path, strerror(errno));
+    close(fd);
+    return result;
+}
+
+// NUL-terminate the pkgver of every package in the pkgdb plist in place. Every package dictionary
+// has a "<key>pkgver</key><string>foo-1.0_1</string>" pair.
+static void _lpm_pkgdb_parse(LPM_Packages_Buffer *buf, LPM_Package_Index *installed)
+{
+    char *end = buf->items + buf->count;
+    char *p = buf->items;
+    while ((p = strstr(p, PKGDB_PKGVER_KEY)) != NULL)
+    {
+        p += strlen(PKGDB_PKGVER_KEY);
+        char *value = strstr(p, "<string>");
+        if (value == NULL)
+            break;
+        value += strlen("<string>");
+        char *value_end = memchr(value, '<', end - value);
+        if (value_end == NULL)
+            break;
+        *value_end = '\0';
+        p = value_end + 1;
+
+        LPM_Package_Index_Entry entry = {
+            .pkgver = value,
+            .name_len = (uint32_t)lpm_packages_pkgname_len(value),
+        };
+        LPM_DA_APPEND(installed, entry);
+    }
+}
+
+LPM_Exit_Code lpm_pkgdb_read(const char *path, LPM_Packages_Buffer *buf,
+                             LPM_Package_Index *installed)
+{
+    LPM_Exit_Code result = _lpm_pkgdb_read_file(path, buf);
+    if (result == LPM_OK)
+        _lpm_pkgdb_parse(buf, installed);
+    return result;
+}
+
+// Undo the XML escaping of a plist string in place
+static void _lpm_pkgdb_unescape(char *s)
+{
+    static const char *entities[][2] = {
+        {"&amp;", "&"}, {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&apos;", "'"},
+    };
+    char *out = s;
+    while (*s)
+    {
+        size_t i = 0;
+        size_t count = sizeof(entities) / sizeof(*entities);
+        if (*s == '&')
+        {
+            while (i < count && strncmp(s, entities[i][0], strlen(entities[i][0])) != 0)
+                i++;
+        }
+        if (*s == '&' && i < count)
+        {
+            *out++ = entities[i][1][0];
+            s += strlen(entities[i][0]);
+        }
+        else
+        {
+            *out++ = *s++;
+        }
+    }
+    *out = '\0';
+}
+
+char *lpm_pkgdb_files_path(const char *pkgdb_path, const char *pkgver)
+{
+    const char *slash = strrchr(pkgdb_path, '/');
+    int dir_len = slash ? (int)(slash - pkgdb_path) : 1;
+    char *path;
+    lpm_asprintf(&path, "%.*s/.%.*s-files.plist", dir_len, slash ? pkgdb_path : ".",
+                 (int)lpm_packages_pkgname_len(pkgver), pkgver);
+    return path;
+}
+
+size_t lpm_pkgdb_parse_files(LPM_Pkgdb_Files_Parser *parser, char *data, size_t len,
+                             LPM_Pkgdb_Paths *paths)
+{
+    // top level keys name the kind of the entries in the array that follows, each entry is a
+    // dictionary with a "<key>file</key><string>/usr/bin/foo</string>" pair
+    char *end = data + len;
+    char *p = data;
+    char *key;
+    while ((key = strstr(p, "<key>")) != NULL)
+    {
+        char *name = key + strlen("<key>");
+        char *name_end = memchr(name, '<', end - name);
+        if (name_end == NULL)
+            return key - data;
+        size_t name_len = name_end - name;
+        p = name_end;
+        if ((name_len == 4 && strncmp(name, "dirs", 4) == 0) ||
+            (name_len == 5 && strncmp(name, "files", 5) == 0) ||
+            (name_len == 5 && strncmp(name, "links", 5) == 0) ||
+            (name_len == 10 && strncmp(name, "conf_files", 10) == 0))
+        {
+            parser->dirs = name_len == 4;
+            continue;
+        }
+        if (parser->dirs || name_len != 4 || strncmp(name, "file", 4) != 0)
+            continue;
+        char *value = strstr(name_end, "<string>");
+        char *value_end = NULL;
+        if (value)
+        {
+            value += strlen("<string>");
+            value_end = memchr(value, '<', end - value);
+        }
+        if (value_end == NULL)
+            return key - data; // the rest of the entry is in the next chunk
+        *value_end = '\0';
+        p = value_end + 1;
+        _lpm_pkgdb_unescape(value);
+        LPM_DA_APPEND(paths, value);
+    }
+    // keep what could be the start of a "<key>" cut off by the end of the chunk
+    size_t keep = strlen("<key>") - 1;
+    size_t consumed = len > keep ? len - keep : 0;
+    return consumed > (size_t)(p - data) ? consumed : (size_t)(p - data);
+}
+
+LPM_Exit_Code lpm_pkgdb_read_files(const char *pkgdb_path, const char *pkgver,
+                                   LPM_Packages_Buffer *buf, LPM_Pkgdb_Paths *paths)
+{
+    char *path = lpm_pkgdb_files_path(pkgdb_path, pkgver);
+    struct stat st;
+    if (stat(path, &st) != 0 && errno == ENOENT)
+    {
+        LPM_FREE(path);
+        return LPM_OK;
+    }
+    LPM_Exit_Code result = _lpm_pkgdb_read_file(path, buf);
+    LPM_FREE(path);
+    if (result != LPM_OK)
+        return result;
+
+    LPM_Pkgdb_Files_Parser parser = {0};
+    lpm_pkgdb_parse_files(&parser, buf->items, buf->count, paths);
+    return LPM_OK;
+}
+
+static uint64_t _lpm_pkgdb_hash(const char *s)
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (; *s; ++s)
+        hash = (hash ^ (unsigned char)*s) * 1099511628211ull;
+    return hash;
+}
+
+LPM_Exit_Code lpm_pkgdb_diff(const LPM_Packages *pkgs, const char *path, LPM_Package_Rows *changed)
+{
+    changed->count = 0;
+    LPM_Packages_Buffer pkgdb = {0};
+    LPM_Package_Index installed = {0};
+    LPM_Exit_Code result = lpm_pkgdb_read(path, &pkgdb, &installed);
+    if (result != LPM_OK)
+    {
+        LPM_DA_FREE(pkgdb);
+        return result;
+    }
+
+    // a few thousand installed pkgvers probed once per row of the table, keep them in an open
+    // addressing set at most half full
+    size_t slot_count = 16;
+    while (slot_count < installed.count * 2)
+        slot_count *= 2;
+    const char **slots = LPM_MALLOC(slot_count * sizeof(*slots));
+    LPM_ASSERT(slots != NULL && "Out of memory");
+    memset(slots, 0, slot_count * sizeof(*slots));
+    for (size_t i = 0; i < installed.count; ++i)
+    {
+        size_t slot = _lpm_pkgdb_hash(installed.items[i].pkgver) & (slot_count - 1);
+        while (slots[slot] != NULL)
+            slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = installed.items[i].pkgver;
+    }
+
+    for (size_t row = 0; row < pkgs->count; ++row)
+    {
+        if (strcmp(pkgs->items[row].status, LPM_PACKAGE_STATUS_SOURCE) == 0)
+            continue; // never installed from the pkgdb's point of view
+        const char *pkgver = pkgs->items[row].name;
+        size_t slot = _lpm_pkgdb_hash(pkgver) & (slot_count - 1);
+        while (slots[slot] != NULL && strcmp(slots[slot], pkgver) != 0)
+            slot = (slot + 1) & (slot_count - 1);
+        bool now = slots[slot] != NULL;
+        bool before = strcmp(pkgs->items[row].status, LPM_PACKAGE_STATUS_INSTALLED) == 0;
+        if (now != before)
+            LPM_DA_APPEND(changed, (uint32_t)row);
+    }
+
+    LPM_FREE(slots);
+    LPM_DA_FREE(installed);
+    LPM_DA_FREE(pkgdb);
+    return LPM_OK;
+}
+
+void lpm_pkgdb_watch_start(LPM_Pkgdb_Watch *watch, const char *path)
+{
+    lpm_pkgdb_watch_teardown(watch);
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL)
+        return;
+
+    char *dir;
+    lpm_asprintf(&dir, "%.*s", (int)(slash == path ? 1 : slash - path), path);
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0)
+    {
+        LPM_LOG_WARNING("Not watching \"%s\" for changes\n\tReason  : %s", dir, strerror(errno));
+        LPM_FREE(dir);
+        return;
+    }
+    // xbps writes a temporary file and renames it over the pkgdb, the file itself is replaced
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE;
+    if (inotify_add_watch(watch->fd, dir, mask) < 0)
+    {
+        LPM_LOG_WARNING("Not watching \"%s\" for changes\n\tReason  : %s", dir, strerror(errno));
+        close(watch->fd);
+        LPM_FREE(dir);
+        return;
+    }
+    LPM_FREE(dir);
+    watch->name = lpm_strdup(slash + 1);
+    watch->pending = false;
+    watch->watching = true;
+}
+
+bool lpm_pkgdb_watch_poll(LPM_Pkgdb_Watch *watch)
+{
+    if (!watch->watching)
+        return false;
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(watch->fd, events, sizeof(events))) > 0)
+    {
+        for (char *p = events; p < events + len;)
+        {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0)
+            {
+                watch->pending = true;
+                clock_gettime(CLOCK_MONOTONIC, &watch->last_change);
+            }
+            p += sizeof(*event) + event->len;
+        }
+    }
+    if (len < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        LPM_LOG_WARNING("Stopped watching the pkgdb\n\tReason  : %s", strerror(errno));
+        lpm_pkgdb_watch_teardown(watch);
+        return false;
+    }
+
+    if (!watch->pending)
+        return false;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double quiet_ms = (now.tv_sec - watch->last_change.tv_sec) * 1000.0 +
+                      (now.tv_nsec - watch->last_change.tv_nsec) / 1000000.0;
+    if (quiet_ms < LPM_PKGDB_SETTLE_MS)
+        return false;
+    watch->pending = false;
+    return true;
+}
+
+void lpm_pkgdb_watch_teardown(LPM_Pkgdb_Watch *watch)
+{
+    if (watch->watching)
+        close(watch->fd);
+    watch->watching = false;
+    watch->pending = false;
+    LPM_FREE(watch->name);
+}
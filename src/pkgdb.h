@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// pkgdb.h - Read the xbps package database and notice when something else changes it
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "packages.h"
+
+// Installed packages and their versions, see xbps-pkgdb(1)
+#ifndef LPM_PKGDB_PATH
+#define LPM_PKGDB_PATH "/var/db/xbps/pkgdb-0.38.plist"
+#endif // LPM_PKGDB_PATH
+
+// Quiet time after the last write before a change is reported, xbps rewrites the pkgdb several
+// times during a single transaction
+#ifndef LPM_PKGDB_SETTLE_MS
+#define LPM_PKGDB_SETTLE_MS 250
+#endif // LPM_PKGDB_SETTLE_MS
+
+// Read the pkgdb plist at path into buf and append the pkgver of every installed package to
+// installed. The entries point into buf, which must outlive them.
+LPM_Exit_Code lpm_pkgdb_read(const char *path, LPM_Packages_Buffer *buf,
+                             LPM_Package_Index *installed);
+
+// Rows of pkgs whose install state differs from the pkgdb at path, in table order. A row is
+// installed when its exact pkgver is, like the "[*]" of `xbps-query -Rs`.
+LPM_Exit_Code lpm_pkgdb_diff(const LPM_Packages *pkgs, const char *path, LPM_Package_Rows *changed);
+
+typedef struct
+{
+    char **items;
+    size_t count;
+    size_t capacity;
+} LPM_Pkgdb_Paths;
+
+// Append every file, link and configuration file of the installed package pkgver to paths, read
+// from the .<pkgname>-files.plist next to the pkgdb at pkgdb_path. Directories are skipped. The
+// paths point into buf, which must outlive them. A package without a files plist, e.g. a
+// metapackage, owns nothing.
+LPM_Exit_Code lpm_pkgdb_read_files(const char *pkgdb_path, const char *pkgver,
+                                   LPM_Packages_Buffer *buf, LPM_Pkgdb_Paths *paths);
+// The files plist of pkgver, owned by the caller
+char *lpm_pkgdb_files_path(const char *pkgdb_path, const char *pkgver);
+
+typedef struct
+{
+    bool dirs; // inside the "dirs" array, whose entries are skipped
+} LPM_Pkgdb_Files_Parser;
+
+// Parse a files plist one chunk at a time, for lists too big to wait for. Appends the paths of the
+// complete entries in data[0..len), which must be NUL-terminated, and returns the bytes consumed.
+// The rest is an entry cut off by the end of the chunk and goes first in the next one. Paths point
+// into data, unescaped in place.
+size_t lpm_pkgdb_parse_files(LPM_Pkgdb_Files_Parser *parser, char *data, size_t len,
+                             LPM_Pkgdb_Paths *paths);
+
+typedef struct
+{
+    bool watching;
+    int fd;       // inotify instance, only open while watching
+    char *name;   // file name of the pkgdb inside the watched directory
+    bool pending; // written to, waiting for LPM_PKGDB_SETTLE_MS of quiet
+    struct timespec last_change;
+} LPM_Pkgdb_Watch;
+
+// Watch the directory holding the pkgdb at path. Without inotify, or without the directory,
+// lazypm carries on with statuses that only change through its own transactions.
+void lpm_pkgdb_watch_start(LPM_Pkgdb_Watch *watch, const char *path);
+// Returns true once per settled burst of writes to the pkgdb. Call regularly, it never blocks.
+bool lpm_pkgdb_watch_poll(LPM_Pkgdb_Watch *watch);
+void lpm_pkgdb_watch_teardown(LPM_Pkgdb_Watch *watch);
@@ -0,0 +1,225 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// prefetch.c - Download packages into the xbps cache in the background
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PROCESS
+#include "prefetch.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+static double _lpm_prefetch_elapsed_s(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+// Bytes written by pid so far. xbps writes every downloaded byte to the cache, so this tracks
+// the download without having to parse its progress output.
+static uint64_t _lpm_prefetch_job_bytes(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    FILE *fp = fopen(path, "re");
+    if (fp == NULL)
+        return 0;
+    char line[128];
+    unsigned long long bytes = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "wchar: %llu", &bytes) == 1)
+            break;
+    }
+    fclose(fp);
+    return bytes;
+}
+
+// The rate limit in KiB/s, $LPM_PREFETCH_RATE_LIMIT overrides LPM_PREFETCH_RATE_LIMIT_KIB
+static long _lpm_prefetch_rate_limit(void)
+{
+    const char *env = getenv("LPM_PREFETCH_RATE_LIMIT");
+    if (env == NULL || *env == '\0')
+        return LPM_PREFETCH_RATE_LIMIT_KIB;
+    char *end = NULL;
+    long kib = strtol(env, &end, 10);
+    if (*end != '\0' || kib < 0)
+    {
+        LPM_LOG_WARNING("Ignoring LPM_PREFETCH_RATE_LIMIT=\"%s\"\n\tReason  : Not a rate in KiB/s",
+                        env);
+        return LPM_PREFETCH_RATE_LIMIT_KIB;
+    }
+    return kib;
+}
+
+static void _lpm_prefetch_start_job(LPM_Prefetch *prefetch)
+{
+    size_t count = prefetch->count < LPM_PREFETCH_BATCH_SIZE ? prefetch->count
+                                                             : LPM_PREFETCH_BATCH_SIZE;
+    // xbps-install -D -y pkgver... NULL
+    char *argv[3 + LPM_PREFETCH_BATCH_SIZE + 1];
+    argv[0] = "xbps-install";
+    argv[1] = "-D";
+    argv[2] = "-y";
+    for (size_t i = 0; i < count; ++i)
+        argv[3 + i] = prefetch->items[i];
+    argv[3 + count] = NULL;
+
+    // the TUI owns the terminal, keep the job quiet
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start a prefetch job\n\tReason  : %s", strerror(err));
+        prefetch->failed += count;
+    }
+    else
+    {
+        prefetch->job = (LPM_Prefetch_Job){.pid = pid, .package_count = count};
+        prefetch->running = true;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        LPM_FREE(prefetch->items[i]);
+    memmove(prefetch->items, prefetch->items + count,
+            (prefetch->count - count) * sizeof(*prefetch->items));
+    prefetch->count -= count;
+}
+
+static void _lpm_prefetch_reap(LPM_Prefetch *prefetch)
+{
+    if (!prefetch->running)
+        return;
+    LPM_Prefetch_Job *job = &prefetch->job;
+    uint64_t bytes = _lpm_prefetch_job_bytes(job->pid);
+    if (bytes > job->bytes)
+        job->bytes = bytes;
+
+    int status;
+    pid_t pid = waitpid(job->pid, &status, WNOHANG);
+    if (pid == 0)
+        return;
+
+    if (pid == job->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        prefetch->downloaded += job->package_count;
+    else
+    {
+        LPM_LOG_WARNING("Prefetch job for %zu packages failed", job->package_count);
+        prefetch->failed += job->package_count;
+    }
+    prefetch->bytes += job->bytes;
+    prefetch->running = false;
+}
+
+// True while the average rate since the queue started is over the limit. xbps has no rate limit
+// of its own, and stopping it would stop it with the pkgdb lock held, so the next batch waits
+// instead. The limit holds on average over the queue, not within a batch.
+static bool _lpm_prefetch_throttle(LPM_Prefetch *prefetch)
+{
+    if (prefetch->rate_limit_kib <= 0)
+        return false;
+    double allowed =
+        _lpm_prefetch_elapsed_s(&prefetch->start) * (double)prefetch->rate_limit_kib * 1024;
+    prefetch->throttled = (double)prefetch->bytes > allowed;
+    return prefetch->throttled;
+}
+
+void lpm_prefetch_queue(LPM_Prefetch *prefetch, const char *pkgver)
+{
+    for (size_t i = 0; i < prefetch->count; ++i)
+    {
+        if (strcmp(prefetch->items[i], pkgver) == 0)
+            return;
+    }
+    if (!lpm_prefetch_active(prefetch))
+    {
+        prefetch->total = 0;
+        prefetch->downloaded = 0;
+        prefetch->failed = 0;
+        prefetch->bytes = 0;
+        prefetch->rate_limit_kib = _lpm_prefetch_rate_limit();
+        clock_gettime(CLOCK_MONOTONIC, &prefetch->start);
+    }
+    LPM_DA_APPEND(prefetch, lpm_strdup(pkgver));
+    prefetch->total++;
+}
+
+void lpm_prefetch_dequeue(LPM_Prefetch *prefetch, const char *pkgver)
+{
+    for (size_t i = 0; i < prefetch->count; ++i)
+    {
+        if (strcmp(prefetch->items[i], pkgver) != 0)
+            continue;
+        LPM_FREE(prefetch->items[i]);
+        memmove(&prefetch->items[i], &prefetch->items[i + 1],
+                (prefetch->count - i - 1) * sizeof(*prefetch->items));
+        prefetch->count--;
+        prefetch->total--;
+        return;
+    }
+}
+
+void lpm_prefetch_poll(LPM_Prefetch *prefetch)
+{
+    if (!lpm_prefetch_active(prefetch))
+        return;
+    _lpm_prefetch_reap(prefetch);
+    if (!prefetch->running && prefetch->count > 0 && !_lpm_prefetch_throttle(prefetch))
+        _lpm_prefetch_start_job(prefetch);
+
+    if (!lpm_prefetch_active(prefetch))
+    {
+        double elapsed_s = _lpm_prefetch_elapsed_s(&prefetch->start);
+        LPM_LOG_INFO("Prefetched %zu of %zu packages, %llu KiB in %.1f s (%zu failed)",
+                     prefetch->downloaded, prefetch->total,
+                     (unsigned long long)(prefetch->bytes / 1024), elapsed_s, prefetch->failed);
+    }
+}
+
+void lpm_prefetch_cancel(LPM_Prefetch *prefetch)
+{
+    for (size_t i = 0; i < prefetch->count; ++i)
+        LPM_FREE(prefetch->items[i]);
+    prefetch->count = 0;
+
+    // waiting for the job releases the pkgdb lock before the caller runs a transaction
+    if (prefetch->running)
+    {
+        kill(prefetch->job.pid, SIGTERM);
+        waitpid(prefetch->job.pid, NULL, 0);
+        LPM_LOG_INFO("Cancelled the prefetch job for %zu packages", prefetch->job.package_count);
+    }
+    prefetch->running = false;
+    prefetch->throttled = false;
+}
+
+void lpm_prefetch_teardown(LPM_Prefetch *prefetch)
+{
+    lpm_prefetch_cancel(prefetch);
+    LPM_DA_FREE(*prefetch);
+    prefetch->capacity = 0;
+}
+
+bool lpm_prefetch_active(const LPM_Prefetch *prefetch)
+{
+    return prefetch->count > 0 || prefetch->running;
+}
+
+void lpm_prefetch_describe(const LPM_Prefetch *prefetch, char *buf, size_t size)
+{
+    snprintf(buf, size, "prefetched %zu/%zu%s", prefetch->downloaded, prefetch->total,
+             prefetch->throttled ? ", throttled" : "");
+}
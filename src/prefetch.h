@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// prefetch.h - Download packages into the xbps cache in the background
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include <sys/types.h>
+
+// Packages handed to a single `xbps-install -D` invocation
+#ifndef LPM_PREFETCH_BATCH_SIZE
+#define LPM_PREFETCH_BATCH_SIZE 8
+#endif // LPM_PREFETCH_BATCH_SIZE
+
+// Average download rate in KiB/s when $LPM_PREFETCH_RATE_LIMIT is not set, 0 for no limit
+#ifndef LPM_PREFETCH_RATE_LIMIT_KIB
+#define LPM_PREFETCH_RATE_LIMIT_KIB 0
+#endif // LPM_PREFETCH_RATE_LIMIT_KIB
+
+typedef struct
+{
+    pid_t pid;
+    size_t package_count;
+    uint64_t bytes; // written by the job so far, see /proc/<pid>/io
+} LPM_Prefetch_Job;
+
+typedef struct
+{
+    char **items; // pkgvers waiting for a job, oldest first
+    size_t count;
+    size_t capacity;
+
+    // xbps holds the pkgdb lock while it downloads, a second job would only fail on it
+    LPM_Prefetch_Job job;
+    bool running;
+    bool throttled;      // the next job waits until the download rate is back under the limit
+    long rate_limit_kib; // read from $LPM_PREFETCH_RATE_LIMIT when the queue starts
+
+    size_t total;      // packages queued since the queue was last empty
+    size_t downloaded; // packages of finished jobs
+    size_t failed;
+    uint64_t bytes; // written by finished jobs
+    struct timespec start;
+} LPM_Prefetch;
+
+// Queue pkgver for download, ignored if it is already waiting
+void lpm_prefetch_queue(LPM_Prefetch *prefetch, const char *pkgver);
+// Drop pkgver from the queue if no job has picked it up yet
+void lpm_prefetch_dequeue(LPM_Prefetch *prefetch, const char *pkgver);
+// Reap the finished job and start the next batch once the rate limit allows it. Call regularly,
+// it never blocks.
+void lpm_prefetch_poll(LPM_Prefetch *prefetch);
+// Stop the running job and empty the queue. Packages already in the cache stay there. Call it
+// before running a transaction, which would wait on the pkgdb lock of the job otherwise.
+void lpm_prefetch_cancel(LPM_Prefetch *prefetch);
+void lpm_prefetch_teardown(LPM_Prefetch *prefetch);
+
+bool lpm_prefetch_active(const LPM_Prefetch *prefetch);
+// Short progress summary, e.g. "prefetched 3/10"
+void lpm_prefetch_describe(const LPM_Prefetch *prefetch, char *buf, size_t size);
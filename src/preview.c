@@ -0,0 +1,356 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// preview.c - Resolve transactions with xbps dry runs in the background, before committing them
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "preview.h"
+#include "packages.h"
+#include <dirent.h>
+#include <sys/stat.h>
+
+static uint64_t _lpm_preview_mix(uint64_t x)
+{
+    // splitmix64 finalizer, spreads the XOR of a few FNV hashes over every bit
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+uint64_t lpm_preview_hash(const char *pkgver)
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (; *pkgver; ++pkgver)
+        hash = (hash ^ (unsigned char)*pkgver) * 1099511628211ull;
+    return hash;
+}
+
+uint64_t lpm_preview_key(LPM_Preview_Kind kind, uint64_t selection)
+{
+    return _lpm_preview_mix(selection + kind + 1);
+}
+
+//
+// invalidation
+//
+
+static uint64_t _lpm_preview_stat(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    return _lpm_preview_mix((uint64_t)st.st_mtim.tv_sec * 1000000000ull +
+                            (uint64_t)st.st_mtim.tv_nsec) ^
+           _lpm_preview_mix((uint64_t)st.st_size + (uint64_t)st.st_ino);
+}
+
+// Changes whenever the pkgdb or the repodata of a repository is rewritten. xbps keeps the
+// repodata in a directory per repository next to the pkgdb, e.g.
+// /var/db/xbps/https___repo-default_voidlinux_org_current/x86_64-repodata.
+static uint64_t _lpm_preview_stamp(const char *pkgdb_path)
+{
+    uint64_t stamp = _lpm_preview_stat(pkgdb_path);
+    const char *slash = strrchr(pkgdb_path, '/');
+    char *dir = slash ? lpm_strdup(pkgdb_path) : lpm_strdup(".");
+    if (slash)
+        dir[slash - pkgdb_path] = '\0';
+
+    DIR *metadir = lpm_process_opendir(dir);
+    struct dirent *repo;
+    while (metadir && (repo = readdir(metadir)) != NULL)
+    {
+        if (repo->d_name[0] == '.')
+            continue;
+        char *repo_path;
+        lpm_asprintf(&repo_path, "%s/%s", dir, repo->d_name);
+        DIR *repodir = lpm_process_opendir(repo_path);
+        struct dirent *entry;
+        while (repodir && (entry = readdir(repodir)) != NULL)
+        {
+            const char *suffix = strstr(entry->d_name, "-repodata");
+            if (suffix == NULL || suffix[strlen("-repodata")] != '\0')
+                continue;
+            char *path;
+            lpm_asprintf(&path, "%s/%s", repo_path, entry->d_name);
+            stamp ^= _lpm_preview_stat(path); // readdir order does not matter
+            LPM_FREE(path);
+        }
+        if (repodir)
+            closedir(repodir);
+        LPM_FREE(repo_path);
+    }
+    if (metadir)
+        closedir(metadir);
+    LPM_FREE(dir);
+    return stamp;
+}
+
+static void _lpm_preview_plan_teardown(LPM_Preview_Plan *plan)
+{
+    LPM_FREE(plan->error);
+    LPM_DA_FREE(plan->text);
+    LPM_DA_FREE(plan->steps);
+    *plan = (LPM_Preview_Plan){0};
+}
+
+static void _lpm_preview_pkgvers_free(char **pkgvers)
+{
+    for (size_t i = 0; pkgvers && pkgvers[i]; ++i)
+        LPM_FREE(pkgvers[i]);
+    LPM_FREE(pkgvers);
+}
+
+static void _lpm_preview_drop(LPM_Preview *preview)
+{
+    for (size_t i = 0; i < preview->count; ++i)
+        _lpm_preview_plan_teardown(&preview->items[i]);
+    preview->count = 0;
+}
+
+const LPM_Preview_Plan *lpm_preview_find(LPM_Preview *preview, const char *pkgdb_path,
+                                         uint64_t key)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double since_ms = (now.tv_sec - preview->stamp_checked.tv_sec) * 1000.0 +
+                      (now.tv_nsec - preview->stamp_checked.tv_nsec) / 1000000.0;
+    bool same_pkgdb = preview->pkgdb_path && strcmp(preview->pkgdb_path, pkgdb_path) == 0;
+    if (!same_pkgdb || since_ms >= LPM_PREVIEW_STAMP_INTERVAL_MS)
+    {
+        uint64_t stamp = _lpm_preview_stamp(pkgdb_path);
+        if (!same_pkgdb || stamp != preview->stamp)
+        {
+            if (preview->count > 0)
+                LPM_LOG_INFO("Package database or repository data changed, dropped %zu "
+                             "transaction previews",
+                             preview->count);
+            _lpm_preview_drop(preview);
+        }
+        if (!same_pkgdb)
+        {
+            LPM_FREE(preview->pkgdb_path);
+            preview->pkgdb_path = lpm_strdup(pkgdb_path);
+        }
+        preview->stamp = stamp;
+        preview->stamp_checked = now;
+    }
+
+    for (size_t i = 0; i < preview->count; ++i)
+    {
+        if (preview->items[i].key == key)
+        {
+            preview->items[i].last_used = ++preview->clock;
+            return &preview->items[i];
+        }
+    }
+    return NULL;
+}
+
+bool lpm_preview_pending(const LPM_Preview *preview, uint64_t key)
+{
+    return (preview->active && preview->job.key == key) ||
+           (preview->queued && preview->queued_key == key);
+}
+
+//
+// dry run
+//
+
+static void _lpm_preview_error_line(char *line, size_t len, LPM_Process_Stream stream, void *data)
+{
+    LPM_UNUSED(stream);
+    LPM_Preview_Plan *plan = data;
+    if (len == 0)
+        return;
+    LPM_FREE(plan->error);
+    plan->error = lpm_strdup(line);
+}
+
+// One "pkgver action arch repository installed_size download_size" line per package, split in
+// place. Lines that are not, e.g. a notice, are skipped.
+static void _lpm_preview_parse(LPM_Preview_Plan *plan)
+{
+    char *cursor = plan->text.items;
+    char *end = plan->text.items + plan->text.count;
+    while (cursor < end)
+    {
+        char *newline = memchr(cursor, '\n', end - cursor);
+        char *line = cursor;
+        cursor = newline ? newline + 1 : end;
+        if (newline)
+            *newline = '\0';
+
+        char *fields[6] = {0};
+        size_t field_count = 0;
+        char *p = line;
+        while (*p != '\0' && field_count < 6)
+        {
+            while (*p == ' ')
+                *p++ = '\0';
+            if (*p == '\0')
+                break;
+            fields[field_count++] = p;
+            while (*p != '\0' && *p != ' ')
+                p++;
+        }
+        if (field_count < 2)
+            continue;
+
+        LPM_Preview_Step step = {.pkgver = fields[0], .action = fields[1]};
+        if (field_count == 6)
+        {
+            step.installed_bytes = strtoll(fields[4], NULL, 10);
+            step.download_bytes = strtoll(fields[5], NULL, 10);
+        }
+        LPM_DA_APPEND(&plan->steps, step);
+
+        plan->download_bytes += step.download_bytes;
+        if (strcmp(step.action, "remove") == 0)
+        {
+            plan->removes++;
+            plan->freed_bytes += step.installed_bytes;
+            continue;
+        }
+        if (strcmp(step.action, "install") == 0)
+            plan->installs++;
+        else if (strcmp(step.action, "update") == 0)
+            plan->updates++;
+        else
+            continue; // configure, hold, ... install nothing new
+        plan->installed_bytes += step.installed_bytes;
+    }
+}
+
+static void *_lpm_preview_worker(void *arg)
+{
+    LPM_Preview *preview = arg;
+    LPM_Preview_Plan *plan = &preview->job;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    plan->result = lpm_packages_dry_run(preview->job_pkgvers, plan->kind == LPM_PREVIEW_REMOVE,
+                                        &plan->text, _lpm_preview_error_line, plan);
+    if (plan->text.items == NULL)
+    {
+        LPM_DA_RESERVE(&plan->text, 1);
+        plan->text.items[0] = '\0';
+    }
+    _lpm_preview_parse(plan);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Resolved a dry run in %.1f ms: %zu to install, %zu to update, %zu to remove",
+                 elapsed_ms, plan->installs, plan->updates, plan->removes);
+    atomic_store(&preview->done, true);
+    return NULL;
+}
+
+static void _lpm_preview_launch(LPM_Preview *preview, uint64_t key, LPM_Preview_Kind kind,
+                                char **pkgvers)
+{
+    preview->job = (LPM_Preview_Plan){.key = key, .kind = kind};
+    preview->job_pkgvers = pkgvers;
+    preview->job_stamp = preview->stamp;
+    atomic_store(&preview->done, false);
+    preview->active = true;
+    int err = pthread_create(&preview->thread, NULL, _lpm_preview_worker, preview);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start the preview thread, resolving inline\n\tReason  : %s",
+                        strerror(err));
+        _lpm_preview_worker(preview);
+        return;
+    }
+    preview->started = true;
+}
+
+void lpm_preview_start(LPM_Preview *preview, uint64_t key, LPM_Preview_Kind kind,
+                       const char *const pkgvers[], size_t count)
+{
+    char **copy = LPM_MALLOC((count + 1) * sizeof(*copy));
+    LPM_ASSERT(copy != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < count; ++i)
+        copy[i] = lpm_strdup(pkgvers[i]);
+    copy[count] = NULL;
+
+    if (preview->active)
+    {
+        // the cursor moved on while xbps was resolving, the selections in between never show
+        _lpm_preview_pkgvers_free(preview->queued_pkgvers);
+        preview->queued = true;
+        preview->queued_key = key;
+        preview->queued_kind = kind;
+        preview->queued_pkgvers = copy;
+        return;
+    }
+    _lpm_preview_launch(preview, key, kind, copy);
+}
+
+bool lpm_preview_poll(LPM_Preview *preview)
+{
+    if (!preview->active || !atomic_load(&preview->done))
+        return false;
+    if (preview->started)
+        pthread_join(preview->thread, NULL);
+    preview->started = false;
+    preview->active = false;
+    _lpm_preview_pkgvers_free(preview->job_pkgvers);
+    preview->job_pkgvers = NULL;
+
+    if (preview->job_stamp != preview->stamp)
+    {
+        // resolved against a pkgdb or repodata that is gone by now
+        _lpm_preview_plan_teardown(&preview->job);
+    }
+    else
+    {
+        preview->job.last_used = ++preview->clock;
+        if (preview->count < LPM_PREVIEW_CACHE_MAX)
+            LPM_DA_APPEND(preview, preview->job);
+        else
+        {
+            size_t oldest = 0;
+            for (size_t i = 1; i < preview->count; ++i)
+            {
+                if (preview->items[i].last_used < preview->items[oldest].last_used)
+                    oldest = i;
+            }
+            _lpm_preview_plan_teardown(&preview->items[oldest]);
+            preview->items[oldest] = preview->job;
+        }
+        preview->job = (LPM_Preview_Plan){0};
+    }
+
+    if (preview->queued)
+    {
+        preview->queued = false;
+        _lpm_preview_launch(preview, preview->queued_key, preview->queued_kind,
+                            preview->queued_pkgvers);
+        preview->queued_pkgvers = NULL;
+    }
+    return true;
+}
+
+void lpm_preview_teardown(LPM_Preview *preview)
+{
+    if (preview->started)
+        pthread_join(preview->thread, NULL);
+    preview->started = false;
+    preview->active = false;
+    _lpm_preview_plan_teardown(&preview->job);
+    _lpm_preview_pkgvers_free(preview->job_pkgvers);
+    preview->job_pkgvers = NULL;
+    _lpm_preview_pkgvers_free(preview->queued_pkgvers);
+    preview->queued_pkgvers = NULL;
+    preview->queued = false;
+    _lpm_preview_drop(preview);
+    LPM_DA_FREE(*preview);
+    preview->count = 0;
+    preview->capacity = 0;
+    LPM_FREE(preview->pkgdb_path);
+}
@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// preview.h - Resolve transactions with xbps dry runs in the background, before committing them
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "process.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Resolved plans kept around, the least recently used one goes first
+#ifndef LPM_PREVIEW_CACHE_MAX
+#define LPM_PREVIEW_CACHE_MAX 64
+#endif // LPM_PREVIEW_CACHE_MAX
+
+// How often the pkgdb and the repodata are checked for changes, the cache is dropped when they did
+#ifndef LPM_PREVIEW_STAMP_INTERVAL_MS
+#define LPM_PREVIEW_STAMP_INTERVAL_MS 1000
+#endif // LPM_PREVIEW_STAMP_INTERVAL_MS
+
+typedef enum
+{
+    LPM_PREVIEW_INSTALL, // `xbps-install -n`, installs and updates
+    LPM_PREVIEW_REMOVE,  // `xbps-remove -n`
+} LPM_Preview_Kind;
+
+// A package of the transaction, one line of the dry run
+typedef struct
+{
+    const char *pkgver; // points into the text of the plan
+    const char *action; // as xbps prints it: "install", "update", "remove", "configure", ...
+    int64_t installed_bytes;
+    int64_t download_bytes;
+} LPM_Preview_Step;
+
+typedef struct
+{
+    LPM_Preview_Step *items; // in the order xbps would run them
+    size_t count;
+    size_t capacity;
+} LPM_Preview_Steps;
+
+typedef struct
+{
+    uint64_t key; // see lpm_preview_key
+    LPM_Preview_Kind kind;
+    LPM_Exit_Code result;
+    char *error; // last line xbps printed on stderr when it refused the transaction, or NULL
+    LPM_Process_Buffer text;
+    LPM_Preview_Steps steps;
+
+    size_t installs;
+    size_t updates;
+    size_t removes;
+    int64_t download_bytes;  // archive sizes as the repodata lists them
+    int64_t installed_bytes; // added by installs and updates
+    int64_t freed_bytes;     // installed size of the removed packages
+
+    uint64_t last_used;
+} LPM_Preview_Plan;
+
+typedef struct
+{
+    LPM_Preview_Plan *items; // resolved plans
+    size_t count;
+    size_t capacity;
+    uint64_t clock;
+
+    // what the plans were resolved against, see lpm_preview_find
+    char *pkgdb_path;
+    uint64_t stamp;
+    struct timespec stamp_checked;
+
+    // the dry run in flight, only touched by the worker until done is set
+    pthread_t thread;
+    bool started;
+    bool active;
+    atomic_bool done;
+    LPM_Preview_Plan job;
+    char **job_pkgvers; // NULL-terminated, owned
+    uint64_t job_stamp;
+
+    // requested while the worker was busy, only the latest one is kept
+    bool queued;
+    uint64_t queued_key;
+    LPM_Preview_Kind queued_kind;
+    char **queued_pkgvers;
+} LPM_Preview;
+
+// Hash of a single pkgver, the key of a selection is the XOR of those of its packages so it can be
+// kept up to date as packages are marked and unmarked
+uint64_t lpm_preview_hash(const char *pkgver);
+// Key of the transaction of kind over the packages whose hashes XOR to selection
+uint64_t lpm_preview_key(LPM_Preview_Kind kind, uint64_t selection);
+
+// The resolved plan for key, or NULL. Plans are dropped once the pkgdb at pkgdb_path or the
+// repodata next to it changed, which is checked at most every LPM_PREVIEW_STAMP_INTERVAL_MS.
+const LPM_Preview_Plan *lpm_preview_find(LPM_Preview *preview, const char *pkgdb_path,
+                                         uint64_t key);
+// True while the plan for key is being resolved or waits for its turn
+bool lpm_preview_pending(const LPM_Preview *preview, uint64_t key);
+// Resolve the transaction of kind over pkgvers (count of them, copied) on a background thread.
+// A dry run already in flight finishes first, a request waiting for it is replaced.
+void lpm_preview_start(LPM_Preview *preview, uint64_t key, LPM_Preview_Kind kind,
+                       const char *const pkgvers[], size_t count);
+// Returns true once per finished dry run, its plan is in the cache then
+bool lpm_preview_poll(LPM_Preview *preview);
+// Wait for a running dry run and free every plan
+void lpm_preview_teardown(LPM_Preview *preview);
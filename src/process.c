@@ -0,0 +1,310 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// process.c - Run xbps binaries directly from an argv, without a shell
+//
+
+#define _GNU_SOURCE // pipe2() and mkostemp()
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PROCESS
+#include "process.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+typedef enum
+{
+    PROCESS_PIPE_CAPTURE, // keep everything
+    PROCESS_PIPE_LINES,   // hand complete lines to the callback, then drop them
+    PROCESS_PIPE_TAIL,    // keep the last LPM_PROCESS_STDERR_TAIL bytes
+} LPM_Process_Pipe_Mode;
+
+typedef struct
+{
+    int fd; // read end, -1 once the child closed its end
+    LPM_Process_Stream stream;
+    LPM_Process_Pipe_Mode mode;
+    LPM_Process_Buffer *buf;
+    size_t scan; // bytes of buf already searched for a line terminator
+} LPM_Process_Pipe;
+
+// End of the line starting at p: the first '\n', or '\r' which xbps uses to redraw progress lines
+static char *_lpm_process_find_eol(char *p, char *end)
+{
+    char *newline = memchr(p, '\n', end - p);
+    char *cr = memchr(p, '\r', (newline ? newline : end) - p);
+    return cr ? cr : newline;
+}
+
+void lpm_process_set_cloexec(int fd)
+{
+    int flags = fcntl(fd, F_GETFD);
+    if (flags != -1)
+        fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+void lpm_process_set_cloexec_all(void)
+{
+    DIR *dir = lpm_process_opendir("/proc/self/fd");
+    if (dir == NULL)
+    {
+        LPM_LOG_WARNING("Failed to list open descriptors\n\tReason  : %s", strerror(errno));
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        int fd = atoi(entry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd(dir))
+            lpm_process_set_cloexec(fd);
+    }
+    closedir(dir);
+}
+
+DIR *lpm_process_opendir(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL)
+    {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+    }
+    return dir;
+}
+
+FILE *lpm_process_tmpfile(void)
+{
+    const char *dir = getenv("TMPDIR");
+    char *path;
+    lpm_asprintf(&path, "%s/lazypm-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkostemp(path, O_CLOEXEC);
+    if (fd != -1)
+        unlink(path); // gone with its last descriptor, like tmpfile()
+    int saved = errno;
+    LPM_FREE(path);
+    errno = saved;
+    if (fd == -1)
+        return NULL;
+    FILE *fp = fdopen(fd, "w+");
+    if (fp == NULL)
+    {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+    }
+    return fp;
+}
+
+// pipe() whose ends are both close-on-exec from the start, a thread spawning in between never
+// sees them. The child only gets them through dup2().
+static bool _lpm_process_pipe(int fds[2])
+{
+    return pipe2(fds, O_CLOEXEC) == 0;
+}
+
+static void _lpm_process_close(int *fd)
+{
+    if (*fd != -1)
+        close(*fd);
+    *fd = -1;
+}
+
+// Consume whatever the last read appended to reader->buf, according to reader->mode
+static void _lpm_process_drain(LPM_Process_Pipe *reader, LPM_Process_Line_Callback callback,
+                               void *data)
+{
+    LPM_Process_Buffer *buf = reader->buf;
+    if (reader->mode == PROCESS_PIPE_CAPTURE)
+        return;
+    if (reader->mode == PROCESS_PIPE_TAIL)
+    {
+        if (buf->count > LPM_PROCESS_STDERR_TAIL)
+        {
+            memmove(buf->items, buf->items + buf->count - LPM_PROCESS_STDERR_TAIL,
+                    LPM_PROCESS_STDERR_TAIL);
+            buf->count = LPM_PROCESS_STDERR_TAIL;
+        }
+        return;
+    }
+
+    // a line split across reads waits for the next one
+    size_t line_start = 0;
+    char *eol;
+    while ((eol = _lpm_process_find_eol(buf->items + reader->scan, buf->items + buf->count)) !=
+           NULL)
+    {
+        *eol = '\0';
+        callback(buf->items + line_start, eol - (buf->items + line_start), reader->stream, data);
+        line_start = reader->scan = eol - buf->items + 1;
+    }
+    memmove(buf->items, buf->items + line_start, buf->count - line_start);
+    buf->count -= line_start;
+    reader->scan = buf->count;
+}
+
+LPM_Exit_Code lpm_process_run(char *const argv[], LPM_Process_Buffer *capture,
+                              LPM_Process_Line_Callback callback, void *data)
+{
+    uint8_t result = LPM_OK;
+    pid_t pid = -1;
+    int out[2] = {-1, -1};
+    int err[2] = {-1, -1};
+    LPM_Process_Buffer out_lines = {0};
+    LPM_Process_Buffer err_text = {0};
+
+    if (!_lpm_process_pipe(out) || !_lpm_process_pipe(err))
+    {
+        LPM_LOG_ERROR("pipe() failed for command: \"%s\"\n\tReason  : %s", argv[0],
+                      strerror(errno));
+        LPM_CLEANUP_RETURN(LPM_ERROR_PIPE_OPEN);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+    int spawn_err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    _lpm_process_close(&out[1]);
+    _lpm_process_close(&err[1]);
+    if (spawn_err != 0)
+    {
+        pid = -1;
+        LPM_LOG_ERROR("posix_spawnp() failed for command: \"%s\"\n\tReason  : %s", argv[0],
+                      strerror(spawn_err));
+        LPM_CLEANUP_RETURN(LPM_ERROR_PIPE_OPEN);
+    }
+
+    LPM_Process_Pipe pipes[2] = {
+        {
+            .fd = out[0],
+            .stream = LPM_PROCESS_STDOUT,
+            .mode = capture ? PROCESS_PIPE_CAPTURE : PROCESS_PIPE_LINES,
+            .buf = capture ? capture : &out_lines,
+        },
+        {
+            .fd = err[0],
+            .stream = LPM_PROCESS_STDERR,
+            .mode = callback ? PROCESS_PIPE_LINES : PROCESS_PIPE_TAIL,
+            .buf = &err_text,
+        },
+    };
+    if (callback == NULL && capture == NULL)
+        pipes[0].mode = PROCESS_PIPE_TAIL; // nobody reads it, it still has to be drained
+    out[0] = err[0] = -1;                  // owned by pipes now
+
+    while (pipes[0].fd != -1 || pipes[1].fd != -1)
+    {
+        struct pollfd fds[2] = {
+            {.fd = pipes[0].fd, .events = POLLIN},
+            {.fd = pipes[1].fd, .events = POLLIN},
+        };
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            LPM_LOG_ERROR("poll() failed while reading the output of: \"%s\"\n\tReason  : %s",
+                          argv[0], strerror(errno));
+            _lpm_process_close(&pipes[0].fd);
+            _lpm_process_close(&pipes[1].fd);
+            LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+        }
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            LPM_Process_Pipe *reader = &pipes[i];
+            if (reader->fd == -1 || fds[i].revents == 0)
+                continue;
+            LPM_Process_Buffer *buf = reader->buf;
+            // +1 so there is always room to NUL-terminate a trailing partial line
+            LPM_DA_RESERVE(buf, buf->count + LPM_PROCESS_READ_CHUNK_SIZE + 1);
+            ssize_t nread = read(reader->fd, buf->items + buf->count, LPM_PROCESS_READ_CHUNK_SIZE);
+            if (nread == -1 && errno == EINTR)
+                continue;
+            if (nread == -1)
+            {
+                LPM_LOG_ERROR("Failed to read the output of: \"%s\"\n\tReason  : %s", argv[0],
+                              strerror(errno));
+                _lpm_process_close(&pipes[0].fd);
+                _lpm_process_close(&pipes[1].fd);
+                LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+            }
+            if (nread == 0)
+            {
+                _lpm_process_close(&reader->fd);
+                continue;
+            }
+            buf->count += nread;
+            _lpm_process_drain(reader, callback, data);
+        }
+    }
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        LPM_Process_Buffer *buf = pipes[i].buf;
+        if (buf->items)
+            buf->items[buf->count] = '\0';
+        if (pipes[i].mode == PROCESS_PIPE_LINES && buf->count > 0)
+            callback(buf->items, buf->count, pipes[i].stream, data);
+    }
+
+cleanup:
+    _lpm_process_close(&out[0]);
+    _lpm_process_close(&out[1]);
+    _lpm_process_close(&err[0]);
+    _lpm_process_close(&err[1]);
+    if (pid != -1)
+    {
+        int status;
+        pid_t waited;
+        while ((waited = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+            ;
+        if (waited == -1)
+        {
+            LPM_LOG_WARNING("Failed to wait for command: \"%s\"\n\tReason  : %s", argv[0],
+                            strerror(errno));
+            if (result != LPM_ERROR_FILE_READ)
+                result = LPM_ERROR_PIPE_CLOSE;
+        }
+        else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            if (WIFEXITED(status))
+                LPM_LOG_ERROR("Command exited with non-zero status: %d", WEXITSTATUS(status));
+            else
+                LPM_LOG_ERROR("Command did not exit normally: \"%s\"", argv[0]);
+            if (err_text.count > 0)
+                LPM_LOG_ERROR("stderr of \"%s\":\n%s", argv[0], err_text.items);
+            result = LPM_ERROR_COMMAND_FAIL;
+        }
+    }
+    LPM_DA_FREE(out_lines);
+    LPM_DA_FREE(err_text);
+    return result;
+}
+
+char *lpm_process_describe(char *const argv[])
+{
+    LPM_Process_Buffer text = {0};
+    for (size_t i = 0; argv[i] != NULL; ++i)
+    {
+        // empty arguments would vanish otherwise, e.g. the search term of `xbps-query -Rs ''`
+        const char *arg = argv[i][0] ? argv[i] : "''";
+        size_t len = strlen(arg);
+        LPM_DA_RESERVE(&text, text.count + len + 2);
+        if (i > 0)
+            text.items[text.count++] = ' ';
+        memcpy(text.items + text.count, arg, len);
+        text.count += len;
+        text.items[text.count] = '\0';
+    }
+    return text.items ? text.items : lpm_strdup("");
+}
@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// process.h - Run xbps binaries directly from an argv, without a shell
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include <dirent.h>
+
+// Bytes read from a child's pipe at a time
+#ifndef LPM_PROCESS_READ_CHUNK_SIZE
+#define LPM_PROCESS_READ_CHUNK_SIZE (64 * 1024)
+#endif // LPM_PROCESS_READ_CHUNK_SIZE
+
+// Trailing stderr kept for the log when nobody else reads it
+#define LPM_PROCESS_STDERR_TAIL 4096
+
+typedef struct
+{
+    char *items;
+    size_t count;
+    size_t capacity;
+} LPM_Process_Buffer;
+
+typedef enum
+{
+    LPM_PROCESS_STDOUT,
+    LPM_PROCESS_STDERR,
+} LPM_Process_Stream;
+
+// line is NUL-terminated in place, without its terminator ('\n' or '\r')
+typedef void (*LPM_Process_Line_Callback)(char *line, size_t len, LPM_Process_Stream stream,
+                                          void *data);
+
+// Run argv, argv[0] is looked up in PATH, and wait for it to exit. Arguments reach the child
+// as is, nothing is quoted or expanded. stdout and stderr are read through separate pipes:
+// - stdout is kept whole in capture (NUL-terminated) when it is set, otherwise its lines go to
+//   callback and are dropped.
+// - stderr lines go to callback when it is set. The tail of stderr is logged if argv fails.
+// The child inherits stdin, every other descriptor lazypm opened is close-on-exec.
+LPM_Exit_Code lpm_process_run(char *const argv[], LPM_Process_Buffer *capture,
+                              LPM_Process_Line_Callback callback, void *data);
+
+// Keep fd out of every child, for descriptors opened by code that does not ask for O_CLOEXEC.
+// Another thread may spawn before the flag is set, lazypm's own descriptors are opened with it.
+void lpm_process_set_cloexec(int fd);
+// lpm_process_set_cloexec() every descriptor above stderr that is open right now, e.g. the ones
+// termbox opened for the terminal and its resize pipe. Called before any thread is started.
+void lpm_process_set_cloexec_all(void);
+// opendir() and tmpfile() whose descriptors are close-on-exec from the start, whatever the libc
+// does. Files are opened with the 'e' mode flag of fopen() for the same reason. The temporary
+// file lives in $TMPDIR, /tmp when it is not set.
+DIR *lpm_process_opendir(const char *path);
+FILE *lpm_process_tmpfile(void);
+
+// argv joined with spaces for logs and headers, owned by the caller
+char *lpm_process_describe(char *const argv[]);
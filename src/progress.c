@@ -0,0 +1,297 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// progress.c - Follow the progress of an xbps transaction from its output
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PROCESS
+#include "progress.h"
+
+#define PROGRESS_BAR_WIDTH 20
+
+typedef struct
+{
+    const char *text;
+    LPM_Progress_Phase phase;
+} LPM_Progress_Heading;
+
+// "[*] ..." lines xbps prints when the transaction moves on
+static const LPM_Progress_Heading _lpm_progress_headings[] = {
+    {"Updating ", LPM_PROGRESS_PHASE_SYNCING},
+    {"Downloading ", LPM_PROGRESS_PHASE_DOWNLOADING},
+    {"Verifying ", LPM_PROGRESS_PHASE_VERIFYING},
+    {"Collecting ", LPM_PROGRESS_PHASE_COLLECTING},
+    {"Unpacking ", LPM_PROGRESS_PHASE_UNPACKING},
+    {"Configuring ", LPM_PROGRESS_PHASE_CONFIGURING},
+    {"Removing ", LPM_PROGRESS_PHASE_REMOVING},
+};
+
+static double _lpm_progress_elapsed_s(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1000000000.0;
+}
+
+static bool _lpm_progress_starts_with(const char *s, const char *end, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    return (size_t)(end - s) >= len && memcmp(s, prefix, len) == 0;
+}
+
+static bool _lpm_progress_ends_with(const char *s, const char *end, const char *suffix)
+{
+    size_t len = strlen(suffix);
+    return (size_t)(end - s) >= len && memcmp(end - len, suffix, len) == 0;
+}
+
+static const char *_lpm_progress_find(const char *s, const char *end, const char *needle)
+{
+    size_t len = strlen(needle);
+    for (; (size_t)(end - s) >= len; ++s)
+    {
+        s = memchr(s, needle[0], end - s - len + 1);
+        if (s == NULL)
+            return NULL;
+        if (memcmp(s, needle, len) == 0)
+            return s;
+    }
+    return NULL;
+}
+
+static void _lpm_progress_set_current(LPM_Progress *progress, const char *s, const char *end)
+{
+    size_t len = end - s;
+    if (len >= sizeof(progress->current))
+        len = sizeof(progress->current) - 1;
+    memcpy(progress->current, s, len);
+    progress->current[len] = '\0';
+}
+
+// "1.5MB/s" -> bytes/s, the units are the ones of xbps' humanize_number
+static double _lpm_progress_parse_rate(const char *s, const char *end)
+{
+    double value = 0;
+    double scale = 0;
+    for (; s < end && isdigit((unsigned char)*s); ++s)
+        value = value * 10 + (*s - '0');
+    if (s < end && *s == '.')
+    {
+        for (scale = 0.1, ++s; s < end && isdigit((unsigned char)*s); ++s, scale /= 10)
+            value += (*s - '0') * scale;
+    }
+    if (s < end && *s == 'K')
+        value *= 1024;
+    else if (s < end && *s == 'M')
+        value *= 1024 * 1024;
+    else if (s < end && *s == 'G')
+        value *= 1024 * 1024 * 1024;
+    return value;
+}
+
+static size_t _lpm_progress_parse_count(const char *s, const char *end)
+{
+    size_t n = 0;
+    for (; s < end && isdigit((unsigned char)*s); ++s)
+        n = n * 10 + (*s - '0');
+    return n;
+}
+
+// "foo-1.0_1.x86_64.xbps: [1234KB 45%] 1024KB/s ETA: 00m02s"
+static void _lpm_progress_download(LPM_Progress *progress, const char *line, const char *colon,
+                                   const char *end)
+{
+    _lpm_progress_set_current(progress, line, colon);
+    const char *percent = memchr(colon, '%', end - colon);
+    const char *bracket = memchr(colon, ']', end - colon);
+    if (percent == NULL || bracket == NULL)
+        return;
+    const char *digits = percent;
+    while (digits > colon && isdigit((unsigned char)digits[-1]))
+        digits--;
+    progress->percent = (int)_lpm_progress_parse_count(digits, percent);
+    progress->transient = true;
+    const char *rate = bracket + 1;
+    while (rate < end && *rate == ' ')
+        rate++;
+    progress->rate = _lpm_progress_parse_rate(rate, end);
+}
+
+void lpm_progress_init(LPM_Progress *progress, LPM_Progress_Render_Callback render, void *data,
+                       LPM_Output *output)
+{
+    *progress = (LPM_Progress){
+        .percent = -1, .render = render, .render_data = data, .output = output};
+    clock_gettime(CLOCK_MONOTONIC, &progress->start);
+}
+
+void lpm_progress_feed(LPM_Progress *progress, const char *line, size_t len)
+{
+    const char *end = line + len;
+    // progress lines end with an erase-line escape before their '\r'
+    if (_lpm_progress_ends_with(line, end, "\033[K"))
+        end -= 3;
+    while (end > line && isspace((unsigned char)end[-1]))
+        end--;
+    progress->transient = false;
+
+    if (end == line)
+    {
+        progress->in_table = false; // a blank line ends the transaction summary
+    }
+    else if (_lpm_progress_starts_with(line, end, "[*] "))
+    {
+        for (size_t i = 0; i < sizeof(_lpm_progress_headings) / sizeof(*_lpm_progress_headings);
+             ++i)
+        {
+            if (!_lpm_progress_starts_with(line + 4, end, _lpm_progress_headings[i].text))
+                continue;
+            // nothing left to download once xbps moved past it, e.g. everything was cached
+            if (_lpm_progress_headings[i].phase > LPM_PROGRESS_PHASE_DOWNLOADING &&
+                progress->downloaded < progress->total)
+                progress->downloaded = progress->total;
+            progress->phase = _lpm_progress_headings[i].phase;
+            progress->percent = -1;
+            progress->rate = 0;
+            break;
+        }
+    }
+    else if (progress->in_table)
+    {
+        progress->total++; // "Name Action Version New version Download size" rows
+    }
+    else if (_lpm_progress_starts_with(line, end, "Name ") &&
+             _lpm_progress_find(line, end, " Action ") != NULL)
+    {
+        progress->in_table = true;
+    }
+    else if (isdigit((unsigned char)*line) && _lpm_progress_find(line, end, " will be ") &&
+             (_lpm_progress_find(line, end, " package ") ||
+              _lpm_progress_find(line, end, " packages ")))
+    {
+        // "3 packages will be updated:", printed when output is not a terminal
+        size_t count = _lpm_progress_parse_count(line, end);
+        progress->total += count;
+        // removals have nothing to download
+        if (_lpm_progress_find(line, end, " will be removed") != NULL)
+            progress->downloaded += count;
+    }
+    else if (isdigit((unsigned char)*line) && _lpm_progress_ends_with(line, end, " removed."))
+    {
+        // "1 downloaded, 1 installed, 0 updated, 1 configured, 0 removed."
+        progress->phase = LPM_PROGRESS_PHASE_DONE;
+        progress->percent = -1;
+    }
+    else
+    {
+        const char *colon = _lpm_progress_find(line, end, ": ");
+        const char *rest = colon ? colon + 2 : end;
+        if (colon == NULL)
+        {
+            // nothing to track, the line still goes to the output
+        }
+        else if (_lpm_progress_starts_with(rest, end, "["))
+            _lpm_progress_download(progress, line, colon, end);
+        else if (_lpm_progress_find(rest, end, "[avg rate: ") != NULL)
+        {
+            // repository indexes and signatures are downloaded too, only count packages
+            if (_lpm_progress_ends_with(line, colon, ".xbps"))
+                progress->downloaded++;
+            progress->percent = -1;
+        }
+        else if (_lpm_progress_ends_with(rest, end, " successfully."))
+        {
+            progress->done++;
+            _lpm_progress_set_current(progress, line, colon);
+        }
+        else if (_lpm_progress_starts_with(rest, end, "unpacking") ||
+                 _lpm_progress_starts_with(rest, end, "configuring") ||
+                 _lpm_progress_starts_with(rest, end, "removing") ||
+                 _lpm_progress_starts_with(rest, end, "collecting") ||
+                 _lpm_progress_starts_with(rest, end, "verifying"))
+        {
+            _lpm_progress_set_current(progress, line, colon);
+        }
+    }
+
+    if (progress->output)
+        lpm_output_append(progress->output, line, end - line, progress->transient);
+
+    if (progress->render &&
+        (progress->phase == LPM_PROGRESS_PHASE_DONE ||
+         _lpm_progress_elapsed_s(&progress->last_render) * 1000 >= LPM_PROGRESS_RENDER_INTERVAL_MS))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &progress->last_render);
+        progress->render(progress, progress->render_data);
+    }
+}
+
+const char *lpm_progress_phase_name(LPM_Progress_Phase phase)
+{
+    switch (phase)
+    {
+    case LPM_PROGRESS_PHASE_STARTING:
+        return "starting";
+    case LPM_PROGRESS_PHASE_SYNCING:
+        return "syncing";
+    case LPM_PROGRESS_PHASE_DOWNLOADING:
+        return "downloading";
+    case LPM_PROGRESS_PHASE_VERIFYING:
+        return "verifying";
+    case LPM_PROGRESS_PHASE_COLLECTING:
+        return "collecting";
+    case LPM_PROGRESS_PHASE_UNPACKING:
+        return "unpacking";
+    case LPM_PROGRESS_PHASE_CONFIGURING:
+        return "configuring";
+    case LPM_PROGRESS_PHASE_REMOVING:
+        return "removing";
+    case LPM_PROGRESS_PHASE_DONE:
+        return "done";
+    default:
+        LPM_UNREACHABLE("lpm_progress_phase_name");
+    }
+}
+
+double lpm_progress_fraction(const LPM_Progress *progress)
+{
+    if (progress->phase == LPM_PROGRESS_PHASE_DONE)
+        return 1.0;
+    if (progress->total == 0)
+        return 0.0;
+    double downloaded = progress->downloaded;
+    if (progress->percent >= 0 && progress->downloaded < progress->total)
+        downloaded += progress->percent / 100.0;
+    double fraction = 0.5 * downloaded / progress->total + 0.5 * progress->done / progress->total;
+    return fraction > 1.0 ? 1.0 : fraction;
+}
+
+double lpm_progress_eta(const LPM_Progress *progress)
+{
+    double fraction = lpm_progress_fraction(progress);
+    if (fraction <= 0.01 || fraction >= 1.0)
+        return -1.0;
+    return _lpm_progress_elapsed_s(&progress->start) * (1.0 - fraction) / fraction;
+}
+
+void lpm_progress_describe(const LPM_Progress *progress, char *buf, size_t size)
+{
+    double fraction = lpm_progress_fraction(progress);
+    char bar[PROGRESS_BAR_WIDTH + 1];
+    int filled = (int)(fraction * PROGRESS_BAR_WIDTH);
+    for (int i = 0; i < PROGRESS_BAR_WIDTH; ++i)
+        bar[i] = i < filled ? '#' : ' ';
+    bar[PROGRESS_BAR_WIDTH] = '\0';
+
+    int len = snprintf(buf, size, "[%s] %3d%% %zu/%zu %s %s", bar, (int)(fraction * 100),
+                       progress->done, progress->total, lpm_progress_phase_name(progress->phase),
+                       progress->current);
+    if (len < 0 || (size_t)len >= size)
+        return;
+    if (progress->percent >= 0 && progress->rate > 0)
+        len += snprintf(buf + len, size - len, " %.1f MiB/s", progress->rate / (1024 * 1024));
+    double eta = lpm_progress_eta(progress);
+    if (eta >= 0 && (size_t)len < size)
+        snprintf(buf + len, size - len, " ETA %02d:%02d", (int)eta / 60, (int)eta % 60);
+}
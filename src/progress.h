@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// progress.h - Follow the progress of an xbps transaction from its output
+//
+
+#pragma once
+
+#include "common.h"
+#include "output.h"
+
+// Minimum time between two calls of LPM_Progress.render
+#ifndef LPM_PROGRESS_RENDER_INTERVAL_MS
+#define LPM_PROGRESS_RENDER_INTERVAL_MS 100
+#endif // LPM_PROGRESS_RENDER_INTERVAL_MS
+
+#define LPM_PROGRESS_NAME_MAX 256
+
+typedef enum
+{
+    LPM_PROGRESS_PHASE_STARTING,
+    LPM_PROGRESS_PHASE_SYNCING, // repository index
+    LPM_PROGRESS_PHASE_DOWNLOADING,
+    LPM_PROGRESS_PHASE_VERIFYING,
+    LPM_PROGRESS_PHASE_COLLECTING,
+    LPM_PROGRESS_PHASE_UNPACKING,
+    LPM_PROGRESS_PHASE_CONFIGURING,
+    LPM_PROGRESS_PHASE_REMOVING,
+    LPM_PROGRESS_PHASE_DONE,
+} LPM_Progress_Phase;
+
+typedef struct LPM_Progress LPM_Progress;
+typedef void (*LPM_Progress_Render_Callback)(const LPM_Progress *progress, void *data);
+
+struct LPM_Progress
+{
+    LPM_Progress_Phase phase;
+    size_t total;      // packages in the transaction, 0 until xbps has printed it
+    size_t downloaded; // packages whose download finished
+    size_t done;       // packages installed, updated or removed
+    char current[LPM_PROGRESS_NAME_MAX]; // file or package xbps is working on
+    int percent;                         // of the current download, -1 when not downloading
+    double rate;                         // bytes/s of the current download
+
+    bool in_table;  // inside the column mode transaction summary
+    bool transient; // the last line was a download progress line xbps will redraw
+    struct timespec start;
+    struct timespec last_render;
+    LPM_Progress_Render_Callback render; // optional, called at a bounded rate while parsing
+    void *render_data;
+    LPM_Output *output; // optional, every parsed line is appended to it
+};
+
+void lpm_progress_init(LPM_Progress *progress, LPM_Progress_Render_Callback render, void *data,
+                       LPM_Output *output);
+// Parse one line of xbps-install/xbps-remove output. Download progress is terminated by '\r'
+// rather than '\n', so lines must be split on both. line is only read, nothing is allocated.
+void lpm_progress_feed(LPM_Progress *progress, const char *line, size_t len);
+
+const char *lpm_progress_phase_name(LPM_Progress_Phase phase);
+// Overall completion in [0, 1], downloads and unpacking each count for half
+double lpm_progress_fraction(const LPM_Progress *progress);
+// Estimated seconds left, negative while there is not enough to go on
+double lpm_progress_eta(const LPM_Progress *progress);
+// One line summary with a progress bar, e.g. "[#####     ] 50% 2/4 unpacking foo-1.0_1 ETA 00:12"
+void lpm_progress_describe(const LPM_Progress *progress, char *buf, size_t size);
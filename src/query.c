@@ -0,0 +1,286 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// query.c - Non-interactive query mode (`lazypm query ...`)
+//
+
+#include "query.h"
+
+#define QUERY_STDOUT_BUFFER_SIZE (64 * 1024)
+
+static void _lpm_query_usage(FILE *stream)
+{
+    fprintf(stream,
+            "Usage: lazypm query [options] [pattern ...]\n"
+            "\n"
+            "Print whether each package is installed, available or missing. A pattern is an\n"
+            "exact pkgname (\"vim\") or a shell glob over pkgnames (\"python3-*\"). With no\n"
+            "patterns, or with \"-\", patterns are read from stdin, one per line.\n"
+            "\n"
+            "Options:\n"
+            "  -t, --tsv        Print tab separated values (default)\n"
+            "  -j, --json       Print one JSON object per line\n"
+            "  -i, --installed  Only print installed packages\n"
+            "  -a, --available  Only print packages that are not installed, not with -i\n"
+            "  -h, --help       Show this message\n"
+            "\n"
+            "Fields: query, name, version, status, description\n"
+            "Exit status is non-zero if any pattern did not match a package, packages left out\n"
+            "by -i or -a do not count.\n");
+}
+
+// Write at most len bytes of s, stopping early at a newline or NUL
+static void _lpm_query_write_tsv_field(const char *s, size_t len)
+{
+    for (size_t i = 0; i < len && s[i] != '\0' && s[i] != '\n'; ++i)
+    {
+        char c = s[i];
+        // keep the record shape intact, TSV has no escaping
+        putchar(c == '\t' || c == '\r' ? ' ' : c);
+    }
+}
+
+static void _lpm_query_write_json_string(const char *s, size_t len)
+{
+    putchar('"');
+    for (size_t i = 0; i < len && s[i] != '\0' && s[i] != '\n'; ++i)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+        {
+            putchar('\\');
+            putchar(c);
+        }
+        else if (c == '\t')
+            fputs("\\t", stdout);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+static void _lpm_query_write_result(const LPM_Query_Options *opts, const char *query,
+                                    const LPM_Package *pkg)
+{
+    const char *status = "missing";
+    const char *name = "";
+    size_t name_len = 0;
+    const char *version = "";
+    const char *description = "";
+    if (pkg)
+    {
+        bool installed = strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0;
+        status = installed ? "installed" : "available";
+        name = pkg->name;
+        name_len = lpm_packages_pkgname_len(pkg->name);
+        version = pkg->name[name_len] == '-' ? pkg->name + name_len + 1 : "";
+        description = pkg->description;
+    }
+
+    if (opts->format == LPM_QUERY_FORMAT_JSON)
+    {
+        fputs("{\"query\":", stdout);
+        _lpm_query_write_json_string(query, SIZE_MAX);
+        fputs(",\"name\":", stdout);
+        _lpm_query_write_json_string(name, name_len);
+        fputs(",\"version\":", stdout);
+        _lpm_query_write_json_string(version, SIZE_MAX);
+        fputs(",\"status\":", stdout);
+        _lpm_query_write_json_string(status, SIZE_MAX);
+        fputs(",\"description\":", stdout);
+        _lpm_query_write_json_string(description, SIZE_MAX);
+        fputs("}\n", stdout);
+    }
+    else if (opts->format == LPM_QUERY_FORMAT_TSV)
+    {
+        _lpm_query_write_tsv_field(query, SIZE_MAX);
+        putchar('\t');
+        _lpm_query_write_tsv_field(name, name_len);
+        putchar('\t');
+        _lpm_query_write_tsv_field(version, SIZE_MAX);
+        putchar('\t');
+        _lpm_query_write_tsv_field(status, SIZE_MAX);
+        putchar('\t');
+        _lpm_query_write_tsv_field(description, SIZE_MAX);
+        putchar('\n');
+    }
+    else
+    {
+        LPM_UNREACHABLE("_lpm_query_write_result format");
+    }
+}
+
+static bool _lpm_query_wanted(const LPM_Query_Options *opts, const LPM_Package *pkg)
+{
+    bool installed = strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0;
+    if (opts->installed_only && !installed)
+        return false;
+    if (opts->available_only && installed)
+        return false;
+    return true;
+}
+
+static int _lpm_query_cmp_pkgname(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0)
+        return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+static int _lpm_query_cmp_packages(const void *a, const void *b)
+{
+    const LPM_Package *pa = a;
+    const LPM_Package *pb = b;
+    return _lpm_query_cmp_pkgname(pa->name, lpm_packages_pkgname_len(pa->name), pb->name,
+                                  lpm_packages_pkgname_len(pb->name));
+}
+
+// Print every package matching pattern, pkgs must be sorted by pkgname.
+// Returns the number of packages printed, a pattern whose matches opts all left out is missing.
+static size_t _lpm_query_pattern(const LPM_Query_Options *opts, const LPM_Packages *pkgs,
+                                 const char *pattern)
+{
+    size_t matched = 0;
+    if (strpbrk(pattern, "*?[") != NULL)
+    {
+        for (size_t i = 0; i < pkgs->count; ++i)
+        {
+            if (!lpm_packages_match(&pkgs->items[i], pattern))
+                continue;
+            if (!_lpm_query_wanted(opts, &pkgs->items[i]))
+                continue;
+            matched++;
+            _lpm_query_write_result(opts, pattern, &pkgs->items[i]);
+        }
+    }
+    else
+    {
+        // exact pkgname: binary search for the first row, several repos may carry the package
+        size_t pattern_len = strlen(pattern);
+        size_t lo = 0;
+        size_t hi = pkgs->count;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            const char *name = pkgs->items[mid].name;
+            if (_lpm_query_cmp_pkgname(name, lpm_packages_pkgname_len(name), pattern,
+                                       pattern_len) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (size_t i = lo; i < pkgs->count && lpm_packages_match(&pkgs->items[i], pattern); ++i)
+        {
+            if (!_lpm_query_wanted(opts, &pkgs->items[i]))
+                continue;
+            matched++;
+            _lpm_query_write_result(opts, pattern, &pkgs->items[i]);
+        }
+    }
+
+    if (matched == 0)
+        _lpm_query_write_result(opts, pattern, NULL);
+    return matched;
+}
+
+LPM_Exit_Code lpm_query_main(int argc, char **argv)
+{
+    LPM_Query_Options opts = {.format = LPM_QUERY_FORMAT_TSV};
+    int first_pattern = argc;
+    for (int i = 1; i < argc; ++i)
+    {
+        char *flag = argv[i];
+        if (strcmp(flag, "--tsv") == 0 || strcmp(flag, "-t") == 0)
+            opts.format = LPM_QUERY_FORMAT_TSV;
+        else if (strcmp(flag, "--json") == 0 || strcmp(flag, "-j") == 0)
+            opts.format = LPM_QUERY_FORMAT_JSON;
+        else if (strcmp(flag, "--installed") == 0 || strcmp(flag, "-i") == 0)
+            opts.installed_only = true;
+        else if (strcmp(flag, "--available") == 0 || strcmp(flag, "-a") == 0)
+            opts.available_only = true;
+        else if (strcmp(flag, "--help") == 0 || strcmp(flag, "-h") == 0)
+        {
+            _lpm_query_usage(stdout);
+            return LPM_OK;
+        }
+        else if (strcmp(flag, "--") == 0)
+        {
+            first_pattern = i + 1;
+            break;
+        }
+        else if (flag[0] == '-' && flag[1] != '\0')
+        {
+            fprintf(stderr, "lazypm query: unknown option \"%s\"\n\n", flag);
+            _lpm_query_usage(stderr);
+            return LPM_ERROR;
+        }
+        else
+        {
+            first_pattern = i;
+            break;
+        }
+    }
+
+    if (opts.installed_only && opts.available_only)
+    {
+        fprintf(stderr, "lazypm query: --installed and --available exclude each other\n\n");
+        _lpm_query_usage(stderr);
+        return LPM_ERROR;
+    }
+
+    // Load the full listing once with a single xbps-query, then answer every pattern from memory
+    LPM_Packages pkgs = {0};
+    if (lpm_packages_get(&pkgs) != LPM_OK)
+    {
+        lpm_packages_teardown(&pkgs);
+        lpm_log_dump_session();
+        return LPM_ERROR;
+    }
+    qsort(pkgs.items, pkgs.count, sizeof(*pkgs.items), _lpm_query_cmp_packages);
+
+    // Results are streamed, nothing is kept per pattern, so a large stdout buffer is all we hold
+    setvbuf(stdout, NULL, _IOFBF, QUERY_STDOUT_BUFFER_SIZE);
+
+    LPM_Exit_Code result = LPM_OK;
+    bool read_stdin = first_pattern >= argc;
+    for (int i = first_pattern; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-") == 0)
+        {
+            read_stdin = true;
+            continue;
+        }
+        if (_lpm_query_pattern(&opts, &pkgs, argv[i]) == 0)
+            result = LPM_ERROR;
+    }
+
+    if (read_stdin)
+    {
+        char *line = NULL;
+        size_t len = 0;
+        ssize_t nread;
+        while ((nread = getline(&line, &len, stdin)) != -1)
+        {
+            while (nread > 0 && isspace((unsigned char)line[nread - 1]))
+                line[--nread] = '\0';
+            char *pattern = line;
+            while (isspace((unsigned char)*pattern))
+                pattern++;
+            if (*pattern == '\0' || *pattern == '#')
+                continue;
+            if (_lpm_query_pattern(&opts, &pkgs, pattern) == 0)
+                result = LPM_ERROR;
+            // callers may drive us as a co-process, answer each line as it arrives
+            fflush(stdout);
+        }
+        free(line); // getline allocates with the C library, not LPM_MALLOC
+    }
+
+    fflush(stdout);
+    lpm_packages_teardown(&pkgs);
+    return result;
+}
@@ -0,0 +1,30 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// query.h - Non-interactive query mode (`lazypm query ...`)
+//
+
+#pragma once
+
+#include "common.h"
+#include "packages.h"
+
+typedef enum
+{
+    LPM_QUERY_FORMAT_TSV,
+    LPM_QUERY_FORMAT_JSON,
+} LPM_Query_Format;
+
+typedef struct
+{
+    LPM_Query_Format format;
+    bool installed_only;
+    bool available_only;
+} LPM_Query_Options;
+
+// Entry point for `lazypm query`. argv[0] is "query". Does not require root and never touches
+// termbox, so it is safe to call from scripts and config management.
+//
+// Returns LPM_OK when every pattern matched at least one package, LPM_ERROR otherwise.
+LPM_Exit_Code lpm_query_main(int argc, char **argv);
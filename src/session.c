@@ -0,0 +1,231 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// session.c - Snapshot of the view saved on exit and restored on the next launch
+//
+
+#include "session.h"
+
+#define SESSION_MAGIC "LPMS"
+// Bump whenever the layout below changes, older snapshots are then ignored
+#define SESSION_VERSION 1
+// Anything bigger was not written by lazypm
+#define SESSION_MAX_FILE_SIZE (4 * 1024 * 1024)
+
+// The file is the header followed by NUL-terminated strings: the query, the repository url ("" for
+// every repository), then per view row its status character ('*', '-' or 's') directly followed by
+// the pkgver, and its description, then one pkgver per marked package. Host byte order, the
+// snapshot never leaves the machine.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t facets;
+    uint32_t selected;
+    uint32_t view_offset;
+    uint32_t view_count;
+    uint32_t marked_count;
+} LPM_Session_Header;
+
+typedef struct
+{
+    char *items;
+    size_t count;
+    size_t capacity;
+} LPM_Session_Bytes;
+
+static void _lpm_session_append(LPM_Session_Bytes *bytes, const void *data, size_t size)
+{
+    LPM_DA_RESERVE(bytes, bytes->count + size);
+    memcpy(bytes->items + bytes->count, data, size);
+    bytes->count += size;
+}
+
+static void _lpm_session_append_string(LPM_Session_Bytes *bytes, const char *s)
+{
+    _lpm_session_append(bytes, s, strlen(s) + 1);
+}
+
+// The NUL-terminated string at *cursor, NULL when the buffer ends before its terminator
+static char *_lpm_session_next_string(char **cursor, char *end)
+{
+    char *s = *cursor;
+    char *nul = s < end ? memchr(s, '\0', end - s) : NULL;
+    if (nul == NULL)
+        return NULL;
+    *cursor = nul + 1;
+    return s;
+}
+
+char *lpm_session_path(void)
+{
+    char *dir = lpm_log_state_dir();
+    char *path;
+    lpm_asprintf(&path, "%s/%s", dir, LPM_SESSION_FILE_NAME);
+    LPM_FREE(dir);
+    return path;
+}
+
+LPM_Exit_Code lpm_session_save(const LPM_Session *session, const char *path)
+{
+    LPM_Session_Header header = {
+        .magic = SESSION_MAGIC,
+        .version = SESSION_VERSION,
+        .facets = session->facets,
+        .selected = (uint32_t)session->selected,
+        .view_offset = (uint32_t)session->view_offset,
+        .view_count = (uint32_t)session->view.count,
+        .marked_count = (uint32_t)session->marked.count,
+    };
+    LPM_Session_Bytes bytes = {0};
+    _lpm_session_append(&bytes, &header, sizeof(header));
+    _lpm_session_append_string(&bytes, session->query);
+    _lpm_session_append_string(&bytes, session->repository ? session->repository : "");
+    for (size_t i = 0; i < session->view.count; ++i)
+    {
+        const LPM_Package *pkg = &session->view.items[i];
+        char status = strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0   ? '*'
+                      : strcmp(pkg->status, LPM_PACKAGE_STATUS_SOURCE) == 0 ? 's'
+                                                                             : '-';
+        _lpm_session_append(&bytes, &status, 1);
+        _lpm_session_append_string(&bytes, pkg->name);
+        _lpm_session_append_string(&bytes, pkg->description);
+    }
+    for (size_t i = 0; i < session->marked.count; ++i)
+        _lpm_session_append_string(&bytes, session->marked.items[i]);
+
+    // write a sibling and rename it over the snapshot, a crash never leaves half a file behind
+    LPM_Exit_Code result = LPM_OK;
+    char *tmp_path;
+    lpm_asprintf(&tmp_path, "%s.tmp", path);
+    FILE *fd = fopen(tmp_path, "wbe");
+    if (fd == NULL)
+    {
+        LPM_LOG_WARNING("Failed to save the session\n\tReason  : %s: %s", tmp_path,
+                        strerror(errno));
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    size_t written = fwrite(bytes.items, 1, bytes.count, fd);
+    if (fclose(fd) == EOF || written != bytes.count)
+    {
+        LPM_LOG_WARNING("Failed to save the session\n\tReason  : %s: %s", tmp_path,
+                        strerror(errno));
+        unlink(tmp_path);
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    if (rename(tmp_path, path) == -1)
+    {
+        LPM_LOG_WARNING("Failed to save the session\n\tReason  : %s: %s", path, strerror(errno));
+        unlink(tmp_path);
+        LPM_CLEANUP_RETURN(LPM_ERROR);
+    }
+    LPM_LOG_INFO("Saved the session to %s, %zu rows and %zu marked packages in %zu bytes", path,
+                 session->view.count, session->marked.count, bytes.count);
+
+cleanup:
+    LPM_FREE(tmp_path);
+    LPM_DA_FREE(bytes);
+    return result;
+}
+
+LPM_Exit_Code lpm_session_load(LPM_Session *session, const char *path)
+{
+    lpm_session_teardown(session);
+
+    FILE *fd = fopen(path, "rbe");
+    if (fd == NULL)
+        return LPM_ERROR_FILE_READ; // nothing saved yet
+    LPM_Exit_Code result = LPM_OK;
+    char *buffer = NULL;
+    struct stat st;
+    if (fstat(fileno(fd), &st) == -1 || st.st_size < (off_t)sizeof(LPM_Session_Header) ||
+        st.st_size > SESSION_MAX_FILE_SIZE)
+    {
+        LPM_LOG_WARNING("Ignoring the saved session\n\tReason  : %s has an unexpected size", path);
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+    }
+    size_t size = (size_t)st.st_size;
+    buffer = LPM_MALLOC(size);
+    LPM_ASSERT(buffer != NULL && "Buy more RAM lol");
+    if (fread(buffer, 1, size, fd) != size)
+    {
+        LPM_LOG_WARNING("Ignoring the saved session\n\tReason  : Failed to read %s", path);
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+    }
+
+    LPM_Session_Header header;
+    memcpy(&header, buffer, sizeof(header));
+    if (memcmp(header.magic, SESSION_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SESSION_VERSION)
+    {
+        LPM_LOG_WARNING("Ignoring the saved session\n\tReason  : %s is not a version %d snapshot",
+                        path, SESSION_VERSION);
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+    }
+
+    // every row is at least its status character, a pkgver and two terminators, a marked package
+    // at least a terminator; a count the rest of the file cannot hold was not written by lazypm
+    char *cursor = buffer + sizeof(header);
+    char *end = buffer + size;
+    if (header.view_count > LPM_SESSION_MAX_ROWS ||
+        (uint64_t)header.view_count * 3 + header.marked_count > (uint64_t)(end - cursor))
+    {
+        LPM_LOG_WARNING("Ignoring the saved session\n\tReason  : %s claims %u rows and %u marked "
+                        "packages in %zu bytes",
+                        path, header.view_count, header.marked_count, size);
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+    }
+    char *query = _lpm_session_next_string(&cursor, end);
+    char *repository = _lpm_session_next_string(&cursor, end);
+    if (query == NULL || repository == NULL)
+        goto corrupt;
+    strncpy(session->query, query, sizeof(session->query) - 1);
+    session->repository = *repository ? repository : NULL;
+    session->facets = header.facets;
+    session->selected = header.selected;
+    session->view_offset = header.view_offset;
+
+    LPM_DA_RESERVE(&session->view, header.view_count);
+    for (uint32_t i = 0; i < header.view_count; ++i)
+    {
+        char *name = _lpm_session_next_string(&cursor, end);
+        char *description = _lpm_session_next_string(&cursor, end);
+        if (name == NULL || description == NULL || *name == '\0')
+            goto corrupt;
+        LPM_Package pkg = {
+            .status = *name == '*'   ? LPM_PACKAGE_STATUS_INSTALLED
+                      : *name == 's' ? LPM_PACKAGE_STATUS_SOURCE
+                                     : LPM_PACKAGE_STATUS_AVAILABLE,
+            .name = name + 1,
+            .description = description,
+        };
+        session->view.items[session->view.count++] = pkg;
+    }
+    for (uint32_t i = 0; i < header.marked_count; ++i)
+    {
+        char *pkgver = _lpm_session_next_string(&cursor, end);
+        if (pkgver == NULL)
+            goto corrupt;
+        LPM_DA_APPEND(&session->marked, pkgver);
+    }
+    session->view.buffer = buffer;
+    buffer = NULL;
+    LPM_CLEANUP_RETURN(LPM_OK);
+
+corrupt:
+    LPM_LOG_WARNING("Ignoring the saved session\n\tReason  : %s is truncated", path);
+    lpm_session_teardown(session);
+    result = LPM_ERROR_FILE_READ;
+cleanup:
+    LPM_FREE(buffer);
+    fclose(fd);
+    return result;
+}
+
+void lpm_session_teardown(LPM_Session *session)
+{
+    lpm_packages_teardown(&session->view);
+    LPM_DA_FREE(session->marked);
+    *session = (LPM_Session){0};
+}
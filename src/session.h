@@ -0,0 +1,48 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// session.h - Snapshot of the view saved on exit and restored on the next launch
+//
+
+#pragma once
+
+#include "common.h"
+#include "filter.h"
+#include "logs.h"
+#include "packages.h"
+
+#define LPM_SESSION_FILE_NAME "session.bin"
+
+// Rows of the view kept in the snapshot, centered on the hovered one. They are only shown until
+// the fresh package list has loaded, so a few pages are enough.
+#ifndef LPM_SESSION_MAX_ROWS
+#define LPM_SESSION_MAX_ROWS 512
+#endif // LPM_SESSION_MAX_ROWS
+
+typedef struct
+{
+    const char **items;
+    size_t count;
+    size_t capacity;
+} LPM_Session_Names;
+
+typedef struct
+{
+    char query[LPM_FILTER_QUERY_MAX_LEN];
+    uint32_t facets;          // LPM_Facets.active
+    const char *repository;   // url of the selected repository, NULL for every repository
+    size_t selected;          // index of the hovered package in the whole view
+    size_t view_offset;       // index in the whole view of view.items[0]
+    LPM_Packages view;        // rows around the hovered one
+    LPM_Session_Names marked; // pkgvers of the marked packages
+} LPM_Session;
+
+// Snapshot file in the lazypm state directory, owned by the caller
+char *lpm_session_path(void);
+// Replace the snapshot at path with session, atomically. Strings of session are only read.
+LPM_Exit_Code lpm_session_save(const LPM_Session *session, const char *path);
+// Read the snapshot at path into session. Every string points into session->view.buffer.
+// LPM_ERROR_FILE_READ when there is no usable snapshot, e.g. on the first launch.
+LPM_Exit_Code lpm_session_load(LPM_Session *session, const char *path);
+void lpm_session_teardown(LPM_Session *session);
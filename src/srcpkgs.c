@@ -0,0 +1,634 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// srcpkgs.c - Index the templates of a void-packages checkout, the sources xbps-src builds
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "srcpkgs.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SRCPKGS_CACHE_MAGIC "LPMT"
+// Bump whenever the layout below or the template parsing changes, the cache is then rebuilt
+#define SRCPKGS_CACHE_VERSION 1
+// Anything bigger was not written by lazypm
+#define SRCPKGS_CACHE_MAX_SIZE (256 * 1024 * 1024)
+// Checkouts smaller than this per thread are not worth another thread
+#define SRCPKGS_TEMPLATES_PER_THREAD 256
+
+// The cache is the header, the distdir it indexes, then per template the mtime seconds,
+// nanoseconds and size as int64 followed by the directory name, pkgver, short_desc and depends,
+// all NUL-terminated. Host byte order, the cache never leaves the machine.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+} LPM_Srcpkgs_Cache_Header;
+
+typedef struct
+{
+    char **items;
+    size_t count;
+    size_t capacity;
+} LPM_Srcpkgs_Names;
+
+// Work shared by the scan threads, every template is claimed by exactly one of them
+typedef struct
+{
+    const char *srcpkgs_dir;
+    const LPM_Srcpkgs_Names *names; // sorted
+    const LPM_Srcpkgs *cache;       // sorted by name
+    bool *reused;                   // one per cache entry, its text moved to the results
+    LPM_Srcpkg *results;            // one per name, text is NULL for templates that were skipped
+    atomic_size_t next;
+    atomic_size_t reparsed;
+} LPM_Srcpkgs_Scan;
+
+char *lpm_srcpkgs_distdir(void)
+{
+    char *distdir;
+    const char *env = getenv("XBPS_DISTDIR");
+    if (env && *env)
+        distdir = lpm_strdup(env);
+    else
+        lpm_asprintf(&distdir, "%s/void-packages", lpm_log_home_dir());
+
+    char *srcpkgs_dir;
+    lpm_asprintf(&srcpkgs_dir, "%s/srcpkgs", distdir);
+    struct stat st;
+    bool found = stat(srcpkgs_dir, &st) == 0 && S_ISDIR(st.st_mode);
+    LPM_FREE(srcpkgs_dir);
+    if (!found)
+        LPM_FREE(distdir);
+    return distdir;
+}
+
+char *lpm_srcpkgs_cache_path(void)
+{
+    char *dir = lpm_log_state_dir();
+    char *path;
+    lpm_asprintf(&path, "%s/%s", dir, LPM_SRCPKGS_CACHE_FILE_NAME);
+    LPM_FREE(dir);
+    return path;
+}
+
+//
+// template parsing
+//
+
+// Top level assignments seen so far as "name=value\0" one after the other, for expanding ${name}
+typedef LPM_Packages_Buffer LPM_Srcpkgs_Vars;
+
+static const char *_lpm_srcpkgs_var(const LPM_Srcpkgs_Vars *vars, const char *name, size_t len)
+{
+    // the last assignment wins, like in the shell
+    const char *found = NULL;
+    for (size_t i = 0; i < vars->count;)
+    {
+        const char *entry = vars->items + i;
+        if (strncmp(entry, name, len) == 0 && entry[len] == '=')
+            found = entry + len + 1;
+        i += strlen(entry) + 1;
+    }
+    return found;
+}
+
+static void _lpm_srcpkgs_append(LPM_Packages_Buffer *out, const char *s, size_t len)
+{
+    LPM_DA_RESERVE(out, out->count + len + 1);
+    memcpy(out->items + out->count, s, len);
+    out->count += len;
+    out->items[out->count] = '\0';
+}
+
+static bool _lpm_srcpkgs_is_name_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// Expand the $name or ${name...} at p into out, returns the first character past it. Modifiers
+// like ${version%.*} are dropped, the metadata lazypm shows never needs them.
+static const char *_lpm_srcpkgs_expand(const char *p, const LPM_Srcpkgs_Vars *vars,
+                                       LPM_Packages_Buffer *out)
+{
+    bool braced = p[1] == '{';
+    const char *name = p + 1 + braced;
+    size_t len = 0;
+    while (_lpm_srcpkgs_is_name_char(name[len]))
+        len++;
+    if (len == 0)
+    {
+        _lpm_srcpkgs_append(out, p, 1); // a lone '$', or $( which is kept as is
+        return p + 1;
+    }
+    const char *end = name + len;
+    if (braced)
+    {
+        const char *close = strchr(end, '}');
+        end = close ? close + 1 : end;
+    }
+    const char *value = _lpm_srcpkgs_var(vars, name, len);
+    if (value)
+        _lpm_srcpkgs_append(out, value, strlen(value));
+    return end;
+}
+
+// Parse the shell word at p into out, quotes removed and variables expanded. Returns the first
+// character past it.
+static const char *_lpm_srcpkgs_word(const char *p, const LPM_Srcpkgs_Vars *vars,
+                                     LPM_Packages_Buffer *out)
+{
+    out->count = 0;
+    _lpm_srcpkgs_append(out, "", 0);
+    while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != ';')
+    {
+        if (*p == '\'')
+        {
+            const char *close = strchr(p + 1, '\'');
+            size_t len = close ? (size_t)(close - p - 1) : strlen(p + 1);
+            _lpm_srcpkgs_append(out, p + 1, len);
+            p += len + 1 + (close != NULL);
+        }
+        else if (*p == '"')
+        {
+            p++;
+            while (*p && *p != '"')
+            {
+                if (*p == '\\' && p[1] == '\n')
+                    p += 2; // line continuation
+                else if (*p == '\\' && (p[1] == '"' || p[1] == '\\' || p[1] == '$' || p[1] == '`'))
+                {
+                    _lpm_srcpkgs_append(out, p + 1, 1);
+                    p += 2;
+                }
+                else if (*p == '$')
+                    p = _lpm_srcpkgs_expand(p, vars, out);
+                else
+                    _lpm_srcpkgs_append(out, p++, 1);
+            }
+            p += *p == '"';
+        }
+        else if (*p == '\\' && p[1])
+        {
+            if (p[1] != '\n')
+                _lpm_srcpkgs_append(out, p + 1, 1);
+            p += 2;
+        }
+        else if (*p == '$')
+            p = _lpm_srcpkgs_expand(p, vars, out);
+        else
+            _lpm_srcpkgs_append(out, p++, 1);
+    }
+    return p;
+}
+
+// Collapse the whitespace runs of a multi-line value like depends into single spaces
+static void _lpm_srcpkgs_squeeze(char *s)
+{
+    char *out = s;
+    bool space = true; // drops leading whitespace
+    for (const char *in = s; *in; ++in)
+    {
+        if (!isspace((unsigned char)*in))
+            *out++ = *in;
+        else if (!space)
+            *out++ = ' ';
+        space = isspace((unsigned char)*in);
+    }
+    if (out > s && out[-1] == ' ')
+        out--;
+    *out = '\0';
+}
+
+// Top level assignments of template, i.e. at the start of a line. The ones in functions are
+// indented and belong to subpackages or build steps.
+static void _lpm_srcpkgs_parse_vars(const char *template, LPM_Srcpkgs_Vars *vars,
+                                    LPM_Packages_Buffer *value)
+{
+    vars->count = 0;
+    const char *p = template;
+    while (*p)
+    {
+        const char *name = p;
+        size_t len = 0;
+        while (_lpm_srcpkgs_is_name_char(name[len]))
+            len++;
+        bool append = len > 0 && name[len] == '+' && name[len + 1] == '=';
+        if (len > 0 && !isdigit((unsigned char)*name) && (name[len] == '=' || append))
+        {
+            p = _lpm_srcpkgs_word(name + len + 1 + append, vars, value);
+            const char *previous = append ? _lpm_srcpkgs_var(vars, name, len) : NULL;
+            // an offset, appending to vars may move it
+            size_t previous_offset = previous ? (size_t)(previous - vars->items) : SIZE_MAX;
+            _lpm_srcpkgs_append(vars, name, len);
+            _lpm_srcpkgs_append(vars, "=", 1);
+            if (previous_offset != SIZE_MAX)
+            {
+                size_t previous_len = strlen(vars->items + previous_offset);
+                LPM_DA_RESERVE(vars, vars->count + previous_len + 1);
+                memcpy(vars->items + vars->count, vars->items + previous_offset, previous_len);
+                vars->count += previous_len;
+            }
+            _lpm_srcpkgs_append(vars, value->items, value->count);
+            vars->count++; // keep the NUL
+        }
+        const char *newline = strchr(p, '\n');
+        if (newline == NULL)
+            break;
+        p = newline + 1;
+    }
+}
+
+static LPM_Exit_Code _lpm_srcpkgs_read(const char *path, off_t max_size, LPM_Packages_Buffer *out,
+                                       struct stat *st)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return LPM_ERROR_FILE_READ;
+    LPM_Exit_Code result = LPM_OK;
+    if (fstat(fd, st) != 0 || st->st_size > max_size)
+        LPM_CLEANUP_RETURN(LPM_ERROR_FILE_READ);
+    out->count = 0;
+    LPM_DA_RESERVE(out, (size_t)st->st_size + 1);
+    while (out->count < (size_t)st->st_size)
+    {
+        ssize_t n = read(fd, out->items + out->count, (size_t)st->st_size - out->count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        out->count += (size_t)n;
+    }
+    out->items[out->count] = '\0';
+
+cleanup:
+    close(fd);
+    return result;
+}
+
+static void _lpm_srcpkgs_set_text(LPM_Srcpkg *pkg, char *text)
+{
+    pkg->text = text;
+    pkg->pkgver = text + strlen(text) + 1;
+    pkg->short_desc = pkg->pkgver + strlen(pkg->pkgver) + 1;
+    pkg->depends = pkg->short_desc + strlen(pkg->short_desc) + 1;
+}
+
+// Per thread buffers, reused from one template to the next
+typedef struct
+{
+    LPM_Packages_Buffer file;
+    LPM_Srcpkgs_Vars vars;
+    LPM_Packages_Buffer value;
+} LPM_Srcpkgs_Scratch;
+
+static bool _lpm_srcpkgs_parse(const char *name, const char *template, LPM_Srcpkgs_Scratch *scratch,
+                               LPM_Srcpkg *pkg)
+{
+    _lpm_srcpkgs_parse_vars(template, &scratch->vars, &scratch->value);
+    const char *pkgname = _lpm_srcpkgs_var(&scratch->vars, "pkgname", strlen("pkgname"));
+    const char *version = _lpm_srcpkgs_var(&scratch->vars, "version", strlen("version"));
+    const char *revision = _lpm_srcpkgs_var(&scratch->vars, "revision", strlen("revision"));
+    const char *short_desc = _lpm_srcpkgs_var(&scratch->vars, "short_desc", strlen("short_desc"));
+    const char *depends = _lpm_srcpkgs_var(&scratch->vars, "depends", strlen("depends"));
+    if (pkgname == NULL || *pkgname == '\0' || version == NULL || *version == '\0')
+        return false;
+
+    char *text;
+    int len = lpm_asprintf(&text, "%s%c%s-%s_%s%c%s%c%s", name, '\0', pkgname, version,
+                           revision && *revision ? revision : "1", '\0',
+                           short_desc ? short_desc : "", '\0', depends ? depends : "");
+    if (len < 0)
+        return false;
+    _lpm_srcpkgs_set_text(pkg, text);
+    _lpm_srcpkgs_squeeze(pkg->short_desc);
+    _lpm_srcpkgs_squeeze(pkg->depends);
+    return true;
+}
+
+static ssize_t _lpm_srcpkgs_find(const LPM_Srcpkgs *srcpkgs, const char *name)
+{
+    size_t lo = 0;
+    size_t hi = srcpkgs->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(srcpkgs->items[mid].text, name);
+        if (cmp == 0)
+            return (ssize_t)mid;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+static void *_lpm_srcpkgs_scan_worker(void *arg)
+{
+    LPM_Srcpkgs_Scan *scan = arg;
+    LPM_Srcpkgs_Scratch scratch = {0};
+    char *path = NULL;
+    size_t i;
+    while ((i = atomic_fetch_add(&scan->next, 1)) < scan->names->count)
+    {
+        const char *name = scan->names->items[i];
+        LPM_Srcpkg *pkg = &scan->results[i];
+        LPM_FREE(path);
+        lpm_asprintf(&path, "%s/%s/template", scan->srcpkgs_dir, name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+        ssize_t found = _lpm_srcpkgs_find(scan->cache, name);
+        const LPM_Srcpkg *cached = found >= 0 ? &scan->cache->items[found] : NULL;
+        if (cached && cached->mtime_sec == (int64_t)st.st_mtim.tv_sec &&
+            cached->mtime_nsec == (int64_t)st.st_mtim.tv_nsec && cached->size == st.st_size)
+        {
+            // names are unique, no other thread touches this entry
+            *pkg = *cached;
+            scan->reused[found] = true;
+            continue;
+        }
+
+        if (_lpm_srcpkgs_read(path, LPM_SRCPKGS_TEMPLATE_MAX_SIZE, &scratch.file, &st) != LPM_OK)
+            continue;
+        atomic_fetch_add(&scan->reparsed, 1);
+        if (!_lpm_srcpkgs_parse(name, scratch.file.items, &scratch, pkg))
+            continue;
+        pkg->mtime_sec = (int64_t)st.st_mtim.tv_sec;
+        pkg->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+        pkg->size = (int64_t)st.st_size;
+    }
+    LPM_FREE(path);
+    LPM_DA_FREE(scratch.file);
+    LPM_DA_FREE(scratch.vars);
+    LPM_DA_FREE(scratch.value);
+    return NULL;
+}
+
+//
+// cache
+//
+
+static void _lpm_srcpkgs_cache_load(LPM_Srcpkgs *cache, const char *path, const char *distdir)
+{
+    LPM_Packages_Buffer buf = {0};
+    struct stat st;
+    if (_lpm_srcpkgs_read(path, SRCPKGS_CACHE_MAX_SIZE, &buf, &st) != LPM_OK)
+    {
+        LPM_DA_FREE(buf);
+        return; // nothing cached yet
+    }
+
+    LPM_Srcpkgs_Cache_Header header;
+    char *cursor = buf.items + sizeof(header);
+    char *end = buf.items + buf.count;
+    if (buf.count < sizeof(header))
+        goto corrupt;
+    memcpy(&header, buf.items, sizeof(header));
+    if (memcmp(header.magic, SRCPKGS_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SRCPKGS_CACHE_VERSION)
+        goto corrupt;
+    char *cached_distdir = cursor;
+    cursor = memchr(cursor, '\0', end - cursor);
+    if (cursor == NULL || strcmp(cached_distdir, distdir) != 0)
+        goto corrupt; // another checkout
+    cursor++;
+
+    LPM_DA_RESERVE(cache, header.count);
+    for (uint32_t i = 0; i < header.count; ++i)
+    {
+        LPM_Srcpkg pkg = {0};
+        int64_t fields[3];
+        if ((size_t)(end - cursor) < sizeof(fields))
+            goto corrupt;
+        memcpy(fields, cursor, sizeof(fields));
+        cursor += sizeof(fields);
+        char *text = cursor;
+        for (int s = 0; s < 4; ++s)
+        {
+            char *nul = cursor < end ? memchr(cursor, '\0', end - cursor) : NULL;
+            if (nul == NULL)
+                goto corrupt;
+            cursor = nul + 1;
+        }
+        char *copy = LPM_MALLOC(cursor - text);
+        LPM_ASSERT(copy != NULL && "Buy more RAM lol");
+        memcpy(copy, text, cursor - text);
+        _lpm_srcpkgs_set_text(&pkg, copy);
+        pkg.mtime_sec = fields[0];
+        pkg.mtime_nsec = fields[1];
+        pkg.size = fields[2];
+        cache->items[cache->count++] = pkg;
+    }
+    LPM_DA_FREE(buf);
+    return;
+
+corrupt:
+    LPM_LOG_WARNING("Ignoring the source package cache\n\tReason  : %s is stale or truncated",
+                    path);
+    lpm_srcpkgs_teardown(cache);
+    LPM_DA_FREE(buf);
+}
+
+static void _lpm_srcpkgs_cache_save(const LPM_Srcpkgs *srcpkgs, const char *path,
+                                    const char *distdir)
+{
+    LPM_Srcpkgs_Cache_Header header = {
+        .magic = SRCPKGS_CACHE_MAGIC,
+        .version = SRCPKGS_CACHE_VERSION,
+        .count = (uint32_t)srcpkgs->count,
+    };
+    LPM_Packages_Buffer bytes = {0};
+    _lpm_srcpkgs_append(&bytes, (const char *)&header, sizeof(header));
+    _lpm_srcpkgs_append(&bytes, distdir, strlen(distdir) + 1);
+    for (size_t i = 0; i < srcpkgs->count; ++i)
+    {
+        const LPM_Srcpkg *pkg = &srcpkgs->items[i];
+        int64_t fields[3] = {pkg->mtime_sec, pkg->mtime_nsec, pkg->size};
+        _lpm_srcpkgs_append(&bytes, (const char *)fields, sizeof(fields));
+        const char *text_end = pkg->depends + strlen(pkg->depends) + 1;
+        _lpm_srcpkgs_append(&bytes, pkg->text, text_end - pkg->text);
+    }
+
+    // write a sibling and rename it over the cache, a crash never leaves half a file behind
+    char *tmp_path;
+    lpm_asprintf(&tmp_path, "%s.tmp", path);
+    FILE *fd = fopen(tmp_path, "wbe");
+    bool written = fd && fwrite(bytes.items, 1, bytes.count, fd) == bytes.count;
+    if (fd && fclose(fd) == EOF)
+        written = false;
+    if (!written || rename(tmp_path, path) == -1)
+    {
+        LPM_LOG_WARNING("Failed to save the source package cache\n\tReason  : %s: %s", tmp_path,
+                        strerror(errno));
+        unlink(tmp_path);
+    }
+    LPM_FREE(tmp_path);
+    LPM_DA_FREE(bytes);
+}
+
+//
+// scan
+//
+
+static int _lpm_srcpkgs_name_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static LPM_Exit_Code _lpm_srcpkgs_list(const char *srcpkgs_dir, LPM_Srcpkgs_Names *names)
+{
+    DIR *dir = lpm_process_opendir(srcpkgs_dir);
+    if (dir == NULL)
+    {
+        LPM_LOG_ERROR("Failed to open \"%s\"\n\tReason  : %s", srcpkgs_dir, strerror(errno));
+        return LPM_ERROR_FILE_READ;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        bool is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN)
+        {
+            struct stat st;
+            is_dir = fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+                     S_ISDIR(st.st_mode);
+        }
+        // subpackages are symlinks to the directory of their source package
+        if (is_dir)
+            LPM_DA_APPEND(names, lpm_strdup(entry->d_name));
+    }
+    closedir(dir);
+    if (names->count > 0)
+        qsort(names->items, names->count, sizeof(*names->items), _lpm_srcpkgs_name_cmp);
+    return LPM_OK;
+}
+
+static size_t _lpm_srcpkgs_thread_count(size_t templates)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    size_t threads = (size_t)cpus < LPM_SRCPKGS_MAX_THREADS ? (size_t)cpus
+                                                            : LPM_SRCPKGS_MAX_THREADS;
+    size_t by_size = templates / SRCPKGS_TEMPLATES_PER_THREAD + 1;
+    return threads < by_size ? threads : by_size;
+}
+
+LPM_Exit_Code lpm_srcpkgs_scan(LPM_Srcpkgs *srcpkgs, const char *distdir, const char *cache_path)
+{
+    lpm_srcpkgs_teardown(srcpkgs);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char *srcpkgs_dir;
+    lpm_asprintf(&srcpkgs_dir, "%s/srcpkgs", distdir);
+    LPM_Srcpkgs_Names names = {0};
+    LPM_Exit_Code result = _lpm_srcpkgs_list(srcpkgs_dir, &names);
+    if (result != LPM_OK)
+    {
+        LPM_FREE(srcpkgs_dir);
+        return result;
+    }
+
+    LPM_Srcpkgs cache = {0};
+    _lpm_srcpkgs_cache_load(&cache, cache_path, distdir);
+    size_t cached_count = cache.count;
+
+    LPM_Srcpkgs_Scan scan = {
+        .srcpkgs_dir = srcpkgs_dir,
+        .names = &names,
+        .cache = &cache,
+        .reused = LPM_MALLOC(cache.count + 1),
+        .results = LPM_MALLOC((names.count + 1) * sizeof(*scan.results)),
+    };
+    LPM_ASSERT(scan.results != NULL && scan.reused != NULL && "Buy more RAM lol");
+    memset(scan.reused, 0, cache.count + 1);
+    memset(scan.results, 0, (names.count + 1) * sizeof(*scan.results));
+    atomic_store(&scan.next, 0);
+    atomic_store(&scan.reparsed, 0);
+
+    size_t thread_count = _lpm_srcpkgs_thread_count(names.count);
+    pthread_t threads[LPM_SRCPKGS_MAX_THREADS];
+    bool spawned[LPM_SRCPKGS_MAX_THREADS] = {0};
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        int err = pthread_create(&threads[i], NULL, _lpm_srcpkgs_scan_worker, &scan);
+        spawned[i] = err == 0;
+        if (err != 0)
+            LPM_LOG_WARNING("Failed to spawn template worker, parsing inline\n\tReason  : %s",
+                            strerror(err));
+    }
+    // the calling thread works too, and picks up whatever a missing worker would have done
+    _lpm_srcpkgs_scan_worker(&scan);
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        if (spawned[i])
+            pthread_join(threads[i], NULL);
+    }
+
+    LPM_DA_RESERVE(srcpkgs, names.count);
+    for (size_t i = 0; i < names.count; ++i)
+    {
+        if (scan.results[i].text)
+            srcpkgs->items[srcpkgs->count++] = scan.results[i];
+        else
+            srcpkgs->skipped++;
+    }
+    srcpkgs->reparsed = atomic_load(&scan.reparsed);
+    if (srcpkgs->reparsed > 0 || srcpkgs->count != cached_count)
+        _lpm_srcpkgs_cache_save(srcpkgs, cache_path, distdir);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Indexed %zu source packages of %s in %.1f ms on %zu threads\n"
+                 "\tParsed  : %zu templates, %zu from the cache, %zu without a pkgname or version",
+                 srcpkgs->count, distdir, elapsed_ms, thread_count, srcpkgs->reparsed,
+                 srcpkgs->count + srcpkgs->skipped - srcpkgs->reparsed, srcpkgs->skipped);
+
+    for (size_t i = 0; i < cache.count; ++i)
+    {
+        if (scan.reused[i])
+            cache.items[i].text = NULL;
+    }
+    lpm_srcpkgs_teardown(&cache);
+    LPM_FREE(scan.reused);
+    LPM_FREE(scan.results);
+    for (size_t i = 0; i < names.count; ++i)
+        LPM_FREE(names.items[i]);
+    LPM_DA_FREE(names);
+    LPM_FREE(srcpkgs_dir);
+    return LPM_OK;
+}
+
+void lpm_srcpkgs_append(const LPM_Srcpkgs *srcpkgs, LPM_Packages *pkgs)
+{
+    LPM_DA_RESERVE(pkgs, pkgs->count + srcpkgs->count);
+    for (size_t i = 0; i < srcpkgs->count; ++i)
+    {
+        LPM_Package pkg = {
+            .status = LPM_PACKAGE_STATUS_SOURCE,
+            .name = srcpkgs->items[i].pkgver,
+            .description = srcpkgs->items[i].short_desc,
+        };
+        pkgs->items[pkgs->count++] = pkg;
+    }
+}
+
+void lpm_srcpkgs_teardown(LPM_Srcpkgs *srcpkgs)
+{
+    for (size_t i = 0; i < srcpkgs->count; ++i)
+        LPM_FREE(srcpkgs->items[i].text);
+    LPM_DA_FREE(*srcpkgs);
+    *srcpkgs = (LPM_Srcpkgs){0};
+}
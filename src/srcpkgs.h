@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// srcpkgs.h - Index the templates of a void-packages checkout, the sources xbps-src builds
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "packages.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LPM_SRCPKGS_CACHE_FILE_NAME "srcpkgs.cache"
+
+// Upper bound on threads reading and parsing templates
+#ifndef LPM_SRCPKGS_MAX_THREADS
+#define LPM_SRCPKGS_MAX_THREADS 8
+#endif // LPM_SRCPKGS_MAX_THREADS
+
+// Templates bigger than this are not templates
+#define LPM_SRCPKGS_TEMPLATE_MAX_SIZE (1024 * 1024)
+
+typedef struct
+{
+    // name of the srcpkgs directory, the pkgver, short_desc and depends, NUL-terminated one after
+    // the other in a single allocation
+    char *text;
+    char *pkgver;
+    char *short_desc;
+    char *depends;     // space separated, like the template
+    int64_t mtime_sec; // of the template when it was parsed
+    int64_t mtime_nsec;
+    int64_t size;
+} LPM_Srcpkg;
+
+typedef struct
+{
+    LPM_Srcpkg *items; // sorted by directory name
+    size_t count;
+    size_t capacity;
+    size_t reparsed; // templates parsed by the last scan, the others came from the cache
+    size_t skipped;  // templates without a pkgname or version
+} LPM_Srcpkgs;
+
+// The void-packages checkout: $XBPS_DISTDIR like xbps-src, else ~/void-packages. NULL when it has
+// no srcpkgs directory. Owned by the caller.
+char *lpm_srcpkgs_distdir(void);
+// Cache file in the lazypm state directory, owned by the caller
+char *lpm_srcpkgs_cache_path(void);
+
+// Index every template under distdir/srcpkgs on up to LPM_SRCPKGS_MAX_THREADS threads. Templates
+// whose mtime and size match cache_path are taken from it instead of being parsed, and the cache
+// is rewritten when anything changed. Subpackages are symlinks to their source package and are
+// skipped.
+LPM_Exit_Code lpm_srcpkgs_scan(LPM_Srcpkgs *srcpkgs, const char *distdir, const char *cache_path);
+// Append a row per source package to pkgs, with LPM_PACKAGE_STATUS_SOURCE. The rows point into
+// srcpkgs, which must outlive them.
+void lpm_srcpkgs_append(const LPM_Srcpkgs *srcpkgs, LPM_Packages *pkgs);
+void lpm_srcpkgs_teardown(LPM_Srcpkgs *srcpkgs);
@@ -14,8 +14,8 @@ typedef struct
     char *msg;
     struct timeval start_time;
     LPM_Status_Msg_Type type;
-    uint8_t xpos;
-    uint8_t ypos;
+    int xpos;
+    int ypos;
 } LPM_Status_Msg;
 
 // For now, we have a singleton-like global status. Eventually, would like to
@@ -87,7 +87,7 @@ void lpm_status_msg_display(bool flush)
     if (_status.type == LPM_STATUS_MSG_TYPE_INFO)
         fg_color = LPM_FG_COLOR_BLUE;
 
-    tb_printf(_status.xpos, _status.ypos, fg_color, LPM_BG_COLOR, _status.msg);
+    tb_print(_status.xpos, _status.ypos, fg_color, LPM_BG_COLOR, _status.msg);
 }
 
 void lpm_status_msg_set_and_display(LPM_Status_Msg_Type st, const char *msg)
@@ -97,7 +97,7 @@ void lpm_status_msg_set_and_display(LPM_Status_Msg_Type st, const char *msg)
     tb_present();
 }
 
-void lpm_status_msg_set_position(uint8_t xpos, uint8_t ypos)
+void lpm_status_msg_set_position(int xpos, int ypos)
 {
     _status.xpos = xpos;
     _status.ypos = ypos;
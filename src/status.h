@@ -18,7 +18,7 @@ typedef enum
     LPM_STATUS_MSG_TYPE_INFO,
 } LPM_Status_Msg_Type;
 
-void lpm_status_msg_set_position(uint8_t xpos, uint8_t ypos);
+void lpm_status_msg_set_position(int xpos, int ypos);
 void lpm_status_msg_display(bool flush);
 
 void lpm_status_msg_set_and_display(LPM_Status_Msg_Type st, const char *msg);
@@ -0,0 +1,256 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// trigram.c - Trigram index over package names and descriptions for substring search
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_FILTER
+#include "trigram.h"
+
+// Trigrams of a query beyond this are ignored, which only widens the candidate set
+#define TRIGRAM_QUERY_MAX_KEYS 64
+
+typedef struct
+{
+    uint64_t *items; // (trigram << 32) | row
+    size_t count;
+    size_t capacity;
+} LPM_Trigram_Pairs;
+
+typedef struct
+{
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} LPM_Trigram_U32s;
+
+typedef struct
+{
+    uint8_t *items;
+    size_t count;
+    size_t capacity;
+} LPM_Trigram_Bytes;
+
+static uint32_t _lpm_trigram_key(const char *s)
+{
+    return (uint32_t)tolower((unsigned char)s[0]) << 16 |
+           (uint32_t)tolower((unsigned char)s[1]) << 8 | (uint32_t)tolower((unsigned char)s[2]);
+}
+
+static void _lpm_trigram_collect(LPM_Trigram_Pairs *pairs, const char *s, uint32_t row)
+{
+    size_t len = strlen(s);
+    if (len < 3)
+        return;
+    LPM_DA_RESERVE(pairs, pairs->count + len - 2);
+    // slide a 24 bit window over the lowercased bytes
+    uint32_t key = (uint32_t)tolower((unsigned char)s[0]) << 8 | tolower((unsigned char)s[1]);
+    for (size_t i = 2; i < len; ++i)
+    {
+        key = (key << 8 | (uint32_t)tolower((unsigned char)s[i])) & 0xffffff;
+        pairs->items[pairs->count++] = (uint64_t)key << 32 | row;
+    }
+}
+
+// Stable LSD radix sort on the 24 trigram bits. Pairs are generated in row order, so the result
+// is sorted by (trigram, row) and duplicate trigrams of a row end up next to each other. After
+// the three passes the sorted pairs are in scratch memory of the load arena, pairs is clobbered.
+static const uint64_t *_lpm_trigram_sort(LPM_Trigram_Pairs *pairs)
+{
+    uint64_t *src = pairs->items;
+    uint64_t *dst = lpm_arena_alloc(LPM_ARENA_LOAD, pairs->count * sizeof(*dst));
+    for (int shift = 32; shift < 56; shift += 8)
+    {
+        size_t counts[257] = {0};
+        for (size_t i = 0; i < pairs->count; ++i)
+            counts[((src[i] >> shift) & 0xff) + 1]++;
+        for (size_t i = 1; i < 257; ++i)
+            counts[i] += counts[i - 1];
+        for (size_t i = 0; i < pairs->count; ++i)
+            dst[counts[(src[i] >> shift) & 0xff]++] = src[i];
+        uint64_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    return src;
+}
+
+static void _lpm_trigram_varint_append(LPM_Trigram_Bytes *bytes, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        LPM_DA_APPEND(bytes, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    LPM_DA_APPEND(bytes, (uint8_t)value);
+}
+
+static const uint8_t *_lpm_trigram_varint_read(const uint8_t *p, uint32_t *value)
+{
+    uint32_t result = 0;
+    int shift = 0;
+    while (*p & 0x80)
+    {
+        result |= (uint32_t)(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *value = result | (uint32_t)*p++ << shift;
+    return p;
+}
+
+void lpm_trigram_index_build(LPM_Trigram_Index *index, const LPM_Packages *pkgs)
+{
+    lpm_trigram_index_teardown(index);
+
+    LPM_Trigram_Pairs pairs = {0};
+    // most rows are short, guess generously once instead of growing the pairs array repeatedly
+    LPM_DA_RESERVE(&pairs, pkgs->count * 64);
+    for (size_t i = 0; i < pkgs->count; ++i)
+    {
+        _lpm_trigram_collect(&pairs, pkgs->items[i].name, (uint32_t)i);
+        _lpm_trigram_collect(&pairs, pkgs->items[i].description, (uint32_t)i);
+    }
+    index->row_count = pkgs->count;
+    if (pairs.count == 0)
+        return;
+    const uint64_t *sorted = _lpm_trigram_sort(&pairs);
+
+    LPM_Trigram_U32s keys = {0};
+    LPM_Trigram_U32s offsets = {0};
+    LPM_Trigram_Bytes postings = {0};
+    uint32_t prev_row = 0;
+    for (size_t i = 0; i < pairs.count; ++i)
+    {
+        uint32_t key = (uint32_t)(sorted[i] >> 32);
+        uint32_t row = (uint32_t)sorted[i];
+        if (keys.count == 0 || keys.items[keys.count - 1] != key)
+        {
+            LPM_DA_APPEND(&keys, key);
+            LPM_DA_APPEND(&offsets, (uint32_t)postings.count);
+            prev_row = 0;
+        }
+        else if (row == prev_row)
+        {
+            continue; // same trigram seen earlier in this row
+        }
+        _lpm_trigram_varint_append(&postings, row - prev_row);
+        prev_row = row;
+    }
+    LPM_DA_APPEND(&offsets, (uint32_t)postings.count);
+    LPM_DA_FREE(pairs);
+
+    index->keys = keys.items;
+    index->key_count = keys.count;
+    index->offsets = offsets.items;
+    index->postings = postings.items;
+    index->postings_size = postings.count;
+}
+
+void lpm_trigram_index_teardown(LPM_Trigram_Index *index)
+{
+    LPM_FREE(index->keys);
+    LPM_FREE(index->offsets);
+    LPM_FREE(index->postings);
+    index->key_count = 0;
+    index->postings_size = 0;
+    index->row_count = 0;
+}
+
+size_t lpm_trigram_index_bytes(const LPM_Trigram_Index *index)
+{
+    if (index->keys == NULL)
+        return sizeof(*index);
+    return sizeof(*index) + index->key_count * sizeof(*index->keys) +
+           (index->key_count + 1) * sizeof(*index->offsets) + index->postings_size;
+}
+
+// Position of key in index->keys, or index->key_count if it is not there
+static size_t _lpm_trigram_find(const LPM_Trigram_Index *index, uint32_t key)
+{
+    size_t lo = 0;
+    size_t hi = index->key_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < index->key_count && index->keys[lo] == key)
+        return lo;
+    return index->key_count;
+}
+
+// Keep only the rows that are also in the posting list [p, end)
+static void _lpm_trigram_intersect(LPM_Package_Rows *rows, const uint8_t *p, const uint8_t *end)
+{
+    size_t out = 0;
+    size_t i = 0;
+    uint32_t row = 0;
+    while (p < end && i < rows->count)
+    {
+        uint32_t delta;
+        p = _lpm_trigram_varint_read(p, &delta);
+        row += delta;
+        while (i < rows->count && rows->items[i] < row)
+            i++;
+        if (i < rows->count && rows->items[i] == row)
+            rows->items[out++] = rows->items[i++];
+    }
+    rows->count = out;
+}
+
+bool lpm_trigram_index_candidates(const LPM_Trigram_Index *index, const char *needle,
+                                  LPM_Package_Rows *rows)
+{
+    size_t len = strlen(needle);
+    if (len < LPM_TRIGRAM_MIN_QUERY_LEN || index->keys == NULL)
+        return false;
+
+    rows->count = 0;
+    size_t lists[TRIGRAM_QUERY_MAX_KEYS];
+    size_t list_count = 0;
+    for (size_t i = 0; i + 2 < len && list_count < TRIGRAM_QUERY_MAX_KEYS; ++i)
+    {
+        size_t found = _lpm_trigram_find(index, _lpm_trigram_key(needle + i));
+        if (found == index->key_count)
+            return true; // some trigram occurs nowhere, nothing can match
+        bool duplicate = false;
+        for (size_t j = 0; j < list_count && !duplicate; ++j)
+            duplicate = lists[j] == found;
+        if (!duplicate)
+            lists[list_count++] = found;
+    }
+
+    // decode the shortest posting list, then narrow it down with the others
+    size_t shortest = 0;
+    for (size_t i = 1; i < list_count; ++i)
+    {
+        size_t len_i = index->offsets[lists[i] + 1] - index->offsets[lists[i]];
+        size_t len_s = index->offsets[lists[shortest] + 1] - index->offsets[lists[shortest]];
+        if (len_i < len_s)
+            shortest = i;
+    }
+
+    const uint8_t *p = index->postings + index->offsets[lists[shortest]];
+    const uint8_t *end = index->postings + index->offsets[lists[shortest] + 1];
+    uint32_t row = 0;
+    while (p < end)
+    {
+        uint32_t delta;
+        p = _lpm_trigram_varint_read(p, &delta);
+        row += delta;
+        LPM_DA_APPEND(rows, row);
+    }
+
+    for (size_t i = 0; i < list_count && rows->count > 0; ++i)
+    {
+        if (i == shortest)
+            continue;
+        _lpm_trigram_intersect(rows, index->postings + index->offsets[lists[i]],
+                               index->postings + index->offsets[lists[i] + 1]);
+    }
+    return true;
+}
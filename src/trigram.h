@@ -0,0 +1,34 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// trigram.h - Trigram index over package names and descriptions for substring search
+//
+
+#pragma once
+
+#include "common.h"
+#include "packages.h"
+
+#define LPM_TRIGRAM_MIN_QUERY_LEN 3
+
+typedef struct
+{
+    uint32_t *keys;     // sorted trigrams, three lowercase bytes packed as 0x00AABBCC
+    uint32_t *offsets;  // key_count + 1 offsets into postings
+    uint8_t *postings;  // per key: ascending row ids, delta + varint encoded
+    size_t key_count;
+    size_t postings_size;
+    size_t row_count;
+} LPM_Trigram_Index;
+
+void lpm_trigram_index_build(LPM_Trigram_Index *index, const LPM_Packages *pkgs);
+void lpm_trigram_index_teardown(LPM_Trigram_Index *index);
+// Bytes held by the index
+size_t lpm_trigram_index_bytes(const LPM_Trigram_Index *index);
+
+// Fill rows with every row containing all trigrams of needle (lowercase, at least
+// LPM_TRIGRAM_MIN_QUERY_LEN bytes). This is a superset of the real matches, callers still have to
+// verify each candidate. Returns false if the index can not answer the query.
+bool lpm_trigram_index_candidates(const LPM_Trigram_Index *index, const char *needle,
+                                  LPM_Package_Rows *rows);
@@ -5,31 +5,923 @@
 // tui.c - Lazypm TUI
 //
 
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_TUI
 #include "tui.h"
 
 static LPM_TUI_Mode lpm_tui_mode = LPM_TUI_MODE_MAIN;
-#define FILTER_TEXT_MAX_LEN 64
+#define FILTER_TEXT_MAX_LEN LPM_FILTER_QUERY_MAX_LEN
 static char filter_text[FILTER_TEXT_MAX_LEN] = {0};
+static char filter_applied[FILTER_TEXT_MAX_LEN] = {0}; // query behind filter_rows
 static bool filter_cursor = false;
 static uint8_t filter_cursor_pos = 0;
 static size_t filter_cursor_render_count = 0;
+static LPM_Filter filter = {0};
+static LPM_Facets facets = {0};
+static LPM_Upgrades upgrades = {0};
+static LPM_Prefetch prefetch = {0};
+static LPM_Pkgdb_Watch pkgdb_watch = {0};
+// Until the package list has loaded, pkgs holds the rows of the saved session, if any
+static LPM_Loader loader = {0};
+static LPM_Srcpkgs srcpkgs = {0}; // source rows of pkgs point into it
+static bool loaded = false;
+static LPM_Session session = {0};
+static char session_cursor[LPM_PACKAGE_NAME_MAX] = {0}; // pkgver hovered when it was saved
+// Events handled per rendered frame and how long they waited to be shown, logged at teardown
+typedef struct
+{
+    size_t events;
+    size_t frames; // with at least one event
+    size_t max_batch;
+    double lag_total_ms; // reading the first event of a batch -> presenting its frame
+    double lag_max_ms;
+} LPM_TUI_Input_Stats;
+static LPM_TUI_Input_Stats input_stats = {0};
+
+// Rows marked for installing in a single transaction
+static LPM_Bitset marked = {0};
+static size_t marked_count = 0;
+static uint64_t marked_hash = 0; // of the marked pkgvers, see lpm_preview_hash
+
+// Dry runs of the transaction enter would start, see _lpm_tui_preview
+static LPM_Preview preview = {0};
+
+// Combined stdout/stderr of every transaction this session, see the output screen (o)
+static LPM_Output output = {0};
+static size_t output_top = 0;         // first line shown
+static bool output_follow = true;     // keep the last line in view as new lines arrive
+static size_t output_match = SIZE_MAX; // line of the last search hit
+static char output_search_text[FILTER_TEXT_MAX_LEN] = {0};
+
+static size_t _lpm_tui_output_capacity(LPM_TUI_Layout *layout)
+{
+    return layout->footer_ypos - (layout->header_ypos + 2) - 1;
+}
+
+static void _lpm_tui_output_scroll_to(LPM_TUI_Layout *layout, size_t top)
+{
+    size_t count = lpm_output_count(&output);
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    size_t last_top = count > capacity ? count - capacity : 0;
+    output_top = top < last_top ? top : last_top;
+    output_follow = output_top == last_top;
+}
+
+static void _lpm_tui_output_search(LPM_TUI_Layout *layout, bool forward)
+{
+    size_t count = lpm_output_count(&output);
+    if (output_search_text[0] == '\0' || count == 0)
+        return;
+    size_t from;
+    if (output_match < count)
+        from = forward ? output_match + 1 : output_match - 1;
+    else
+        from = forward ? output_top : output_top + _lpm_tui_output_capacity(layout) - 1;
+    // wrap around once, like less
+    size_t hit = output_match == 0 && !forward
+                     ? count
+                     : lpm_output_search(&output, output_search_text, from, forward);
+    if (hit == count)
+        hit = lpm_output_search(&output, output_search_text, forward ? 0 : count - 1, forward);
+    if (hit == count)
+    {
+        char *status_msg;
+        lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "Pattern not found: %s",
+                           output_search_text);
+        LPM_STATUS_MSG_SET_ERROR(status_msg);
+        return;
+    }
+    output_match = hit;
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    _lpm_tui_output_scroll_to(layout, hit > capacity / 2 ? hit - capacity / 2 : 0);
+}
+
+// Keys of the output screen, also handled while a transaction is running
+static void _lpm_tui_output_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout)
+{
+    if (evt->type != TB_EVENT_KEY)
+        return;
+
+    if (lpm_tui_mode == LPM_TUI_MODE_OUTPUT_SEARCH)
+    {
+        size_t len = strlen(output_search_text);
+        if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C ||
+            ((evt->key == TB_KEY_BACKSPACE || evt->key == TB_KEY_BACKSPACE2) && len == 0))
+        {
+            lpm_tui_mode = LPM_TUI_MODE_OUTPUT;
+        }
+        else if (evt->key == TB_KEY_ENTER)
+        {
+            lpm_tui_mode = LPM_TUI_MODE_OUTPUT;
+            output_match = SIZE_MAX;
+            _lpm_tui_output_search(layout, true);
+        }
+        else if (evt->key == TB_KEY_BACKSPACE || evt->key == TB_KEY_BACKSPACE2)
+        {
+            output_search_text[len - 1] = '\0';
+        }
+        else if (evt->ch >= ' ' && evt->ch < 127 && len + 1 < sizeof(output_search_text))
+        {
+            output_search_text[len] = (char)evt->ch;
+            output_search_text[len + 1] = '\0';
+        }
+        return;
+    }
+
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C || evt->ch == 'q' || evt->ch == 'o')
+        lpm_tui_mode = LPM_TUI_MODE_MAIN;
+    else if (evt->key == TB_KEY_ARROW_DOWN || evt->ch == 'j')
+        _lpm_tui_output_scroll_to(layout, output_top + 1);
+    else if ((evt->key == TB_KEY_ARROW_UP || evt->ch == 'k') && output_top > 0)
+        _lpm_tui_output_scroll_to(layout, output_top - 1);
+    else if (evt->key == TB_KEY_ARROW_RIGHT || evt->ch == 'l')
+        _lpm_tui_output_scroll_to(layout, output_top + capacity);
+    else if (evt->key == TB_KEY_ARROW_LEFT || evt->ch == 'h')
+        _lpm_tui_output_scroll_to(layout, output_top > capacity ? output_top - capacity : 0);
+    else if (evt->ch == 'H')
+        _lpm_tui_output_scroll_to(layout, 0);
+    else if (evt->ch == 'L')
+        _lpm_tui_output_scroll_to(layout, SIZE_MAX);
+    else if (evt->ch == 'n' || evt->ch == 'N')
+        _lpm_tui_output_search(layout, evt->ch == 'n');
+    else if (evt->ch == '/')
+    {
+        lpm_tui_mode = LPM_TUI_MODE_OUTPUT_SEARCH;
+        memset(output_search_text, 0, sizeof(output_search_text));
+    }
+}
+
+// Files of the hovered package, see the files screen (f)
+static LPM_Files files = {0};
+static size_t files_top = 0;
+static char files_query[LPM_FILES_QUERY_MAX_LEN] = {0};
+
+static void _lpm_tui_files_scroll_to(LPM_TUI_Layout *layout, size_t top)
+{
+    size_t count = lpm_files_view_count(&files);
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    size_t last_top = count > capacity ? count - capacity : 0;
+    files_top = top < last_top ? top : last_top;
+}
+
+// Keys of the files screen, rows keep streaming in while they are handled
+static void _lpm_tui_files_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout)
+{
+    if (evt->type != TB_EVENT_KEY)
+        return;
+
+    size_t len = strlen(files_query);
+    if (lpm_tui_mode == LPM_TUI_MODE_FILES_FILTER)
+    {
+        if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C)
+        {
+            files_query[0] = '\0';
+            lpm_tui_mode = LPM_TUI_MODE_FILES;
+        }
+        else if (evt->key == TB_KEY_ENTER ||
+                 ((evt->key == TB_KEY_BACKSPACE || evt->key == TB_KEY_BACKSPACE2) && len == 0))
+        {
+            lpm_tui_mode = LPM_TUI_MODE_FILES;
+        }
+        else if (evt->key == TB_KEY_BACKSPACE || evt->key == TB_KEY_BACKSPACE2)
+        {
+            files_query[len - 1] = '\0';
+        }
+        else if (evt->ch >= ' ' && evt->ch < 127 && len + 1 < sizeof(files_query))
+        {
+            files_query[len] = (char)evt->ch;
+            files_query[len + 1] = '\0';
+        }
+        lpm_files_set_query(&files, files_query);
+        files_top = 0;
+        return;
+    }
+
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C || evt->ch == 'q' || evt->ch == 'f')
+        lpm_tui_mode = LPM_TUI_MODE_MAIN;
+    else if (evt->key == TB_KEY_ARROW_DOWN || evt->ch == 'j')
+        _lpm_tui_files_scroll_to(layout, files_top + 1);
+    else if ((evt->key == TB_KEY_ARROW_UP || evt->ch == 'k') && files_top > 0)
+        _lpm_tui_files_scroll_to(layout, files_top - 1);
+    else if (evt->key == TB_KEY_ARROW_RIGHT || evt->ch == 'l')
+        _lpm_tui_files_scroll_to(layout, files_top + capacity);
+    else if (evt->key == TB_KEY_ARROW_LEFT || evt->ch == 'h')
+        _lpm_tui_files_scroll_to(layout, files_top > capacity ? files_top - capacity : 0);
+    else if (evt->ch == 'H')
+        _lpm_tui_files_scroll_to(layout, 0);
+    else if (evt->ch == 'L')
+        _lpm_tui_files_scroll_to(layout, SIZE_MAX);
+    else if (evt->ch == '/')
+        lpm_tui_mode = LPM_TUI_MODE_FILES_FILTER;
+}
+
+// Packages in the xbps cache, see the cache screen (c)
+static LPM_Pkgcache pkgcache = {0};
+static LPM_Bitset cache_marked = {0}; // bit per group of pkgcache
+static size_t cache_marked_count = 0;
+static size_t cache_selected = 0;
+static size_t cache_top = 0;
+
+// "12.3 MiB" style, for sizes in the package cache
+static void _lpm_tui_format_bytes(int64_t bytes, char *buf, size_t size)
+{
+    if (bytes < 1024)
+        snprintf(buf, size, "%lld B", (long long)bytes);
+    else if (bytes < 1024 * 1024)
+        snprintf(buf, size, "%.1f KiB", bytes / 1024.0);
+    else if (bytes < 1024 * 1024 * 1024)
+        snprintf(buf, size, "%.1f MiB", bytes / (1024.0 * 1024.0));
+    else
+        snprintf(buf, size, "%.1f GiB", bytes / (1024.0 * 1024.0 * 1024.0));
+}
+
+// Cut line to columns in place, ending it with "..." when it is longer. Returns the columns it
+// takes, which may be fewer than its bytes.
+static size_t _lpm_tui_cut_line(char *line, size_t columns)
+{
+    size_t width;
+    lpm_packages_text_cut(line, 0, SIZE_MAX, &width);
+    if (width <= columns)
+        return width;
+    if (columns <= 3)
+    {
+        line[lpm_packages_text_cut(line, 0, columns, &width)] = '\0';
+        return width;
+    }
+    // every column takes at least a byte, the cut leaves room for the dots
+    memcpy(line + lpm_packages_text_cut(line, 0, columns - 3, &width), "...", 4);
+    return width + 3;
+}
+
+static void _lpm_tui_cache_finish_scan(void)
+{
+    if (pkgcache.result != LPM_OK)
+        LPM_STATUS_MSG_SET_ERROR("Failed to scan the package cache, see the logs");
+    // groups are reordered by every scan, marks would land on other packages
+    lpm_bitset_init(&cache_marked, pkgcache.groups.count);
+    cache_marked_count = 0;
+    if (cache_selected >= pkgcache.groups.count)
+        cache_selected = pkgcache.groups.count > 0 ? pkgcache.groups.count - 1 : 0;
+    if (cache_top > cache_selected)
+        cache_top = cache_selected;
+}
+
+// Delete the reclaimable files of the marked packages, or of the selected one if none are marked
+static void _lpm_tui_cache_purge(void)
+{
+    if (lpm_pkgcache_active(&pkgcache) || cache_selected >= pkgcache.groups.count)
+        return;
+    if (cache_marked_count == 0)
+        lpm_bitset_set(&cache_marked, cache_selected, true);
+    size_t removed;
+    int64_t freed;
+    LPM_Exit_Code result = lpm_pkgcache_purge(&pkgcache, &cache_marked, &removed, &freed);
+    char freed_text[32];
+    _lpm_tui_format_bytes(freed, freed_text, sizeof(freed_text));
+    char *status_msg;
+    lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "Purged %zu cached packages, %s%s", removed,
+                       freed_text,
+                       result == LPM_OK ? "" : ", some could not be deleted, see the logs");
+    if (result == LPM_OK)
+        LPM_STATUS_MSG_SET_SUCCESS(status_msg);
+    else
+        LPM_STATUS_MSG_SET_ERROR(status_msg);
+    if (lpm_pkgcache_start(&pkgcache, LPM_PKGCACHE_DIR, LPM_PKGDB_PATH))
+        return; // marks are reset once the rescan is in
+    lpm_bitset_init(&cache_marked, pkgcache.groups.count);
+    cache_marked_count = 0;
+}
+
+static void _lpm_tui_cache_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout)
+{
+    if (evt->type != TB_EVENT_KEY)
+        return;
+
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    size_t count = lpm_pkgcache_active(&pkgcache) ? 0 : pkgcache.groups.count;
+    if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C || evt->ch == 'q' || evt->ch == 'c')
+    {
+        lpm_tui_mode = LPM_TUI_MODE_MAIN;
+    }
+    else if ((evt->key == TB_KEY_ARROW_DOWN || evt->ch == 'j') && cache_selected + 1 < count)
+    {
+        cache_selected++;
+        if (cache_selected >= cache_top + capacity)
+            cache_top = cache_selected - capacity + 1;
+    }
+    else if ((evt->key == TB_KEY_ARROW_UP || evt->ch == 'k') && cache_selected > 0)
+    {
+        cache_selected--;
+        if (cache_selected < cache_top)
+            cache_top = cache_selected;
+    }
+    else if (evt->ch == ' ' && cache_selected < count)
+    {
+        bool mark = !lpm_bitset_test(&cache_marked, cache_selected);
+        lpm_bitset_set(&cache_marked, cache_selected, mark);
+        cache_marked_count += mark ? 1 : -1;
+    }
+    else if (evt->ch == 'a' && count > 0)
+    {
+        // groups are sorted by reclaimable size, the ones with nothing to purge come last
+        lpm_bitset_init(&cache_marked, count);
+        cache_marked_count = 0;
+        for (size_t g = 0; g < count && pkgcache.groups.items[g].reclaimable > 0; ++g)
+        {
+            lpm_bitset_set(&cache_marked, g, true);
+            cache_marked_count++;
+        }
+    }
+    else if (evt->key == TB_KEY_ENTER && count > 0)
+    {
+        _lpm_tui_cache_purge();
+    }
+}
+
+// Which installed package owns a path, see the owners screen (w)
+static LPM_Owners owners = {0};
+static bool owners_stale = true; // the pkgdb changed since the index was last brought up to date
+static char owners_text[FILTER_TEXT_MAX_LEN] = {0};
+static LPM_Owners_Matches owners_matches = {0};
+static size_t owners_selected = 0;
+static size_t owners_top = 0;
+static double owners_search_ms = 0;
+
+static void _lpm_tui_owners_search(void)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lpm_owners_search(&owners, owners_text, LPM_TUI_OWNERS_MAX_MATCHES, &owners_matches);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    owners_search_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    owners_selected = 0;
+    owners_top = 0;
+}
+
+// Bring the index up to date in the background, the current one keeps answering meanwhile
+static void _lpm_tui_owners_update(void)
+{
+    if (!owners_stale || lpm_owners_active(&owners))
+        return;
+    char *path = lpm_owners_path();
+    lpm_owners_start(&owners, LPM_PKGDB_PATH, path);
+    LPM_FREE(path);
+    owners_stale = false;
+}
+
+static void _lpm_tui_owners_finish_update(void)
+{
+    if (owners.result != LPM_OK)
+    {
+        LPM_STATUS_MSG_SET_ERROR("Failed to index the installed files, see the logs");
+        return;
+    }
+    _lpm_tui_owners_search();
+    if (lpm_tui_mode == LPM_TUI_MODE_OWNERS && owners.reparsed > 0)
+    {
+        char *status_msg;
+        lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                           "Indexed the files of %zu packages in %.1f ms", owners.reparsed,
+                           owners.elapsed_ms);
+        LPM_STATUS_MSG_SET_INFO(status_msg);
+    }
+    if (owners_stale && lpm_tui_mode == LPM_TUI_MODE_OWNERS)
+        _lpm_tui_owners_update(); // the pkgdb changed again while indexing
+}
+
+// Transactions block the event loop, their progress redraws the screen from the output callback
+static LPM_Progress transaction_progress = {0};
+typedef struct
+{
+    LPM_TUI_Layout *layout;
+    LPM_Packages *pkgs;
+} LPM_TUI_Progress_Target;
+
+static void _lpm_tui_render_progress(const LPM_Progress *progress, void *data)
+{
+    LPM_TUI_Progress_Target *target = data;
+
+    // only the output screen is usable until the transaction is done
+    struct tb_event evt;
+    while (tb_peek_event(&evt, 0) == TB_OK)
+    {
+        if (lpm_tui_mode == LPM_TUI_MODE_OUTPUT || lpm_tui_mode == LPM_TUI_MODE_OUTPUT_SEARCH)
+            _lpm_tui_output_event_handler(&evt, target->layout);
+        else if (lpm_tui_mode == LPM_TUI_MODE_MAIN && evt.type == TB_EVENT_KEY && evt.ch == 'o')
+            lpm_tui_mode = LPM_TUI_MODE_OUTPUT;
+    }
+
+    char text[256];
+    lpm_progress_describe(progress, text, sizeof(text));
+    LPM_STATUS_MSG_SET_INFO(text);
+    lpm_tui_display(target->layout, target->pkgs);
+    tb_present();
+}
+
+static LPM_Progress *_lpm_tui_progress_start(LPM_TUI_Progress_Target *target)
+{
+    lpm_progress_init(&transaction_progress, _lpm_tui_render_progress, target, &output);
+    return &transaction_progress;
+}
+// Rows matching the filter text, and the subset of those passing the active facets that is
+// currently shown. pkgs itself always holds the full list.
+static LPM_Package_Rows filter_rows = {0};
+static LPM_Package_Rows rows = {0};
+
+static void _lpm_tui_apply_facets(LPM_TUI_Layout *layout)
+{
+    lpm_facets_apply(&facets, &filter_rows, &rows);
+    layout->packages_page_index = 0;
+    layout->packages_cursor_ypos = 0;
+}
+
+// Move the cursor to the index-th shown row, or the last one when there are fewer
+static void _lpm_tui_select(LPM_TUI_Layout *layout, size_t index)
+{
+    size_t capacity = layout->packages_render_capacity;
+    if (capacity == 0)
+        return;
+    if (index >= rows.count)
+        index = rows.count > 0 ? rows.count - 1 : 0;
+    layout->packages_page_index = index / capacity;
+    layout->packages_cursor_ypos = index % capacity;
+}
+
+// Re-apply the facets after rows changed install state, keeping the hovered package in place
+// when it still passes them
+static void _lpm_tui_reapply_facets(LPM_TUI_Layout *layout)
+{
+    size_t capacity = layout->packages_render_capacity;
+    size_t selected = layout->packages_page_index * capacity + layout->packages_cursor_ypos;
+    uint32_t selected_row = selected < rows.count ? rows.items[selected] : UINT32_MAX;
+    lpm_facets_apply(&facets, &filter_rows, &rows);
+    for (size_t i = 0; i < rows.count; ++i)
+    {
+        if (rows.items[i] == selected_row)
+        {
+            selected = i;
+            break;
+        }
+    }
+    _lpm_tui_select(layout, selected);
+}
+
+// Put the cursor back on the package hovered when the session was saved. It is matched by
+// pkgname, the fresh list may have a newer version of it.
+static void _lpm_tui_restore_cursor(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    size_t len = lpm_packages_pkgname_len(session_cursor);
+    for (size_t i = 0; i < rows.count && len > 0; ++i)
+    {
+        const char *name = pkgs->items[rows.items[i]].name;
+        if (lpm_packages_pkgname_len(name) == len && strncmp(name, session_cursor, len) == 0)
+        {
+            _lpm_tui_select(layout, i);
+            return;
+        }
+    }
+}
+
+// Results of the background upgrades computation arrived, feed them to the upgradable facet
+static void _lpm_tui_apply_upgrades(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    if (upgrades.result != LPM_OK)
+        return;
+    lpm_facets_set_upgradable(&facets, &upgrades.rows);
+    // have the packages in the cache by the time the user updates
+    for (size_t i = 0; i < upgrades.rows.count; ++i)
+        lpm_prefetch_queue(&prefetch, pkgs->items[upgrades.rows.items[i]].name);
+    if (facets.active & (1u << LPM_FACET_UPGRADABLE))
+    {
+        _lpm_tui_apply_facets(layout);
+        // a session restored with this facet had nothing to hover until now
+        _lpm_tui_restore_cursor(layout, pkgs);
+    }
+    session_cursor[0] = '\0';
+    if (upgrades.rows.count > 0)
+    {
+        char *status_msg;
+        lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                           "Upgrades available: %zu, press U to list them", upgrades.rows.count);
+        LPM_STATUS_MSG_SET_INFO(status_msg);
+    }
+}
+
+// The pkgdb changed behind our back, e.g. xbps-install in another shell. Flip the rows whose
+// install state differs instead of reloading the package list.
+static void _lpm_tui_refresh_installed(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    LPM_Package_Rows changed = {0};
+    if (lpm_pkgdb_diff(pkgs, LPM_PKGDB_PATH, &changed) != LPM_OK || changed.count == 0)
+    {
+        LPM_DA_FREE(changed);
+        return;
+    }
+
+    size_t installed_count = 0;
+    for (size_t i = 0; i < changed.count; ++i)
+    {
+        LPM_Package *pkg = &pkgs->items[changed.items[i]];
+        bool installed = strcmp(pkg->status, LPM_PACKAGE_STATUS_AVAILABLE) == 0;
+        pkg->status = installed ? LPM_PACKAGE_STATUS_INSTALLED : LPM_PACKAGE_STATUS_AVAILABLE;
+        lpm_facets_set_installed(&facets, changed.items[i], installed);
+        installed_count += installed;
+    }
+    if (lpm_facets_any_active(&facets))
+        _lpm_tui_reapply_facets(layout);
+    // installed versions moved, so did the upgradable set
+    lpm_upgrades_start(&upgrades, pkgs);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Package database changed, flipped %zu of %zu rows in %.1f ms", changed.count,
+                 pkgs->count, elapsed_ms);
+    char *status_msg;
+    lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                       "Package database changed: %zu installed, %zu removed", installed_count,
+                       changed.count - installed_count);
+    LPM_STATUS_MSG_SET_INFO(status_msg);
+    LPM_DA_FREE(changed);
+}
+
+// Source rows are templates, xbps can only install them once xbps-src has built them. Tells the
+// user how to and returns true for those.
+static bool _lpm_tui_refuse_source(const LPM_Package *pkg)
+{
+    if (strcmp(pkg->status, LPM_PACKAGE_STATUS_SOURCE) != 0)
+        return false;
+    char *status_msg;
+    int name_len = (int)lpm_packages_pkgname_len(pkg->name);
+    lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                       "'%s' is a source package, build it with ./xbps-src pkg %.*s", pkg->name,
+                       name_len, pkg->name);
+    LPM_STATUS_MSG_SET_ERROR(status_msg);
+    return true;
+}
+
+static void _lpm_tui_toggle_mark(LPM_Packages *pkgs, uint32_t row)
+{
+    bool mark = !lpm_bitset_test(&marked, row);
+    lpm_bitset_set(&marked, row, mark);
+    marked_hash ^= lpm_preview_hash(pkgs->items[row].name);
+    if (mark)
+    {
+        marked_count++;
+        lpm_prefetch_queue(&prefetch, pkgs->items[row].name);
+    }
+    else
+    {
+        marked_count--;
+        lpm_prefetch_dequeue(&prefetch, pkgs->items[row].name);
+    }
+}
+
+static void _lpm_tui_install_marked(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    LPM_TUI_Progress_Target target = {layout, pkgs};
+    LPM_Package_Rows marked_rows = {0};
+    for (size_t row = 0; row < pkgs->count; ++row)
+    {
+        if (lpm_bitset_test(&marked, row))
+            LPM_DA_APPEND(&marked_rows, (uint32_t)row);
+    }
+
+    char *status_msg;
+    lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "Installing %zu marked packages... ",
+                       marked_rows.count);
+    LPM_STATUS_MSG_SET_INFO(status_msg);
+    if (lpm_packages_install_rows(pkgs, &marked_rows, _lpm_tui_progress_start(&target)) == LPM_OK)
+    {
+        for (size_t i = 0; i < marked_rows.count; ++i)
+            lpm_facets_set_installed(&facets, marked_rows.items[i], true);
+        lpm_bitset_init(&marked, pkgs->count);
+        marked_count = 0;
+        marked_hash = 0;
+    }
+    LPM_DA_FREE(marked_rows);
+}
+
+static void _lpm_tui_apply_filter(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    lpm_filter_query(&filter, pkgs, filter_text, &filter_rows);
+    memcpy(filter_applied, filter_text, sizeof(filter_applied));
+    _lpm_tui_apply_facets(layout);
+}
+
+// Tabs are views over the same package list. The shown one lives in filter_applied, filter_rows,
+// rows, the facets and the layout, the others are parked in their slot and swapped back in. Their
+// rows are narrowed again only when the facets changed while they were parked, and filtered again
+// from their query when the package list was loaded anew.
+typedef struct
+{
+    char query[FILTER_TEXT_MAX_LEN];
+    char label[32]; // written when parked, the shown tab is described as it is drawn
+    LPM_Package_Rows filter_rows;
+    LPM_Package_Rows rows;
+    LPM_Facets_Selection selection;
+    size_t selected; // index of the hovered package in rows
+    bool reload;     // rows index a package list that is gone
+} LPM_TUI_Tab;
+static LPM_TUI_Tab tabs[LPM_TUI_MAX_TABS] = {0};
+static size_t tabs_count = 1;
+static size_t tabs_shown = 0; // its slot is empty
+
+static void _lpm_tui_tab_describe(char *buf, size_t size)
+{
+    char facets_text[128];
+    lpm_facets_describe(&facets, facets_text, sizeof(facets_text));
+    if (filter_applied[0] != '\0' && facets_text[0] != '\0')
+        snprintf(buf, size, "'%s' %s", filter_applied, facets_text);
+    else if (filter_applied[0] != '\0')
+        snprintf(buf, size, "'%s'", filter_applied);
+    else
+        snprintf(buf, size, "%s", facets_text[0] != '\0' ? facets_text : "all");
+}
+
+static void _lpm_tui_tab_show(LPM_TUI_Layout *layout, LPM_Packages *pkgs, size_t index)
+{
+    if (index == tabs_shown || index >= tabs_count)
+        return;
+    LPM_TUI_Tab *parked = &tabs[tabs_shown];
+    LPM_TUI_Tab *tab = &tabs[index];
+
+    _lpm_tui_tab_describe(parked->label, sizeof(parked->label));
+    memcpy(parked->query, filter_applied, sizeof(parked->query));
+    parked->filter_rows = filter_rows;
+    parked->rows = rows;
+    parked->selected = layout->packages_page_index * layout->packages_render_capacity +
+                       layout->packages_cursor_ypos;
+
+    memcpy(filter_applied, tab->query, sizeof(filter_applied));
+    memcpy(filter_text, tab->query, sizeof(filter_text));
+    filter_rows = tab->filter_rows;
+    rows = tab->rows;
+    bool stale = lpm_facets_swap_selection(&facets, &tab->selection);
+    parked->selection = tab->selection;
+    size_t selected = tab->selected;
+    bool reload = tab->reload;
+    *tab = (LPM_TUI_Tab){0};
+    tabs_shown = index;
+
+    if (reload)
+        _lpm_tui_apply_filter(layout, pkgs);
+    // pages follow the current layout, the terminal may have been resized in the meantime
+    _lpm_tui_select(layout, selected);
+    if (stale && !reload)
+        _lpm_tui_reapply_facets(layout);
+}
+
+// Open a tab with the whole package list and show it
+static void _lpm_tui_tab_open(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    if (tabs_count == LPM_TUI_MAX_TABS)
+    {
+        LPM_STATUS_MSG_SET_ERROR("No more tabs can be opened, close one with T");
+        return;
+    }
+    tabs_count++;
+    _lpm_tui_tab_show(layout, pkgs, tabs_count - 1);
+    lpm_packages_rows_all(&filter_rows, pkgs);
+    lpm_packages_rows_all(&rows, pkgs);
+    _lpm_tui_select(layout, 0);
+}
+
+// Close the shown tab, the one right of it takes its place
+static void _lpm_tui_tab_close(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    if (tabs_count == 1)
+        return;
+    size_t closed = tabs_shown;
+    _lpm_tui_tab_show(layout, pkgs, closed + 1 < tabs_count ? closed + 1 : closed - 1);
+    LPM_DA_FREE(tabs[closed].filter_rows);
+    LPM_DA_FREE(tabs[closed].rows);
+    LPM_DA_FREE(tabs[closed].selection.combined);
+    memmove(&tabs[closed], &tabs[closed + 1], (tabs_count - closed - 1) * sizeof(*tabs));
+    tabs_count--;
+    tabs[tabs_count] = (LPM_TUI_Tab){0};
+    if (tabs_shown > closed)
+        tabs_shown--;
+}
+
+// Show the view saved by the last session while the package list loads: its rows stand in for
+// pkgs, actions that need the whole list wait for the load
+static void _lpm_tui_session_restore(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    char *path = lpm_session_path();
+    LPM_Exit_Code result = lpm_session_load(&session, path);
+    LPM_FREE(path);
+    if (result != LPM_OK)
+    {
+        lpm_bitset_init(&marked, 0);
+        LPM_STATUS_MSG_SET_INFO("Loading the package list...");
+        return;
+    }
+
+    strncpy(filter_text, session.query, sizeof(filter_text) - 1);
+    memcpy(filter_applied, filter_text, sizeof(filter_applied));
+    facets.active = session.facets; // shown in the footer, the facets themselves are not built yet
+
+    *pkgs = session.view;
+    session.view = (LPM_Packages){0}; // session.marked and .repository still point into it
+    lpm_packages_measure(pkgs);
+    lpm_bitset_init(&marked, pkgs->count);
+    marked_count = 0;
+    marked_hash = 0;
+    for (size_t i = 0; i < session.marked.count; ++i)
+    {
+        for (size_t row = 0; row < pkgs->count; ++row)
+        {
+            if (strcmp(pkgs->items[row].name, session.marked.items[i]) != 0 ||
+                lpm_bitset_test(&marked, row))
+                continue;
+            lpm_bitset_set(&marked, row, true);
+            marked_count++;
+            marked_hash ^= lpm_preview_hash(pkgs->items[row].name);
+        }
+    }
+    lpm_packages_rows_all(&filter_rows, pkgs);
+    lpm_packages_rows_all(&rows, pkgs);
+    _lpm_tui_select(layout, session.selected - session.view_offset);
+    LPM_STATUS_MSG_SET_INFO("Restored the last session, loading the package list...");
+}
+
+// The package list arrived, take it over and rebuild the saved view on top of it
+static LPM_Exit_Code _lpm_tui_finish_loading(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    lpm_arena_release(LPM_ARENA_LOAD);
+    if (lpm_packages_fetch_report(loader.result) != LPM_OK)
+    {
+        if (!loaded)
+            return LPM_ERROR;
+        // a refresh, e.g. after updating everything, keeps the list it already has
+        lpm_loader_teardown(&loader);
+        LPM_STATUS_MSG_SET_ERROR("Failed to reload the package list, kept the current one");
+        return LPM_OK;
+    }
+
+    // the first load takes the selection of the saved session, a reload keeps the current one
+    uint32_t active = facets.active;
+    uint64_t generation = facets.generation;
+    const char *url = loaded ? lpm_facets_repository(&facets) : session.repository;
+    char *repository = url ? lpm_strdup(url) : NULL;
+    LPM_Session_Names remarked = session.marked;
+    if (loaded)
+    {
+        remarked = (LPM_Session_Names){0};
+        for (size_t row = 0; row < pkgs->count && marked_count > 0; ++row)
+        {
+            if (lpm_bitset_test(&marked, row))
+                LPM_DA_APPEND(&remarked, pkgs->items[row].name);
+        }
+    }
+
+    // the search history outlives the index it was typed against
+    memcpy(loader.filter.history, filter.history, sizeof(filter.history));
+    loader.filter.history_count = filter.history_count;
+    loader.filter.history_cursor = filter.history_count;
+    filter.history_count = 0;
+    lpm_filter_teardown(&filter);
+    filter = loader.filter;
+    loader.filter = (LPM_Filter){0};
+    lpm_facets_teardown(&facets);
+    facets = loader.facets;
+    loader.facets = (LPM_Facets){0};
+    facets.generation = generation + 1; // parked tabs combine their selection again
+    lpm_facets_restore(&facets, active, repository);
+    LPM_FREE(repository);
+
+    // marked packages are matched by pkgname like the hovered one
+    LPM_Package_Rows restored_marked = {0};
+    if (remarked.count > 0)
+    {
+        LPM_Package_Index index = {0};
+        lpm_packages_index_build(&index, &loader.pkgs);
+        for (size_t i = 0; i < remarked.count; ++i)
+        {
+            const char *pkgver = remarked.items[i];
+            size_t first, last;
+            lpm_packages_index_range(&index, pkgver, lpm_packages_pkgname_len(pkgver), &first,
+                                     &last);
+            if (first < last)
+                LPM_DA_APPEND(&restored_marked, index.items[first].row);
+        }
+        LPM_DA_FREE(index);
+    }
+    if (loaded)
+        LPM_DA_FREE(remarked);
+
+    // the cursor may have moved over the saved rows in the meantime
+    size_t capacity = layout->packages_render_capacity;
+    size_t selected = layout->packages_page_index * capacity + layout->packages_cursor_ypos;
+    if (selected < rows.count)
+        strncpy(session_cursor, pkgs->items[rows.items[selected]].name, sizeof(session_cursor) - 1);
+    selected += session.view_offset;
+    lpm_packages_teardown(pkgs); // the rows of the saved session, session strings die with it
+    *pkgs = loader.pkgs;
+    loader.pkgs = (LPM_Packages){0};
+    lpm_srcpkgs_teardown(&srcpkgs);
+    srcpkgs = loader.srcpkgs;
+    loader.srcpkgs = (LPM_Srcpkgs){0};
+    lpm_session_teardown(&session);
+    loaded = true;
+    for (size_t i = 0; i < tabs_count; ++i)
+        tabs[i].reload = i != tabs_shown;
+
+    lpm_bitset_init(&marked, pkgs->count);
+    marked_count = 0;
+    marked_hash = 0;
+    for (size_t i = 0; i < restored_marked.count; ++i)
+    {
+        if (!lpm_bitset_test(&marked, restored_marked.items[i]))
+            _lpm_tui_toggle_mark(pkgs, restored_marked.items[i]);
+    }
+    LPM_DA_FREE(restored_marked);
+
+    // the saved position is the fallback when the hovered package is gone
+    _lpm_tui_apply_filter(layout, pkgs);
+    _lpm_tui_select(layout, selected);
+    _lpm_tui_restore_cursor(layout, pkgs);
+    if (!(facets.active & (1u << LPM_FACET_UPGRADABLE)))
+        session_cursor[0] = '\0';
+
+    lpm_upgrades_start(&upgrades, pkgs);
+    lpm_pkgdb_watch_start(&pkgdb_watch, LPM_PKGDB_PATH);
+    return LPM_OK;
+}
+
+// Snapshot the view for the next launch. Quitting before the package list arrived leaves the last
+// snapshot alone, nothing could have changed it but the cursor.
+static void _lpm_tui_session_save(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+{
+    if (!loaded)
+        return;
+    LPM_Session snapshot = {
+        .facets = facets.active,
+        .repository = lpm_facets_repository(&facets),
+    };
+    memcpy(snapshot.query, filter_applied, sizeof(snapshot.query));
+
+    size_t selected = layout->packages_page_index * layout->packages_render_capacity +
+                      layout->packages_cursor_ypos;
+    snapshot.selected = selected < rows.count ? selected : 0;
+    size_t first = snapshot.selected > LPM_SESSION_MAX_ROWS / 2
+                       ? snapshot.selected - LPM_SESSION_MAX_ROWS / 2
+                       : 0;
+    size_t last = first + LPM_SESSION_MAX_ROWS < rows.count ? first + LPM_SESSION_MAX_ROWS
+                                                            : rows.count;
+    first = last > LPM_SESSION_MAX_ROWS ? last - LPM_SESSION_MAX_ROWS : 0;
+    snapshot.view_offset = first;
+    LPM_DA_RESERVE(&snapshot.view, last - first);
+    for (size_t i = first; i < last; ++i)
+        snapshot.view.items[snapshot.view.count++] = pkgs->items[rows.items[i]];
+    for (size_t row = 0; row < pkgs->count; ++row)
+    {
+        if (lpm_bitset_test(&marked, row))
+            LPM_DA_APPEND(&snapshot.marked, pkgs->items[row].name);
+    }
+
+    char *path = lpm_session_path();
+    lpm_session_save(&snapshot, path);
+    LPM_FREE(path);
+    lpm_session_teardown(&snapshot); // the strings belong to pkgs, only the arrays are freed
+}
 
 void lpm_tui_layout_setup(LPM_TUI_Layout *layout)
 {
+    layout->width = tb_width();
+    layout->height = tb_height();
     layout->min_xpos = 5;
-    layout->max_xpos = tb_width() - layout->min_xpos;
+    layout->max_xpos = layout->width - layout->min_xpos;
     layout->min_ypos = 1;
-    layout->max_ypos = tb_height() - layout->min_ypos;
+    layout->max_ypos = layout->height - layout->min_ypos;
     layout->header_xpos = layout->min_xpos;
     layout->header_ypos = layout->min_ypos;
-    layout->packages_xpos = layout->min_xpos;
-    layout->packages_ypos = 0;
-    layout->packages_cursor_ypos = 0;
-    layout->packages_page_index = 0;
-    layout->packages_total_pages = 1;
-    layout->packages_render_capacity = 0;
     layout->footer_xpos = layout->min_xpos;
     layout->footer_ypos = layout->max_ypos - 4;
+    // a terminal shrunk below MIN_HEIGHT still gets one row of packages, termbox clips the rest
+    if (layout->footer_ypos < layout->header_ypos + 4)
+        layout->footer_ypos = layout->header_ypos + 4;
+
+    layout->packages_xpos = layout->min_xpos;
+    layout->packages_ypos = layout->header_ypos + 2;
+    layout->packages_max_xpos = layout->max_xpos;
+    layout->packages_render_capacity = layout->footer_ypos - layout->packages_ypos - 1;
+
+    // wide terminals: the list keeps two thirds, the hovered package gets the rest
+    layout->details_xpos = 0;
+    layout->details_width = 0;
+    if (layout->width >= LPM_TUI_SPLIT_MIN_WIDTH)
+    {
+        int content_width = layout->max_xpos - layout->min_xpos;
+        layout->details_width = content_width / 3;
+        layout->details_xpos = layout->max_xpos - layout->details_width;
+        layout->packages_max_xpos = layout->details_xpos - 3; // a gap and the divider
+    }
 }
 
 void lpm_tui_layout_teardown(LPM_TUI_Layout *layout)
@@ -63,42 +955,226 @@ LPM_Exit_Code lpm_tui_setup(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
         return LPM_ERROR;
     }
 
+    // xbps is spawned while the TUI owns the terminal, keep termbox's descriptors to ourselves
+    lpm_process_set_cloexec_all();
+
     lpm_tui_layout_setup(layout);
-    result = lpm_packages_get(pkgs, NULL);
-    return result;
+    // the rest of the setup happens in _lpm_tui_finish_loading once the list is in
+    lpm_loader_start(&loader);
+    _lpm_tui_session_restore(layout, pkgs);
+    return LPM_OK;
 }
 
 void lpm_tui_teardown(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
 {
     tb_shutdown();
+    _lpm_tui_session_save(layout, pkgs);
     lpm_tui_layout_teardown(layout);
+    lpm_loader_teardown(&loader);
+    lpm_session_teardown(&session);
+    lpm_filter_teardown(&filter);
+    lpm_prefetch_teardown(&prefetch);
+    lpm_preview_teardown(&preview);
+    lpm_upgrades_teardown(&upgrades);
+    lpm_pkgdb_watch_teardown(&pkgdb_watch);
+    lpm_owners_teardown(&owners);
+    lpm_files_teardown(&files);
+    lpm_pkgcache_teardown(&pkgcache);
+    LPM_DA_FREE(cache_marked);
+    lpm_owners_matches_teardown(&owners_matches);
+    LPM_DA_FREE(marked);
+    lpm_facets_teardown(&facets);
+    LPM_DA_FREE(filter_rows);
+    LPM_DA_FREE(rows);
+    for (size_t i = 0; i < tabs_count; ++i)
+    {
+        LPM_DA_FREE(tabs[i].filter_rows);
+        LPM_DA_FREE(tabs[i].rows);
+        LPM_DA_FREE(tabs[i].selection.combined);
+    }
+    lpm_output_teardown(&output);
     lpm_packages_teardown(pkgs);
+    lpm_srcpkgs_teardown(&srcpkgs);
+    lpm_backend_teardown();
+    if (input_stats.frames > 0)
+        LPM_LOG_INFO("Handled %zu input events in %zu frames, up to %zu in one frame\n"
+                     "\tLag     : %.1f ms average, %.1f ms worst from reading an event to "
+                     "presenting it",
+                     input_stats.events, input_stats.frames, input_stats.max_batch,
+                     input_stats.lag_total_ms / input_stats.frames, input_stats.lag_max_ms);
+    lpm_alloc_teardown();
     lpm_log_dump_session();
 }
 
-void lpm_tui_run(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
+static double _lpm_tui_elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+LPM_Exit_Code lpm_tui_run(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
 {
     int timeout_ms = 50; // how long to wait for an event to be triggered
+    const double frame_ms = 1000.0 / LPM_TUI_MAX_FPS;
+    struct timespec batch_start, presented;
+    size_t batch = 0;
     while (1)
     {
+        if (lpm_loader_poll(&loader) && _lpm_tui_finish_loading(layout, pkgs) != LPM_OK)
+            return LPM_ERROR;
+        if (lpm_upgrades_poll(&upgrades))
+            _lpm_tui_apply_upgrades(layout, pkgs);
+        if (lpm_pkgdb_watch_poll(&pkgdb_watch))
+        {
+            _lpm_tui_refresh_installed(layout, pkgs);
+            owners_stale = true;
+            if (lpm_tui_mode == LPM_TUI_MODE_OWNERS)
+                _lpm_tui_owners_update();
+        }
+        if (lpm_owners_poll(&owners))
+            _lpm_tui_owners_finish_update();
+        if (lpm_pkgcache_poll(&pkgcache))
+            _lpm_tui_cache_finish_scan();
+        lpm_preview_poll(&preview); // the next frame finds the plan in the cache
+        if (lpm_files_poll(&files) && files.result != LPM_OK)
+            LPM_STATUS_MSG_SET_ERROR("Failed to list the files of the package, see the logs");
+        if (lpm_prefetch_active(&prefetch))
+        {
+            lpm_prefetch_poll(&prefetch);
+            if (!lpm_prefetch_active(&prefetch) && prefetch.downloaded > 0)
+            {
+                char *status_msg;
+                lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                                   "Prefetched %zu packages into the xbps cache",
+                                   prefetch.downloaded);
+                LPM_STATUS_MSG_SET_INFO(status_msg);
+            }
+        }
         lpm_tui_display(layout, pkgs);
         tb_present();
+        clock_gettime(CLOCK_MONOTONIC, &presented);
+        if (batch > 0)
+        {
+            double lag_ms = _lpm_tui_elapsed_ms(&batch_start, &presented);
+            input_stats.events += batch;
+            input_stats.frames++;
+            input_stats.lag_total_ms += lag_ms;
+            if (batch > input_stats.max_batch)
+                input_stats.max_batch = batch;
+            if (lag_ms > input_stats.lag_max_ms)
+                input_stats.lag_max_ms = lag_ms;
+            batch = 0;
+        }
+
+        struct tb_event evt;
+        int result = tb_peek_event(&evt, timeout_ms);
+        if (result == TB_ERR_NO_EVENT)
+            continue;
+        if (result == TB_ERR_POLL && tb_last_errno() == EINTR)
+            continue; // poll was interrupted, maybe by a SIGWINCH; try again
+        clock_gettime(CLOCK_MONOTONIC, &batch_start);
+
+        // Handle everything that is queued, and whatever arrives until the next frame is due,
+        // before rendering once. Rendering per event falls behind a held key on a slow link and
+        // the cursor keeps moving after the key is released.
+        while (result == TB_OK)
+        {
+            LPM_Exit_Code handled = lpm_tui_event_handler(&evt, layout, pkgs);
+            lpm_arena_reset(LPM_ARENA_COMMAND);
+            batch++;
+            if (handled != LPM_OK)
+                return LPM_OK;
+
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double wait_ms = frame_ms - _lpm_tui_elapsed_ms(&presented, &now);
+            result = tb_peek_event(&evt, wait_ms > 0 ? (int)wait_ms : 0);
+        }
+    }
+}
+
+// Keys acting on the whole package list, ignored while it is still loading
+static bool _lpm_tui_key_needs_packages(const struct tb_event *evt)
+{
+    if (evt->key == TB_KEY_ENTER)
+        return true;
+    return evt->ch > 0 && evt->ch < 128 && strchr("uxIAUOSR /Ct", (int)evt->ch) != NULL;
+}
 
-        struct tb_event evt;
-        int result = tb_peek_event(&evt, timeout_ms);
-        if (result == TB_ERR_NO_EVENT)
-            continue;
-        if (result == TB_ERR_POLL && tb_last_errno() == EINTR)
-            continue; // poll was interrupted, maybe by a SIGWINCH; try again
+// Keys of the owners screen, typing searches the index as you go
+static void _lpm_tui_owners_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout,
+                                          LPM_Packages *pkgs)
+{
+    if (evt->type != TB_EVENT_KEY)
+        return;
 
-        if (lpm_tui_event_handler(&evt, layout, pkgs) != LPM_OK)
-            break;
+    size_t len = strlen(owners_text);
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C)
+    {
+        lpm_tui_mode = LPM_TUI_MODE_MAIN;
+    }
+    else if (evt->key == TB_KEY_ENTER)
+    {
+        if (!loaded || owners_selected >= owners_matches.count)
+            return;
+        // show the owning package in the list, the filter matches its name
+        const char *pkgver = owners_matches.items[owners_selected].pkgver;
+        size_t name_len = lpm_packages_pkgname_len(pkgver);
+        if (name_len >= sizeof(filter_text))
+            return;
+        memset(filter_text, 0, sizeof(filter_text));
+        memcpy(filter_text, pkgver, name_len);
+        _lpm_tui_apply_filter(layout, pkgs);
+        lpm_filter_history_push(&filter, filter_text);
+        char *status_msg;
+        lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "%s is owned by %s",
+                           owners_matches.text.items + owners_matches.items[owners_selected].path,
+                           pkgver);
+        LPM_STATUS_MSG_SET_INFO(status_msg);
+        lpm_tui_mode = LPM_TUI_MODE_MAIN;
+    }
+    else if (evt->key == TB_KEY_ARROW_DOWN && owners_selected + 1 < owners_matches.count)
+    {
+        owners_selected++;
+        if (owners_selected >= owners_top + capacity)
+            owners_top = owners_selected - capacity + 1;
+    }
+    else if (evt->key == TB_KEY_ARROW_UP && owners_selected > 0)
+    {
+        owners_selected--;
+        if (owners_selected < owners_top)
+            owners_top = owners_selected;
+    }
+    else if (evt->key == TB_KEY_CTRL_U && len > 0)
+    {
+        memset(owners_text, 0, sizeof(owners_text));
+        _lpm_tui_owners_search();
+    }
+    else if ((evt->key == TB_KEY_BACKSPACE || evt->key == TB_KEY_BACKSPACE2) && len > 0)
+    {
+        owners_text[len - 1] = '\0';
+        _lpm_tui_owners_search();
+    }
+    else if (evt->ch > ' ' && evt->ch < 127 && len + 1 < sizeof(owners_text))
+    {
+        owners_text[len] = (char)evt->ch;
+        owners_text[len + 1] = '\0';
+        _lpm_tui_owners_search();
     }
 }
 
 LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout,
                                     LPM_Packages *pkgs)
 {
+    if (evt->type == TB_EVENT_RESIZE)
+    {
+        // the only time the layout changes, the hovered package stays hovered on the new pages
+        size_t selected = layout->packages_page_index * layout->packages_render_capacity +
+                          layout->packages_cursor_ypos;
+        lpm_tui_layout_setup(layout);
+        _lpm_tui_select(layout, selected);
+        return LPM_OK;
+    }
     if (lpm_tui_mode == LPM_TUI_MODE_FILTER)
     {
         size_t filter_text_len = strlen(filter_text);
@@ -114,30 +1190,34 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
             }
             else if (evt->key == TB_KEY_ENTER)
             {
-                LPM_Packages new_pkgs = {0};
-                uint8_t res = lpm_packages_get(&new_pkgs, filter_text);
-                if (res == LPM_OK)
+                // filtering runs over the already loaded package list, no xbps-query involved
+                _lpm_tui_apply_filter(layout, pkgs);
+                lpm_filter_history_push(&filter, filter_text);
+                if (filter_text_len > 0)
                 {
-                    // Transfer ownership of heap-allocated contents from new_pkgs to *pkgs
-                    lpm_packages_teardown(pkgs);
-                    *pkgs = new_pkgs;
-                    if (filter_text_len > 0)
-                    {
-                        char *status_msg;
-                        lpm_asprintf(&status_msg, "Showing results for '%s'", filter_text);
-                        LPM_STATUS_MSG_SET(status_msg);
-                        LPM_FREE(status_msg);
-                    }
-                    else
-                        LPM_STATUS_MSG_SET(NULL);
+                    char *status_msg;
+                    lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "Showing results for '%s'",
+                                       filter_text);
+                    LPM_STATUS_MSG_SET(status_msg);
                 }
                 else
-                {
-                    lpm_packages_teardown(&new_pkgs);
-                }
+                    LPM_STATUS_MSG_SET(NULL);
 
                 lpm_tui_mode = LPM_TUI_MODE_MAIN;
-                layout->packages_cursor_ypos = 0;
+            }
+            else if (evt->key == TB_KEY_ARROW_UP || evt->key == TB_KEY_ARROW_DOWN)
+            {
+                // recall a previous query, its results are usually still cached
+                const char *recalled = evt->key == TB_KEY_ARROW_UP
+                                           ? lpm_filter_history_prev(&filter)
+                                           : lpm_filter_history_next(&filter);
+                if (recalled)
+                {
+                    memset(filter_text, 0, sizeof(filter_text));
+                    strncpy(filter_text, recalled, sizeof(filter_text) - 1);
+                    filter_cursor_pos = strlen(filter_text);
+                    _lpm_tui_apply_filter(layout, pkgs);
+                }
             }
             else if (evt->key == TB_KEY_ARROW_LEFT && filter_cursor_pos > 0)
             {
@@ -200,6 +1280,26 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
         }
         return LPM_OK;
     }
+    if (lpm_tui_mode == LPM_TUI_MODE_OUTPUT || lpm_tui_mode == LPM_TUI_MODE_OUTPUT_SEARCH)
+    {
+        _lpm_tui_output_event_handler(evt, layout);
+        return LPM_OK;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_OWNERS)
+    {
+        _lpm_tui_owners_event_handler(evt, layout, pkgs);
+        return LPM_OK;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_FILES || lpm_tui_mode == LPM_TUI_MODE_FILES_FILTER)
+    {
+        _lpm_tui_files_event_handler(evt, layout);
+        return LPM_OK;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_CACHE)
+    {
+        _lpm_tui_cache_event_handler(evt, layout);
+        return LPM_OK;
+    }
     if (lpm_tui_mode == LPM_TUI_MODE_KEYBINDINGS)
     {
         switch (evt->type)
@@ -221,7 +1321,7 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
     }
 
     size_t items_remaining =
-        pkgs->count - layout->packages_page_index * layout->packages_render_capacity;
+        rows.count - layout->packages_page_index * layout->packages_render_capacity;
     size_t items_to_render = items_remaining < layout->packages_render_capacity
                                  ? items_remaining
                                  : layout->packages_render_capacity;
@@ -233,6 +1333,11 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
     case TB_EVENT_KEY:
         if (evt->key == TB_KEY_ESC || evt->key == TB_KEY_CTRL_C)
             return LPM_QUIT;
+        if (!loaded && _lpm_tui_key_needs_packages(evt))
+        {
+            LPM_STATUS_MSG_SET_INFO("Still loading the package list...");
+            return LPM_OK;
+        }
 
         if (evt->ch == 'H') // go to first page
         {
@@ -274,33 +1379,58 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
         {
             layout->packages_page_index--;
         }
-        else if (evt->key == TB_KEY_ENTER)
+        else if (evt->key == TB_KEY_ENTER && marked_count > 0)
+        {
+            // xbps holds the pkgdb lock while downloading, finished downloads stay cached
+            lpm_prefetch_cancel(&prefetch);
+            _lpm_tui_install_marked(layout, pkgs);
+        }
+        else if ((evt->key == TB_KEY_ENTER || evt->ch == ' ') &&
+                 curr_selected_pkg_idx < rows.count &&
+                 _lpm_tui_refuse_source(&pkgs->items[rows.items[curr_selected_pkg_idx]]))
         {
-            LPM_Package *pkg = &pkgs->items[curr_selected_pkg_idx];
+            // nothing xbps can install or mark, the status line says how to build it
+        }
+        else if (evt->key == TB_KEY_ENTER && curr_selected_pkg_idx < rows.count)
+        {
+            lpm_prefetch_cancel(&prefetch);
+            LPM_Package *pkg = &pkgs->items[rows.items[curr_selected_pkg_idx]];
             char *status_msg;
             if (strcmp(pkg->status, LPM_PACKAGE_STATUS_AVAILABLE) == 0)
-                lpm_asprintf(&status_msg, "Installing package '%s'... ", pkg->name);
+                lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "Installing package '%s'... ",
+                                   pkg->name);
             else
-                lpm_asprintf(&status_msg, "Updating package '%s'... ", pkg->name);
+                lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg, "Updating package '%s'... ",
+                                   pkg->name);
             LPM_STATUS_MSG_SET_INFO(status_msg);
-            LPM_FREE(status_msg);
-            lpm_packages_install(pkg);
+            LPM_TUI_Progress_Target target = {layout, pkgs};
+            LPM_Exit_Code res = lpm_packages_install(pkg, _lpm_tui_progress_start(&target));
+            if (res == LPM_OK || res == LPM_ERROR_PIPE_CLOSE)
+                lpm_facets_set_installed(&facets, rows.items[curr_selected_pkg_idx], true);
         }
         else if (evt->ch == 'u')
         {
             LPM_STATUS_MSG_SET_INFO("Updating all installed packages. This may take a moment...");
-            lpm_packages_update_all();
+            lpm_prefetch_cancel(&prefetch);
+            LPM_TUI_Progress_Target target = {layout, pkgs};
+            // the repositories were synced, load the list and its facets again in the background,
+            // the selection of every tab is kept. Upgrades are compared once it is in.
+            if (lpm_packages_update_all(_lpm_tui_progress_start(&target)) == LPM_OK)
+                lpm_loader_start(&loader);
         }
-        else if (evt->ch == 'x')
+        else if (evt->ch == 'x' && curr_selected_pkg_idx < rows.count)
         {
-            LPM_Package *pkg = &pkgs->items[curr_selected_pkg_idx];
+            LPM_Package *pkg = &pkgs->items[rows.items[curr_selected_pkg_idx]];
             if (strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0)
             {
                 char *status_msg;
-                lpm_asprintf(&status_msg, "Uninstalling package '%s'... ", pkg->name);
+                lpm_prefetch_cancel(&prefetch);
+                lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                                   "Uninstalling package '%s'... ", pkg->name);
                 LPM_STATUS_MSG_SET_INFO(status_msg);
-                LPM_FREE(status_msg);
-                lpm_packages_uninstall(pkg);
+                LPM_TUI_Progress_Target target = {layout, pkgs};
+                if (lpm_packages_uninstall(pkg, _lpm_tui_progress_start(&target)) == LPM_OK)
+                    lpm_facets_set_installed(&facets, rows.items[curr_selected_pkg_idx], false);
             }
         }
         else if (evt->ch == '/')
@@ -309,11 +1439,93 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
             filter_cursor_render_count = 0;
             filter_cursor_pos = 0;
             memset(filter_text, 0, sizeof(filter_text));
+            lpm_filter_history_rewind(&filter);
         }
         else if (evt->ch == '?')
         {
             lpm_tui_mode = LPM_TUI_MODE_KEYBINDINGS;
         }
+        else if (evt->ch == 'o')
+        {
+            lpm_tui_mode = LPM_TUI_MODE_OUTPUT;
+        }
+        else if (evt->ch == 'f' && curr_selected_pkg_idx < rows.count)
+        {
+            LPM_Package *pkg = &pkgs->items[rows.items[curr_selected_pkg_idx]];
+            if (strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) != 0)
+            {
+                char *status_msg;
+                lpm_arena_asprintf(LPM_ARENA_COMMAND, &status_msg,
+                                   "Package '%s' is not installed, it has no files yet", pkg->name);
+                LPM_STATUS_MSG_SET_ERROR(status_msg);
+            }
+            else
+            {
+                // the list of the package shown last is kept, so is its filter
+                if (strcmp(files.pkgver, pkg->name) != 0 || files.result != LPM_OK)
+                {
+                    lpm_files_start(&files, LPM_PKGDB_PATH, pkg->name);
+                    files_query[0] = '\0';
+                    files_top = 0;
+                }
+                lpm_tui_mode = LPM_TUI_MODE_FILES;
+            }
+        }
+        else if (evt->ch == 'c')
+        {
+            // the last scan is reused as long as neither the cache nor the pkgdb changed
+            lpm_tui_mode = LPM_TUI_MODE_CACHE;
+            lpm_pkgcache_start(&pkgcache, LPM_PKGCACHE_DIR, LPM_PKGDB_PATH);
+        }
+        else if (evt->ch == 'w')
+        {
+            lpm_tui_mode = LPM_TUI_MODE_OWNERS;
+            _lpm_tui_owners_update();
+        }
+        else if (evt->ch == 'I' || evt->ch == 'A' || evt->ch == 'U' || evt->ch == 'O' ||
+                 evt->ch == 'S')
+        {
+            // facets only combine precomputed bitsets, no xbps command is run here
+            LPM_Facet facet = evt->ch == 'I'   ? LPM_FACET_INSTALLED
+                              : evt->ch == 'A' ? LPM_FACET_AVAILABLE
+                              : evt->ch == 'U' ? LPM_FACET_UPGRADABLE
+                              : evt->ch == 'O' ? LPM_FACET_ORPHAN
+                                               : LPM_FACET_SOURCE;
+            lpm_facets_toggle(&facets, facet);
+            _lpm_tui_apply_facets(layout);
+        }
+        else if (evt->ch == 'R')
+        {
+            lpm_facets_cycle_repository(&facets);
+            _lpm_tui_apply_facets(layout);
+        }
+        else if (evt->key == TB_KEY_TAB || evt->key == TB_KEY_BACK_TAB)
+        {
+            // switching swaps the parked rows in, nothing is filtered again
+            size_t step = evt->key == TB_KEY_TAB ? 1 : tabs_count - 1;
+            _lpm_tui_tab_show(layout, pkgs, (tabs_shown + step) % tabs_count);
+        }
+        else if (evt->ch >= '1' && evt->ch <= '9')
+        {
+            _lpm_tui_tab_show(layout, pkgs, evt->ch - '1');
+        }
+        else if (evt->ch == 't')
+        {
+            _lpm_tui_tab_open(layout, pkgs);
+        }
+        else if (evt->ch == 'T')
+        {
+            _lpm_tui_tab_close(layout, pkgs);
+        }
+        else if (evt->ch == ' ' && curr_selected_pkg_idx < rows.count)
+        {
+            _lpm_tui_toggle_mark(pkgs, rows.items[curr_selected_pkg_idx]);
+        }
+        else if (evt->ch == 'C' && lpm_prefetch_active(&prefetch))
+        {
+            lpm_prefetch_cancel(&prefetch);
+            LPM_STATUS_MSG_SET_INFO("Cancelled downloading packages in the background");
+        }
         break;
     case TB_EVENT_RESIZE:
         break;
@@ -325,8 +1537,205 @@ LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout
     return LPM_OK;
 }
 
+// The plan of the transaction enter would start: the marked packages, or the hovered one. An
+// installed package that is up to date previews what x does instead. Resolved by xbps in the
+// background, NULL until then. Flipping back to a selection previewed before reuses its plan.
+static const LPM_Preview_Plan *_lpm_tui_preview(LPM_TUI_Layout *layout, LPM_Packages *pkgs,
+                                                LPM_Preview_Kind *kind, bool *pending)
+{
+    *kind = LPM_PREVIEW_INSTALL;
+    *pending = false;
+    if (!loaded)
+        return NULL;
+    uint64_t selection = marked_hash;
+    const char *hovered = NULL;
+    if (marked_count == 0)
+    {
+        size_t selected = layout->packages_page_index * layout->packages_render_capacity +
+                          layout->packages_cursor_ypos;
+        if (selected >= rows.count)
+            return NULL;
+        uint32_t row = rows.items[selected];
+        const LPM_Package *pkg = &pkgs->items[row];
+        if (strcmp(pkg->status, LPM_PACKAGE_STATUS_SOURCE) == 0)
+            return NULL;
+        const LPM_Bitset *upgradable = &facets.sets[LPM_FACET_UPGRADABLE];
+        bool upgrade = row / 64 < upgradable->count && lpm_bitset_test(upgradable, row);
+        if (strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0 && !upgrade)
+            *kind = LPM_PREVIEW_REMOVE;
+        hovered = pkg->name;
+        selection = lpm_preview_hash(hovered);
+    }
+
+    uint64_t key = lpm_preview_key(*kind, selection);
+    const LPM_Preview_Plan *plan = lpm_preview_find(&preview, LPM_PKGDB_PATH, key);
+    if (plan != NULL)
+        return plan;
+    *pending = true;
+    if (lpm_preview_pending(&preview, key))
+        return NULL;
+    if (hovered)
+    {
+        lpm_preview_start(&preview, key, *kind, &hovered, 1);
+        return NULL;
+    }
+    const char **pkgvers = lpm_arena_alloc(LPM_ARENA_FRAME, marked_count * sizeof(*pkgvers));
+    size_t count = 0;
+    for (size_t row = 0; row < pkgs->count && count < marked_count; ++row)
+    {
+        if (lpm_bitset_test(&marked, row))
+            pkgvers[count++] = pkgs->items[row].name;
+    }
+    lpm_preview_start(&preview, key, *kind, pkgvers, count);
+    return NULL;
+}
+
+// Below the details: what the previewed transaction would install, update and remove
+static void _lpm_tui_display_plan(LPM_TUI_Layout *layout, const LPM_Preview_Plan *plan,
+                                  LPM_Preview_Kind kind, bool pending, int ypos)
+{
+    int xpos = layout->details_xpos;
+    int width = layout->details_width;
+    int bottom = layout->footer_ypos - 1;
+    if (ypos + 2 >= bottom || (plan == NULL && !pending))
+        return;
+    const char *title = marked_count > 0            ? "enter (marked)"
+                        : kind == LPM_PREVIEW_REMOVE ? "x"
+                                                     : "enter";
+    tb_printf(xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR, "%s would", title);
+    ypos++;
+    if (plan == NULL)
+    {
+        tb_printf(xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR, "resolving with xbps...");
+        return;
+    }
+    if (plan->result != LPM_OK)
+    {
+        tb_printf(xpos, ypos, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s", width,
+                  plan->error ? plan->error : "fail, see the logs");
+        return;
+    }
+    if (plan->steps.count == 0)
+    {
+        tb_printf(xpos, ypos, LPM_FG_COLOR, LPM_BG_COLOR, "do nothing, already done");
+        return;
+    }
+
+    char *temp;
+    lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "install %zu, update %zu, remove %zu",
+                       plan->installs, plan->updates, plan->removes);
+    tb_printf(xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s", width, temp);
+    char download[32], installed[32];
+    _lpm_tui_format_bytes(plan->download_bytes, download, sizeof(download));
+    if (plan->kind == LPM_PREVIEW_REMOVE)
+    {
+        _lpm_tui_format_bytes(plan->freed_bytes, installed, sizeof(installed));
+        lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "frees %s", installed);
+    }
+    else
+    {
+        _lpm_tui_format_bytes(plan->installed_bytes, installed, sizeof(installed));
+        lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "download %s, installed %s", download,
+                           installed);
+    }
+    tb_printf(xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s", width, temp);
+    ypos++;
+
+    for (size_t i = 0; i < plan->steps.count && ypos < bottom; ++i)
+    {
+        const LPM_Preview_Step *step = &plan->steps.items[i];
+        if (ypos + 1 == bottom && i + 1 < plan->steps.count)
+        {
+            tb_printf(xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR, "and %zu more",
+                      plan->steps.count - i);
+            break;
+        }
+        tb_printf(xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR, "%.*s", width, step->action);
+        tb_printf(xpos + 10, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s",
+                  width > 10 ? width - 10 : 0, step->pkgver);
+    }
+}
+
+// What is known about row without asking xbps, in the pane right of the packages list
+static void _lpm_tui_display_details(LPM_TUI_Layout *layout, LPM_Packages *pkgs, uint32_t row,
+                                     const LPM_Preview_Plan *plan, LPM_Preview_Kind kind,
+                                     bool pending)
+{
+    const LPM_Package *pkg = &pkgs->items[row];
+    int xpos = layout->details_xpos;
+    int ypos = layout->packages_ypos;
+    int width = layout->details_width;
+    int bottom = layout->footer_ypos - 1;
+    for (int y = ypos; y < bottom; ++y)
+        tb_set_cell(xpos - 2, y, 0x2502, LPM_FG_COLOR_DIM, LPM_BG_COLOR);
+
+    int name_len = (int)lpm_packages_pkgname_len(pkg->name);
+    const char *version = pkg->name[name_len] == '-' ? pkg->name + name_len + 1 : "";
+    tb_printf(xpos, ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR_HIGHLIGHT, " %.*s ",
+              name_len < width - 2 ? name_len : width - 2, pkg->name);
+    ypos += 2;
+
+    const char *status = strcmp(pkg->status, LPM_PACKAGE_STATUS_INSTALLED) == 0 ? "installed"
+                         : strcmp(pkg->status, LPM_PACKAGE_STATUS_SOURCE) == 0  ? "source"
+                                                                                : "available";
+    // the facets are not built while a restored session stands in for the package list
+    const char *repository = "";
+    for (size_t i = 0; i < facets.count; ++i)
+    {
+        const LPM_Bitset *rows_of = &facets.items[i].rows;
+        if (row / 64 < rows_of->count && lpm_bitset_test(rows_of, row))
+        {
+            repository = facets.items[i].url;
+            break;
+        }
+    }
+    const LPM_Bitset *upgradable = &facets.sets[LPM_FACET_UPGRADABLE];
+    bool upgrade = row / 64 < upgradable->count && lpm_bitset_test(upgradable, row);
+    bool is_marked = row / 64 < marked.count && lpm_bitset_test(&marked, row);
+
+    const char *labels[] = {"version", "status", "repository", "upgrade", "marked"};
+    const char *values[] = {version, status, repository, upgrade ? "available" : "",
+                            is_marked ? "yes" : ""};
+    int label_width = (int)strlen("repository") + 1;
+    for (size_t i = 0; i < sizeof(labels) / sizeof(*labels) && ypos < bottom; ++i)
+    {
+        if (values[i][0] == '\0')
+            continue;
+        tb_printf(xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR, "%s", labels[i]);
+        tb_printf(xpos + label_width, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s",
+                  width - label_width, values[i]);
+    }
+    ypos++;
+
+    // word wrapped, a word longer than the pane is cut where the pane ends
+    const char *p = pkg->description;
+    while (*p != '\0' && ypos < bottom)
+    {
+        size_t offset = p - pkg->description;
+        size_t ascii = offset < pkg->description_ascii ? pkg->description_ascii - offset : 0;
+        size_t taken_width;
+        size_t take = lpm_packages_text_cut(p, ascii, width, &taken_width);
+        if (take == 0)
+            break; // a wide character in a pane of one column
+        if (p[take] != '\0')
+        {
+            size_t cut = take;
+            while (cut > 0 && p[cut] != ' ')
+                cut--;
+            if (cut > 0)
+                take = cut;
+        }
+        tb_printf(xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s", (int)take, p);
+        p += take;
+        while (*p == ' ')
+            p++;
+    }
+    _lpm_tui_display_plan(layout, plan, kind, pending, ypos + 1);
+}
+
 void lpm_tui_display(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
 {
+    lpm_arena_reset(LPM_ARENA_FRAME);
     tb_clear();
 
     if (lpm_tui_mode == LPM_TUI_MODE_KEYBINDINGS)
@@ -334,8 +1743,28 @@ void lpm_tui_display(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
         lpm_tui_display_keybindings_screen(layout);
         return;
     }
+    if (lpm_tui_mode == LPM_TUI_MODE_OUTPUT || lpm_tui_mode == LPM_TUI_MODE_OUTPUT_SEARCH)
+    {
+        lpm_tui_display_output_screen(layout);
+        return;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_OWNERS)
+    {
+        lpm_tui_display_owners_screen(layout);
+        return;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_FILES || lpm_tui_mode == LPM_TUI_MODE_FILES_FILTER)
+    {
+        lpm_tui_display_files_screen(layout);
+        return;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_CACHE)
+    {
+        lpm_tui_display_cache_screen(layout);
+        return;
+    }
 
-    // temp buffer to concatenate text together for displaying
+    // temp buffer to concatenate text together for displaying, lives until the next frame
     char *temp = NULL;
     size_t temp_len = 0;
 
@@ -357,8 +1786,8 @@ void lpm_tui_display(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
         header_text = " FILTER ";
         tb_printf(layout->header_xpos, layout->header_ypos, LPM_FG_COLOR_BLACK_DIM,
                   LPM_BG_COLOR_HIGHLIGHT_FILTER, header_text);
-        tb_printf(layout->header_xpos + strlen(header_text) + 1, layout->header_ypos, LPM_FG_COLOR,
-                  LPM_BG_COLOR, filter_text);
+        tb_print(layout->header_xpos + strlen(header_text) + 1, layout->header_ypos, LPM_FG_COLOR,
+                 LPM_BG_COLOR, filter_text);
         if (filter_cursor)
         {
             tb_set_cell(layout->header_xpos + strlen(header_text) + 1 + filter_cursor_pos,
@@ -377,82 +1806,161 @@ void lpm_tui_display(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
 
     lpm_status_msg_display(false);
 
+    //
+    // tabs, in the gap above the packages list once there is more than one
+    //
+
+    int tab_xpos = layout->packages_xpos;
+    for (size_t i = 0; i < tabs_count && tabs_count > 1 && tab_xpos < layout->max_xpos; ++i)
+    {
+        char label[sizeof(tabs[i].label)];
+        if (i == tabs_shown)
+            _lpm_tui_tab_describe(label, sizeof(label));
+        else
+            memcpy(label, tabs[i].label, sizeof(label));
+        temp_len = lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, " %zu %s ", i + 1, label);
+        if (i == tabs_shown)
+            tb_print(tab_xpos, layout->header_ypos + 1, LPM_FG_COLOR_BLACK_DIM,
+                     LPM_BG_COLOR_HIGHLIGHT, temp);
+        else
+            tb_print(tab_xpos, layout->header_ypos + 1, LPM_FG_COLOR_DIM, LPM_BG_COLOR, temp);
+        tab_xpos += temp_len + 1;
+    }
+
     //
     // packages
     //
 
-    layout->packages_ypos = layout->header_ypos + 2;
-    uint8_t max_line_len = layout->max_xpos - layout->min_xpos;
-    uint8_t longest_package_name_len = 0;
-    layout->packages_render_capacity = layout->footer_ypos - layout->packages_ypos - 1;
+    // the geometry is cached in layout and only changes on resize, the page count follows rows
+    int ypos = layout->packages_ypos;
+    int max_line_len = layout->packages_max_xpos - layout->packages_xpos;
+    int longest_package_name_len = 0;
     layout->packages_total_pages =
-        (pkgs->count + layout->packages_render_capacity - 1) / layout->packages_render_capacity;
+        (rows.count + layout->packages_render_capacity - 1) / layout->packages_render_capacity;
+    if (layout->packages_total_pages == 0)
+        layout->packages_total_pages = 1;
+    if (layout->packages_page_index >= layout->packages_total_pages)
+        layout->packages_page_index = layout->packages_total_pages - 1;
 
     size_t items_remaining =
-        pkgs->count - layout->packages_page_index * layout->packages_render_capacity;
+        rows.count - layout->packages_page_index * layout->packages_render_capacity;
     size_t items_to_render = items_remaining < layout->packages_render_capacity
                                  ? items_remaining
                                  : layout->packages_render_capacity;
 
     if (layout->packages_cursor_ypos >= items_to_render)
-        layout->packages_cursor_ypos = items_to_render - 1;
+        layout->packages_cursor_ypos = items_to_render > 0 ? items_to_render - 1 : 0;
 
+    // widths were measured at load, a row is laid out without scanning its text
     for (size_t i = 0; i < items_to_render; ++i)
     {
         size_t idx = layout->packages_page_index * layout->packages_render_capacity + i;
-        LPM_Package pkg = pkgs->items[idx];
-        if (strlen(pkg.name) > longest_package_name_len)
-            longest_package_name_len = strlen(pkg.name);
+        int name_width = pkgs->items[rows.items[idx]].name_width;
+        if (name_width > longest_package_name_len)
+            longest_package_name_len = name_width;
     }
+    // "[*] name description", the description gets what the longest name leaves over
+    int description_columns = max_line_len - (int)strlen(LPM_PACKAGE_STATUS_INSTALLED) - 2 -
+                              longest_package_name_len;
     for (size_t i = 0; i < layout->packages_render_capacity; ++i)
     {
         if (i >= items_to_render)
             break;
 
-        size_t idx = layout->packages_page_index * layout->packages_render_capacity + i;
-        lpm_asprintf(&temp, "%s %-*s %s", pkgs->items[idx].status, longest_package_name_len,
-                     pkgs->items[idx].name, pkgs->items[idx].description);
-
-        temp_len = strlen(temp);
-        if (temp_len >= max_line_len)
+        size_t idx = rows.items[layout->packages_page_index * layout->packages_render_capacity + i];
+        const LPM_Package *pkg = &pkgs->items[idx];
+        size_t description_len = SIZE_MAX; // all of it
+        size_t description_width = pkg->description_width;
+        const char *ellipsis = "";
+        if (description_columns <= 3)
+        {
+            description_len = 0;
+            description_width = 0;
+        }
+        else if (pkg->description_width > description_columns)
         {
-            temp[max_line_len - 3] = '.';
-            temp[max_line_len - 2] = '.';
-            temp[max_line_len - 1] = '.';
-            temp[max_line_len] = '\0';
+            description_len = lpm_packages_text_cut(pkg->description, pkg->description_ascii,
+                                                    description_columns - 3, &description_width);
+            description_width += 3;
+            ellipsis = "...";
         }
+        lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%s %s%*s %.*s%s", pkg->status, pkg->name,
+                           longest_package_name_len - pkg->name_width, "",
+                           description_len > INT_MAX ? INT_MAX : (int)description_len,
+                           pkg->description, ellipsis);
+        // in columns, the bytes of temp may be more
+        temp_len = strlen(LPM_PACKAGE_STATUS_INSTALLED) + 2 + longest_package_name_len +
+                   description_width;
 
         if (lpm_tui_mode == LPM_TUI_MODE_MAIN && i == layout->packages_cursor_ypos)
         {
-            tb_printf(layout->packages_xpos, layout->packages_ypos, LPM_FG_COLOR_BLACK_DIM,
-                      LPM_BG_COLOR_HIGHLIGHT, temp);
-            for (int j = layout->packages_xpos + temp_len - 1; j < layout->max_xpos; ++j)
+            tb_print(layout->packages_xpos, ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR_HIGHLIGHT,
+                     temp);
+            for (int j = layout->packages_xpos + temp_len; j < layout->packages_max_xpos; ++j)
             {
                 // highlight remaining cells of the hovered package row
-                tb_set_cell(j, layout->packages_ypos, ' ', LPM_FG_COLOR, LPM_BG_COLOR_HIGHLIGHT);
+                tb_set_cell(j, ypos, ' ', LPM_FG_COLOR, LPM_BG_COLOR_HIGHLIGHT);
             }
         }
         else
         {
-            tb_printf(layout->packages_xpos, layout->packages_ypos, LPM_FG_COLOR, LPM_BG_COLOR,
-                      temp);
+            uintattr_t fg = lpm_bitset_test(&marked, idx) ? LPM_FG_COLOR_MARKED : LPM_FG_COLOR;
+            tb_print(layout->packages_xpos, ypos, fg, LPM_BG_COLOR, temp);
         }
-        LPM_FREE(temp);
-        layout->packages_ypos++;
+        ypos++;
     }
 
+    size_t curr_selected_pkg_idx = layout->packages_page_index * layout->packages_render_capacity +
+                                   layout->packages_cursor_ypos;
+    LPM_Preview_Kind plan_kind;
+    bool plan_pending;
+    const LPM_Preview_Plan *plan = _lpm_tui_preview(layout, pkgs, &plan_kind, &plan_pending);
+    if (layout->details_width > 0 && curr_selected_pkg_idx < rows.count)
+        _lpm_tui_display_details(layout, pkgs, rows.items[curr_selected_pkg_idx], plan, plan_kind,
+                                 plan_pending);
+
     //
     // footer
     //
 
-    if (temp)
-        LPM_FREE(temp);
-    lpm_asprintf(&temp, "Page %zu of %zu (%zu) | ", layout->packages_page_index + 1,
-                 layout->packages_total_pages, pkgs->count);
-    temp_len = strlen(temp);
-
-    tb_printf(layout->footer_xpos, layout->footer_ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR, temp);
-    LPM_FREE(temp);
+    char footer_text[256] = {0};
+    size_t footer_len = 0;
+    if (lpm_facets_any_active(&facets))
+    {
+        char facets_text[128];
+        lpm_facets_describe(&facets, facets_text, sizeof(facets_text));
+        footer_len += snprintf(footer_text + footer_len, sizeof(footer_text) - footer_len,
+                               " [%s]", facets_text);
+    }
+    if (!loaded && footer_len < sizeof(footer_text))
+        footer_len +=
+            snprintf(footer_text + footer_len, sizeof(footer_text) - footer_len, " [loading]");
+    if (marked_count > 0 && footer_len < sizeof(footer_text))
+        footer_len += snprintf(footer_text + footer_len, sizeof(footer_text) - footer_len,
+                               " [%zu marked]", marked_count);
+    if (layout->details_width == 0 && plan && plan->result == LPM_OK && plan->steps.count > 0 &&
+        footer_len < sizeof(footer_text))
+    {
+        // no pane to list the plan in, its sizes still fit
+        char download[32];
+        _lpm_tui_format_bytes(plan->kind == LPM_PREVIEW_REMOVE ? plan->freed_bytes
+                                                               : plan->download_bytes,
+                              download, sizeof(download));
+        footer_len += snprintf(footer_text + footer_len, sizeof(footer_text) - footer_len,
+                               " [%zu packages, %s %s]", plan->steps.count,
+                               plan->kind == LPM_PREVIEW_REMOVE ? "frees" : "download", download);
+    }
+    if (lpm_prefetch_active(&prefetch) && footer_len < sizeof(footer_text))
+    {
+        char prefetch_text[64];
+        lpm_prefetch_describe(&prefetch, prefetch_text, sizeof(prefetch_text));
+        snprintf(footer_text + footer_len, sizeof(footer_text) - footer_len, " [%s]",
+                 prefetch_text);
+    }
+    temp_len = lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "Page %zu of %zu (%zu)%s | ",
+                                  layout->packages_page_index + 1, layout->packages_total_pages,
+                                  rows.count, footer_text);
+    tb_print(layout->footer_xpos, layout->footer_ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR, temp);
 
     tb_printf(layout->footer_xpos + temp_len, layout->footer_ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
               "/k");
@@ -479,16 +1987,16 @@ void lpm_tui_display(LPM_TUI_Layout *layout, LPM_Packages *pkgs)
               LPM_BG_COLOR, "previous");
     temp_len = 0;
 
-    uint8_t footer_ypos = layout->footer_ypos + 2;
-    size_t curr_selected_pkg_idx = layout->packages_page_index * layout->packages_render_capacity +
-                                   layout->packages_cursor_ypos;
+    int footer_ypos = layout->footer_ypos + 2;
 
     if (lpm_tui_mode == LPM_TUI_MODE_MAIN)
     {
         tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
                   "enter");
         temp_len += strlen("enter");
-        if (strcmp(pkgs->items[curr_selected_pkg_idx].status, LPM_PACKAGE_STATUS_INSTALLED) == 0)
+        if (curr_selected_pkg_idx < rows.count &&
+            strcmp(pkgs->items[rows.items[curr_selected_pkg_idx]].status,
+                   LPM_PACKAGE_STATUS_INSTALLED) == 0)
         {
             tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_BLACK_DIM,
                       LPM_BG_COLOR, " update ");
@@ -559,69 +2067,107 @@ void lpm_tui_display_keybindings_screen(LPM_TUI_Layout *layout)
               LPM_BG_COLOR_HIGHLIGHT_HELP, header_text);
     lpm_status_msg_set_position(layout->header_xpos + strlen(header_text) + 1, layout->header_ypos);
 
-    layout->packages_ypos = layout->header_ypos + 2;
+    int ypos = layout->header_ypos + 2;
 
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR,
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR,
               "escape (ctrl + c) : Exit current mode. If in LAZYPM mode, terminate program");
 
     // Lazypm (Main) Mode keybindings
 
     size_t longest_keybinding_strlen = strlen("enter");
-    layout->packages_ypos++;
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR_BLACK_DIM,
+    ypos++;
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR_BLACK_DIM,
               LPM_BG_COLOR_HIGHLIGHT, " LAZYPM ");
-    layout->packages_ypos++;
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    ypos++;
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "h ()", ": Go to previous page");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "l ()", ": Go to next page");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "j ()", ": Go to next package");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "k ()", ": Go to previous package");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "H", ": Go to first page of packages");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "L", ": Go to last page of packages");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "J", ": Go to first package of current page");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "K", ": Go to last package of current page");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
-              longest_keybinding_strlen, "enter", ": install or update selected package");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "enter",
+              ": install or update marked packages, or the selected one if none are marked");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "space",
+              ": mark selected package, marked packages are downloaded in the background");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "u", ": update all installed packages");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "x", ": uninstall selected package if installed already");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "/", ": enter filter mode");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "I", ": toggle showing installed packages only");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "A", ": toggle showing available packages only");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "U", ": toggle showing upgradable packages only");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "O", ": toggle showing orphaned packages only");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "S",
+              ": toggle showing source packages of a void-packages checkout only");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "R", ": cycle through repositories");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "C", ": cancel downloading packages in the background");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "t",
+              ": open a tab with all packages, T closes the shown one");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "tab", ": switch to the next tab, 1-9 to a given one");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "o",
+              ": view output of install, update and uninstall commands, / searches it");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "f",
+              ": list the files of the selected package if installed, / filters them");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "w",
+              ": find the package owning a file, e.g. /usr/bin/vi or libssl.so");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "c",
+              ": show what the package cache holds and purge old or uninstalled packages");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "?", ": view list of all keybindings");
 
     // Filter Mode keybindings
 
     longest_keybinding_strlen = strlen("backspace");
-    layout->packages_ypos++;
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR_BLACK_DIM,
+    ypos++;
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR_BLACK_DIM,
               LPM_BG_COLOR_HIGHLIGHT_FILTER, " FILTER ");
-    layout->packages_ypos++;
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    ypos++;
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "enter", ": Query for packages with given input");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "        ", ": Move cursor left one position");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "        ", ": Move cursor right one position");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "ctrl + a", ": Mover cursor to the beginning of input");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "ctrl + e", ": Mover cursor to the end of input");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "ctrl + u",
               ": Delete text from cursor position to the beginning of input");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "backspace", ": Delete character left of cursor position");
-    tb_printf(layout->packages_xpos, layout->packages_ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
               longest_keybinding_strlen, "delete", ": Delete character right of cursor position");
+    tb_printf(layout->packages_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%-*s %s",
+              longest_keybinding_strlen, "       ", ": Recall previous/next query");
 
     // Footer
 
@@ -632,6 +2178,325 @@ void lpm_tui_display_keybindings_screen(LPM_TUI_Layout *layout)
               LPM_BG_COLOR, " back");
 }
 
+void lpm_tui_display_output_screen(LPM_TUI_Layout *layout)
+{
+    char *header_text = " OUTPUT ";
+    tb_printf(layout->header_xpos, layout->header_ypos, LPM_FG_COLOR_BLACK_DIM,
+              LPM_BG_COLOR_HIGHLIGHT_FILTER, header_text);
+    size_t status_xpos = layout->header_xpos + strlen(header_text) + 1;
+    if (lpm_tui_mode == LPM_TUI_MODE_OUTPUT_SEARCH)
+    {
+        tb_printf(status_xpos, layout->header_ypos, LPM_FG_COLOR, LPM_BG_COLOR, "/%s",
+                  output_search_text);
+        status_xpos += strlen(output_search_text) + 1;
+        tb_set_cell(status_xpos, layout->header_ypos, ' ', LPM_FG_COLOR_BLACK_DIM,
+                    LPM_BG_COLOR_HIGHLIGHT_FILTER);
+        status_xpos += 2;
+    }
+    lpm_status_msg_set_position(status_xpos, layout->header_ypos);
+    lpm_status_msg_display(false);
+
+    size_t count = lpm_output_count(&output);
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    if (output_follow)
+        output_top = count > capacity ? count - capacity : 0;
+    else if (output_top >= count)
+        output_top = count > 0 ? count - 1 : 0;
+
+    int ypos = layout->header_ypos + 2;
+    size_t max_line_len = layout->max_xpos - layout->min_xpos;
+    char line[LPM_OUTPUT_LINE_MAX + 1];
+    for (size_t i = output_top; i < count && i < output_top + capacity; ++i)
+    {
+        size_t len = lpm_output_line(&output, i, line, sizeof(line));
+        if (len > max_line_len)
+            len = max_line_len;
+        for (size_t j = 0; j < len; ++j)
+        {
+            // xbps may print tabs or escape sequences, keep one cell per byte
+            if ((unsigned char)line[j] < ' ' || line[j] == 127)
+                line[j] = ' ';
+        }
+        line[len] = '\0';
+        if (i == output_match)
+            tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR_HIGHLIGHT_FILTER,
+                      "%s", line);
+        else
+            tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR, LPM_BG_COLOR, "%s", line);
+        ypos++;
+    }
+    if (count == 0)
+        tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  "Nothing yet, install, update or uninstall a package first");
+
+    char *temp;
+    size_t last = output_top + capacity < count ? output_top + capacity : count;
+    lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "Line %zu-%zu of %zu%s", count ? output_top + 1 : 0,
+                       last, count, output_follow ? " [following]" : "");
+    tb_print(layout->footer_xpos, layout->footer_ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR, temp);
+
+    static const char *keybindings[][2] = {
+        {"j/k", " scroll "},
+        {"h/l", " page "},
+        {"/", " search "},
+        {"n/N", " next/previous match "},
+        {"esc", " back"},
+    };
+    size_t temp_len = 0;
+    int footer_ypos = layout->footer_ypos + 2;
+    for (size_t i = 0; i < sizeof(keybindings) / sizeof(*keybindings); ++i)
+    {
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  keybindings[i][0]);
+        temp_len += strlen(keybindings[i][0]);
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_BLACK_DIM,
+                  LPM_BG_COLOR, keybindings[i][1]);
+        temp_len += strlen(keybindings[i][1]);
+    }
+}
+
+void lpm_tui_display_files_screen(LPM_TUI_Layout *layout)
+{
+    char *header_text = " FILES ";
+    tb_printf(layout->header_xpos, layout->header_ypos, LPM_FG_COLOR_BLACK_DIM,
+              LPM_BG_COLOR_HIGHLIGHT_FILTER, header_text);
+    size_t status_xpos = layout->header_xpos + strlen(header_text) + 1;
+    tb_printf(status_xpos, layout->header_ypos, LPM_FG_COLOR, LPM_BG_COLOR, "%s", files.pkgver);
+    status_xpos += strlen(files.pkgver) + 1;
+    if (lpm_tui_mode == LPM_TUI_MODE_FILES_FILTER || files_query[0] != '\0')
+    {
+        tb_printf(status_xpos, layout->header_ypos, LPM_FG_COLOR, LPM_BG_COLOR, "/%s",
+                  files_query);
+        status_xpos += strlen(files_query) + 1;
+    }
+    if (lpm_tui_mode == LPM_TUI_MODE_FILES_FILTER)
+    {
+        tb_set_cell(status_xpos, layout->header_ypos, ' ', LPM_FG_COLOR_BLACK_DIM,
+                    LPM_BG_COLOR_HIGHLIGHT_FILTER);
+        status_xpos++;
+    }
+    lpm_status_msg_set_position(status_xpos + 1, layout->header_ypos);
+    lpm_status_msg_display(false);
+
+    // only the rows on screen are looked at, however long the list is
+    size_t count = lpm_files_view_count(&files);
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    if (files_top >= count)
+        files_top = count > capacity ? count - capacity : 0;
+    size_t last = files_top + capacity < count ? files_top + capacity : count;
+    int ypos = layout->header_ypos + 2;
+    size_t max_line_len = layout->max_xpos - layout->min_xpos;
+    for (size_t i = files_top; i < last; ++i)
+    {
+        const char *path = lpm_files_view_get(&files, i);
+        tb_printf(layout->min_xpos, ypos++, LPM_FG_COLOR, LPM_BG_COLOR, "%.*s", (int)max_line_len,
+                  path);
+    }
+    if (count == 0)
+        tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR, "%s",
+                  lpm_files_active(&files) ? "Reading the files of the package..."
+                  : files_query[0]         ? "No files match the filter"
+                                           : "The package has no files");
+
+    char *temp;
+    lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "Line %zu-%zu of %zu", count ? files_top + 1 : 0,
+                       last, count);
+    if (files_query[0] != '\0')
+        lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%s, filtered from %zu files", temp,
+                           lpm_files_count(&files));
+    if (lpm_files_active(&files))
+        lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%s [loading]", temp);
+    tb_print(layout->footer_xpos, layout->footer_ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR, temp);
+
+    static const char *keybindings[][2] = {
+        {"j/k", " scroll "},
+        {"h/l", " page "},
+        {"/", " filter "},
+        {"esc", " back"},
+    };
+    size_t temp_len = 0;
+    int footer_ypos = layout->footer_ypos + 2;
+    for (size_t i = 0; i < sizeof(keybindings) / sizeof(*keybindings); ++i)
+    {
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  keybindings[i][0]);
+        temp_len += strlen(keybindings[i][0]);
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_BLACK_DIM,
+                  LPM_BG_COLOR, keybindings[i][1]);
+        temp_len += strlen(keybindings[i][1]);
+    }
+}
+
+void lpm_tui_display_cache_screen(LPM_TUI_Layout *layout)
+{
+    char *header_text = " CACHE ";
+    tb_printf(layout->header_xpos, layout->header_ypos, LPM_FG_COLOR_BLACK_DIM,
+              LPM_BG_COLOR_HIGHLIGHT_FILTER, header_text);
+    size_t status_xpos = layout->header_xpos + strlen(header_text) + 1;
+    tb_printf(status_xpos, layout->header_ypos, LPM_FG_COLOR, LPM_BG_COLOR, "%s",
+              LPM_PKGCACHE_DIR);
+    lpm_status_msg_set_position(status_xpos + strlen(LPM_PKGCACHE_DIR) + 1, layout->header_ypos);
+    lpm_status_msg_display(false);
+
+    int ypos = layout->header_ypos + 2;
+    if (lpm_pkgcache_active(&pkgcache))
+    {
+        tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  "Scanning the package cache...");
+        return;
+    }
+    if (pkgcache.groups.count == 0)
+        tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  "The package cache is empty");
+
+    // per package its size, then every cached version and what it is to the installed one
+    static const char *states[] = {
+        [LPM_PKGCACHE_CURRENT] = "installed",
+        [LPM_PKGCACHE_PENDING] = "newer",
+        [LPM_PKGCACHE_SUPERSEDED] = "superseded",
+        [LPM_PKGCACHE_NOT_INSTALLED] = "not installed",
+    };
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    size_t last = cache_top + capacity < pkgcache.groups.count ? cache_top + capacity
+                                                                : pkgcache.groups.count;
+    size_t max_line_len = layout->max_xpos - layout->min_xpos;
+    for (size_t g = cache_top; g < last; ++g)
+    {
+        const LPM_Pkgcache_Group *group = &pkgcache.groups.items[g];
+        char bytes[32], reclaimable[32];
+        _lpm_tui_format_bytes(group->bytes, bytes, sizeof(bytes));
+        _lpm_tui_format_bytes(group->reclaimable, reclaimable, sizeof(reclaimable));
+        char *temp;
+        size_t temp_len = lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%s %-24.*s %10s %10s ",
+                                             lpm_bitset_test(&cache_marked, g) ? "[x]" : "[ ]",
+                                             (int)group->name_len, group->pkgname, bytes,
+                                             reclaimable);
+        for (size_t i = group->first; i < group->first + group->count; ++i)
+        {
+            const LPM_Pkgcache_File *file = &pkgcache.files.items[i];
+            temp_len = lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%s%s%s %s", temp,
+                                          i == group->first ? "" : ", ",
+                                          lpm_version_of(file->pkgver), states[file->state]);
+        }
+        temp_len = _lpm_tui_cut_line(temp, max_line_len);
+        if (g == cache_selected)
+        {
+            tb_print(layout->min_xpos, ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR_HIGHLIGHT, temp);
+            for (int j = layout->min_xpos + temp_len; j < layout->max_xpos; ++j)
+                tb_set_cell(j, ypos, ' ', LPM_FG_COLOR, LPM_BG_COLOR_HIGHLIGHT);
+        }
+        else
+            tb_print(layout->min_xpos, ypos, LPM_FG_COLOR, LPM_BG_COLOR, temp);
+        ypos++;
+    }
+
+    char bytes[32], reclaimable[32];
+    _lpm_tui_format_bytes(pkgcache.bytes, bytes, sizeof(bytes));
+    _lpm_tui_format_bytes(pkgcache.reclaimable, reclaimable, sizeof(reclaimable));
+    char *temp;
+    lpm_arena_asprintf(LPM_ARENA_FRAME, &temp,
+                       "%zu packages, %zu files, %s, %s reclaimable, %zu marked (%s in %.1f ms)",
+                       pkgcache.groups.count, pkgcache.files.count, bytes, reclaimable,
+                       cache_marked_count, pkgcache.listed ? "scanned" : "reclassified",
+                       pkgcache.elapsed_ms);
+    tb_print(layout->footer_xpos, layout->footer_ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR, temp);
+
+    static const char *keybindings[][2] = {
+        {"j/k", " move "},
+        {"space", " mark "},
+        {"a", " mark reclaimable "},
+        {"enter", " purge "},
+        {"esc", " back"},
+    };
+    size_t temp_len = 0;
+    int footer_ypos = layout->footer_ypos + 2;
+    for (size_t i = 0; i < sizeof(keybindings) / sizeof(*keybindings); ++i)
+    {
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  keybindings[i][0]);
+        temp_len += strlen(keybindings[i][0]);
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_BLACK_DIM,
+                  LPM_BG_COLOR, keybindings[i][1]);
+        temp_len += strlen(keybindings[i][1]);
+    }
+}
+
+void lpm_tui_display_owners_screen(LPM_TUI_Layout *layout)
+{
+    char *header_text = " OWNERS ";
+    tb_printf(layout->header_xpos, layout->header_ypos, LPM_FG_COLOR_BLACK_DIM,
+              LPM_BG_COLOR_HIGHLIGHT_FILTER, header_text);
+    size_t status_xpos = layout->header_xpos + strlen(header_text) + 1;
+    tb_printf(status_xpos, layout->header_ypos, LPM_FG_COLOR, LPM_BG_COLOR, "%s", owners_text);
+    status_xpos += strlen(owners_text);
+    tb_set_cell(status_xpos, layout->header_ypos, ' ', LPM_FG_COLOR_BLACK_DIM,
+                LPM_BG_COLOR_HIGHLIGHT_FILTER);
+    lpm_status_msg_set_position(status_xpos + 2, layout->header_ypos);
+    lpm_status_msg_display(false);
+
+    size_t capacity = _lpm_tui_output_capacity(layout);
+    size_t last = owners_top + capacity < owners_matches.count ? owners_top + capacity
+                                                               : owners_matches.count;
+    int longest_pkgver_len = 0;
+    for (size_t i = owners_top; i < last; ++i)
+    {
+        int pkgver_len = (int)strlen(owners_matches.items[i].pkgver);
+        if (pkgver_len > longest_pkgver_len)
+            longest_pkgver_len = pkgver_len;
+    }
+    int ypos = layout->header_ypos + 2;
+    size_t max_line_len = layout->max_xpos - layout->min_xpos;
+    for (size_t i = owners_top; i < last; ++i)
+    {
+        const LPM_Owners_Match *match = &owners_matches.items[i];
+        char *temp;
+        const char *path = owners_matches.text.items + match->path;
+        lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%-*s %s", longest_pkgver_len, match->pkgver,
+                           path);
+        size_t temp_len = _lpm_tui_cut_line(temp, max_line_len);
+        if (i == owners_selected)
+        {
+            tb_print(layout->min_xpos, ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR_HIGHLIGHT, temp);
+            for (int j = layout->min_xpos + temp_len; j < layout->max_xpos; ++j)
+                tb_set_cell(j, ypos, ' ', LPM_FG_COLOR, LPM_BG_COLOR_HIGHLIGHT);
+        }
+        else
+            tb_print(layout->min_xpos, ypos, LPM_FG_COLOR, LPM_BG_COLOR, temp);
+        ypos++;
+    }
+    if (!lpm_owners_ready(&owners))
+        tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  lpm_owners_active(&owners) ? "Indexing the files of installed packages..."
+                                             : "No index of installed files");
+    else if (owners_text[0] == '\0')
+        tb_printf(layout->min_xpos, ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  "Type a path prefix like /usr/bin/vi, or any part of a path like libssl.so");
+
+    char *temp;
+    lpm_arena_asprintf(LPM_ARENA_FRAME, &temp, "%zu of %zu matches in %.2f ms, %u files indexed%s",
+                       owners_matches.count, owners_matches.total, owners_search_ms,
+                       owners.map.entry_count, lpm_owners_active(&owners) ? " [updating]" : "");
+    tb_print(layout->footer_xpos, layout->footer_ypos, LPM_FG_COLOR_BLACK_DIM, LPM_BG_COLOR, temp);
+
+    static const char *keybindings[][2] = {
+        {"up/down", " move "},
+        {"enter", " show package "},
+        {"ctrl + u", " clear "},
+        {"esc", " back"},
+    };
+    size_t temp_len = 0;
+    int footer_ypos = layout->footer_ypos + 2;
+    for (size_t i = 0; i < sizeof(keybindings) / sizeof(*keybindings); ++i)
+    {
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_DIM, LPM_BG_COLOR,
+                  keybindings[i][0]);
+        temp_len += strlen(keybindings[i][0]);
+        tb_printf(layout->footer_xpos + temp_len, footer_ypos, LPM_FG_COLOR_BLACK_DIM,
+                  LPM_BG_COLOR, keybindings[i][1]);
+        temp_len += strlen(keybindings[i][1]);
+    }
+}
+
 void lpm_tui_crash_handler(int sig)
 {
     tb_shutdown();
@@ -649,6 +2514,6 @@ void lpm_tui_crash_signals(void)
     signal(SIGBUS, lpm_tui_crash_handler);
     signal(SIGINT, lpm_tui_crash_handler); // User interruption
     signal(SIGTERM, lpm_tui_crash_handler);
-    signal(SIGPIPE, lpm_tui_crash_handler); // Pipe-related (important for popen!)
+    signal(SIGPIPE, lpm_tui_crash_handler); // Pipe-related
     signal(SIGCHLD, SIG_DFL);               // Child process signals (may be useful)
 }
@@ -8,51 +8,103 @@
 #pragma once
 
 #include "common.h"
+#include "facets.h"
+#include "files.h"
+#include "filter.h"
+#include "loader.h"
+#include "output.h"
+#include "owners.h"
 #include "packages.h"
+#include "pkgcache.h"
+#include "pkgdb.h"
+#include "prefetch.h"
+#include "preview.h"
+#include "session.h"
+#include "upgrades.h"
 
 #define MIN_WIDTH 80
 #define MIN_HEIGHT 15
 
+// Terminals at least this wide show the details of the hovered package next to the list
+#ifndef LPM_TUI_SPLIT_MIN_WIDTH
+#define LPM_TUI_SPLIT_MIN_WIDTH 140
+#endif // LPM_TUI_SPLIT_MIN_WIDTH
+
+// Frames rendered per second at most. Input arriving faster, e.g. a held key, is applied in
+// batches with a single frame each.
+#ifndef LPM_TUI_MAX_FPS
+#define LPM_TUI_MAX_FPS 60
+#endif // LPM_TUI_MAX_FPS
+
+// Tabs open at most, the digit keys switch to the first nine
+#ifndef LPM_TUI_MAX_TABS
+#define LPM_TUI_MAX_TABS 9
+#endif // LPM_TUI_MAX_TABS
+
+// Matches listed by the owners screen, the footer still counts all of them
+#ifndef LPM_TUI_OWNERS_MAX_MATCHES
+#define LPM_TUI_OWNERS_MAX_MATCHES 1000
+#endif // LPM_TUI_OWNERS_MAX_MATCHES
+
 typedef enum
 {
     LPM_TUI_MODE_MAIN,
     LPM_TUI_MODE_FILTER,
     LPM_TUI_MODE_KEYBINDINGS,
+    LPM_TUI_MODE_OUTPUT,
+    LPM_TUI_MODE_OUTPUT_SEARCH,
+    LPM_TUI_MODE_OWNERS,
+    LPM_TUI_MODE_FILES,
+    LPM_TUI_MODE_FILES_FILTER,
+    LPM_TUI_MODE_CACHE,
 } LPM_TUI_Mode;
 
 typedef struct
 {
-    uint8_t min_xpos; // Horizontal padding: leftmost column where layout begins
-    uint8_t max_xpos; // Horizontal padding: rightmost column where layout ends
-    uint8_t min_ypos; // Vertical padding: top row where layout begins
-    uint8_t max_ypos; // Vertical padding: bottom row where layout ends
-
-    uint8_t header_xpos; // X position of the header text (column)
-    uint8_t header_ypos; // Y position of the header text (row)
-
-    uint8_t packages_xpos;            // X position of the packages list (column)
-    uint8_t packages_ypos;            // Y position of the packages list (row)
-    uint8_t packages_cursor_ypos;     // Y position of the hovered("selected") package
-    size_t packages_page_index;       // Current page of packages to render
-    size_t packages_total_pages;      // Total pages of packages
-    uint8_t packages_render_capacity; // Distance between packages_ypos and footer_ypos,
-                                      // giving us largest number of packages we can render per page
-
-    uint8_t footer_xpos; // X position of the footer text (column)
-    uint8_t footer_ypos; // Y position of the footer text (row)
+    int width;  // Terminal size the layout was computed for, see lpm_tui_layout_setup
+    int height;
+
+    int min_xpos; // Horizontal padding: leftmost column where layout begins
+    int max_xpos; // Horizontal padding: rightmost column where layout ends
+    int min_ypos; // Vertical padding: top row where layout begins
+    int max_ypos; // Vertical padding: bottom row where layout ends
+
+    int header_xpos; // X position of the header text (column)
+    int header_ypos; // Y position of the header text (row)
+
+    int packages_xpos;               // X position of the packages list (column)
+    int packages_ypos;               // Y position of the packages list (row)
+    int packages_max_xpos;           // Rightmost column of the packages list
+    size_t packages_cursor_ypos;     // Y position of the hovered("selected") package
+    size_t packages_page_index;      // Current page of packages to render
+    size_t packages_total_pages;     // Total pages of packages
+    size_t packages_render_capacity; // Distance between packages_ypos and footer_ypos,
+                                     // giving us largest number of packages we can render per page
+
+    int details_xpos;  // X position of the details pane of the hovered package (column)
+    int details_width; // 0 when the terminal is too narrow to split it off the packages list
+
+    int footer_xpos; // X position of the footer text (column)
+    int footer_ypos; // Y position of the footer text (row)
 } LPM_TUI_Layout;
 
+// Compute every position from the terminal size. Only called on startup and on resize events,
+// frames draw from the cached result. The cursor is kept, see _lpm_tui_select.
 void lpm_tui_layout_setup(LPM_TUI_Layout *layout);
 void lpm_tui_layout_teardown(LPM_TUI_Layout *layout);
 
 LPM_Exit_Code lpm_tui_setup(LPM_TUI_Layout *layout, LPM_Packages *pkgs);
 void lpm_tui_teardown(LPM_TUI_Layout *layout, LPM_Packages *pkgs);
 
-void lpm_tui_run(LPM_TUI_Layout *layout, LPM_Packages *pkgs);
+LPM_Exit_Code lpm_tui_run(LPM_TUI_Layout *layout, LPM_Packages *pkgs);
 LPM_Exit_Code lpm_tui_event_handler(struct tb_event *evt, LPM_TUI_Layout *layout,
                                     LPM_Packages *pkgs);
 void lpm_tui_display(LPM_TUI_Layout *layout, LPM_Packages *pkgs);
 void lpm_tui_display_keybindings_screen(LPM_TUI_Layout *layout);
+void lpm_tui_display_output_screen(LPM_TUI_Layout *layout);
+void lpm_tui_display_owners_screen(LPM_TUI_Layout *layout);
+void lpm_tui_display_files_screen(LPM_TUI_Layout *layout);
+void lpm_tui_display_cache_screen(LPM_TUI_Layout *layout);
 
 void lpm_tui_crash_handler(int sig);
 void lpm_tui_crash_signals(void);
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// upgrades.c - Find installed packages with a newer version in the repositories
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "upgrades.h"
+
+static int _lpm_upgrades_row_cmp(const void *a, const void *b)
+{
+    uint32_t ra = *(const uint32_t *)a;
+    uint32_t rb = *(const uint32_t *)b;
+    return (ra > rb) - (ra < rb);
+}
+
+void lpm_upgrades_snapshot(LPM_Package_Index *repository, const LPM_Packages *pkgs)
+{
+    repository->count = 0;
+    LPM_DA_RESERVE(repository, pkgs->count);
+    for (size_t i = 0; i < pkgs->count; ++i)
+    {
+        const LPM_Package *pkg = &pkgs->items[i];
+        if (strcmp(pkg->status, LPM_PACKAGE_STATUS_SOURCE) == 0)
+            continue;
+        repository->items[repository->count++] = (LPM_Package_Index_Entry){
+            .pkgver = pkg->name,
+            .name_len = (uint32_t)lpm_packages_pkgname_len(pkg->name),
+            .row = (uint32_t)i,
+        };
+    }
+}
+
+LPM_Exit_Code lpm_upgrades_compute(LPM_Package_Index *repository, const char *pkgdb_path,
+                                   LPM_Package_Rows *rows, size_t *installed_count)
+{
+    rows->count = 0;
+    *installed_count = 0;
+
+    LPM_Packages_Buffer pkgdb = {0};
+    LPM_Package_Index installed = {0};
+    LPM_Exit_Code result = lpm_pkgdb_read(pkgdb_path, &pkgdb, &installed);
+    if (result != LPM_OK)
+    {
+        LPM_DA_FREE(pkgdb);
+        return result;
+    }
+    *installed_count = installed.count;
+
+    // one sorted index of the repository rows, then a binary search per installed package
+    lpm_packages_index_sort(repository);
+    for (size_t i = 0; i < installed.count; ++i)
+    {
+        const LPM_Package_Index_Entry *pkg = &installed.items[i];
+        const char *installed_version = lpm_version_of(pkg->pkgver);
+        size_t first, last;
+        lpm_packages_index_range(repository, pkg->pkgver, pkg->name_len, &first, &last);
+        for (size_t j = first; j < last; ++j)
+        {
+            const LPM_Package_Index_Entry *entry = &repository->items[j];
+            if (lpm_version_compare(lpm_version_of(entry->pkgver), installed_version) > 0)
+                LPM_DA_APPEND(rows, entry->row);
+        }
+    }
+
+    // back to table order, rows are unique since every row has a single pkgname
+    if (rows->count > 0)
+        qsort(rows->items, rows->count, sizeof(*rows->items), _lpm_upgrades_row_cmp);
+
+    LPM_DA_FREE(installed);
+    LPM_DA_FREE(pkgdb);
+    return LPM_OK;
+}
+
+static void *_lpm_upgrades_worker(void *arg)
+{
+    LPM_Upgrades *upgrades = arg;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    upgrades->result = lpm_upgrades_compute(&upgrades->repository, LPM_PKGDB_PATH,
+                                            &upgrades->rows, &upgrades->installed_count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    LPM_LOG_INFO("Compared %zu installed packages against the repositories in %.1f ms, %zu "
+                 "upgradable",
+                 upgrades->installed_count, elapsed_ms, upgrades->rows.count);
+    atomic_store(&upgrades->done, true);
+    return NULL;
+}
+
+void lpm_upgrades_start(LPM_Upgrades *upgrades, const LPM_Packages *pkgs)
+{
+    lpm_upgrades_teardown(upgrades);
+    lpm_upgrades_snapshot(&upgrades->repository, pkgs);
+    upgrades->active = true;
+    atomic_store(&upgrades->done, false);
+    int err = pthread_create(&upgrades->thread, NULL, _lpm_upgrades_worker, upgrades);
+    if (err != 0)
+    {
+        LPM_LOG_WARNING("Failed to start the upgrades thread, computing inline\n\tReason  : %s",
+                        strerror(err));
+        _lpm_upgrades_worker(upgrades);
+        upgrades->started = false;
+        return;
+    }
+    upgrades->started = true;
+}
+
+bool lpm_upgrades_poll(LPM_Upgrades *upgrades)
+{
+    if (!upgrades->active || !atomic_load(&upgrades->done))
+        return false;
+    if (upgrades->started)
+        pthread_join(upgrades->thread, NULL);
+    upgrades->started = false;
+    upgrades->active = false; // report the results once
+    LPM_DA_FREE(upgrades->repository);
+    upgrades->repository = (LPM_Package_Index){0};
+    return true;
+}
+
+void lpm_upgrades_teardown(LPM_Upgrades *upgrades)
+{
+    if (upgrades->started)
+        pthread_join(upgrades->thread, NULL);
+    upgrades->started = false;
+    upgrades->active = false;
+    LPM_DA_FREE(upgrades->repository);
+    upgrades->repository = (LPM_Package_Index){0};
+    LPM_DA_FREE(upgrades->rows);
+    upgrades->rows.count = 0;
+    upgrades->rows.capacity = 0;
+    upgrades->installed_count = 0;
+}
@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// upgrades.h - Find installed packages with a newer version in the repositories
+//
+
+#pragma once
+
+#include "common.h"
+#include "logs.h"
+#include "packages.h"
+#include "pkgdb.h"
+#include "version.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+    pthread_t thread;
+    bool started;
+    bool active;
+    atomic_bool done;
+    // pkgvers of the repository rows, taken before the thread starts so the main thread is free
+    // to change the rows meanwhile
+    LPM_Package_Index repository;
+
+    // only valid once lpm_upgrades_poll has returned true
+    LPM_Exit_Code result;
+    LPM_Package_Rows rows; // rows of pkgs whose repository version is newer than the installed one
+    size_t installed_count;
+} LPM_Upgrades;
+
+// Set repository to the rows of pkgs available from a repository, source templates are left out
+// as a newer one is not an upgrade until it is built. Entries point into pkgs, unsorted.
+void lpm_upgrades_snapshot(LPM_Package_Index *repository, const LPM_Packages *pkgs);
+// Compare every installed package from the pkgdb at pkgdb_path against the repository versions
+// in repository, which is sorted first. rows is set to the upgradable rows in table order. No xbps
+// command is run.
+LPM_Exit_Code lpm_upgrades_compute(LPM_Package_Index *repository, const char *pkgdb_path,
+                                   LPM_Package_Rows *rows, size_t *installed_count);
+
+// Run lpm_upgrades_compute on a background thread over a snapshot of pkgs. The pkgvers of pkgs
+// must outlive the computation, the rows themselves may change meanwhile.
+void lpm_upgrades_start(LPM_Upgrades *upgrades, const LPM_Packages *pkgs);
+// Returns true once, when a started computation has finished and its results can be read
+bool lpm_upgrades_poll(LPM_Upgrades *upgrades);
+// Wait for a running computation and free its results
+void lpm_upgrades_teardown(LPM_Upgrades *upgrades);
@@ -0,0 +1,127 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// version.c - Compare xbps package versions the way xbps_cmpver does
+//
+
+#define LPM_ALLOC_SUBSYSTEM LPM_ALLOC_PACKAGES
+#include "version.h"
+#include <limits.h>
+#include <strings.h>
+
+// Values of the version modifiers, relative to a plain "." separator
+#define VERSION_ALPHA -3
+#define VERSION_BETA -2
+#define VERSION_RC -1
+#define VERSION_DOT 0
+
+typedef struct
+{
+    const char *name;
+    size_t len;
+    int value;
+} LPM_Version_Modifier;
+
+static const LPM_Version_Modifier _lpm_version_modifiers[] = {
+    {"alpha", 5, VERSION_ALPHA}, {"beta", 4, VERSION_BETA}, {"pre", 3, VERSION_RC},
+    {"rc", 2, VERSION_RC},       {"pl", 2, VERSION_DOT},    {".", 1, VERSION_DOT},
+};
+
+// Walks the components of a version string one at a time, so comparing two versions needs no
+// allocation and usually stops after the first few components.
+typedef struct
+{
+    const char *p;
+    int pending; // letter index queued after its VERSION_DOT
+    bool has_pending;
+    int revision;
+} LPM_Version_Cursor;
+
+static int _lpm_version_number(const char **p)
+{
+    int n = 0;
+    for (; isdigit((unsigned char)**p); (*p)++)
+        n = n > (INT_MAX - 9) / 10 ? INT_MAX : n * 10 + (**p - '0');
+    return n;
+}
+
+static bool _lpm_version_next(LPM_Version_Cursor *cursor, int *value)
+{
+    if (cursor->has_pending)
+    {
+        cursor->has_pending = false;
+        *value = cursor->pending;
+        return true;
+    }
+
+    while (*cursor->p != '\0')
+    {
+        const char *p = cursor->p;
+        if (isdigit((unsigned char)*p))
+        {
+            *value = _lpm_version_number(&cursor->p);
+            return true;
+        }
+
+        bool matched = false;
+        for (size_t i = 0; i < sizeof(_lpm_version_modifiers) / sizeof(*_lpm_version_modifiers);
+             ++i)
+        {
+            const LPM_Version_Modifier *mod = &_lpm_version_modifiers[i];
+            if (strncasecmp(p, mod->name, mod->len) == 0)
+            {
+                cursor->p += mod->len;
+                *value = mod->value;
+                matched = true;
+                break;
+            }
+        }
+        if (matched)
+            return true;
+
+        if (*p == '_')
+        {
+            cursor->p++;
+            cursor->revision = _lpm_version_number(&cursor->p);
+            continue;
+        }
+
+        cursor->p++;
+        if (isalpha((unsigned char)*p))
+        {
+            // "1.0a" reads as 1.0.0.1, so a lettered release sorts after the plain one
+            cursor->pending = tolower((unsigned char)*p) - 'a' + 1;
+            cursor->has_pending = true;
+            *value = VERSION_DOT;
+            return true;
+        }
+        // anything else is skipped, like xbps does
+    }
+    return false;
+}
+
+const char *lpm_version_of(const char *pkgver)
+{
+    const char *dash = strrchr(pkgver, '-');
+    return dash ? dash + 1 : pkgver;
+}
+
+int lpm_version_compare(const char *a, const char *b)
+{
+    LPM_Version_Cursor ca = {.p = a};
+    LPM_Version_Cursor cb = {.p = b};
+    while (1)
+    {
+        // the shorter version is padded with zeros, "1.0" == "1.0.0"
+        int va = 0;
+        int vb = 0;
+        bool more_a = _lpm_version_next(&ca, &va);
+        bool more_b = _lpm_version_next(&cb, &vb);
+        if (!more_a && !more_b)
+            break;
+        if (va != vb)
+            return va < vb ? -1 : 1;
+    }
+    return (ca.revision > cb.revision) - (ca.revision < cb.revision);
+}
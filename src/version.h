@@ -0,0 +1,19 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// version.h - Compare xbps package versions the way xbps_cmpver does
+//
+
+#pragma once
+
+#include "common.h"
+
+// Version part of a pkgver, e.g. "foo-bar-1.0_1" -> "1.0_1"
+const char *lpm_version_of(const char *pkgver);
+
+// Returns < 0, 0 or > 0 when version a is older than, equal to or newer than version b.
+// Follows xbps ordering: numeric components compare numerically, "alpha" < "beta" < "pre" ==
+// "rc" < release, "pl" and "." separate components, a trailing letter counts as one more
+// component ("1.0a" > "1.0"), and the "_N" revision only breaks ties.
+int lpm_version_compare(const char *a, const char *b);
@@ -0,0 +1,658 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// bench.c - Time the hot paths of lazypm on an `xbps-query -Rs` style listing
+//
+// Built with -O2 and run by `./build/nob --bench`. Each case reports its best of BENCH_RUNS runs,
+// next to a reference doing the same work the way lazypm used to. The listing is generated from a
+// fixed seed unless --fixture names a real dump, e.g. `xbps-query -Rs '' > listing.txt`.
+//
+// usage: build/bench [--rows N] [--fixture PATH] [CASE...]
+//
+
+#define TB_IMPL
+
+#include "../src/filter.h"
+#include "../src/packages.h"
+#include "../src/process.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BENCH_RUNS 5
+#define BENCH_SPAWNS 200
+// A full screen of rows at the description width of a wide terminal
+#define BENCH_FRAME_ROWS 195
+#define BENCH_FRAME_COLUMNS 200
+#define BENCH_FRAMES 1000
+#define BENCH_ROWS 100000
+#define BENCH_SEED 0x6c617a79706d0002ull
+
+typedef struct
+{
+    LPM_Process_Buffer text; // NUL-terminated
+    size_t rows;
+    char *path; // the listing on disk, for the cases that read it through a process
+    bool generated;
+} Bench_Listing;
+
+typedef struct
+{
+    const char *name;
+    const char *description;
+    bool (*run)(const Bench_Listing *listing); // false when the results disagree
+} Bench_Case;
+
+static double bench_now_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+// Keep the fastest run, the others mostly measure the rest of the machine
+static void bench_keep(double *best_ms, double start_ms)
+{
+    double elapsed_ms = bench_now_ms() - start_ms;
+    if (*best_ms == 0 || elapsed_ms < *best_ms)
+        *best_ms = elapsed_ms;
+}
+
+static void bench_report(const char *label, double ms, size_t bytes)
+{
+    if (bytes == 0)
+    {
+        printf("  %-24s %9.3f ms\n", label, ms);
+        return;
+    }
+    printf("  %-24s %9.3f ms %8.1f MiB/s\n", label, ms,
+           ms > 0 ? bytes / (1024.0 * 1024.0) / (ms / 1000.0) : 0);
+}
+
+//
+// listing
+//
+
+static uint64_t bench_random(uint64_t *state)
+{
+    // xorshift64*, the listing must not depend on the libc
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dull;
+}
+
+static const char *bench_pick(uint64_t *state, const char *const words[], size_t count)
+{
+    return words[bench_random(state) % count];
+}
+
+static void bench_append(LPM_Process_Buffer *text, const char *s)
+{
+    size_t len = strlen(s);
+    LPM_DA_RESERVE(text, text->count + len + 1);
+    memcpy(text->items + text->count, s, len);
+    text->count += len;
+    text->items[text->count] = '\0';
+}
+
+// Package names and descriptions shaped like the Void repositories, about two in five
+// descriptions carry accented or CJK text
+static void bench_generate(Bench_Listing *listing, size_t rows)
+{
+    static const char *const prefixes[] = {"", "", "", "lib", "python3-", "perl-", "rust-",
+                                           "xfce4-", "font-", "qt6-", "gst-plugins-", "R-cran-"};
+    static const char *const stems[] = {"zlib", "gtk", "vim", "curl", "openssl", "mesa", "ffmpeg",
+                                        "kde", "xorg", "glib", "pango", "cairo", "sqlite", "nss"};
+    static const char *const suffixes[] = {"", "", "", "", "-devel", "-doc", "-32bit", "-dbg"};
+    static const char *const words[] = {
+        "library",  "for",    "the",     "X11",    "client",   "GTK+",     "toolkit", "bindings",
+        "fast",     "simple", "command", "line",   "tool",     "to",       "manage",  "files",
+        "plugin",   "of",     "and",     "Python", "terminal", "emulator", "data",    "files",
+    };
+    static const char *const foreign[] = {"café", "naïve", "Übersetzung", "日本語", "한국어",
+                                          "文字列", "señal", "Ελληνικά"};
+
+    uint64_t state = BENCH_SEED;
+    char line[256];
+    for (size_t i = 0; i < rows; ++i)
+    {
+        bool installed = bench_random(&state) % 10 == 0;
+        snprintf(line, sizeof(line), "[%c] %s%s%zu%s-%u.%u.%u_%u", installed ? '*' : '-',
+                 bench_pick(&state, prefixes, sizeof(prefixes) / sizeof(*prefixes)),
+                 bench_pick(&state, stems, sizeof(stems) / sizeof(*stems)), i,
+                 bench_pick(&state, suffixes, sizeof(suffixes) / sizeof(*suffixes)),
+                 (unsigned)(bench_random(&state) % 30), (unsigned)(bench_random(&state) % 20),
+                 (unsigned)(bench_random(&state) % 100), (unsigned)(1 + bench_random(&state) % 4));
+        bench_append(&listing->text, line);
+        // xbps pads the pkgver column
+        size_t pad = strlen(line) < 40 ? 40 - strlen(line) : 1;
+        for (size_t p = 0; p < pad; ++p)
+            bench_append(&listing->text, " ");
+
+        bool accented = bench_random(&state) % 5 < 2;
+        size_t word_count = 3 + bench_random(&state) % 8;
+        for (size_t w = 0; w < word_count; ++w)
+        {
+            if (w > 0)
+                bench_append(&listing->text, " ");
+            if (accented && w == word_count / 2)
+                bench_append(&listing->text,
+                             bench_pick(&state, foreign, sizeof(foreign) / sizeof(*foreign)));
+            else
+                bench_append(&listing->text,
+                             bench_pick(&state, words, sizeof(words) / sizeof(*words)));
+        }
+        bench_append(&listing->text, "\n");
+    }
+    listing->rows = rows;
+}
+
+static bool bench_read(Bench_Listing *listing, const char *path)
+{
+    FILE *fp = fopen(path, "re");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "bench: failed to open \"%s\": %s\n", path, strerror(errno));
+        return false;
+    }
+    char chunk[64 * 1024];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    {
+        LPM_DA_RESERVE(&listing->text, listing->text.count + n + 1);
+        memcpy(listing->text.items + listing->text.count, chunk, n);
+        listing->text.count += n;
+        listing->text.items[listing->text.count] = '\0';
+    }
+    fclose(fp);
+    for (size_t i = 0; i < listing->text.count; ++i)
+        listing->rows += listing->text.items[i] == '\n';
+    listing->path = lpm_strdup(path);
+    return listing->text.count > 0;
+}
+
+// Write a generated listing next to the other temporary files, the process cases cat it
+static bool bench_write(Bench_Listing *listing)
+{
+    const char *dir = getenv("TMPDIR");
+    lpm_asprintf(&listing->path, "%s/lazypm-bench-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(listing->path);
+    if (fd == -1)
+    {
+        fprintf(stderr, "bench: failed to create \"%s\": %s\n", listing->path, strerror(errno));
+        return false;
+    }
+    FILE *fp = fdopen(fd, "w");
+    bool written = fp && fwrite(listing->text.items, 1, listing->text.count, fp) ==
+                             listing->text.count;
+    if (fp == NULL || fclose(fp) != 0)
+        written = false;
+    return written;
+}
+
+// A private copy of the listing, lpm_packages_parse takes ownership of what it parses
+static LPM_Process_Buffer bench_copy(const Bench_Listing *listing)
+{
+    LPM_Process_Buffer copy = {0};
+    LPM_DA_RESERVE(&copy, listing->text.count + 1);
+    memcpy(copy.items, listing->text.items, listing->text.count + 1);
+    copy.count = listing->text.count;
+    return copy;
+}
+
+//
+// cases
+//
+
+typedef struct
+{
+    char **items; // status, name and description of every row, each one its own copy
+    size_t count;
+    size_t capacity;
+} Bench_Reference_Rows;
+
+// The getline() loop over popen() and the copying line callback lazypm parsed with before the
+// output was read in bulk
+static void bench_parse_reference(const char *path, Bench_Reference_Rows *rows)
+{
+    char *cmd;
+    lpm_asprintf(&cmd, "cat '%s'", path);
+    FILE *fp = popen(cmd, "r");
+    LPM_FREE(cmd);
+    if (fp == NULL)
+        return;
+
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, fp) != -1)
+    {
+        LPM_DA_APPEND(rows, strndup(line, 3));
+        size_t i = 4;
+        while (line[i] != '\0' && !isspace((unsigned char)line[i]))
+            i++;
+        char temp = line[i];
+        line[i] = '\0';
+        LPM_DA_APPEND(rows, strdup(line + 4));
+        line[i] = temp;
+        while (isspace((unsigned char)line[i]))
+            i++;
+        LPM_DA_APPEND(rows, strdup(line + i));
+    }
+    free(line);
+    pclose(fp);
+}
+
+static bool bench_parse(const Bench_Listing *listing)
+{
+    double reference_ms = 0, parse_ms = 0;
+    size_t reference_rows = 0, rows = 0;
+    for (size_t run = 0; run < BENCH_RUNS; ++run)
+    {
+        Bench_Reference_Rows reference = {0};
+        double start = bench_now_ms();
+        bench_parse_reference(listing->path, &reference);
+        bench_keep(&reference_ms, start);
+        reference_rows = reference.count / 3;
+        for (size_t i = 0; i < reference.count; ++i)
+            free(reference.items[i]);
+        LPM_DA_FREE(reference);
+
+        start = bench_now_ms();
+        LPM_Packages pkgs = {0};
+        LPM_Process_Buffer out = {0};
+        char *argv[] = {"cat", listing->path, NULL};
+        if (lpm_process_run(argv, &out, NULL, NULL) == LPM_OK)
+            lpm_packages_parse(&pkgs, &out);
+        bench_keep(&parse_ms, start);
+        rows = pkgs.count;
+        lpm_packages_teardown(&pkgs);
+    }
+
+    bench_report("popen, getline, copies", reference_ms, listing->text.count);
+    bench_report("bulk read, in place", parse_ms, listing->text.count);
+    if (rows != reference_rows)
+    {
+        fprintf(stderr, "  FAIL: %zu rows parsed, the reference found %zu\n", rows, reference_rows);
+        return false;
+    }
+    return true;
+}
+
+static bool bench_parse_threads(const Bench_Listing *listing)
+{
+    static const size_t thread_counts[] = {1, 2, 4, 8};
+    printf("  CPUs online: %ld, thread limit: %d\n", sysconf(_SC_NPROCESSORS_ONLN),
+           LPM_PACKAGES_PARSE_MAX_THREADS);
+    LPM_Packages single = {0};
+    bool same = true;
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(*thread_counts); ++t)
+    {
+        double best_ms = 0;
+        for (size_t run = 0; run < BENCH_RUNS; ++run)
+        {
+            LPM_Process_Buffer copy = bench_copy(listing);
+            LPM_Packages pkgs = {0};
+            double start = bench_now_ms();
+            lpm_packages_parse_threads(&pkgs, &copy, thread_counts[t]);
+            bench_keep(&best_ms, start);
+
+            // every thread count must give the rows of the single threaded parse, in order
+            if (t == 0 && run == 0)
+            {
+                single = pkgs;
+                continue;
+            }
+            same = same && pkgs.count == single.count;
+            for (size_t i = 0; same && i < pkgs.count; ++i)
+            {
+                same = strcmp(pkgs.items[i].name, single.items[i].name) == 0 &&
+                       strcmp(pkgs.items[i].description, single.items[i].description) == 0;
+            }
+            lpm_packages_teardown(&pkgs);
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "%zu thread%s", thread_counts[t],
+                 thread_counts[t] == 1 ? "" : "s");
+        bench_report(label, best_ms, listing->text.count);
+    }
+    lpm_packages_teardown(&single);
+    if (!same)
+        fprintf(stderr, "  FAIL: the rows depend on the thread count\n");
+    return same;
+}
+
+// The full scan every query did before the trigram index, needle is lowercase
+static void bench_filter_reference(const LPM_Packages *pkgs, const char *needle,
+                                   LPM_Package_Rows *rows)
+{
+    rows->count = 0;
+    for (size_t i = 0; i < pkgs->count; ++i)
+    {
+        if (lpm_packages_contains(&pkgs->items[i], needle))
+            LPM_DA_APPEND(rows, (uint32_t)i);
+    }
+}
+
+static bool bench_filter(const Bench_Listing *listing)
+{
+    // common words, rare ones, non-ASCII text, short queries the index leaves to the scan, and
+    // queries nothing matches
+    static const char *const queries[] = {"lib",  "python3", "devel", "terminal emulator", "gtk+",
+                                          "日本語", "curl12", "vi",    "xyzzy",             "qq"};
+    LPM_Process_Buffer copy = bench_copy(listing);
+    LPM_Packages pkgs = {0};
+    lpm_packages_parse(&pkgs, &copy);
+
+    LPM_Filter filter = {0};
+    double build_ms = 0;
+    for (size_t run = 0; run < BENCH_RUNS; ++run)
+    {
+        double start = bench_now_ms();
+        lpm_filter_index(&filter, &pkgs);
+        bench_keep(&build_ms, start);
+    }
+    bench_report("index build", build_ms, 0);
+    printf("  %-24s %9.1f KiB\n", "index size",
+           lpm_trigram_index_bytes(&filter.index) / 1024.0);
+
+    bool same = true;
+    LPM_Package_Rows reference = {0}, rows = {0};
+    for (size_t q = 0; q < sizeof(queries) / sizeof(*queries); ++q)
+    {
+        double scan_ms = 0, index_ms = 0;
+        for (size_t run = 0; run < BENCH_RUNS; ++run)
+        {
+            double start = bench_now_ms();
+            bench_filter_reference(&pkgs, queries[q], &reference);
+            bench_keep(&scan_ms, start);
+
+            lpm_filter_invalidate(&filter); // no cached superset to narrow down
+            start = bench_now_ms();
+            lpm_filter_query(&filter, &pkgs, queries[q], &rows);
+            bench_keep(&index_ms, start);
+        }
+        printf("  %-20s %6zu rows  scan %8.3f ms  index %8.3f ms\n", queries[q], rows.count,
+               scan_ms, index_ms);
+        if (rows.count != reference.count ||
+            memcmp(rows.items, reference.items, rows.count * sizeof(*rows.items)) != 0)
+        {
+            fprintf(stderr, "  FAIL: \"%s\" matches other rows than the scan\n", queries[q]);
+            same = false;
+        }
+    }
+    LPM_DA_FREE(reference);
+    LPM_DA_FREE(rows);
+    lpm_filter_teardown(&filter);
+    lpm_packages_teardown(&pkgs);
+    return same;
+}
+
+// Mean time of a run of argv through popen(), which goes through /bin/sh like lazypm used to
+static double bench_spawn_popen_us(char *const argv[])
+{
+    char *cmd = lpm_process_describe(argv);
+    double start = bench_now_ms();
+    for (size_t i = 0; i < BENCH_SPAWNS; ++i)
+    {
+        FILE *fp = popen(cmd, "r");
+        char chunk[4096];
+        while (fp && fread(chunk, 1, sizeof(chunk), fp) > 0)
+            ;
+        if (fp)
+            pclose(fp);
+    }
+    double elapsed_ms = bench_now_ms() - start;
+    LPM_FREE(cmd);
+    return elapsed_ms * 1000.0 / BENCH_SPAWNS;
+}
+
+static double bench_spawn_process_us(char *const argv[])
+{
+    double start = bench_now_ms();
+    for (size_t i = 0; i < BENCH_SPAWNS; ++i)
+    {
+        LPM_Process_Buffer out = {0};
+        lpm_process_run(argv, &out, NULL, NULL);
+        LPM_DA_FREE(out);
+    }
+    return (bench_now_ms() - start) * 1000.0 / BENCH_SPAWNS;
+}
+
+// popen() and fread() into a growing buffer, the capture before lpm_process_run
+static size_t bench_capture_reference(const char *path)
+{
+    char *cmd;
+    lpm_asprintf(&cmd, "cat '%s'", path);
+    FILE *fp = popen(cmd, "r");
+    LPM_FREE(cmd);
+    if (fp == NULL)
+        return 0;
+    LPM_Process_Buffer out = {0};
+    char chunk[64 * 1024];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    {
+        LPM_DA_RESERVE(&out, out.count + n + 1);
+        memcpy(out.items + out.count, chunk, n);
+        out.count += n;
+    }
+    pclose(fp);
+    size_t count = out.count;
+    LPM_DA_FREE(out);
+    return count;
+}
+
+static bool bench_spawn(const Bench_Listing *listing)
+{
+    // a shell script standing in for xbps-query -L, like the fake tools used to try lazypm out
+    const char *dir = getenv("TMPDIR");
+    char *stand_in;
+    lpm_asprintf(&stand_in, "%s/lazypm-bench-query-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(stand_in);
+    const char script[] = "#!/bin/sh\necho ' 12 https://repo-default.voidlinux.org/current "
+                          "(RSA signed)'\n";
+    bool ready = fd != -1 && write(fd, script, sizeof(script) - 1) == sizeof(script) - 1 &&
+                 fchmod(fd, 0755) == 0;
+    if (fd != -1)
+        close(fd);
+
+    char *true_argv[] = {"true", NULL};
+    char *stand_in_argv[] = {stand_in, "-L", NULL};
+    printf("  %-24s %9s %12s\n", "spawn, us per call", "popen", "posix_spawn");
+    printf("  %-24s %9.0f %12.0f\n", "true", bench_spawn_popen_us(true_argv),
+           bench_spawn_process_us(true_argv));
+    if (ready)
+        printf("  %-24s %9.0f %12.0f\n", "shell stand-in -L", bench_spawn_popen_us(stand_in_argv),
+               bench_spawn_process_us(stand_in_argv));
+    else
+        fprintf(stderr, "  failed to write the stand-in \"%s\", skipped\n", stand_in);
+    if (fd != -1)
+        unlink(stand_in);
+    LPM_FREE(stand_in);
+
+    double reference_ms = 0, capture_ms = 0;
+    size_t reference_bytes = 0, bytes = 0;
+    for (size_t run = 0; run < BENCH_RUNS; ++run)
+    {
+        double start = bench_now_ms();
+        reference_bytes = bench_capture_reference(listing->path);
+        bench_keep(&reference_ms, start);
+
+        LPM_Process_Buffer out = {0};
+        char *argv[] = {"cat", listing->path, NULL};
+        start = bench_now_ms();
+        lpm_process_run(argv, &out, NULL, NULL);
+        bench_keep(&capture_ms, start);
+        bytes = out.count;
+        LPM_DA_FREE(out);
+    }
+    bench_report("capture, popen", reference_ms, listing->text.count);
+    bench_report("capture, posix_spawn", capture_ms, listing->text.count);
+    if (bytes != listing->text.count || reference_bytes != listing->text.count)
+    {
+        fprintf(stderr, "  FAIL: captured %zu and %zu bytes of %zu\n", bytes, reference_bytes,
+                listing->text.count);
+        return false;
+    }
+    return true;
+}
+
+// Cut every description of a screenful of rows the way a frame does. ascii false scans the text
+// like a frame would without lpm_packages_measure, bytes cuts by strlen like lazypm used to.
+static size_t bench_frame(const LPM_Packages *pkgs, size_t first, bool ascii, bool bytes)
+{
+    size_t total = 0;
+    for (size_t i = first; i < first + BENCH_FRAME_ROWS && i < pkgs->count; ++i)
+    {
+        const LPM_Package *pkg = &pkgs->items[i];
+        size_t width;
+        if (bytes)
+        {
+            size_t len = strlen(pkg->description);
+            total += len < BENCH_FRAME_COLUMNS ? len : BENCH_FRAME_COLUMNS;
+        }
+        else
+            total += lpm_packages_text_cut(pkg->description, ascii ? pkg->description_ascii : 0,
+                                           BENCH_FRAME_COLUMNS, &width);
+    }
+    return total;
+}
+
+static bool bench_measure(const Bench_Listing *listing)
+{
+    LPM_Process_Buffer copy = bench_copy(listing);
+    LPM_Packages pkgs = {0};
+    lpm_packages_parse(&pkgs, &copy);
+
+    double measure_ms = 0;
+    for (size_t run = 0; run < BENCH_RUNS; ++run)
+    {
+        double start = bench_now_ms();
+        lpm_packages_measure(&pkgs);
+        bench_keep(&measure_ms, start);
+    }
+    bench_report("measure every row", measure_ms, listing->text.count);
+
+    // frames walk down the list so they do not all hit the same rows
+    static const char *const labels[] = {"frame, bytes (us)", "frame, scan (us)",
+                                         "frame, measured (us)"};
+    volatile size_t sink = 0;
+    for (size_t mode = 0; mode < 3; ++mode)
+    {
+        double best_ms = 0;
+        for (size_t run = 0; run < BENCH_RUNS; ++run)
+        {
+            double start = bench_now_ms();
+            for (size_t f = 0; f < BENCH_FRAMES; ++f)
+                sink += bench_frame(&pkgs, (f * BENCH_FRAME_ROWS) % pkgs.count, mode == 2,
+                                    mode == 0);
+            bench_keep(&best_ms, start);
+        }
+        printf("  %-24s %9.1f\n", labels[mode], best_ms * 1000.0 / BENCH_FRAMES);
+    }
+
+    // the precomputed prefix must cut where a scan from the start would, at any width
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pkgs.count; ++i)
+    {
+        const LPM_Package *pkg = &pkgs.items[i];
+        size_t scanned_width;
+        lpm_packages_text_cut(pkg->description, 0, SIZE_MAX, &scanned_width);
+        if (scanned_width != pkg->description_width)
+            mismatches++;
+        for (size_t columns = 1; columns <= 64; columns *= 2)
+        {
+            size_t measured, scanned;
+            if (lpm_packages_text_cut(pkg->description, pkg->description_ascii, columns,
+                                      &measured) !=
+                    lpm_packages_text_cut(pkg->description, 0, columns, &scanned) ||
+                measured != scanned)
+                mismatches++;
+        }
+    }
+    lpm_packages_teardown(&pkgs);
+    if (mismatches > 0)
+        fprintf(stderr, "  FAIL: %zu widths or cuts differ from a scan\n", mismatches);
+    return mismatches == 0;
+}
+
+static const Bench_Case cases[] = {
+    {"parse", "capture and parse the listing through `cat`, end to end", bench_parse},
+    {"parse-threads", "parse the captured listing in place on 1 to 8 threads",
+     bench_parse_threads},
+    {"filter", "build the trigram index and answer queries, against a full scan", bench_filter},
+    {"spawn", "run commands and capture their output, against popen", bench_spawn},
+    {"measure", "measure display widths at load time, and cut rows by them in frames",
+     bench_measure},
+};
+
+int main(int argc, char **argv)
+{
+    size_t rows = BENCH_ROWS;
+    const char *fixture = NULL;
+    const char **selected = calloc(argc, sizeof(*selected));
+    size_t selected_count = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+            rows = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--fixture") == 0 && i + 1 < argc)
+            fixture = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "usage: %s [--rows N] [--fixture PATH] [CASE...]\n", argv[0]);
+            return 1;
+        }
+        else
+            selected[selected_count++] = argv[i];
+    }
+
+    for (size_t s = 0; s < selected_count; ++s)
+    {
+        bool known = false;
+        for (size_t c = 0; c < sizeof(cases) / sizeof(*cases); ++c)
+            known = known || strcmp(selected[s], cases[c].name) == 0;
+        if (!known)
+        {
+            fprintf(stderr, "bench: unknown case \"%s\"\n", selected[s]);
+            return 1;
+        }
+    }
+
+    Bench_Listing listing = {0};
+    if (fixture)
+    {
+        if (!bench_read(&listing, fixture))
+            return 1;
+    }
+    else
+    {
+        bench_generate(&listing, rows);
+        listing.generated = true;
+        if (!bench_write(&listing))
+            return 1;
+    }
+    printf("listing: %zu rows, %.1f MiB%s\n", listing.rows,
+           listing.text.count / (1024.0 * 1024.0), listing.generated ? ", generated" : "");
+
+    size_t failed = 0;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(*cases); ++c)
+    {
+        bool wanted = selected_count == 0;
+        for (size_t s = 0; s < selected_count && !wanted; ++s)
+            wanted = strcmp(selected[s], cases[c].name) == 0;
+        if (!wanted)
+            continue;
+        printf("%s: %s\n", cases[c].name, cases[c].description);
+        if (!cases[c].run(&listing))
+            failed++;
+    }
+
+    if (listing.generated)
+        unlink(listing.path);
+    LPM_FREE(listing.path);
+    LPM_DA_FREE(listing.text);
+    free(selected);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2025 Michael Navarro
+// MIT license, see LICENSE for more
+//
+// version.c - Check lpm_version_compare against known orderings and a reference implementation
+//
+// Built and run by `./build/nob --test`, exits non-zero on the first mismatch.
+//
+
+#include "../src/version.h"
+#include <limits.h>
+#include <strings.h>
+
+// Pairs seeded from the fixed seed below, the same ones on every run
+#define RANDOM_PAIRS 20000
+#define RANDOM_SEED 0x6c617a79706d0001ull
+#define MAX_COMPONENTS 128
+
+typedef struct
+{
+    const char *a;
+    const char *b;
+    int expected;
+} Version_Case;
+
+static const Version_Case cases[] = {
+    {"1.0", "1.0.1", -1},
+    {"1.0_1", "1.0_2", -1},
+    {"1.0_10", "1.0_9", 1},
+    {"1.0alpha", "1.0", -1},
+    {"1.0beta1", "1.0rc1", -1},
+    {"1.0rc1", "1.0", -1},
+    {"1.0pre1", "1.0rc1", 0},
+    {"1.0a", "1.0", 1},
+    {"1.0a", "1.0b", -1},
+    {"1.0.0", "1.0", 0},
+    {"1.0pl1", "1.0.1", 0},
+    {"2.0", "1.99", 1},
+    {"1.0_1", "1.0.1_1", -1},
+    {"1.10", "1.9", 1},
+    {"0.9.9_3", "1.0_1", -1},
+    {"2024.01.05_1", "2023.12.31_4", 1},
+    {"1.2.3rc2_1", "1.2.3_1", -1},
+    {"5.15.2_1", "5.15.10_1", -1},
+    {"1.0alpha2", "1.0alpha10", -1},
+    {"1.0-beta", "1.0beta", 0},
+};
+
+//
+// reference, the array based mkversion/vtest of xbps' lib/dewey.c
+//
+
+typedef struct
+{
+    int values[MAX_COMPONENTS];
+    size_t count;
+    int revision;
+} Version_Reference;
+
+static const struct
+{
+    const char *name;
+    int value;
+} modifiers[] = {
+    {"alpha", -3}, {"beta", -2}, {"pre", -1}, {"rc", -1}, {"pl", 0}, {".", 0},
+};
+
+static void reference_push(Version_Reference *version, int value)
+{
+    if (version->count < MAX_COMPONENTS)
+        version->values[version->count++] = value;
+}
+
+// Numbers past INT_MAX saturate like in lpm_version_compare, xbps would overflow its int
+static int reference_number(const char **p)
+{
+    long long value = 0;
+    while (isdigit((unsigned char)**p))
+    {
+        value = value * 10 + (*(*p)++ - '0');
+        if (value > INT_MAX)
+            value = INT_MAX;
+    }
+    return (int)value;
+}
+
+static void reference_parse(const char *s, Version_Reference *version)
+{
+    *version = (Version_Reference){0};
+    while (*s != '\0')
+    {
+        if (isdigit((unsigned char)*s))
+        {
+            reference_push(version, reference_number(&s));
+            continue;
+        }
+        bool modifier = false;
+        for (size_t i = 0; i < sizeof(modifiers) / sizeof(*modifiers); ++i)
+        {
+            size_t len = strlen(modifiers[i].name);
+            if (strncasecmp(s, modifiers[i].name, len) == 0)
+            {
+                reference_push(version, modifiers[i].value);
+                s += len;
+                modifier = true;
+                break;
+            }
+        }
+        if (modifier)
+            continue;
+        if (*s == '_')
+        {
+            s++;
+            version->revision = reference_number(&s);
+            continue;
+        }
+        if (isalpha((unsigned char)*s))
+        {
+            reference_push(version, 0);
+            reference_push(version, tolower((unsigned char)*s) - 'a' + 1);
+        }
+        s++;
+    }
+}
+
+static int reference_compare(const char *a, const char *b)
+{
+    Version_Reference va, vb;
+    reference_parse(a, &va);
+    reference_parse(b, &vb);
+    size_t count = va.count > vb.count ? va.count : vb.count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int x = i < va.count ? va.values[i] : 0;
+        int y = i < vb.count ? vb.values[i] : 0;
+        if (x != y)
+            return x < y ? -1 : 1;
+    }
+    return (va.revision > vb.revision) - (va.revision < vb.revision);
+}
+
+//
+// random pairs
+//
+
+static uint64_t random_next(uint64_t *state)
+{
+    // xorshift64*, the pairs must not depend on the libc
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dull;
+}
+
+static void random_version(uint64_t *state, char *buffer, size_t size)
+{
+    static const char *atoms[] = {"0",  "1",  "2",   "9",  "10", "99", ".", "_",  "alpha",
+                                  "beta", "rc", "pre", "pl", "a",  "b",  "z", "+", "1.0"};
+    size_t atom_count = sizeof(atoms) / sizeof(*atoms);
+    size_t parts = 1 + random_next(state) % 6;
+    buffer[0] = '\0';
+    for (size_t i = 0; i < parts; ++i)
+        strncat(buffer, atoms[random_next(state) % atom_count], size - strlen(buffer) - 1);
+}
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+static bool check(const char *a, const char *b, int expected)
+{
+    int forward = sign(lpm_version_compare(a, b));
+    int backward = sign(lpm_version_compare(b, a));
+    if (forward == expected && backward == -expected)
+        return true;
+    fprintf(stderr, "FAIL: compare(\"%s\", \"%s\") = %d, reversed %d, expected %d\n", a, b,
+            forward, backward, expected);
+    return false;
+}
+
+int main(void)
+{
+    size_t failed = 0;
+    size_t case_count = sizeof(cases) / sizeof(*cases);
+    for (size_t i = 0; i < case_count; ++i)
+    {
+        if (sign(reference_compare(cases[i].a, cases[i].b)) != cases[i].expected)
+        {
+            fprintf(stderr, "FAIL: the reference disagrees on \"%s\" vs \"%s\"\n", cases[i].a,
+                    cases[i].b);
+            failed++;
+        }
+        if (!check(cases[i].a, cases[i].b, cases[i].expected))
+            failed++;
+    }
+
+    uint64_t state = RANDOM_SEED;
+    char a[128], b[128];
+    for (size_t i = 0; i < RANDOM_PAIRS; ++i)
+    {
+        random_version(&state, a, sizeof(a));
+        // equal versions come up too rarely by chance
+        if (random_next(&state) % 10 == 0)
+            memcpy(b, a, sizeof(b));
+        else
+            random_version(&state, b, sizeof(b));
+        if (!check(a, b, sign(reference_compare(a, b))))
+            failed++;
+    }
+
+    printf("version: %zu fixed cases, %d random pairs, %zu failed\n", case_count, RANDOM_PAIRS,
+           failed);
+    return failed == 0 ? 0 : 1;
+}